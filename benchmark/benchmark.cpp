@@ -13,7 +13,8 @@
 
 PULL_ESC_CORE;
 
-struct update_position
+// The same system as update_position from update.cpp, iterated by hand
+struct update_position_iter
 {
   ECS_RUN(const EventUpdate &evt, const glm::vec3 &vel, glm::vec3 &pos)
   {
@@ -21,27 +22,17 @@ struct update_position
   }
 };
 
-static constexpr ConstComponentDescription update_position_components[] = {
+static constexpr ConstComponentDescription update_position_iter_components[] = {
   {HASH("vel"), ComponentType<glm::vec3>::size, ComponentDescriptionFlags::kNone},
   {HASH("pos"), ComponentType<glm::vec3>::size, ComponentDescriptionFlags::kWrite},
 };
-static constexpr ConstQueryDescription update_position_query_desc = {
-  make_const_array(update_position_components),
+static constexpr ConstQueryDescription update_position_iter_query_desc = {
+  make_const_array(update_position_iter_components),
   empty_desc_array,
   empty_desc_array,
   empty_desc_array,
 };
 
-static void update_position_run(const RawArg &stage_or_event, Query &query)
-{
-  ecs::wait_system_dependencies(HASH("update_position"));
-  for (auto q = query.begin(), e = query.end(); q != e; ++q)
-    update_position::run(*(EventUpdate*)stage_or_event.mem,
-      GET_COMPONENT(update_position, q, glm::vec3, vel),
-      GET_COMPONENT(update_position, q, glm::vec3, pos));
-}
-static SystemDescription _reg_sys_update_position(HASH("update_position"), &update_position_run, HASH("EventUpdate"), update_position_query_desc, "", "");
-
 static void BM_NativeFor(benchmark::State& state)
 {
   const float dt = 1.f / 60.f;
@@ -76,15 +67,18 @@ static void BM_ECS_System(benchmark::State& state)
   }
 
   EventUpdate evt = { 1.f / 60.f, 10.f };
+  RawArg arg(sizeof(evt), (uint8_t*)&evt);
 
-  Query query = ecs::perform_query(update_position_query_desc);
+  // update_position_run generated from update.cpp
+  const System &sys = g_mgr->systems[ecs::get_system_id(HASH("update_position")).index];
+
+  // create_entity_sync does NOT perform queries
+  ecs::perform_query(sys.queryId);
+  Query &query = ecs::get_query(sys.queryId);
 
   while (state.KeepRunning())
   {
-    for (auto q = query.begin(), e = query.end(); q != e; ++q)
-      update_position::run(evt,
-        GET_COMPONENT(update_position, q, glm::vec3, vel),
-        GET_COMPONENT(update_position, q, glm::vec3, pos));
+    sys.sys(arg, query);
   }
 
   for (auto eid : eids)
@@ -93,6 +87,38 @@ static void BM_ECS_System(benchmark::State& state)
 }
 BENCHMARK(BM_ECS_System)->RangeMultiplier(2)->Range(1 << 11, 1 << 20);
 
+static void BM_ECS_SystemIterator(benchmark::State& state)
+{
+  const int count = (int)state.range(0);
+
+  eastl::vector<EntityId> eids;
+
+  for (int leftCount = count; leftCount > 0; leftCount -= 4096)
+  {
+    for (int i = 0; i < eastl::min(leftCount, 4096); ++i)
+      eids.push_back(ecs::create_entity_sync("test", ComponentsMap()));
+    ecs::tick();
+    clear_frame_mem();
+  }
+
+  EventUpdate evt = { 1.f / 60.f, 10.f };
+
+  Query query = ecs::perform_query(update_position_iter_query_desc);
+
+  while (state.KeepRunning())
+  {
+    for (auto q = query.begin(), e = query.end(); q != e; ++q)
+      update_position_iter::run(evt,
+        GET_COMPONENT(update_position_iter, q, glm::vec3, vel),
+        GET_COMPONENT(update_position_iter, q, glm::vec3, pos));
+  }
+
+  for (auto eid : eids)
+    ecs::delete_entity(eid);
+  ecs::tick();
+}
+BENCHMARK(BM_ECS_SystemIterator)->RangeMultiplier(2)->Range(1 << 11, 1 << 20);
+
 static void BM_ECS_UpdateStage(benchmark::State& state)
 {
   const int count = (int)state.range(0);
@@ -254,14 +280,14 @@ static void BM_ECS_JobManager(benchmark::State& state)
 
   EventUpdate evt = { 1.f / 60.f, 10.f };
 
-  Query query = ecs::perform_query(update_position_query_desc);
+  Query query = ecs::perform_query(update_position_iter_query_desc);
 
   jobmanager::callback_t task = [&query, evt](int from, int count)
   {
     for (auto q = query.begin(from), e = query.end(); q != e && count > 0; ++q, --count)
-      update_position::run(evt,
-        GET_COMPONENT(update_position, q, glm::vec3, vel),
-        GET_COMPONENT(update_position, q, glm::vec3, pos));
+      update_position_iter::run(evt,
+        GET_COMPONENT(update_position_iter, q, glm::vec3, vel),
+        GET_COMPONENT(update_position_iter, q, glm::vec3, pos));
   };
 
   const int chunkSize = (int)state.range(1);
@@ -280,6 +306,33 @@ static void BM_ECS_JobManager(benchmark::State& state)
 }
 BENCHMARK(BM_ECS_JobManager)->RangeMultiplier(2)->Ranges({{1 << 11, 1 << 20}, {256, 1024}});
 
+static void BM_JobManagerWakePolicy(benchmark::State& state)
+{
+  static const int count = 1 << 16;
+
+  eastl::vector<int> data;
+  data.resize(count);
+
+  int *dataBegin = data.data();
+  auto task = [dataBegin](int from, int count)
+  {
+    for (int i = from; i < from + count; ++i)
+      dataBegin[i] += i;
+  };
+
+  const auto policy = jobmanager::get_wake_policy();
+  jobmanager::set_wake_policy((jobmanager::WakePolicy)state.range(0));
+
+  while (state.KeepRunning())
+  {
+    jobmanager::add_job(count, 1024, task);
+    jobmanager::wait_all_jobs();
+  }
+
+  jobmanager::set_wake_policy(policy);
+}
+BENCHMARK(BM_JobManagerWakePolicy)->DenseRange(0, 3);
+
 #include <Windows.h>
 
 #include <condition_variable>
@@ -0,0 +1,11 @@
+#include <ecs/ecs.h>
+
+#include <glm/vec3.hpp>
+
+struct update_position
+{
+  ECS_RUN(const EventUpdate &evt, const glm::vec3 &vel, glm::vec3 &pos)
+  {
+    pos += vel * evt.dt;
+  }
+};
@@ -107,6 +107,32 @@ function(das_aot source_files ret)
   SET(${ret} ${result} PARENT_SCOPE)
 endfunction()
 
+# The tool is an executable with the script modules registered, run as: tool --aot <script> <output>
+function(ecs_das_aot tool source_files ret)
+  foreach(src IN LISTS source_files)
+    get_filename_component(source_name ${src} NAME)
+    get_filename_component(source_dir ${src} DIRECTORY)
+    set(target_file "${CMAKE_CURRENT_BINARY_DIR}/aot/${source_name}.aot.cpp")
+
+    # Required modules are not tracked, any script of the directory might be one
+    file(GLOB source_deps "${CMAKE_CURRENT_SOURCE_DIR}/${source_dir}/*.das")
+
+    add_custom_command(
+      OUTPUT ${target_file}
+      COMMAND $<TARGET_FILE:${tool}> --aot ${src} ${target_file}
+      DEPENDS ${tool} ${source_deps}
+      WORKING_DIRECTORY "${CMAKE_CURRENT_SOURCE_DIR}"
+      COMMENT "AOT for ${src}..."
+    )
+
+    list(APPEND result ${target_file})
+
+    set_source_files_properties(${target_file} PROPERTIES LANGUAGE CXX GENERATED TRUE)
+  endforeach()
+
+  SET(${ret} ${result} PARENT_SCOPE)
+endfunction()
+
 function(make_char_array source_files ret)
   set(codegen_exe "${PROJECT_SOURCE_DIR}/bin/codegen.exe")
 
@@ -64,6 +64,39 @@ void makeCharArray(const eastl::string &filename, const eastl::string &arr_name)
   out.close();
 }
 
+static void writeColumns(std::ostream &out, const VisitorState::System &sys, const char *indent)
+{
+  for (int i = 1; i < (int)sys.parameters.size(); ++i)
+  {
+    const auto &p = sys.parameters[i];
+    out << indent << "auto * __restrict " << p.name << "_ = GET_COMPONENT_COLUMN(" << sys.name << ", columns, "
+      << (p.isRW ? "" : "const ") << p.pureType << ", " << p.name << ") + begin;\n";
+  }
+}
+
+// Calls run for count entities from the columns written by writeColumns.
+// ecs_ref and ecs_span resolve to plain references and Span for AoS components and to SoAValue and Lanes for SoA ones.
+static void writeRun(std::ostream &out, const VisitorState::System &sys, const eastl::string &stage, const char *indent)
+{
+  if (sys.chunk)
+  {
+    out << indent << sys.name << "::run(" << stage;
+    for (int i = 1; i < (int)sys.parameters.size(); ++i)
+    {
+      const auto &p = sys.parameters[i];
+      out << ", ecs_span(" << p.name << "_, count)";
+    }
+    out << ");\n";
+    return;
+  }
+
+  out << indent << "for (int i = 0; i < count; ++i)\n";
+  out << indent << "  " << sys.name << "::run(" << stage;
+  for (int i = 1; i < (int)sys.parameters.size(); ++i)
+    out << ", ecs_ref(" << sys.parameters[i].name << "_[i])";
+  out << ");\n";
+}
+
 int main_das(int argc, char * argv[]);
 
 int main(int argc, char* argv[])
@@ -333,6 +366,11 @@ int main(int argc, char* argv[])
           fmt::arg("component", p.name));
       }
       out << "\n>;\n";
+
+      // SoA components have no addressable value, they are copied to value fields
+      for (const auto &p : q.parameters)
+        if (p.type.find('&') != eastl::string::npos)
+          out << "static_assert(!ComponentLayout<" << p.pureType << ">::soa, \"" << q.name << "::" << p.name << ": SoA components can't be bound to reference fields\");\n";
     }
 
     for (const auto &i : state.indices)
@@ -384,10 +422,45 @@ int main(int argc, char* argv[])
     for (const auto &q : persistentQueries)
       out << "static PersistentQueryDescription _reg_query_" << q.name << "(HASH(\"" << basename << "_" << q.name << "\"), " << q.name << "_query_desc, " << (q.filter.empty() ? "nullptr" : q.filter) << ");" << std::endl;
 
+    for (const auto &q : lazyQueries)
+      out << "static LazyQueryDescription _reg_lazy_query_" << q.name << "(" << q.name << "_query_desc, " << (q.filter.empty() ? "nullptr" : q.filter) << ");" << std::endl;
+
+    out << std::endl;
+
+    // QL_WHERE ranges, the query takes candidates from an ordered index of the component if there is one at runtime
+    for (const auto &q : persistentQueries)
+      for (const auto &r : q.ranges)
+        out << "static OrderedQueryPlan _plan_" << q.name << "_" << r.component << "(HASH(\"" << basename << "_" << q.name << "\"), HASH(\"" << r.component << "\"), " << r.expr << ");" << std::endl;
+    for (const auto &sys : state.systems)
+      for (const auto &r : sys.ranges)
+        out << "static OrderedQueryPlan _plan_" << sys.name << "_" << r.component << "(HASH(\"" << sys.name << "\"), HASH(\"" << r.component << "\"), " << r.expr << ");" << std::endl;
+
     out << std::endl;
 
     for (const auto &i : state.indices)
-      out << "static IndexDescription _reg_index_" << i.name << "(HASH(\"" << basename << "_" << i.name << "\"), " << "HASH(\"" << i.componentName << "\"), " << i.name << "_query_desc, " << (i.filter.empty() ? "nullptr" : i.filter) << ");" << std::endl;
+    {
+      // Hashed keys, see is_hash_join_key
+      if (!i.ordered && !i.spatial)
+        for (const auto &k : i.keyComponents)
+          for (const auto &p : i.parameters)
+            if (p.name == k)
+              out << "static_assert(is_hash_join_key<" << p.pureType << ">::value, \"" << i.name << ": " << k << " can't be an index key, only integral, enum and EntityId components can\");" << std::endl;
+
+      if (i.ordered)
+        out << "static OrderedIndexDescription _reg_ordered_index_" << i.name << "(HASH(\"" << basename << "_" << i.name << "\"), " << "HASH(\"" << i.componentName << "\"), &ordered_key<" << i.keyType << ">, " << i.name << "_query_desc);" << std::endl;
+      else if (i.spatial)
+        out << "static SpatialIndexDescription _reg_spatial_index_" << i.name << "(HASH(\"" << basename << "_" << i.name << "\"), " << "HASH(\"" << i.componentName << "\"), " << i.cellSize << ", " << i.name << "_query_desc, " << (i.filter.empty() ? "nullptr" : i.filter) << ");" << std::endl;
+      else if (i.keyComponents.size() > 1)
+      {
+        out << "static constexpr ConstHashedString " << i.name << "_keys[] = {";
+        for (int k = 0; k < (int)i.keyComponents.size(); ++k)
+          out << (k != 0 ? ", " : " ") << "HASH(\"" << i.keyComponents[k] << "\")";
+        out << " };" << std::endl;
+        out << "static IndexDescription _reg_index_" << i.name << "(HASH(\"" << basename << "_" << i.name << "\"), " << "make_const_array(" << i.name << "_keys), " << i.name << "_query_desc, " << (i.filter.empty() ? "nullptr" : i.filter) << ");" << std::endl;
+      }
+      else
+        out << "static IndexDescription _reg_index_" << i.name << "(HASH(\"" << basename << "_" << i.name << "\"), " << "HASH(\"" << i.componentName << "\"), " << i.name << "_query_desc, " << (i.filter.empty() ? "nullptr" : i.filter) << ");" << std::endl;
+    }
 
     out << std::endl;
 
@@ -395,7 +468,7 @@ int main(int argc, char* argv[])
     {
       out << "template <typename Callable> void " << q.name << "::perform(Callable callback)\n";
       out << "{\n";
-      out << "  Query query = ecs::perform_query(" << q.name << "_query_desc);\n";
+      out << "  Query &query = ecs::perform_cached_query(_reg_lazy_query_" << q.name << ");\n";
       out << "  for (auto q = query.begin(), e = query.end(); q != e; ++q)\n";
       out << "    callback(\n";
       out << "    {\n      ";
@@ -444,6 +517,59 @@ int main(int argc, char* argv[])
         out << "  return nullptr;\n";
       out << "}\n";
 
+      out << "OrderedIndex* " << q.name << "::ordered_index()\n";
+      out << "{\n";
+      if (q.orderedIndexId >= 0)
+      {
+        const auto &i = state.indices[q.orderedIndexId];
+        out << "  return ecs::find_ordered_index(HASH(\"" << basename << "_" << i.name << "\"));\n";
+      }
+      else
+        out << "  return nullptr;\n";
+      out << "}\n";
+
+      if (q.orderedIndexId >= 0)
+      {
+        out << "template <typename Callable> void " << q.name << "::foreach_in_range(const OrderedRange &range, Callable callback)\n";
+        out << "{\n";
+        out << "  ordered_index()->forEachInRange(range, [&](QueryIterator &iter) { callback(get(iter)); });\n";
+        out << "}\n";
+
+        out << "template <typename Callable> void " << q.name << "::foreach_first(int count, Callable callback)\n";
+        out << "{\n";
+        out << "  ordered_index()->forEachFirst(count, [&](QueryIterator &iter) { callback(get(iter)); });\n";
+        out << "}\n";
+
+        out << "template <typename Callable> void " << q.name << "::foreach_last(int count, Callable callback)\n";
+        out << "{\n";
+        out << "  ordered_index()->forEachLast(count, [&](QueryIterator &iter) { callback(get(iter)); });\n";
+        out << "}\n";
+      }
+
+      out << "SpatialIndex* " << q.name << "::spatial_index()\n";
+      out << "{\n";
+      if (q.spatialIndexId >= 0)
+      {
+        const auto &i = state.indices[q.spatialIndexId];
+        out << "  return ecs::find_spatial_index(HASH(\"" << basename << "_" << i.name << "\"));\n";
+      }
+      else
+        out << "  return nullptr;\n";
+      out << "}\n";
+
+      if (q.spatialIndexId >= 0)
+      {
+        out << "template <typename Callable> void " << q.name << "::foreach_in_radius(const glm::vec2 &center, float radius, Callable callback)\n";
+        out << "{\n";
+        out << "  spatial_index()->forEachInRadius(center, radius, [&](QueryIterator &iter) { callback(get(iter)); });\n";
+        out << "}\n";
+
+        out << "template <typename Callable> void " << q.name << "::foreach_in_aabb(const glm::vec2 &min, const glm::vec2 &max, Callable callback)\n";
+        out << "{\n";
+        out << "  spatial_index()->forEachInAabb(min, max, [&](QueryIterator &iter) { callback(get(iter)); });\n";
+        out << "}\n";
+      }
+
       out << q.name << " " << q.name << "::get(QueryIterator &iter)\n";
       out << "{\n";
       out << "  return {\n      ";
@@ -550,8 +676,9 @@ int main(int argc, char* argv[])
         fmt::arg("basename", basename),
         fmt::arg("index", index.name));
 
-      out << "  for (const Index::Item &item : index.items)\n";
-      out << fmt::format("    {system}::run(*({stage}*)stage_or_event.mem, *({indexType}*)(uint8_t*)&item.value, QueryIterable<{query}, {query}Builder>(index.queries[item.queryId]));\n",
+      out << "  for (int itemId = 0; itemId < index.itemsCount(); ++itemId)\n";
+      out << "    if (IndexBucket bucket = index.bucket(itemId))\n";
+      out << fmt::format("      {system}::run(*({stage}*)stage_or_event.mem, *({indexType}*)index.keys[itemId].data, QueryIterable<{query}, {query}Builder>(bucket.begin(), bucket.end(), bucket.entitiesCount));\n",
         fmt::arg("system", sys.name),
         fmt::arg("query", query.name),
         fmt::arg("stage", sys.parameters[0].pureType),
@@ -594,9 +721,8 @@ int main(int argc, char* argv[])
         }
         else
         {
-          out << indent << "if (Query *pquery" << i << " = index.find(*(uint32_t*)(uint8_t*)&" << index.lookup << "))\n";
+          out << indent << "if (IndexBucket query" << i << " = index.find(" << index.lookup << "))\n";
           out << indent << "{\n";
-          out << indent << "  Query &query" << i << " = *pquery" << i << ";\n";
           out << indent << "  for (auto q" << i << " = query" << i << ".begin(), e = query" << i << ".end(); q" << i << " != e; ++q" << i << ")\n";
           out << indent << "  {\n";
           indent += "  ";
@@ -651,6 +777,12 @@ int main(int argc, char* argv[])
         fmt::arg("after", sys.afterStr));
     }
 
+    auto findParameter = [](const VisitorState::Query &q, const eastl::string &name) -> const VisitorState::Parameter*
+    {
+      auto res = eastl::find_if(q.parameters.begin(), q.parameters.end(), [&](const VisitorState::Parameter &p) { return p.name == name; });
+      return res != q.parameters.end() ? res : nullptr;
+    };
+
     for (const auto &sys : systemsJoinQueries)
     {
       out << fmt::format("static void {system}_run(const RawArg &stage_or_event, Query&)\n", fmt::arg("system", sys.name));
@@ -666,6 +798,55 @@ int main(int argc, char* argv[])
         out << "  Query &query" << i << " = ecs::get_query(_reg_query_"<< q.name << ".queryId);" << std::endl;
       }
 
+      // Equi-join on keys of the same type, equi_join falls back to a nested loop for keys that can't be hashed
+      const VisitorState::Parameter *joinKey1 = nullptr;
+      const VisitorState::Parameter *joinKey2 = nullptr;
+      if (!sys.joinKey1.empty())
+      {
+        joinKey1 = findParameter(state.queries[sys.parameters[1].queryId], sys.joinKey1);
+        joinKey2 = findParameter(state.queries[sys.parameters[2].queryId], sys.joinKey2);
+        if (!joinKey1 || !joinKey2 || joinKey1->pureType != joinKey2->pureType)
+          joinKey1 = joinKey2 = nullptr;
+      }
+
+      if (joinKey1)
+      {
+        const auto &q1 = state.queries[sys.parameters[1].queryId];
+        const auto &q2 = state.queries[sys.parameters[2].queryId];
+
+        out << "  equi_join<" << joinKey1->pureType << ">(query1, INDEX_OF_COMPONENT(" << q1.name << ", " << joinKey1->name << "), query2, INDEX_OF_COMPONENT(" << q2.name << ", " << joinKey2->name << "), [&](QueryIterator &q1, QueryIterator &q2)\n";
+        out << "  {\n";
+        for (int i = 1; i < (int)sys.parameters.size(); ++i)
+        {
+          const auto &q = state.queries[sys.parameters[i].queryId];
+          out << "    " << q.name << " " << sys.parameters[i].name << " =\n";
+          out << "    {\n";
+          for (int j = 0; j < (int)q.parameters.size(); ++j)
+          {
+            const auto &p = q.parameters[j];
+            if (j != 0)
+              out << ",\n";
+            out << "      GET_COMPONENT(" << q.name << ", q" << i << ", " << p.pureType << ", " << p.name << ")";
+          }
+          out << "\n";
+          out << "    };\n";
+        }
+        out << "    if (" << sys.filter << ")\n";
+        out << "      " << sys.name << "::run(*(" << sys.parameters[0].pureType << "*)stage_or_event.mem";
+        for (int i = 1; i < (int)sys.parameters.size(); ++i)
+          out << ", eastl::move(" << sys.parameters[i].name << ")";
+        out << ");\n";
+        out << "  });\n";
+        out << "}\n";
+
+        out << fmt::format("static SystemDescription _reg_sys_{system}(HASH(\"{system}\"), &{system}_run, HASH(\"{stage}\"), \"{before}\", \"{after}\");\n\n",
+          fmt::arg("system", sys.name),
+          fmt::arg("stage", sys.parameters[0].pureType),
+          fmt::arg("before", sys.beforeStr),
+          fmt::arg("after", sys.afterStr));
+        continue;
+      }
+
       std::string indent = "  ";
       for (int i = 1; i < (int)sys.parameters.size(); ++i)
       {
@@ -756,14 +937,15 @@ int main(int argc, char* argv[])
       out << fmt::format("static void {system}_run(const RawArg &stage_or_event, Query &query)\n", fmt::arg("system", sys.name));
       out << "{\n";
       out << "  ecs::wait_system_dependencies(HASH(\"" << sys.name << "\"));\n";
-      out << "  for (auto q = query.begin(), e = query.end(); q != e; ++q)\n";
-      out << "    " << sys.name << "::run(*(" << sys.parameters[0].pureType << "*)stage_or_event.mem";
-      for (int i = 1; i < (int)sys.parameters.size(); ++i)
-      {
-        const auto &p = sys.parameters[i];
-        out << ",\n      GET_COMPONENT(" << sys.name << ", q, " << p.pureType << ", " << p.name << ")";
-      }
-      out << ");" << std::endl;
+      out << "  auto &stage = *(" << sys.parameters[0].pureType << "*)stage_or_event.mem;\n";
+      out << "  for (auto chunk = query.beginChunk(), chunkEnd = query.endChunk(); chunk != chunkEnd; ++chunk)\n";
+      out << "  {\n";
+      out << "    uint8_t * __restrict * __restrict columns = *chunk;\n";
+      out << "    const int begin = chunk.begin();\n";
+      out << "    const int count = chunk.end() - begin;\n";
+      writeColumns(out, sys, "    ");
+      writeRun(out, sys, "stage", "    ");
+      out << "  }\n";
       out << "}\n";
 
       out << fmt::format("static SystemDescription _reg_sys_{system}(HASH(\"{system}\"), &{system}_run, HASH(\"{stage}\"), {system}_query_desc, \"{before}\", \"{after}\", {filter});\n\n",
@@ -778,21 +960,11 @@ int main(int argc, char* argv[])
     {
       out << fmt::format("static void {system}_run(const RawArg &stage_or_event, Query &query)\n", fmt::arg("system", sys.name));
       out << "{\n";
-      out << "  auto job = jobmanager::add_job(query.entitiesCount, " << sys.chunkSize << ", [&](int from, int count)\n";
+      out << "  ecs::parallel_for(query, " << sys.chunkSize << ", [&](uint8_t * __restrict * __restrict columns, int begin, int count)\n";
       out << "  {\n";
-      out << "    auto begin = query.begin(from);\n";
-      out << "    auto end = query.begin(from + count);\n";
-      out << "    for (auto q = begin, e = end; q != e; ++q)\n";
-      out << "      " << sys.name << "::run(*(" << sys.parameters[0].pureType << "*)stage_or_event.mem";
-      for (int i = 1; i < (int)sys.parameters.size(); ++i)
-      {
-        const auto &p = sys.parameters[i];
-        out << ",\n        GET_COMPONENT(" << sys.name << ", q, " << p.pureType << ", " << p.name << ")";
-      }
-      out << ");\n";
+      writeColumns(out, sys, "    ");
+      writeRun(out, sys, "*(" + sys.parameters[0].pureType + "*)stage_or_event.mem", "    ");
       out << "  });\n";
-      out << "  jobmanager::start_jobs();\n";
-      out << "  jobmanager::wait(job);\n";
       out << "}\n";
 
       out << fmt::format("static SystemDescription _reg_sys_{system}(HASH(\"{system}\"), &{system}_run, HASH(\"{stage}\"), {system}_query_desc, \"{before}\", \"{after}\", {filter});\n\n",
@@ -811,16 +983,11 @@ int main(int argc, char* argv[])
       out << "  auto stage = *(" << sys.parameters[0].pureType << "*)stage_or_event.mem;\n";
       out << "  jobmanager::callback_t task = [&query, stage](int from, int count)\n";
       out << "  {\n";
-      out << "    auto begin = query.begin(from);\n";
-      out << "    auto end = query.begin(from + count);\n";
-      out << "    for (auto q = begin, e = end; q != e; ++q)\n";
-      out << "      " << sys.name << "::run(stage";
-      for (int i = 1; i < (int)sys.parameters.size(); ++i)
-      {
-        const auto &p = sys.parameters[i];
-        out << ",\n        GET_COMPONENT(" << sys.name << ", q, " << p.pureType << ", " << p.name << ")";
-      }
-      out << ");\n";
+      out << "    query.forEachChunk(from, count, [&](uint8_t * __restrict * __restrict columns, int begin, int count)\n";
+      out << "    {\n";
+      writeColumns(out, sys, "      ");
+      writeRun(out, sys, "stage", "      ");
+      out << "    });\n";
       out << "  };\n";
       out << "  ecs::set_system_job(sid, " << sys.name << "::addJobs(eastl::move(ecs::get_system_dependency_list(sid)), eastl::move(task), query.entitiesCount));\n";
       out << "  jobmanager::start_jobs();\n";
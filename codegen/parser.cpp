@@ -504,11 +504,15 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
     bool isLazyQuery = false;
     bool isSystem = false;
     bool isSystemInJobs = false;
+    bool isSystemChunk = false;
+    bool isSystemChunkInJobs = false;
     bool isBarrier = false;
     foreach_struct_decl(cursor, [&isQuery]       (CXCursor, const eastl::string &name) { if (name == "ecs_query") isQuery = true; });
     foreach_struct_decl(cursor, [&isLazyQuery]   (CXCursor, const eastl::string &name) { if (name == "ecs_lazy_query") isLazyQuery = true; });
     foreach_struct_decl(cursor, [&isSystem]      (CXCursor, const eastl::string &name) { if (name == "ecs_system") isSystem = true; });
     foreach_struct_decl(cursor, [&isSystemInJobs](CXCursor, const eastl::string &name) { if (name == "ecs_system_in_jobs") isSystemInJobs = true; });
+    foreach_struct_decl(cursor, [&isSystemChunk] (CXCursor, const eastl::string &name) { if (name == "ecs_system_chunk") isSystemChunk = true; });
+    foreach_struct_decl(cursor, [&isSystemChunkInJobs](CXCursor, const eastl::string &name) { if (name == "ecs_system_chunk_in_jobs") isSystemChunkInJobs = true; });
     foreach_struct_decl(cursor, [&isBarrier]     (CXCursor, const eastl::string &name) { if (name == "ecs_barrier") isBarrier = true; });
 
     if (isQuery || isLazyQuery)
@@ -542,7 +546,11 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
           read_struct_fields(cursor, fields);
 
           QueryComponents outComps;
-          q.filter = parse_where_query(fields[0].value, outComps);
+          QueryRanges outRanges;
+          q.filter = parse_where_query(fields[0].value, outComps, outRanges);
+
+          for (const auto &r : outRanges)
+            q.ranges.push_back({ r.component, r.expr });
 
           for (const auto &c : outComps)
           {
@@ -563,8 +571,11 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
           eastl::vector<VisitorState::Parameter> fields;
           read_struct_fields(cursor, fields);
 
+          // QL_INDEX(a, b) makes a composite key
           eastl::string indexComponent = fields[0].name;
-          eastl::string indexName = "index_by_" + q.name + "_" + indexComponent;
+          eastl::string indexName = "index_by_" + q.name;
+          for (const auto &f : fields)
+            indexName += "_" + f.name;
 
           auto indexRes = eastl::find_if(state.indices.begin(), state.indices.end(), [&] (const VisitorState::Index &i) { return i.name == indexName; });
           if (indexRes != state.indices.end())
@@ -590,23 +601,72 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
           i.notHave = q.notHave;
           i.filter = q.filter;
 
-          auto componentRes = eastl::find_if(i.parameters.begin(), i.parameters.end(), [&] (const VisitorState::Parameter &p) { return p.name == indexComponent; });
-          auto haveRes = eastl::find_if(i.have.begin(), i.have.end(), [&] (const VisitorState::Parameter &p) { return p.name == indexComponent; });
-          if (componentRes == i.parameters.end() && haveRes == i.have.end())
+          for (const auto &f : fields)
           {
-            auto &p = i.have.emplace_back();
-            p.name = i.componentName;
+            i.keyComponents.push_back(f.name);
+
+            auto componentRes = eastl::find_if(i.parameters.begin(), i.parameters.end(), [&] (const VisitorState::Parameter &p) { return p.name == f.name; });
+            auto haveRes = eastl::find_if(i.have.begin(), i.have.end(), [&] (const VisitorState::Parameter &p) { return p.name == f.name; });
+            if (componentRes == i.parameters.end() && haveRes == i.have.end())
+            {
+              auto &p = i.have.emplace_back();
+              p.name = f.name;
+            }
           }
         }
+        else if (name == "ql_spatial_index")
+        {
+          eastl::vector<VisitorState::Parameter> fields;
+          read_struct_fields(cursor, fields);
+
+          q.spatialIndexId = state.indices.size();
+          auto &i = state.indices.push_back();
+
+          i.name = "spatial_index_by_" + q.name + "_" + fields[0].name;
+          i.componentName = fields[0].name;
+          i.spatial = true;
+          i.cellSize = fields[1].value;
+          i.parameters = q.parameters;
+          i.have = q.have;
+          i.notHave = q.notHave;
+          i.filter = q.filter;
+
+          auto componentRes = eastl::find_if(i.parameters.begin(), i.parameters.end(), [&] (const VisitorState::Parameter &p) { return p.name == i.componentName; });
+          auto haveRes = eastl::find_if(i.have.begin(), i.have.end(), [&] (const VisitorState::Parameter &p) { return p.name == i.componentName; });
+          if (componentRes == i.parameters.end() && haveRes == i.have.end())
+            i.have.emplace_back().name = i.componentName;
+        }
+        else if (name == "ql_ordered_index")
+        {
+          eastl::vector<VisitorState::Parameter> fields;
+          read_struct_fields(cursor, fields);
+
+          q.orderedIndexId = state.indices.size();
+          auto &i = state.indices.push_back();
+
+          i.name = "ordered_index_by_" + q.name + "_" + fields[0].name;
+          i.componentName = fields[0].name;
+          i.ordered = true;
+          i.parameters = q.parameters;
+          i.have = q.have;
+          i.notHave = q.notHave;
+          // No filter, so the index can serve QL_WHERE ranges of other queries
+
+          // The key is read as a parameter of the query
+          auto componentRes = eastl::find_if(i.parameters.begin(), i.parameters.end(), [&] (const VisitorState::Parameter &p) { return p.name == i.componentName; });
+          assert(componentRes != i.parameters.end());
+          i.keyType = componentRes->pureType;
+        }
       });
     }
 
-    if (isSystem || isSystemInJobs || isBarrier)
+    if (isSystem || isSystemInJobs || isSystemChunk || isSystemChunkInJobs || isBarrier)
     {
       auto structName = to_string(clang_getCursorSpelling(cursor));
       auto &s = state.systems.push_back();
       s.name = eastl::move(structName);
-      s.inJobs = isSystemInJobs;
+      s.inJobs = isSystemInJobs || isSystemChunkInJobs;
+      s.chunk = isSystemChunk || isSystemChunkInJobs;
       s.isBarrier = isBarrier;
 
       if (s.inJobs)
@@ -631,26 +691,43 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
         assert(!clang_equalCursors(runCursor, clang_getNullCursor()));
 
         read_function_params(runCursor, s.parameters);
+
+        // Span<const T> or Lanes<const T> -> T
+        if (s.chunk)
+          for (int i = 1; i < (int)s.parameters.size(); ++i)
+          {
+            auto &p = s.parameters[i];
+            const auto b = p.type.find('<');
+            const auto e = p.type.rfind('>');
+            assert((p.type.find("Span<") != eastl::string::npos || p.type.find("Lanes<") != eastl::string::npos) && b != eastl::string::npos && e != eastl::string::npos);
+
+            const eastl::string elementType = p.type.substr(b + 1, e - b - 1);
+            p.pureType = std::regex_replace(elementType.c_str(), std::regex("(?:const|\\&|(?:\\s+))"), "").c_str();
+            p.isRW = elementType.find("const ") == eastl::string::npos;
+          }
       }
 
-      for (const auto &p : s.parameters)
-        if (!p.templateRef.empty() && s.parameters.size() >= 3)
-        {
-          s.indexId = state.indices.size();
-          auto &i = state.indices.push_back();
+      // Span<T> and Lanes<T> of chunk systems are template refs too, not an index query
+      if (!s.chunk)
+        for (const auto &p : s.parameters)
+          if (!p.templateRef.empty() && s.parameters.size() >= 3)
+          {
+            s.indexId = state.indices.size();
+            auto &i = state.indices.push_back();
 
-          auto indexComponent = s.parameters[1].name;
-          auto queryName = p.templateRef;
-          auto res = eastl::find_if(state.queries.begin(), state.queries.end(), [&] (const VisitorState::Query &q) { return q.name == queryName; });
-          assert(res != state.queries.end());
+            auto indexComponent = s.parameters[1].name;
+            auto queryName = p.templateRef;
+            auto res = eastl::find_if(state.queries.begin(), state.queries.end(), [&] (const VisitorState::Query &q) { return q.name == queryName; });
+            assert(res != state.queries.end());
 
-          i.name = "index_by_" + queryName + "_" + indexComponent;
-          i.componentName = indexComponent;
-          i.parameters = res->parameters;
-          i.filter = res->filter;
+            i.name = "index_by_" + queryName + "_" + indexComponent;
+            i.componentName = indexComponent;
+            i.keyComponents.push_back(indexComponent);
+            i.parameters = res->parameters;
+            i.filter = res->filter;
 
-          break;
-        }
+            break;
+          }
 
       CXCursor systemCursor = cursor;
       foreach_struct_decl(cursor, [&](CXCursor cursor, const eastl::string &name)
@@ -675,7 +752,11 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
           read_struct_fields(cursor, fields);
 
           QueryComponents outComps;
-          s.filter = parse_where_query(fields[0].value, outComps);
+          QueryRanges outRanges;
+          s.filter = parse_where_query(fields[0].value, outComps, outRanges);
+
+          for (const auto &r : outRanges)
+            s.ranges.push_back({ r.component, r.expr });
 
           for (const auto &c : outComps)
           {
@@ -697,6 +778,36 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
           read_struct_fields(cursor, fields);
 
           s.filter = fields[0].value;
+
+          // Any `first.x == second.y` conjunct makes it an equi-join, the whole expression is still checked for every pair
+          if (s.parameters.size() == 3 && s.filter.find("||") == eastl::string::npos)
+          {
+            const std::string expr = s.filter.c_str();
+            const std::regex conjunctRe("[^&]+");
+            const std::regex equalRe("^[\\s(]*(\\w+)\\.(\\w+)\\s*==\\s*(\\w+)\\.(\\w+)[\\s)]*$");
+            for (auto it = std::sregex_iterator(expr.begin(), expr.end(), conjunctRe); it != std::sregex_iterator(); ++it)
+            {
+              const std::string conjunct = it->str();
+              std::smatch m;
+              if (!std::regex_match(conjunct, m, equalRe))
+                continue;
+
+              const eastl::string &first = s.parameters[1].name;
+              const eastl::string &second = s.parameters[2].name;
+              if (first == m[1].str().c_str() && second == m[3].str().c_str())
+              {
+                s.joinKey1 = m[2].str().c_str();
+                s.joinKey2 = m[4].str().c_str();
+                break;
+              }
+              if (second == m[1].str().c_str() && first == m[3].str().c_str())
+              {
+                s.joinKey1 = m[4].str().c_str();
+                s.joinKey2 = m[2].str().c_str();
+                break;
+              }
+            }
+          }
         }
         else if (name == "ql_index")
         {
@@ -717,7 +828,12 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
 
           eastl::string indexComponent = fields[0].name;
           eastl::string queryName = fields[0].pureType;
-          eastl::string indexName = "index_by_" + queryName + "_" + indexComponent;
+          eastl::string indexName = "index_by_" + queryName;
+          for (const auto &f : fields)
+          {
+            assert(f.pureType == queryName);
+            indexName += "_" + f.name;
+          }
 
           auto indexRes = eastl::find_if(state.indices.begin(), state.indices.end(), [&] (const VisitorState::Index &i) { return i.name == indexName; });
           if (indexRes != state.indices.end())
@@ -741,6 +857,8 @@ static CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData
 
           i.name = indexName;
           i.componentName = indexComponent;
+          for (const auto &f : fields)
+            i.keyComponents.push_back(f.name);
           i.parameters = res->parameters;
           i.filter = res->filter;
           i.lookup = lookup;
@@ -22,6 +22,13 @@ struct VisitorState
     Parameter() = default;
   };
 
+  // OrderedRange a QL_WHERE clause implies for the component
+  struct Range
+  {
+    eastl::string component;
+    eastl::string expr;
+  };
+
   struct Function
   {
     int indexId = -1;
@@ -35,6 +42,7 @@ struct VisitorState
     eastl::vector<Parameter> have;
     eastl::vector<Parameter> notHave;
     eastl::vector<Parameter> track;
+    eastl::vector<Range> ranges;
   };
 
   struct System : Function
@@ -42,7 +50,12 @@ struct VisitorState
     bool fromQuery = false;
     bool inJobs = false;
     bool addJobs = false;
+    // run is called once per chunk with Span<T> of every component
+    bool chunk = false;
     bool isBarrier = false;
+    // QL_JOIN(a.x == b.y), components of the first and the second joined query that make an equi-join
+    eastl::string joinKey1;
+    eastl::string joinKey2;
     eastl::string chunkSize;
     eastl::vector<eastl::string> before;
     eastl::vector<eastl::string> after;
@@ -60,6 +73,8 @@ struct VisitorState
   {
     bool empty = false;
     bool lazy = false;
+    int spatialIndexId = -1;
+    int orderedIndexId = -1;
     CXCursor cursor;
     eastl::string components;
   };
@@ -67,7 +82,14 @@ struct VisitorState
   struct Index : Query
   {
     eastl::string componentName;
+    eastl::vector<eastl::string> keyComponents;
     eastl::string lookup;
+    // QL_SPATIAL_INDEX, componentName is the position
+    bool spatial = false;
+    eastl::string cellSize;
+    // QL_ORDERED_INDEX, componentName is the key of keyType
+    bool ordered = false;
+    eastl::string keyType;
   };
 
   struct Component
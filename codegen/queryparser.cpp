@@ -22,6 +22,16 @@ enum class order : int
 {
 };
 
+// `component op value`
+struct range_desc
+{
+  eastl::string component;
+  eastl::string op;
+  eastl::string value;
+};
+
+using ranges_t = eastl::vector<range_desc>;
+
 struct operand
 {
   enum class Type
@@ -35,14 +45,40 @@ struct operand
 
   Type type;
   eastl::string value;
+  // Conjuncts the operand implies
+  ranges_t ranges;
 };
 
 struct op
 {
   order p;
+  eastl::string name;
   eastl::function<eastl::string (const operand&, const operand&)> f;
 };
 
+static bool is_number(const operand &o)
+{
+  return o.type == operand::Type::INTEGER || o.type == operand::Type::REAL;
+}
+
+// Comparison of a component with a number, the component is always on the left in the result
+static bool make_range(const eastl::string &op_name, const operand &l, const operand &r, range_desc &range)
+{
+  static const char *ops[][2] = { { "<", ">" }, { "<=", ">=" }, { ">", "<" }, { ">=", "<=" }, { "==", "==" } };
+  for (const auto &o : ops)
+    if (op_name == o[0])
+    {
+      if (l.type == operand::Type::COMPONENT && is_number(r))
+        range = { l.value, o[0], r.value };
+      else if (is_number(l) && r.type == operand::Type::COMPONENT)
+        range = { r.value, o[1], l.value };
+      else
+        return false;
+      return true;
+    }
+  return false;
+}
+
 struct component_desc
 {
   operand::Type type;
@@ -68,6 +104,11 @@ struct stack
     m_l.push_back({t, s});
   }
 
+  void push(const operand &o)
+  {
+    m_l.push_back(o);
+  }
+
   operand finish(components_t &components)
   {
     while (!m_o.empty())
@@ -101,8 +142,9 @@ private:
       for (auto &c : components)
         if (c.name == r.value)
         {
-          assert(c.type == operand::Type::COMPONENT);
-          c.type = l.type;
+          // The first comparison gives the type when the component is used several times, e.g. in a range
+          if (c.type == operand::Type::COMPONENT)
+            c.type = l.type;
           break;
         }
     }
@@ -111,13 +153,25 @@ private:
       for (auto &c : components)
         if (c.name == l.value)
         {
-          assert(c.type == operand::Type::COMPONENT);
-          c.type = r.type;
+          // The first comparison gives the type when the component is used several times, e.g. in a range
+          if (c.type == operand::Type::COMPONENT)
+            c.type = r.type;
           break;
         }
     }
 
-    m_l.push_back({operand::Type::RESULT, "(" + o.f(l, r) + ")"});
+    operand res = {operand::Type::RESULT, "(" + o.f(l, r) + ")"};
+
+    range_desc range;
+    if (make_range(o.name, l, r, range))
+      res.ranges.push_back(range);
+    else if (o.name == "&&")
+    {
+      res.ranges = l.ranges;
+      res.ranges.insert(res.ranges.end(), r.ranges.begin(), r.ranges.end());
+    }
+
+    m_l.push_back(res);
   }
 };
 
@@ -150,7 +204,7 @@ struct stacks
     assert(m_v.size() > 1);
     const auto r = m_v.back().finish(components);
     m_v.pop_back();
-    m_v.back().push(r.value, r.type);
+    m_v.back().push(r);
   }
 
   operand finish(components_t &components)
@@ -181,7 +235,7 @@ struct operators
   void insert(const std::string &name, const order p, const eastl::function<eastl::string(const operand&, const operand&)> &f)
   {
     assert(!name.empty());
-    m_ops.insert({name, {p, f}});
+    m_ops.insert({name, {p, name.c_str(), f}});
   }
 
   const std::map<std::string, op> &ops() const
@@ -254,7 +308,8 @@ struct digits : plus<abnf::DIGIT> {};
 struct exp : seq<one<'e', 'E'>, opt<one<'-', '+'>>, must<digits>> {};
 struct frac : if_must<one<'.'>, digits> {};
 struct int_ : sor<one<'0'>, seq<one<'-'>, digits>, digits> {};
-struct real : seq<opt<one<'-'>>, int_, opt<frac>, opt<exp>> {};
+// Fraction or exponent is required, otherwise it's an integer
+struct real : seq<opt<one<'-'>>, int_, sor<seq<frac, opt<exp>>, exp>> {};
 
 struct true_ : string<'t', 'r', 'u', 'e'> {};
 struct false_ : string<'f', 'a', 'l', 's', 'e'> {};
@@ -273,7 +328,7 @@ struct bracket : if_must<one<'('>, expression, one<')'>>
 {
 };
 
-struct atomic : sor<integer, real, boolean, component, bracket>
+struct atomic : sor<real, integer, boolean, component, bracket>
 {
 };
 
@@ -354,7 +409,26 @@ struct action<one<')'>>
 
 }
 
+static eastl::string range_expr(const queryparser::range_desc &range)
+{
+  if (range.op == "<")
+    return "OrderedRange::less(" + range.value + ")";
+  if (range.op == "<=")
+    return "OrderedRange::lessEqual(" + range.value + ")";
+  if (range.op == ">")
+    return "OrderedRange::greater(" + range.value + ")";
+  if (range.op == ">=")
+    return "OrderedRange::greaterEqual(" + range.value + ")";
+  return "OrderedRange::equal(" + range.value + ")";
+}
+
 eastl::string parse_where_query(const eastl::string &where, QueryComponents &out_components)
+{
+  QueryRanges ranges;
+  return parse_where_query(where, out_components, ranges);
+}
+
+eastl::string parse_where_query(const eastl::string &where, QueryComponents &out_components, QueryRanges &out_ranges)
 {
   if (pegtl::analyze<queryparser::grammar>() != 0)
     return "nullptr";
@@ -376,6 +450,16 @@ eastl::string parse_where_query(const eastl::string &where, QueryComponents &out
   std::ostringstream oss;
 
   auto result = s.finish(components);
+
+  // Conjuncts of one component are intersected
+  for (const auto &r : result.ranges)
+  {
+    auto res = eastl::find_if(out_ranges.begin(), out_ranges.end(), [&](const QueryRange &o) { return o.component == r.component; });
+    if (res == out_ranges.end())
+      out_ranges.push_back({ r.component, range_expr(r) });
+    else
+      res->expr += " & " + range_expr(r);
+  }
   for (auto &c : components)
   {
     out_components.emplace_back() = { c.name };
@@ -10,4 +10,14 @@ struct QueryComponent
 
 using QueryComponents = eastl::vector<QueryComponent>;
 
-eastl::string parse_where_query(const eastl::string &where, QueryComponents &out_components);
\ No newline at end of file
+// OrderedRange expression of the comparisons of the component with numbers the where clause implies
+struct QueryRange
+{
+  eastl::string component;
+  eastl::string expr;
+};
+
+using QueryRanges = eastl::vector<QueryRange>;
+
+eastl::string parse_where_query(const eastl::string &where, QueryComponents &out_components);
+eastl::string parse_where_query(const eastl::string &where, QueryComponents &out_components, QueryRanges &out_ranges);
\ No newline at end of file
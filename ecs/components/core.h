@@ -15,4 +15,26 @@ ECS_COMPONENT_TYPE(double);
 ECS_COMPONENT_TYPE_ALIAS(glm::vec2, vec2);
 ECS_COMPONENT_TYPE_ALIAS(glm::vec3, vec3);
 ECS_COMPONENT_TYPE_ALIAS(glm::vec4, vec4);
-ECS_COMPONENT_TYPE_ALIAS(eastl::string, string);
\ No newline at end of file
+ECS_COMPONENT_TYPE_ALIAS(eastl::string, string);
+
+template <>
+struct ComponentSerializer<eastl::string>
+{
+  static constexpr bool defined = true;
+
+  static void write(BinaryOutStream &out, const eastl::string &val)
+  {
+    out.write((uint32_t)val.size());
+    out.write(val.data(), val.size());
+  }
+
+  static bool read(BinaryInStream &in, eastl::string &val)
+  {
+    uint32_t size = 0;
+    if (!in.read(size) || size_t(in.end - in.cur) < size)
+      return false;
+    val.assign((const char*)in.cur, size);
+    in.cur += size;
+    return true;
+  }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// Included by the AOT generated code of every script that requires ecs,
+// the functions are bound with these names as their cppName
+
+#include <ecs/ecs-das.h>
+#include <ecs/ecs-events.h>
+
+namespace bind_dascript
+{
+  void process_query(Query &query, const das::Block &block, das::Context *ctx, das::LineInfoArg *line);
+  void perform_query(const das::Block &block, das::Context *ctx, das::LineInfoArg *line);
+
+  vec4f add_component_to_template(das::Context &ctx, das::SimNode_CallBase *call, vec4f *args);
+
+  void create_entity(const char *template_name, const das::TBlock<void, ComponentsMap> &block, das::Context *context);
+  void delete_entity(EntityId eid);
+  bool load_level(const char *path);
+  bool load_level_async(const char *path);
+
+  eastl::string* to_eastl_string(const char *str, das::Context *ctx);
+
+  void get_system_profile(const char *name, const das::TBlock<void, const SystemProfileStat> &block, das::Context *context);
+  void set_profiling(bool enable);
+
+  int ecs_hash(const char *s);
+}
@@ -0,0 +1,248 @@
+#include "allocator.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct SubsystemStat
+{
+  std::atomic<size_t> allocated = 0;
+  std::atomic<size_t> allocatedMax = 0;
+  std::atomic<size_t> allocationsCount = 0;
+  std::atomic<size_t> hugePagesSize = 0;
+};
+
+static SubsystemStat g_stat[(int)memory::Subsystem::kCount];
+
+static bool g_huge_pages = false;
+static size_t g_huge_pages_threshold = memory::HUGE_PAGE_SIZE;
+
+// Blocks of this size or bigger are allocated by pages
+static constexpr size_t PAGE_ALLOC_THRESHOLD = 256 << 10;
+
+static inline size_t align_size(size_t sz, size_t alignment)
+{
+  return (sz + alignment - 1) & ~(alignment - 1);
+}
+
+static void* alloc_pages(size_t sz, bool &huge)
+{
+#ifdef _WIN32
+  if (huge)
+  {
+    const size_t largePageSize = ::GetLargePageMinimum();
+    // Needs SeLockMemoryPrivilege
+    void *p = largePageSize > 0 ? ::VirtualAlloc(nullptr, align_size(sz, largePageSize), MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE) : nullptr;
+    if (p)
+      return p;
+    huge = false;
+  }
+  return ::VirtualAlloc(nullptr, sz, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+  if (huge)
+  {
+    const size_t hugeSize = align_size(sz, memory::HUGE_PAGE_SIZE);
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    p = ::mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+      return p;
+#endif
+#ifdef MADV_HUGEPAGE
+    // Transparent huge pages back only 2MB aligned ranges, so the mapping is over-allocated,
+    // aligned and the slack on both sides is unmapped
+    p = ::mmap(nullptr, hugeSize + memory::HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED)
+    {
+      uint8_t *aligned = (uint8_t*)align_size((uintptr_t)p, memory::HUGE_PAGE_SIZE);
+      const size_t head = aligned - (uint8_t*)p;
+      if (head > 0)
+        ::munmap(p, head);
+      if (memory::HUGE_PAGE_SIZE - head > 0)
+        ::munmap(aligned + hugeSize, memory::HUGE_PAGE_SIZE - head);
+      ::madvise(aligned, hugeSize, MADV_HUGEPAGE);
+      return aligned;
+    }
+#endif
+    huge = false;
+  }
+  void *p = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return p != MAP_FAILED ? p : nullptr;
+#endif
+}
+
+static void free_pages(void *p, size_t sz, bool huge)
+{
+#ifdef _WIN32
+  ::VirtualFree(p, 0, MEM_RELEASE);
+#else
+  ::munmap(p, huge ? align_size(sz, memory::HUGE_PAGE_SIZE) : sz);
+#endif
+}
+
+struct DefaultAllocator final : memory::Allocator
+{
+  // Page blocks keep a header in front of the data
+  struct PageHeader
+  {
+    size_t size;
+    bool huge;
+  };
+
+  void* alloc(size_t sz, size_t alignment) override
+  {
+    if (sz >= PAGE_ALLOC_THRESHOLD)
+    {
+      ASSERT(alignment <= memory::CACHE_LINE_SIZE);
+      bool huge = g_huge_pages && sz >= g_huge_pages_threshold;
+      const size_t headerSize = memory::CACHE_LINE_SIZE;
+      uint8_t *p = (uint8_t*)alloc_pages(sz + headerSize, huge);
+      ASSERT(p != nullptr);
+      PageHeader *header = (PageHeader*)p;
+      header->size = sz + headerSize;
+      header->huge = huge;
+      return p + headerSize;
+    }
+
+#ifdef _WIN32
+    return ::_aligned_malloc(sz, alignment);
+#else
+    void *p = nullptr;
+    return ::posix_memalign(&p, eastl::max(alignment, sizeof(void*)), sz) == 0 ? p : nullptr;
+#endif
+  }
+
+  static bool isHuge(const void *p, size_t sz)
+  {
+    return sz >= PAGE_ALLOC_THRESHOLD && ((const PageHeader*)((const uint8_t*)p - memory::CACHE_LINE_SIZE))->huge;
+  }
+
+  void free(void *p, size_t sz) override
+  {
+    if (!p)
+      return;
+
+    if (sz >= PAGE_ALLOC_THRESHOLD)
+    {
+      PageHeader *header = (PageHeader*)((uint8_t*)p - memory::CACHE_LINE_SIZE);
+      free_pages(header, header->size, header->huge);
+      return;
+    }
+
+#ifdef _WIN32
+    ::_aligned_free(p);
+#else
+    ::free(p);
+#endif
+  }
+};
+
+static DefaultAllocator g_default_allocator;
+static memory::Allocator *g_allocator = &g_default_allocator;
+
+memory::Allocator* memory::get_default_allocator()
+{
+  return &g_default_allocator;
+}
+
+void memory::set_allocator(Allocator *allocator)
+{
+  for (const SubsystemStat &stat : g_stat)
+    ASSERT(stat.allocated.load() == 0);
+  g_allocator = allocator ? allocator : &g_default_allocator;
+}
+
+memory::Allocator* memory::get_allocator()
+{
+  return g_allocator;
+}
+
+void memory::set_huge_pages(bool enable, size_t threshold)
+{
+  g_huge_pages = enable;
+  g_huge_pages_threshold = eastl::max(threshold, PAGE_ALLOC_THRESHOLD);
+}
+
+bool memory::is_huge_pages_enabled()
+{
+  return g_huge_pages;
+}
+
+void* memory::alloc(Subsystem subsystem, size_t sz, size_t alignment)
+{
+  if (sz == 0)
+    return nullptr;
+
+  void *p = g_allocator->alloc(sz, alignment);
+
+  SubsystemStat &stat = g_stat[(int)subsystem];
+  const size_t allocated = stat.allocated.fetch_add(sz, std::memory_order_relaxed) + sz;
+  size_t allocatedMax = stat.allocatedMax.load(std::memory_order_relaxed);
+  while (allocated > allocatedMax && !stat.allocatedMax.compare_exchange_weak(allocatedMax, allocated, std::memory_order_relaxed))
+    ;
+  stat.allocationsCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (g_allocator == &g_default_allocator && DefaultAllocator::isHuge(p, sz))
+    stat.hugePagesSize.fetch_add(sz, std::memory_order_relaxed);
+
+  return p;
+}
+
+void memory::free(Subsystem subsystem, void *p, size_t sz)
+{
+  if (!p)
+    return;
+
+  SubsystemStat &stat = g_stat[(int)subsystem];
+  stat.allocated.fetch_sub(sz, std::memory_order_relaxed);
+  stat.allocationsCount.fetch_sub(1, std::memory_order_relaxed);
+
+  if (g_allocator == &g_default_allocator && DefaultAllocator::isHuge(p, sz))
+    stat.hugePagesSize.fetch_sub(sz, std::memory_order_relaxed);
+
+  g_allocator->free(p, sz);
+}
+
+memory::Stat memory::get_stat(Subsystem subsystem)
+{
+  const SubsystemStat &stat = g_stat[(int)subsystem];
+
+  Stat res;
+  res.allocated = stat.allocated.load();
+  res.allocatedMax = stat.allocatedMax.load();
+  res.allocationsCount = stat.allocationsCount.load();
+  res.hugePagesSize = stat.hugePagesSize.load();
+  return res;
+}
+
+const char* memory::get_subsystem_name(Subsystem subsystem)
+{
+  switch (subsystem)
+  {
+    case Subsystem::kStorage: return "storage";
+    case Subsystem::kQuery: return "query";
+    case Subsystem::kIndex: return "index";
+    case Subsystem::kEvent: return "event";
+    case Subsystem::kSnapshot: return "snapshot";
+    default: return "other";
+  }
+}
+
+void memory::write_stat(std::ostream &out)
+{
+  out << "[memory]:\n";
+  for (int i = 0; i < (int)Subsystem::kCount; ++i)
+  {
+    const Stat stat = get_stat((Subsystem)i);
+    out << "  " << get_subsystem_name((Subsystem)i) << ": " << (stat.allocated >> 10) << " kB, max " << (stat.allocatedMax >> 10)
+      << " kB, huge pages " << (stat.hugePagesSize >> 10) << " kB in " << stat.allocationsCount << " allocations\n";
+  }
+  out.flush();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace memory
+{
+  static constexpr size_t DEFAULT_ALIGNMENT = 16;
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20; // 2MB
+
+  enum class Subsystem : uint8_t
+  {
+    kStorage,
+    kQuery,
+    kIndex,
+    kEvent,
+    kSnapshot,
+    kOther,
+    kCount
+  };
+
+  struct Allocator
+  {
+    virtual ~Allocator() = default;
+
+    virtual void* alloc(size_t sz, size_t alignment) = 0;
+    // sz is the same as passed to alloc
+    virtual void free(void *p, size_t sz) = 0;
+  };
+
+  // Aligned malloc, large blocks are allocated by pages (huge pages if enabled)
+  Allocator* get_default_allocator();
+
+  // Must be called before anything is allocated, nullptr restores the default one
+  void set_allocator(Allocator *allocator);
+  Allocator* get_allocator();
+
+  // Back blocks of threshold size or bigger with 2MB pages (MAP_HUGETLB, THP or large pages).
+  // Falls back to regular pages if huge pages are not available.
+  void set_huge_pages(bool enable, size_t threshold = HUGE_PAGE_SIZE);
+  bool is_huge_pages_enabled();
+
+  void* alloc(Subsystem subsystem, size_t sz, size_t alignment = DEFAULT_ALIGNMENT);
+  void free(Subsystem subsystem, void *p, size_t sz);
+
+  struct Stat
+  {
+    size_t allocated = 0;
+    size_t allocatedMax = 0;
+    size_t allocationsCount = 0;
+    size_t hugePagesSize = 0;
+  };
+
+  Stat get_stat(Subsystem subsystem);
+  const char* get_subsystem_name(Subsystem subsystem);
+  void write_stat(std::ostream &out);
+
+  // EASTL allocator which goes through the memory layer
+  template <Subsystem S>
+  struct SubsystemAllocator
+  {
+    explicit SubsystemAllocator(const char * = nullptr) {}
+    SubsystemAllocator(const SubsystemAllocator &x) {}
+    SubsystemAllocator(const SubsystemAllocator &x, const char *) {}
+
+    SubsystemAllocator &operator=(const SubsystemAllocator &x) { return *this; }
+
+    void *allocate(size_t n, int flags = 0) { return memory::alloc(S, n); }
+    void *allocate(size_t n, size_t alignment, size_t offset, int flags = 0) { return memory::alloc(S, n, eastl::max(alignment, DEFAULT_ALIGNMENT)); }
+    void deallocate(void *p, size_t n) { memory::free(S, p, n); }
+
+    const char *get_name() const { return get_subsystem_name(S); }
+    void set_name(const char *) {}
+  };
+
+  template <Subsystem S>
+  inline bool operator==(const SubsystemAllocator<S>&, const SubsystemAllocator<S>&) { return true; }
+
+  template <Subsystem S>
+  inline bool operator!=(const SubsystemAllocator<S>&, const SubsystemAllocator<S>&) { return false; }
+
+  using StorageAllocator = SubsystemAllocator<Subsystem::kStorage>;
+  using QueryAllocator = SubsystemAllocator<Subsystem::kQuery>;
+  using IndexAllocator = SubsystemAllocator<Subsystem::kIndex>;
+  using EventAllocator = SubsystemAllocator<Subsystem::kEvent>;
+}
@@ -2,6 +2,9 @@
 
 #include "stdafx.h"
 
+#include "layout.h"
+#include "serialize.h"
+
 #define __S(a) #a
 #define __C2(a, b) __S(a) __S(b)
 #define __C3(a, b, c) __C2(a, b) __S(c)
@@ -74,6 +77,15 @@ struct ComponentDescription
 
   bool hasEqual = false;
 
+  // Non-zero for components with ECS_COMPONENT_LAYOUT(T, soa)
+  int soaFieldsCount = 0;
+  int soaFieldSize = 0;
+
+  // Trivially copyable components are stored in levels as raw columns,
+  // the others only with ComponentSerializer<T>, see serialize.h
+  bool isTrivial = false;
+  bool isSerializable = false;
+
   static const ComponentDescription *head;
   static int count;
 
@@ -87,6 +99,10 @@ struct ComponentDescription
   virtual bool equal(uint8_t *lhs, uint8_t *rhs) const = 0;
   virtual void copy(uint8_t *to, const uint8_t *from) const = 0;
   virtual void move(uint8_t *to, uint8_t *from) const = 0;
+  virtual void write(BinaryOutStream &out, const uint8_t *mem) const = 0;
+  virtual bool read(BinaryInStream &in, uint8_t *mem) const = 0;
+
+  inline bool isSoA() const { return soaFieldsCount > 0; }
 };
 
 template<class T, class EqualTo>
@@ -155,9 +171,23 @@ struct ComponentDescriptionDetails final : ComponentDescription
     *(T*)to = eastl::move(*(T*)from);
   }
 
+  void write(BinaryOutStream &out, const uint8_t *mem) const override final
+  {
+    ComponentSerializer<T>::write(out, *(const T*)mem);
+  }
+
+  bool read(BinaryInStream &in, uint8_t *mem) const override final
+  {
+    return ComponentSerializer<T>::read(in, *(T*)mem);
+  }
+
   ComponentDescriptionDetails(const char *name) : ComponentDescription(name, CompDesc::type, CompDesc::size)
   {
     hasEqual = HasOperatorEqual<T>::value;
+    soaFieldsCount = ComponentLayout<T>::fieldsCount;
+    soaFieldSize = ComponentLayout<T>::fieldSize;
+    isTrivial = eastl::is_trivially_copyable<T>::value;
+    isSerializable = isTrivial || ComponentSerializer<T>::defined;
   }
 };
 
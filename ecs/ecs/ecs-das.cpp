@@ -1,4 +1,7 @@
 #include <ecs/ecs-das.h>
+#include <dasModules/ecs.h>
+
+#include <EASTL/shared_ptr.h>
 
 #include <daScript/ast/ast_policy_types.h>
 #include <daScript/simulate/sim_policy.h>
@@ -50,6 +53,26 @@ struct QueryAnnotation : das::ManagedStructureAnnotation<Query, false>
   }
 };
 
+struct SystemProfileStatAnnotation : das::ManagedStructureAnnotation<SystemProfileStat, false>
+{
+  SystemProfileStatAnnotation(das::ModuleLibrary &ml) : das::ManagedStructureAnnotation<SystemProfileStat, false>("SystemProfileStat", ml)
+  {
+    cppName = " ::SystemProfileStat";
+    addField<DAS_BIND_MANAGED_FIELD(p50)>("p50");
+    addField<DAS_BIND_MANAGED_FIELD(p95)>("p95");
+    addField<DAS_BIND_MANAGED_FIELD(max)>("max");
+    addField<DAS_BIND_MANAGED_FIELD(jobTime)>("jobTime");
+    addField<DAS_BIND_MANAGED_FIELD(entities)>("entities");
+    addField<DAS_BIND_MANAGED_FIELD(chunks)>("chunks");
+    addField<DAS_BIND_MANAGED_FIELD(jobs)>("jobs");
+    addField<DAS_BIND_MANAGED_FIELD(calls)>("calls");
+    addField<DAS_BIND_MANAGED_FIELD(cycles)>("cycles");
+    addField<DAS_BIND_MANAGED_FIELD(instructions)>("instructions");
+    addField<DAS_BIND_MANAGED_FIELD(cacheMisses)>("cacheMisses");
+    addField<DAS_BIND_MANAGED_FIELD(branchMisses)>("branchMisses");
+  }
+};
+
 static bool get_underlying_ecs_type(das::Type type, das::string &str)
 {
   switch (type)
@@ -121,33 +144,66 @@ static void process_query_impl(Query &query, DasQueryData *query_data, const das
 {
   ASSERT(query_data != nullptr);
 
-  vec4f * __restrict args = (vec4f *)(::alloca(query.componentsCount * sizeof(vec4f)));
-  int32_t * __restrict stride = query_data->stride.data();
+  if (query.entitiesCount <= 0)
+    return;
+
+  const int componentsCount = query.componentsCount;
+  vec4f * __restrict args = (vec4f *)(::alloca(componentsCount * sizeof(vec4f)));
+  uint8_t ** __restrict data = (uint8_t **)(::alloca(componentsCount * sizeof(uint8_t *)));
+  const int32_t * __restrict stride = query_data->stride.data();
+  uint8_t *soaTemp = query_data->soaTempSize > 0 ? (uint8_t *)::alloca(query_data->soaTempSize) : nullptr;
 
-  for (auto q = query.begin(), e = query.end(); q != e; ++q)
+  // The block frame is set up once, then the body is evaluated in place for every entity of every chunk
+  ctx->invokeEx(block, args, nullptr, [&](das::SimNode *code)
   {
-    for (int compNo = 0; compNo < query.componentsCount; ++compNo)
+    for (int chunkIdx = 0; chunkIdx < query.chunksCount; ++chunkIdx)
     {
-      uint8_t * __restrict ptr = *(q.curChunk + compNo) + q.idx * stride[compNo];
-      if (query_data->isComponentPointer[compNo])
-        args[compNo] = das::cast<uint8_t *>::from(ptr);
-      else
+      uint8_t * __restrict * __restrict chunk = query.chunks.data() + chunkIdx * componentsCount;
+      for (int compNo = 0; compNo < componentsCount; ++compNo)
+        data[compNo] = chunk[compNo];
+
+      for (int i = 0, count = query.entitiesInChunk[chunkIdx]; i < count; ++i)
       {
-        if (stride[compNo] == 1)
-          args[compNo] = v_cast_vec4f(v_splatsi(*(uint8_t*)ptr));
-        else if (stride[compNo] == 2)
-          args[compNo] = v_cast_vec4f(v_splatsi(*(uint16_t*)ptr));
-        else
-          args[compNo] = v_ldu((float *)ptr);
+        for (int compNo : query_data->pointerArgs)
+          args[compNo] = das::cast<uint8_t *>::from(data[compNo] + i * stride[compNo]);
+        for (int compNo : query_data->byteArgs)
+          args[compNo] = v_cast_vec4f(v_splatsi(data[compNo][i]));
+        for (int compNo : query_data->wordArgs)
+          args[compNo] = v_cast_vec4f(v_splatsi(((uint16_t *)data[compNo])[i]));
+        for (int compNo : query_data->valueArgs)
+          args[compNo] = v_ldu((float *)(data[compNo] + i * stride[compNo]));
+
+        uint8_t *soaValue = soaTemp;
+        for (const DasQueryData::SoAArg &soa : query_data->soaArgs)
+        {
+          soa_gather(soaValue, data[soa.compNo] + i * stride[soa.compNo], soa.desc->soaFieldsCount, soa.desc->soaFieldSize);
+          args[soa.compNo] = soa.isPointer ? das::cast<uint8_t *>::from(soaValue) : v_ldu((float *)soaValue);
+          soaValue += soa.desc->size;
+        }
+
+        code->eval(*ctx);
+        ctx->stopFlags = 0;
+
+        soaValue = soaTemp;
+        for (const DasQueryData::SoAArg &soa : query_data->soaArgs)
+        {
+          if (soa.isPointer)
+            soa_scatter(data[soa.compNo] + i * stride[soa.compNo], soaValue, soa.desc->soaFieldsCount, soa.desc->soaFieldSize);
+          soaValue += soa.desc->size;
+        }
+
+        if (ctx->getException())
+          return;
       }
     }
-    ctx->invoke(block, args, nullptr, line);
-  }
+  }, line);
 }
 
-static void process_query(Query &query, const das::Block &block, das::Context *ctx, das::LineInfoArg *line)
+void bind_dascript::process_query(Query &query, const das::Block &block, das::Context *ctx, das::LineInfoArg *line)
 {
-  process_query_impl(query, (DasQueryData *)query.userData.get(), block, ctx, line);
+  // Slices of parallel systems have no user data, the block has the same one
+  DasQueryData *qd = query.userData ? (DasQueryData *)query.userData.get() : (DasQueryData *)((das::SimNode_ClosureBlock *)block.body)->annotationData;
+  process_query_impl(query, qd, block, ctx, line);
 }
 
 static void das_system(const RawArg &evt, Query &query)
@@ -155,6 +211,8 @@ static void das_system(const RawArg &evt, Query &query)
   DasQueryData *qd = (DasQueryData *)query.userData.get();
   ASSERT(qd != nullptr);
 
+  g_mgr->waitSystemDependencies(g_mgr->getSystemId(ConstHashedString(qd->fn->name)));
+
   qd->ctx->tryRestartAndLock();
   auto lambda = [&evt, &query, qd]()
   {
@@ -169,6 +227,64 @@ static void das_system(const RawArg &evt, Query &query)
   qd->ctx->unlock();
 }
 
+static void das_system_parallel(const RawArg &evt, Query &query)
+{
+  DasQueryData *qd = (DasQueryData *)query.userData.get();
+  ASSERT(qd != nullptr);
+
+  eastl::vector<Query::Task> tasks;
+  query.splitToTasks(qd->chunkSize, tasks);
+  if (tasks.empty())
+    return;
+
+  // Jobs outlive the call, so the event and the slices of the query are copied
+  struct Slices
+  {
+    eastl::vector<uint8_t> evt;
+    eastl::vector<Query> queries;
+  };
+  auto slices = eastl::make_shared<Slices>();
+  slices->evt.assign(evt.mem, evt.mem + evt.size);
+  slices->queries.resize(tasks.size());
+  for (int i = 0; i < (int)tasks.size(); ++i)
+  {
+    Query &slice = slices->queries[i];
+    slice.componentsCount = query.componentsCount;
+    query.forEachChunk(tasks[i].chunkIdx, tasks[i].offset, tasks[i].count, [&](uint8_t * __restrict * __restrict columns, int begin, int count)
+    {
+      for (int compNo = 0; compNo < query.componentsCount; ++compNo)
+        slice.chunks.push_back(columns[compNo] + begin * qd->stride[compNo]);
+      slice.entitiesInChunk.push_back(count);
+      ++slice.chunksCount;
+      slice.entitiesCount += count;
+    });
+  }
+
+  EcsContext *ctx = (EcsContext *)qd->ctx;
+  ctx->createWorkerContexts();
+
+  das::SimFunction *fn = qd->fn;
+  jobmanager::callback_t task = [slices, ctx, fn](int from, int count)
+  {
+    EcsContext &workerCtx = ctx->getWorkerContext();
+    workerCtx.tryRestartAndLock();
+    for (int i = from; i < from + count; ++i)
+    {
+      vec4f args[2];
+      args[0] = das::cast<const uint8_t *>::from(slices->evt.data());
+      args[1] = das::cast<const Query *>::from(&slices->queries[i]);
+      const bool result = workerCtx.runWithCatch([&]() { workerCtx.call(fn, args, 0); });
+      if (!result)
+        DEBUG_LOG("unhandled exception <" << workerCtx.getException() << "> during es <" << fn->name << ">");
+    }
+    workerCtx.unlock();
+  };
+
+  const SystemId sid = g_mgr->getSystemId(ConstHashedString(fn->name));
+  ecs::set_system_job(sid, jobmanager::add_job(g_mgr->getSystemDependencyList(sid), (int)tasks.size(), 1, task));
+  jobmanager::start_jobs();
+}
+
 static void das_system_empty(const RawArg &evt, Query &query)
 {
   DasQueryData *qd = (DasQueryData *)query.userData.get();
@@ -185,7 +301,7 @@ static void das_system_empty(const RawArg &evt, Query &query)
   qd->ctx->unlock();
 }
 
-void perform_query(const das::Block &block, das::Context *ctx, das::LineInfoArg *line)
+void bind_dascript::perform_query(const das::Block &block, das::Context *ctx, das::LineInfoArg *line)
 {
   das::SimNode_ClosureBlock *closure = (das::SimNode_ClosureBlock *)block.body;
   DasQueryData *qd = (DasQueryData*)closure->annotationData;
@@ -206,7 +322,6 @@ bool create_query_data(T first, T last, const das::AnnotationArgumentList &args,
 
   const std::size_t argumentsCount = std::distance(first, last);
 
-  query_data->isComponentPointer.resize(argumentsCount);
   query_data->stride.resize(argumentsCount);
 
   int i = 0;
@@ -225,13 +340,28 @@ bool create_query_data(T first, T last, const das::AnnotationArgumentList &args,
       return false;
     }
 
+    const bool isPointer = arg->type->isRefOrPointer();
+
     Component comp;
     comp.name = hash_str(arg->name.c_str());
     comp.desc = compDesc;
     comp.size = comp.desc->size;
+    comp.flags = isPointer && !arg->type->isConst() ? ComponentDescriptionFlags::kWrite : ComponentDescriptionFlags::kNone;
 
-    query_data->isComponentPointer[i] = arg->type->isRefOrPointer();
-    query_data->stride[i] = comp.size;
+    query_data->stride[i] = compDesc->isSoA() ? compDesc->soaFieldSize : comp.size;
+    if (compDesc->isSoA())
+    {
+      query_data->soaArgs.push_back({ i, isPointer, compDesc });
+      query_data->soaTempSize += compDesc->size;
+    }
+    else if (isPointer)
+      query_data->pointerArgs.push_back(i);
+    else if (comp.size == 1)
+      query_data->byteArgs.push_back(i);
+    else if (comp.size == 2)
+      query_data->wordArgs.push_back(i);
+    else
+      query_data->valueArgs.push_back(i);
 
     query_desc.components.push_back(comp);
   }
@@ -280,17 +410,27 @@ struct SystemRegistrator final : das::FunctionAnnotation
     tags_from_list(args, "after",  afterStr);
 
     EcsModuleGroupData::UnresolvedSystem sys;
+    sys.signature = func->getMangledName().c_str();
+    for (auto &ann : func->annotations)
+      if (ann->annotation.get() == this)
+        sys.signature += (" " + ann->getMangledName()).c_str();
     if (!create_query_data(func->arguments.begin() + 1, func->arguments.end(), args, sys.queryDesc, sys.queryData))
     {
       DEBUG_LOG("Cannot create system: " << func->name);
       return false;
     }
 
+    const das::AnnotationArgument *parallelArg = args.find("parallel", das::Type::tBool);
+    const das::AnnotationArgument *chunkArg = args.find("chunk", das::Type::tInt);
+    sys.queryData->parallel = parallelArg && parallelArg->bValue;
+    if (chunkArg && chunkArg->iValue > 0)
+      sys.queryData->chunkSize = chunkArg->iValue;
+
     func->exports = true;
 
     sys.systemDesc.reset(new SystemDescription(
       hash_str(func->name.c_str()),
-      func->arguments.size() > 1 ? &das_system : &das_system_empty,
+      func->arguments.size() > 1 ? (sys.queryData->parallel ? &das_system_parallel : &das_system) : &das_system_empty,
       hash_str(eventName.c_str()),
       beforeStr.empty() ? "*" : beforeStr.c_str(),
       afterStr.empty()  ? "*" : afterStr.c_str()));
@@ -375,16 +515,30 @@ struct SystemRegistrator final : das::FunctionAnnotation
       return false;
     }
 
-    // TODO: Mark as lazy query ?
-    QueryId qid = g_mgr->createQuery(hash_str(mangledName.c_str()), queryDesc);
-    queryData->queryId = qid;
+    auto *moduleData = ((EcsModuleGroupData*)mg.getUserData("ecs"));
 
-    g_mgr->queries[qid.index].userData = eastl::move(queryData);
+    // The name has the types of the arguments and the annotation, the same name is the same query
+    QueryId qid;
+    auto reusable = moduleData->reusableQueries.find(mangledName.c_str());
+    const bool isNew = reusable == moduleData->reusableQueries.end();
+    if (!isNew)
+    {
+      qid = reusable->second;
+      moduleData->reusableQueries.erase(reusable);
+    }
+    else
+    {
+      // TODO: Mark as lazy query ?
+      qid = g_mgr->createQuery(hash_str(mangledName.c_str()), queryDesc);
+    }
+    queryData->queryId = qid;
 
     block->annotationDataSid = das::hash_blockz32((uint8_t *)mangledName.c_str());
-    block->annotationData = (uintptr_t)g_mgr->queries[qid.index].userData.get();
+    block->annotationData = (uintptr_t)queryData.get();
 
-    ((EcsModuleGroupData*)mg.getUserData("ecs"))->dasQueries.push_back(qid);
+    moduleData->dasQueries.push_back(qid);
+    moduleData->dasQueriesByName.insert(eastl::make_pair(eastl::string(mangledName.c_str()), qid));
+    moduleData->unresolvedQueries.push_back({qid, isNew, eastl::move(queryData)});
 
     return true;
   }
@@ -394,6 +548,25 @@ struct SystemRegistrator final : das::FunctionAnnotation
   }
 };
 
+EcsModuleGroupData::~EcsModuleGroupData()
+{
+  // Not resolved, the compilation has failed
+  for (auto &q : unresolvedQueries)
+    if (q.isNew)
+      g_mgr->deleteQuery(q.queryId);
+}
+
+void EcsModuleGroupData::resolveQueries()
+{
+  for (auto &q : unresolvedQueries)
+    g_mgr->queries[q.queryId.index].userData = eastl::move(q.queryData);
+  unresolvedQueries.clear();
+
+  for (auto &kv : reusableQueries)
+    g_mgr->deleteQuery(kv.second);
+  reusableQueries.clear();
+}
+
 struct TemplateRegistrator final : das::FunctionAnnotation
 {
   TemplateRegistrator() : das::FunctionAnnotation("ecsTemplate") {}
@@ -514,7 +687,7 @@ struct ComponentsMapDataWalker : das::DataWalker
   }
 };
 
-static vec4f add_component_to_template(das::Context &ctx, das::SimNode_CallBase *call, vec4f *args)
+vec4f bind_dascript::add_component_to_template(das::Context &ctx, das::SimNode_CallBase *call, vec4f *args)
 {
   ComponentsMap &cmap = *das::cast<ComponentsMap*>::to(args[0]);
   const char* name = das::cast<const char*>::to(args[1]);
@@ -530,7 +703,7 @@ static vec4f add_component_to_template(das::Context &ctx, das::SimNode_CallBase
   return v_zero();
 }
 
-static void create_entity(const char *template_name, const das::TBlock<void, ComponentsMap> &block, das::Context *context)
+void bind_dascript::create_entity(const char *template_name, const das::TBlock<void, ComponentsMap> &block, das::Context *context)
 {
   ComponentsMap cmap;
   vec4f arg = das::cast<ComponentsMap*>::from(&cmap);
@@ -539,17 +712,39 @@ static void create_entity(const char *template_name, const das::TBlock<void, Com
   return ecs::create_entity(template_name, eastl::move(cmap));
 }
 
-static void delete_entity(EntityId eid)
+void bind_dascript::delete_entity(EntityId eid)
 {
   return ecs::delete_entity(eid);
 }
 
-static eastl::string* to_eastl_string(const char *str, das::Context *ctx)
+bool bind_dascript::load_level(const char *path)
+{
+  return path && ecs::load_level(path);
+}
+
+bool bind_dascript::load_level_async(const char *path)
+{
+  return path && ecs::load_level_async(path);
+}
+
+eastl::string* bind_dascript::to_eastl_string(const char *str, das::Context *ctx)
 {
   return new (ctx->heap->allocate(sizeof(eastl::string))) eastl::string(str);
 }
 
-static int ecs_hash(const char *s)
+void bind_dascript::get_system_profile(const char *name, const das::TBlock<void, const SystemProfileStat> &block, das::Context *context)
+{
+  SystemProfileStat stat = g_mgr->getSystemProfileStat(g_mgr->getSystemId(ConstHashedString(name ? name : "")));
+  vec4f arg = das::cast<SystemProfileStat*>::from(&stat);
+  context->invoke(block, &arg, nullptr);
+}
+
+void bind_dascript::set_profiling(bool enable)
+{
+  ecs::set_profiling(enable);
+}
+
+int bind_dascript::ecs_hash(const char *s)
 {
   return hash::str(s ? s : "");
 }
@@ -567,25 +762,30 @@ struct ECSModule final : public das::Module
     addAnnotation(das::make_smart<ComponentsMapAnnotation>(lib));
     addAnnotation(das::make_smart<TagAnnotation>(lib));
     addAnnotation(das::make_smart<QueryAnnotation>(lib));
+    addAnnotation(das::make_smart<SystemProfileStatAnnotation>(lib));
 
     do_auto_bind_module(HASH("ecs"), *this, lib);
 
     das::addFunctionBasic<EntityId>(*this, lib);
     addFunction(das::make_smart<das::BuiltInFn<das::Sim_BoolNot<EntityId>, bool, EntityId>>("!", lib, "BoolNot"));
 
-    das::addExtern<DAS_BIND_FUN(ecs_hash)>(*this, lib, "ecs_hash", das::SideEffects::none, "ecs_hash");
-    das::addExtern<DAS_BIND_FUN(to_eastl_string)>(*this, lib, "eastl_string", das::SideEffects::none, "to_eastl_string");
-    das::addExtern<DAS_BIND_FUN(create_entity)>(*this, lib, "create_entity", das::SideEffects::modifyExternal, "create_entity");
-    das::addExtern<DAS_BIND_FUN(delete_entity)>(*this, lib, "delete_entity", das::SideEffects::modifyExternal, "delete_entity");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::ecs_hash)>(*this, lib, "ecs_hash", das::SideEffects::none, "bind_dascript::ecs_hash");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::to_eastl_string)>(*this, lib, "eastl_string", das::SideEffects::none, "bind_dascript::to_eastl_string");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::create_entity)>(*this, lib, "create_entity", das::SideEffects::modifyExternal, "bind_dascript::create_entity");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::delete_entity)>(*this, lib, "delete_entity", das::SideEffects::modifyExternal, "bind_dascript::delete_entity");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::load_level)>(*this, lib, "load_level", das::SideEffects::modifyExternal, "bind_dascript::load_level");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::load_level_async)>(*this, lib, "load_level_async", das::SideEffects::modifyExternal, "bind_dascript::load_level_async");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::get_system_profile)>(*this, lib, "get_system_profile", das::SideEffects::accessExternal, "bind_dascript::get_system_profile");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::set_profiling)>(*this, lib, "set_profiling", das::SideEffects::modifyExternal, "bind_dascript::set_profiling");
 
-    das::addInterop<add_component_to_template, void, ComponentsMap&, const char*, vec4f>
-      (*this, lib, "_builtin_add", das::SideEffects::modifyArgument, "add_component_to_template");
+    das::addInterop<bind_dascript::add_component_to_template, void, ComponentsMap&, const char*, vec4f>
+      (*this, lib, "_builtin_add", das::SideEffects::modifyArgument, "bind_dascript::add_component_to_template");
 
     addAnnotation(das::make_smart<TemplateRegistrator>());
     addAnnotation(das::make_smart<SystemRegistrator>());
 
-    das::addExtern<DAS_BIND_FUN(process_query)>(*this, lib, "process_query", das::SideEffects::modifyExternal, "bind_dascript::process_query");
-    das::addExtern<DAS_BIND_FUN(perform_query)>(*this, lib, "query", das::SideEffects::modifyExternal, "perform_query");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::process_query)>(*this, lib, "process_query", das::SideEffects::modifyExternal, "bind_dascript::process_query");
+    das::addExtern<DAS_BIND_FUN(bind_dascript::perform_query)>(*this, lib, "query", das::SideEffects::modifyExternal, "bind_dascript::perform_query");
 
     #include "ecs.das.gen"
     compileBuiltinModule("ecs.das", ecs_builtin, sizeof(ecs_builtin));
@@ -600,4 +800,78 @@ struct ECSModule final : public das::Module
   }
 };
 
-REGISTER_MODULE(ECSModule);
\ No newline at end of file
+REGISTER_MODULE(ECSModule);
+namespace das
+{
+  extern bool g_isInAot;
+  extern ProgramPtr g_Program;
+}
+
+bool das_aot_cpp(const das::ProgramPtr &program, das::Context &ctx, das::TextWriter &tw)
+{
+  tw << "#include \"daScript/misc/platform.h\"\n\n";
+  tw << "#include \"daScript/simulate/simulate.h\"\n";
+  tw << "#include \"daScript/simulate/aot.h\"\n";
+  tw << "#include \"daScript/simulate/aot_library.h\"\n\n";
+
+  bool noAot = program->options.getBoolOption("no_aot", false);
+  program->library.foreach([&](das::Module *mod)
+  {
+    if (!mod->name.empty() && mod->name != "$" && mod->aotRequire(tw) == das::ModuleAotType::no_aot)
+    {
+      tw << "// AOT disabled due to module " << mod->name << "\n";
+      noAot = true;
+    }
+    return true;
+  }, "*");
+
+  // Still a valid source file, the functions of this script are interpreted
+  if (noAot)
+    return false;
+
+  tw << "\n#if defined(_MSC_VER)\n";
+  tw << "#pragma warning(push)\n";
+  tw << "#pragma warning(disable:4100)\n";
+  tw << "#pragma warning(disable:4189)\n";
+  tw << "#pragma warning(disable:4244)\n";
+  tw << "#pragma warning(disable:4114)\n";
+  tw << "#pragma warning(disable:4623)\n";
+  tw << "#pragma warning(disable:4946)\n";
+  tw << "#pragma warning(disable:4269)\n";
+  tw << "#endif\n\n";
+
+  tw << "namespace das {\n";
+  tw << "namespace " << program->thisNamespace << " {\n";
+  das::g_isInAot = true;
+  das::g_Program = program;
+  program->aotCpp(ctx, tw);
+  das::g_Program.reset();
+  das::g_isInAot = false;
+  tw << "\tstatic void registerAotFunctions ( AotLibrary & aotLib ) {\n";
+  program->registerAotCpp(tw, ctx, false);
+  tw << "\t};\n\n";
+  tw << "AotListBase impl(registerAotFunctions);\n";
+  tw << "}\n";
+  tw << "}\n\n";
+
+  tw << "#if defined(_MSC_VER)\n";
+  tw << "#pragma warning(pop)\n";
+  tw << "#endif\n";
+
+  return true;
+}
+
+int das_link_aot(das::Program &program, das::Context &ctx, das::TextWriter &tout)
+{
+  static das::AotLibrary aotLib;
+  if (aotLib.empty())
+    das::AotListBase::registerAot(aotLib);
+
+  program.linkCppAot(ctx, aotLib, tout);
+
+  int count = 0;
+  for (int i = 0; i < ctx.getTotalFunctions(); ++i)
+    if (ctx.getFunction(i)->aot)
+      ++count;
+  return count;
+}
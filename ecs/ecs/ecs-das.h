@@ -41,7 +41,35 @@ struct EASTLStringAnnotation : das::TypeAnnotation
 
 struct EcsContext final : das::Context
 {
+  // Clones share the simulated program and the shared globals, the other globals are per clone
+  eastl::vector<eastl::unique_ptr<EcsContext>> workerContexts;
+
   EcsContext(uint32_t stack_size) : das::Context(stack_size) {}
+  EcsContext(const EcsContext &ctx) : das::Context(ctx) {}
+
+  ~EcsContext()
+  {
+    // Parallel systems might still run in the clones
+    if (!workerContexts.empty())
+      jobmanager::wait_all_jobs();
+  }
+
+  // Must be called on the main thread before jobs that use getWorkerContext are added
+  void createWorkerContexts()
+  {
+    if (!workerContexts.empty())
+      return;
+    // The last one is for the jobs done not by workers
+    workerContexts.resize(jobmanager::get_workers_count() + 1);
+    for (auto &ctx : workerContexts)
+      ctx.reset(new EcsContext(*this));
+  }
+
+  EcsContext& getWorkerContext()
+  {
+    const int workerId = jobmanager::get_worker_id();
+    return *workerContexts[workerId >= 0 ? workerId : workerContexts.size() - 1];
+  }
 
   void to_out(const char *message) override
   {
@@ -61,28 +89,76 @@ struct DasQueryData : QueryUserData
   das::Context *ctx = nullptr;
   das::SimFunction *fn = nullptr;
   QueryId queryId;
-  eastl::vector<bool> isComponentPointer;
   eastl::vector<int> stride;
+
+  // Components grouped by the way they are passed to the block, resolved once on creation
+  eastl::vector<int> pointerArgs;
+  eastl::vector<int> byteArgs;
+  eastl::vector<int> wordArgs;
+  eastl::vector<int> valueArgs;
+
+  // SoA components are gathered to a temporary before the call and scattered back after it
+  struct SoAArg
+  {
+    int compNo;
+    bool isPointer;
+    const ComponentDescription *desc;
+  };
+  eastl::vector<SoAArg> soaArgs;
+  int soaTempSize = 0;
+
+  // [es (parallel=true, chunk=N)], the query is split into tasks of N entities run in the worker contexts
+  bool parallel = false;
+  int chunkSize = 256;
 };
 
 struct EcsModuleGroupData final : das::ModuleGroupUserData
 {
   struct UnresolvedSystem
   {
+    // Mangled function and annotation, a system with the same one has the same query and dependencies
+    eastl::string signature;
     QueryDescription queryDesc;
     eastl::unique_ptr<DasQueryData> queryData;
     eastl::unique_ptr<SystemDescription> systemDesc;
   };
 
+  struct UnresolvedQuery
+  {
+    QueryId queryId;
+    bool isNew;
+    eastl::unique_ptr<DasQueryData> queryData;
+  };
+
+  using QueriesByName = eastl::hash_multimap<eastl::string, QueryId>;
+
+  // Queries of the previous compilation of the script, a block with the same name takes one instead of a new query
+  QueriesByName reusableQueries;
+
   eastl::vector<QueryId> dasQueries;
+  QueriesByName dasQueriesByName;
+  eastl::vector<UnresolvedQuery> unresolvedQueries;
   eastl::hash_map<eastl::string, UnresolvedSystem> unresolvedSystems;
 
   EcsModuleGroupData() : das::ModuleGroupUserData("ecs") {}
+  ~EcsModuleGroupData();
+
+  // Once the program is simulated: moves the data of the blocks to the queries and deletes the reusable queries
+  // nobody has taken. Until then the queries keep the data of the previous program, so a failed compilation changes nothing
+  void resolveQueries();
 };
 
+// Writes the AOT source of a simulated program, false if a required module has no AOT
+bool das_aot_cpp(const das::ProgramPtr &program, das::Context &ctx, das::TextWriter &tw);
+
+// Replaces the functions with the registered AOT ones of the same semantic hash,
+// the others stay interpreted. The program must be compiled with policies.fail_on_no_aot = false
+int das_link_aot(das::Program &program, das::Context &ctx, das::TextWriter &tout);
+
 MAKE_TYPE_FACTORY(eastl_string, eastl::string);
 MAKE_TYPE_FACTORY(ComponentsMap, ::ComponentsMap);
 MAKE_TYPE_FACTORY(Query, ::Query);
+MAKE_TYPE_FACTORY(SystemProfileStat, ::SystemProfileStat);
 
 MAKE_EXTERNAL_TYPE_FACTORY(EntityId, ::EntityId);
 
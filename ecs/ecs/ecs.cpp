@@ -1,9 +1,21 @@
 #include "ecs.h"
 #include "autoBind.h"
+#include "trace.h"
 
 #include <sstream>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
 
-EntityManager *g_mgr = nullptr;
+EntityManager *EntityManager::mainWorld = nullptr;
+
+// Hardware counter groups of the live worlds, groups of destroyed worlds are reused
+static std::mutex g_counters_groups_mutex;
+static eastl::vector<uint32_t> g_free_counters_groups;
+static uint32_t g_counters_groups_count = 0;
+
+// New threads start in the main world
+thread_local EntityManager *g_mgr = EntityManager::mainWorld;
 
 const SystemDescription *SystemDescription::head = nullptr;
 int SystemDescription::count = 0;
@@ -14,9 +26,21 @@ int ComponentDescription::count = 0;
 const PersistentQueryDescription *PersistentQueryDescription::head = nullptr;
 int PersistentQueryDescription::count = 0;
 
+const LazyQueryDescription *LazyQueryDescription::head = nullptr;
+int LazyQueryDescription::count = 0;
+
 const IndexDescription *IndexDescription::head = nullptr;
 int IndexDescription::count = 0;
 
+const SpatialIndexDescription *SpatialIndexDescription::head = nullptr;
+int SpatialIndexDescription::count = 0;
+
+const OrderedIndexDescription *OrderedIndexDescription::head = nullptr;
+int OrderedIndexDescription::count = 0;
+
+const OrderedQueryPlan *OrderedQueryPlan::head = nullptr;
+int OrderedQueryPlan::count = 0;
+
 const AutoBindDescription *AutoBindDescription::head = nullptr;
 int AutoBindDescription::count = 0;
 
@@ -95,13 +119,53 @@ PersistentQueryDescription::PersistentQueryDescription(const ConstHashedString &
   ++PersistentQueryDescription::count;
 }
 
-IndexDescription::IndexDescription(const ConstHashedString &_name, const ConstHashedString &component_name, const ConstQueryDescription &_desc, filter_t &&f) : name(_name), componentName(component_name), desc(_desc), filter(eastl::move(f))
+LazyQueryDescription::LazyQueryDescription(const ConstQueryDescription &_desc, filter_t &&f) : desc(_desc), filter(eastl::move(f))
+{
+  next = LazyQueryDescription::head;
+  LazyQueryDescription::head = this;
+  ++LazyQueryDescription::count;
+}
+
+IndexDescription::IndexDescription(const ConstHashedString &_name, const ConstHashedString &component_name, const ConstQueryDescription &_desc, filter_t &&f) :
+  name(_name), componentName(component_name), keyComponents(&componentName, 1), desc(_desc), filter(eastl::move(f))
+{
+  next = IndexDescription::head;
+  IndexDescription::head = this;
+  ++IndexDescription::count;
+}
+
+IndexDescription::IndexDescription(const ConstHashedString &_name, const ConstArray<const ConstHashedString> &key_components, const ConstQueryDescription &_desc, filter_t &&f) :
+  name(_name), componentName(key_components[0]), keyComponents(key_components), desc(_desc), filter(eastl::move(f))
 {
   next = IndexDescription::head;
   IndexDescription::head = this;
   ++IndexDescription::count;
 }
 
+SpatialIndexDescription::SpatialIndexDescription(const ConstHashedString &_name, const ConstHashedString &component_name, float cell_size, const ConstQueryDescription &_desc, filter_t &&f) :
+  name(_name), componentName(component_name), cellSize(cell_size), desc(_desc), filter(eastl::move(f))
+{
+  next = SpatialIndexDescription::head;
+  SpatialIndexDescription::head = this;
+  ++SpatialIndexDescription::count;
+}
+
+OrderedIndexDescription::OrderedIndexDescription(const ConstHashedString &_name, const ConstHashedString &component_name, ordered_key_t get_key, const ConstQueryDescription &_desc, filter_t &&f) :
+  name(_name), componentName(component_name), getKey(get_key), desc(_desc), filter(eastl::move(f))
+{
+  next = OrderedIndexDescription::head;
+  OrderedIndexDescription::head = this;
+  ++OrderedIndexDescription::count;
+}
+
+OrderedQueryPlan::OrderedQueryPlan(const ConstHashedString &query_name, const ConstHashedString &component_name, const OrderedRange &_range) :
+  queryName(query_name), componentName(component_name), range(_range)
+{
+  next = OrderedQueryPlan::head;
+  OrderedQueryPlan::head = this;
+  ++OrderedQueryPlan::count;
+}
+
 void EventStream::push(EntityId eid, uint8_t flags, int event_id, const RawArg &ev)
 {
   ++count;
@@ -152,33 +216,202 @@ eastl::tuple<EventStream::Header, RawArg> EventStream::pop()
   return eastl::make_tuple(header, RawArg{ header.eventSize, mem });
 }
 
+// Called on a worker when it takes a job of another world
+static void set_job_world(void *context)
+{
+  g_mgr = context ? (EntityManager*)context : EntityManager::mainWorld;
+  set_frame_mem_context(g_mgr ? g_mgr->frameMemContext : nullptr);
+}
+
+// Names owned by queries and systems might be freed before the trace dump
+static inline trace::Name trace_name_kind(const HashedString &name)
+{
+  return name.isOwnMemory ? trace::Name::kCopy : trace::Name::kStatic;
+}
+
 void EntityManager::create()
 {
-  if (g_mgr)
+  if (mainWorld)
     return;
 
-  g_mgr = new EntityManager;
-  g_mgr->init();
+  jobmanager::init();
+  jobmanager::set_context_callback(&set_job_world);
+
+  mainWorld = new EntityManager;
+  setWorld(mainWorld);
+  mainWorld->init();
 }
 
 void EntityManager::release()
 {
-  delete g_mgr;
-  g_mgr = nullptr;
+  jobmanager::wait_all_jobs();
+
+  delete mainWorld;
+  mainWorld = nullptr;
+  setWorld(nullptr);
 
   jobmanager::release();
 }
 
+EntityManager* EntityManager::createWorld()
+{
+  ASSERT(mainWorld != nullptr);
+
+  EntityManager *prevWorld = g_mgr;
+
+  EntityManager *world = new EntityManager;
+  world->frameMemContext = world;
+  setWorld(world);
+  world->init();
+
+  setWorld(prevWorld);
+  return world;
+}
+
+void EntityManager::destroyWorld(EntityManager *world)
+{
+  ASSERT(world != mainWorld);
+
+  EntityManager *prevWorld = g_mgr;
+
+  setWorld(world);
+  jobmanager::wait_context_jobs();
+  delete world;
+  release_frame_mem_context(world);
+
+  setWorld(prevWorld != world ? prevWorld : mainWorld);
+}
+
+void EntityManager::setWorld(EntityManager *world)
+{
+  g_mgr = world;
+  jobmanager::set_context(world);
+  set_frame_mem_context(world ? world->frameMemContext : nullptr);
+}
+
+// Waits for frames of its world, one at a time
+struct WorldThread
+{
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  // Guarded by mutex
+  const eastl::function<void(EntityManager*)> *frame = nullptr;
+  bool terminated = false;
+
+  WorldThread(EntityManager *world)
+  {
+    thread = std::thread([this, world]()
+    {
+      trace::set_thread_name("world");
+
+      while (true)
+      {
+        const eastl::function<void(EntityManager*)> *f = nullptr;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [this]() { return frame || terminated; });
+          if (terminated)
+            return;
+          f = frame;
+        }
+
+        EntityManager::setWorld(world);
+        (*f)(world);
+        EntityManager::setWorld(EntityManager::mainWorld);
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          frame = nullptr;
+        }
+        cv.notify_all();
+      }
+    });
+  }
+
+  ~WorldThread()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      terminated = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
+
+  void start(const eastl::function<void(EntityManager*)> &f)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      frame = &f;
+    }
+    cv.notify_all();
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !frame; });
+  }
+};
+
+void EntityManager::runWorlds(const eastl::vector<EntityManager*> &worlds, const eastl::function<void(EntityManager*)> &frame)
+{
+  if (worlds.empty())
+    return;
+
+  for (size_t i = 1; i < worlds.size(); ++i)
+  {
+    EntityManager *world = worlds[i];
+    if (!world->worldThread)
+      world->worldThread.reset(new WorldThread(world));
+    world->worldThread->start(frame);
+  }
+
+  // The first one runs on the calling thread
+  EntityManager *prevWorld = g_mgr;
+  setWorld(worlds[0]);
+  frame(worlds[0]);
+  setWorld(prevWorld);
+
+  for (size_t i = 1; i < worlds.size(); ++i)
+    worlds[i]->worldThread->wait();
+}
+
 EntityManager::EntityManager()
 {
+  std::lock_guard<std::mutex> lock(g_counters_groups_mutex);
+  if (!g_free_counters_groups.empty())
+  {
+    countersGroup = g_free_counters_groups.back();
+    g_free_counters_groups.pop_back();
+  }
+  else
+    countersGroup = g_counters_groups_count++;
 }
 
 EntityManager::~EntityManager()
 {
+  worldThread.reset();
+
+  {
+    // Counters left since the last tick must not go to the next world of the group
+    eastl::vector<hwcounters::Values> counters;
+    hwcounters::collect(countersGroup, counters);
+    eastl::vector<jobmanager::OwnerStat> ownerStats;
+    jobmanager::collect_owner_stats(countersGroup, ownerStats);
+
+    std::lock_guard<std::mutex> lock(g_counters_groups_mutex);
+    g_free_counters_groups.push_back(countersGroup);
+  }
+
+  destroyPipelinedItems();
   for (auto &s : systems)
     s.reset();
   for (auto &q : queries)
     q.reset();
+  cachedQueries.clear();
   for (auto &t : archetypes)
     t.clear();
 }
@@ -264,8 +497,6 @@ static eastl::vector<eastl::string_view, FrameMemAllocator> split(const char *st
 
 void EntityManager::init()
 {
-  jobmanager::init();
-
   // Reserve eid = 0 as invalid
   entities.resize(1);
 
@@ -275,10 +506,7 @@ void EntityManager::init()
   {
     // Not valid since we have Barriers
     // ASSERT(sys->sys != nullptr);
-    SystemId sid = createSystem(sys->name, sys);
-    auto res = systemsByName.insert(sys->name);
-    ASSERT(res.second); // Check for duplicates
-    res.first->second = sid;
+    createSystem(sys->name, sys);
   }
 
   sortSystems();
@@ -288,11 +516,19 @@ void EntityManager::init()
 
   for (const auto *query = PersistentQueryDescription::head; query; query = query->next)
   {
-    const_cast<PersistentQueryDescription*>(query)->queryId = createQuery(query->name, query->desc, query->filter);
+    // Worlds create the same queries in the same order, so the id is the same for all of them
+    const QueryId queryId = createQuery(query->name, query->desc, query->filter);
+    ASSERT(this == mainWorld || query->queryId == queryId);
+    const_cast<PersistentQueryDescription*>(query)->queryId = queryId;
     for (const auto &c : query->desc.trackComponents)
       enableChangeDetection(c.name);
   }
 
+  // Cached results of filtered lazy queries are dropped when the filter's components change
+  for (const auto *query = LazyQueryDescription::head; query; query = query->next)
+    for (const auto &c : query->desc.trackComponents)
+      enableChangeDetection(c.name);
+
   namedIndices.resize(IndexDescription::count);
   int indexIdx = 0;
   for (const auto *index = IndexDescription::head; index; index = index->next, ++indexIdx)
@@ -303,9 +539,49 @@ void EntityManager::init()
     namedIndices[indexIdx].desc = index->desc;
     namedIndices[indexIdx].desc.filter = index->filter;
     findArchetypes(namedIndices[indexIdx].desc);
+    namedIndices[indexIdx].keyComponents.clear();
+    namedIndices[indexIdx].keySize = 0;
+    for (const auto &c : index->keyComponents)
+    {
+      const int compIdx = namedIndices[indexIdx].desc.getComponentIndex(c);
+      ASSERT(compIdx >= 0);
+      namedIndices[indexIdx].keySize += namedIndices[indexIdx].desc.components[compIdx].size;
+      namedIndices[indexIdx].keyComponents.emplace_back(c);
+      enableChangeDetection(c);
+    }
+  }
+
+  spatialIndices.resize(SpatialIndexDescription::count);
+  int spatialIndexIdx = 0;
+  for (const auto *index = SpatialIndexDescription::head; index; index = index->next, ++spatialIndexIdx)
+  {
+    ASSERT(findSpatialIndex(index->name) == nullptr);
+    ASSERT(index->cellSize > 0.f);
+    spatialIndices[spatialIndexIdx].name = index->name;
+    spatialIndices[spatialIndexIdx].componentName = index->componentName;
+    spatialIndices[spatialIndexIdx].cellSize = index->cellSize;
+    spatialIndices[spatialIndexIdx].invCellSize = 1.f / index->cellSize;
+    spatialIndices[spatialIndexIdx].desc = index->desc;
+    spatialIndices[spatialIndexIdx].desc.filter = index->filter;
+    findArchetypes(spatialIndices[spatialIndexIdx].desc);
+  }
+
+  orderedIndices.resize(OrderedIndexDescription::count);
+  int orderedIndexIdx = 0;
+  for (const auto *index = OrderedIndexDescription::head; index; index = index->next, ++orderedIndexIdx)
+  {
+    ASSERT(findOrderedIndex(index->name) == nullptr);
+    orderedIndices[orderedIndexIdx].name = index->name;
+    orderedIndices[orderedIndexIdx].componentName = index->componentName;
+    orderedIndices[orderedIndexIdx].getKey = index->getKey;
+    orderedIndices[orderedIndexIdx].desc = index->desc;
+    orderedIndices[orderedIndexIdx].desc.filter = index->filter;
+    findArchetypes(orderedIndices[orderedIndexIdx].desc);
     enableChangeDetection(index->componentName);
   }
 
+  planOrderedQueries();
+
   dirtyQueries.reserve(queries.size());
   dirtyNamedIndices.reserve(namedIndices.size());
 }
@@ -450,21 +726,26 @@ void EntityManager::sortSystems()
 void EntityManager::buildSystemsDependencies()
 {
   // TODO: Check this. The code might be broken. archetypes are empty by this moment.
-  for (int i = (int)systems.size() - 1; i >= 0; --i)
+  // A system depends on the systems that run before it, so the sorted order is used
+  for (int i = (int)systemsSorted.size() - 1; i >= 0; --i)
   {
-    if (!sidFactory.isValid(systems[i].id))
+    const System &sysI = systems[systemsSorted[i].index];
+    if (!sidFactory.isValid(sysI.id))
       continue;
 
-    const auto &qI = queryDescriptions[systems[i].queryId.index];
-    const auto &compsI = systems[i].desc->queryDesc.components;
-    auto &deps = systemDependencies[systems[i].id];
+    const auto &qI = queryDescriptions[sysI.queryId.index];
+    // Queries of the systems created at runtime (i.e. from scripts) are not in desc
+    const auto &compsI = qI.components;
+    auto &deps = systemDependencies[sysI.id.index];
+    deps.clear();
 
     for (int j = i - 1; j >= 0; --j)
     {
-      if (!sidFactory.isValid(systems[j].id))
+      const System &sysJ = systems[systemsSorted[j].index];
+      if (!sidFactory.isValid(sysJ.id))
         continue;
 
-      const auto &qJ = queryDescriptions[systems[j].queryId.index];
+      const auto &qJ = queryDescriptions[sysJ.queryId.index];
 
       // TODO: abort loop normaly instead of dry runs
 
@@ -482,12 +763,12 @@ void EntityManager::buildSystemsDependencies()
 
       found = false;
       for (const auto &compI : compsI)
-        for (const auto &compJ : systems[j].desc->queryDesc.components)
+        for (const auto &compJ : qJ.components)
           if (!found && compI.name == compJ.name && ((compJ.flags & ComponentDescriptionFlags::kWrite) || (compI.flags & ComponentDescriptionFlags::kWrite)))
           {
             // TODO: Check query intersection!!!
             found = true;
-            deps.push_back(systems[j].id);
+            deps.push_back(sysJ.id);
             break;
           }
     }
@@ -521,18 +802,151 @@ jobmanager::DependencyList EntityManager::getSystemDependencyList(SystemId sid)
 {
   jobmanager::DependencyList deps;
   if (sidFactory.isValid(sid))
+  {
+    const bool isPipelined = isPipelinedSystem(sid);
     for (SystemId depSid : systemDependencies[sid.index])
-      if (sidFactory.isValid(depSid) && systemJobs[depSid.index])
+      if (sidFactory.isValid(depSid) && systemJobs[depSid.index] && isPipelinedSystem(depSid) == isPipelined)
         deps.push_back(systemJobs[depSid.index]);
+  }
   return deps;
 }
 
 void EntityManager::waitSystemDependencies(SystemId sid) const
 {
   if (sidFactory.isValid(sid))
+  {
+    // Pipelined systems work with the extracted copies, so they don't intersect with the others
+    const bool isPipelined = isPipelinedSystem(sid);
     for (SystemId depSid : systemDependencies[sid.index])
-      if (sidFactory.isValid(depSid))
+      if (sidFactory.isValid(depSid) && isPipelinedSystem(depSid) == isPipelined)
         jobmanager::wait(systemJobs[depSid.index]);
+  }
+}
+
+void EntityManager::setPipelined(bool enable)
+{
+  DEBUG_LOG("setPipelined: " << enable);
+  pipelined = enable;
+  pipelinedQueries.clear();
+}
+
+void EntityManager::addPipelinedStage(uint32_t stage_id)
+{
+  pipelinedStages.insert(stage_id);
+  pipelinedQueries.clear();
+}
+
+bool EntityManager::isPipelinedSystem(SystemId sid) const
+{
+  return
+    pipelined &&
+    sid.index < pipelinedQueries.size() &&
+    pipelinedStages.find(systems[sid.index].desc->stageName.hash) != pipelinedStages.end();
+}
+
+// Offset of the last lane of a SoA chunk from its lane 0
+static inline size_t soa_last_lane_offset(const ComponentDescription *desc)
+{
+  if (!desc || !desc->isSoA())
+    return 0;
+  return size_t(desc->soaFieldsCount - 1) * (SOA_BLOCK_SIZE * desc->soaFieldSize);
+}
+
+void EntityManager::destroyPipelinedItems()
+{
+  for (const PipelinedItems &items : pipelinedItems)
+    for (int i = 0; i < items.count; ++i)
+      items.desc->dtor(items.items + i * items.desc->size);
+  pipelinedItems.clear();
+}
+
+void EntityManager::extractPipelinedQueries()
+{
+  static constexpr size_t alignment = 16;
+
+  destroyPipelinedItems();
+
+  pipelinedQueries.resize(systems.size());
+
+  size_t totalSize = 0;
+  for (uint32_t stageId : pipelinedStages)
+  {
+    auto res = systemsByStage.find(stageId);
+    if (res == systemsByStage.end())
+      continue;
+
+    for (SystemId sid : res->second)
+    {
+      const Query &query = queries[systems[sid.index].queryId.index];
+      const QueryDescription &desc = queryDescriptions[systems[sid.index].queryId.index];
+      // Pipelined systems must be read-only, writes to the copies would be lost
+      for (const auto &c : systems[sid.index].desc->queryDesc.components)
+        ASSERT_FMT(!(c.flags & ComponentDescriptionFlags::kWrite), "Pipelined system '%s' writes '%s'", systems[sid.index].name.str, c.name.str);
+
+      for (const auto &c : desc.components)
+        totalSize += query.entitiesCount * c.size + query.chunksCount * (alignment - 1 + soa_last_lane_offset(getComponentDescByName(c.name)));
+    }
+  }
+
+  pipelinedStorage.resize(totalSize);
+  uint8_t *mem = pipelinedStorage.data();
+
+  eastl::vector<const ComponentDescription*> soaDescs;
+
+  for (uint32_t stageId : pipelinedStages)
+  {
+    auto res = systemsByStage.find(stageId);
+    if (res == systemsByStage.end())
+      continue;
+
+    for (SystemId sid : res->second)
+    {
+      const Query &src = queries[systems[sid.index].queryId.index];
+      const QueryDescription &desc = queryDescriptions[systems[sid.index].queryId.index];
+      Query &dst = pipelinedQueries[sid.index];
+
+      dst.id = src.id;
+      dst.name = src.name;
+      dst.componentsCount = src.componentsCount;
+      dst.chunksCount = src.chunksCount;
+      dst.entitiesCount = src.entitiesCount;
+      dst.entitiesInChunk = src.entitiesInChunk;
+      dst.chunkOffsets = src.chunkOffsets;
+      dst.chunks.resize(src.chunks.size());
+
+      soaDescs.resize(src.componentsCount);
+      for (int compIdx = 0; compIdx < src.componentsCount; ++compIdx)
+        soaDescs[compIdx] = getComponentDescByName(desc.components[compIdx].name);
+
+      for (int chunkIdx = 0; chunkIdx < src.chunksCount; ++chunkIdx)
+        for (int compIdx = 0; compIdx < src.componentsCount; ++compIdx)
+        {
+          const int idx = compIdx + chunkIdx * src.componentsCount;
+          // SoA lanes are copied with the gaps between them to keep the lane stride
+          const size_t sz = soaDescs[compIdx] && soaDescs[compIdx]->isSoA() ?
+            soa_last_lane_offset(soaDescs[compIdx]) + src.entitiesInChunk[chunkIdx] * soaDescs[compIdx]->soaFieldSize :
+            src.entitiesInChunk[chunkIdx] * desc.components[compIdx].size;
+          mem = (uint8_t*)(((uintptr_t)mem + alignment - 1) & ~(uintptr_t)(alignment - 1));
+          const ComponentDescription *compDesc = soaDescs[compIdx];
+          if (compDesc && !compDesc->isTrivial && !compDesc->isSoA())
+          {
+            // Containers must not share their heap with the items the next update might change
+            for (int i = 0; i < src.entitiesInChunk[chunkIdx]; ++i)
+            {
+              compDesc->ctor(mem + i * compDesc->size);
+              compDesc->copy(mem + i * compDesc->size, src.chunks[idx] + i * compDesc->size);
+            }
+            pipelinedItems.push_back({compDesc, mem, src.entitiesInChunk[chunkIdx]});
+          }
+          else
+            ::memcpy(mem, src.chunks[idx], sz);
+          dst.chunks[idx] = mem;
+          mem += sz;
+        }
+    }
+  }
+
+  ASSERT(mem <= pipelinedStorage.data() + pipelinedStorage.size());
 }
 
 const ComponentDescription* EntityManager::getComponentDescByName(const char *name) const
@@ -567,12 +981,58 @@ Index* EntityManager::findIndex(const ConstHashedString &name)
   return nullptr;
 }
 
+SpatialIndex* EntityManager::findSpatialIndex(const ConstHashedString &name)
+{
+  for (auto &i : spatialIndices)
+    if (i.name == name)
+      return &i;
+  return nullptr;
+}
+
+OrderedIndex* EntityManager::findOrderedIndex(const ConstHashedString &name)
+{
+  for (auto &i : orderedIndices)
+    if (i.name == name)
+      return &i;
+  return nullptr;
+}
+
+static bool is_same_components(const ComponentsMap &lhs, const ComponentsMap &rhs)
+{
+  if (lhs.components.size() != rhs.components.size())
+    return false;
+  for (const auto &kv : lhs.components)
+  {
+    auto res = rhs.components.find(kv.first);
+    if (res == rhs.components.end() || res->second.desc != kv.second.desc)
+      return false;
+  }
+  return true;
+}
+
 void EntityManager::addTemplate(const char *templ_name, ComponentsMap &&cmap)
 {
-  EntityTemplate &templ = templates.emplace_back();
+  cmap.createComponent(HASH("eid"), find_component(HASH("EntityId")));
+
+  EntityTemplate *existing = nullptr;
+  for (auto &t : templates)
+    if (t.name == templ_name)
+    {
+      existing = &t;
+      break;
+    }
+
+  // Registered again on a script reload, only the values changed so the archetype is kept
+  if (existing && is_same_components(existing->cmap, cmap))
+  {
+    existing->cmap = eastl::move(cmap);
+    return;
+  }
+
+  // New components, the created entities stay in the old archetype
+  EntityTemplate &templ = existing ? *existing : templates.emplace_back();
   templ.name = templ_name;
   templ.cmap = eastl::move(cmap);
-  templ.cmap.createComponent(HASH("eid"), find_component(HASH("EntityId")));
 
   templ.size = 0;
   for (const auto &kv : templ.cmap.components)
@@ -602,6 +1062,7 @@ void EntityManager::addTemplate(const char *templ_name, ComponentsMap &&cmap)
     ASSERT(kv.second.desc != nullptr);
     new (&type.storages[i]) Archetype::Storage(kv.second.desc);
     new (&type.storageNames[i]) HashedString(kv.first);
+    type.hasSoA = type.hasSoA || type.storages[i].soa;
     ++i;
   }
 
@@ -678,13 +1139,130 @@ EntityId EntityManager::createEntitySync(const char *templ_name, ComponentsMap &
   return eid;
 }
 
+static eastl::unique_ptr<LevelStaging> prepare_level(const char *path)
+{
+  eastl::unique_ptr<Level> level = eastl::make_unique<Level>();
+  if (!level->open(path))
+    return nullptr;
+
+  eastl::unique_ptr<LevelStaging> staging = eastl::make_unique<LevelStaging>();
+  if (!staging->prepare(eastl::move(level)))
+    return nullptr;
+  return staging;
+}
+
+bool EntityManager::loadLevel(const char *path)
+{
+  eastl::unique_ptr<LevelStaging> staging = prepare_level(path);
+  if (!staging)
+    return false;
+  levelQueue.emplace_back(eastl::move(staging));
+  return true;
+}
+
+bool EntityManager::loadLevelAsync(const char *path)
+{
+  eastl::unique_ptr<LevelStaging> staging = prepare_level(path);
+  if (!staging)
+    return false;
+  LevelStaging *ptr = staging.get();
+  staging->decodeResult = std::async(std::launch::async, [ptr]() { ptr->decode(); });
+  levelQueue.emplace_back(eastl::move(staging));
+  return true;
+}
+
+void EntityManager::spliceLevel(LevelStaging &staging)
+{
+  DEBUG_LOG("[level]: " << staging.level->path.c_str());
+  ASSERT_FMT(staging.error.empty(), "%s", staging.error.c_str());
+
+  for (LevelStaging::Group &group : staging.groups)
+  {
+    // The template was registered again with other components while the level was decoded
+    if (templates[group.templateId].archetypeId != group.archetypeId)
+    {
+      ASSERT_FMT(false, "Template '%s' is changed while level '%s' is loaded", templates[group.templateId].name.c_str(), staging.level->path.c_str());
+      continue;
+    }
+
+    Archetype &type = archetypes[group.archetypeId];
+    const int32_t count = group.entitiesCount;
+    const int32_t first = type.allocateRange(count);
+
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      Archetype::Storage &storage = type.storages[i];
+      uint8_t *items = group.columns[i].items;
+      if (storage.soa)
+        for (int32_t j = 0; j < count; ++j)
+          storage.set(first + j, items + j * storage.itemSize);
+      else if (storage.desc->isTrivial)
+        ::memcpy(storage.get(first), items, size_t(storage.itemSize) * count);
+      else
+        for (int32_t j = 0; j < count; ++j)
+        {
+          storage.desc->ctor(storage.get(first + j));
+          storage.desc->move(storage.get(first + j), items + j * storage.itemSize);
+        }
+    }
+
+    const int eidCompIdx = type.getComponentIndex(HASH("eid"));
+    for (int32_t i = 0; i < count; ++i)
+    {
+      const EntityId eid = eidFactory.allocate();
+      if (eid.index >= entities.size())
+        entities.resize(eid.index + 1);
+
+      auto &e = entities[eid.index];
+      e.templateId = group.templateId;
+      e.archetypeId = group.archetypeId;
+      e.indexInArchetype = first + i;
+      e.ready = true;
+
+      type.storages[eidCompIdx].set(first + i, (const uint8_t*)&eid);
+    }
+
+    entitiesCount += count;
+
+    sendEventSync(group.archetypeId, first, count, EventOnEntityCreate{});
+  }
+}
+
 void EntityManager::tick()
 {
-  jobmanager::wait_all_jobs();
+  jobmanager::wait_context_jobs();
 
   for (auto &job : systemJobs)
     job = jobmanager::JobId{};
 
+  if (profiling)
+  {
+    if (hwcounters::is_enabled())
+    {
+      // Owner index is sid.index + 1
+      eastl::vector<hwcounters::Values> counters;
+      hwcounters::collect(countersGroup, counters);
+      for (int index = 1, sz = eastl::min((int)counters.size(), (int)systemProfiles.size() + 1); index < sz; ++index)
+        for (int i = 0; i < hwcounters::kCount; ++i)
+          systemProfiles[index - 1].counters[i] += counters[index][i];
+    }
+
+    eastl::vector<jobmanager::OwnerStat> ownerStats;
+    jobmanager::collect_owner_stats(countersGroup, ownerStats);
+    for (int index = 1, sz = eastl::min((int)ownerStats.size(), (int)systemProfiles.size() + 1); index < sz; ++index)
+    {
+      systemProfiles[index - 1].jobTime += ownerStats[index].taskTime;
+      systemProfiles[index - 1].jobs += ownerStats[index].jobs;
+    }
+
+    for (auto &profile : systemProfiles)
+      profile.nextFrame();
+
+    ++profilingFrameNo;
+    if (profilingReportFrames > 0 && (profilingFrameNo % profilingReportFrames) == 0)
+      writeProfilingReport(std::cout, profilingReportCsv);
+  }
+
   bool shouldInvalidateQueries = false;
 
   if (isDirtySystems)
@@ -734,42 +1312,89 @@ void EntityManager::tick()
     createQueue.pop();
   }
 
-  for (const auto &v : asyncValues)
+  for (size_t i = 0; i < levelQueue.size();)
   {
-    const bool ready = v.isReady();
-    if (ready)
+    LevelStaging &staging = *levelQueue[i];
+    if (staging.decodeResult.valid())
     {
-      shouldInvalidateQueries = true;
-
-      if (eidFactory.isValid(v.eid))
+      if (staging.decodeResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
       {
-        entities[v.eid.index].ready = ready;
-        sendEventSync(v.eid, EventOnEntityReady{});
+        ++i;
+        continue;
       }
+      staging.decodeResult.get();
     }
-  }
+    else
+      staging.decode();
 
-  if (!asyncValues.empty())
-    asyncValues.erase(eastl::remove_if(asyncValues.begin(), asyncValues.end(), [](const AsyncValue &v) { return v.isReady(); }), asyncValues.end());
+    // A broken level is discarded as a whole, no entity of it is created
+    if (!staging.error.empty())
+    {
+      DEBUG_LOG("[level]: " << staging.error.c_str());
+      levelQueue.erase(levelQueue.begin() + i);
+      continue;
+    }
 
-  if (shouldInvalidateQueries)
-  {
-    for (auto &q : queries)
-      performQuery(queryDescriptions[q.id.index], q);
-    for (auto &i : namedIndices)
-      rebuildIndex(i);
+    shouldInvalidateQueries = true;
+
+    spliceLevel(staging);
+    levelQueue.erase(levelQueue.begin() + i);
   }
-  else
+
+  if (!asyncValues.empty())
+  {
+    eastl::vector<EntityId> readyEntities;
+    for (size_t i = 0; i < asyncValues.size();)
+      if (asyncValues[i].isReady())
+      {
+        if (eidFactory.isValid(asyncValues[i].eid))
+        {
+          entities[asyncValues[i].eid.index].ready = true;
+          readyEntities.push_back(asyncValues[i].eid);
+        }
+        asyncValues.erase(asyncValues.begin() + i);
+      }
+      else
+        ++i;
+
+    if (!readyEntities.empty())
+    {
+      shouldInvalidateQueries = true;
+      sendEventSync(readyEntities, EventOnEntityReady{});
+    }
+  }
+
+  // Planned queries take candidates from ordered indices, so indices go first
+  for (auto &i : orderedIndices)
+    if (shouldInvalidateQueries)
+      rebuildOrderedIndex(i);
+    else
+      updateOrderedIndex(i);
+
+  if (shouldInvalidateQueries)
+  {
+    for (auto &q : queries)
+      performQuery(queryDescriptions[q.id.index], q);
+    for (auto &i : namedIndices)
+      rebuildIndex(i);
+  }
+  else
   {
     for (QueryId queryId : dirtyQueries)
       performQuery(queryId);
     for (int indexIdx : dirtyNamedIndices)
-      rebuildIndex(namedIndices[indexIdx]);
+      updateIndex(namedIndices[indexIdx]);
 
     dirtyQueries.clear();
     dirtyNamedIndices.clear();
   }
 
+  for (auto &i : spatialIndices)
+    rebuildSpatialIndex(i);
+
+  if (pipelined)
+    extractPipelinedQueries();
+
   // Use double buffer for events because events might me sent
   // during current events quere sendeing.
   // So, change the buffer to write before processing current events
@@ -787,6 +1412,8 @@ void EntityManager::tick()
       RawArg ev;
       eastl::tie(header, ev) = events[streamIndex].pop();
 
+      TRACE_SCOPE(kEvent, "event", header.eventId);
+
       if (header.flags & EventStream::kBroadcast)
         sendEventBroadcastSync(header.eventId, ev);
       else
@@ -820,16 +1447,61 @@ int Archetype::getComponentIndex(const ConstHashedString &name) const
   return getComponentIndex(HashedString(name));
 }
 
-Query* Index::find(uint32_t value)
+static inline size_t align_to_cache_line(size_t sz)
 {
-  auto res = itemsMap.find(value);
-  return res != itemsMap.end() ? &queries[res->second] : nullptr;
+  return (sz + memory::CACHE_LINE_SIZE - 1) & ~(memory::CACHE_LINE_SIZE - 1);
+}
+
+void Archetype::reserve(int32_t count)
+{
+  if (count <= entitiesReserved)
+    return;
+
+  size_t newColumnsSize = 0;
+  for (int i = 0; i < componentsCount; ++i)
+    newColumnsSize += align_to_cache_line(storages[i].columnSize(count));
+
+  uint8_t *newColumns = (uint8_t*)memory::alloc(memory::Subsystem::kStorage, newColumnsSize, memory::CACHE_LINE_SIZE);
+  if (newColumns)
+    ::memset(newColumns, 0, newColumnsSize);
+
+  uint8_t *column = newColumns;
+  for (int i = 0; i < componentsCount; ++i)
+  {
+    storages[i].move(column, freeMask, entitiesCapacity);
+    column += align_to_cache_line(storages[i].columnSize(count));
+  }
+
+  memory::free(memory::Subsystem::kStorage, columns, columnsSize);
+
+  columns = newColumns;
+  columnsSize = newColumnsSize;
+  entitiesReserved = count;
 }
 
 void Query::addChunks(const QueryDescription &in_desc, Archetype &type, int begin, int entities_count)
+{
+  if (!type.hasSoA)
+  {
+    addChunk(in_desc, type, begin, entities_count);
+    return;
+  }
+
+  // All lanes of a chunk must be addressable from its lane 0 pointer
+  while (entities_count > 0)
+  {
+    const int count = eastl::min(entities_count, SOA_BLOCK_SIZE - begin % SOA_BLOCK_SIZE);
+    addChunk(in_desc, type, begin, count);
+    begin += count;
+    entities_count -= count;
+  }
+}
+
+void Query::addChunk(const QueryDescription &in_desc, Archetype &type, int begin, int entities_count)
 {
   ++chunksCount;
 
+  chunkOffsets.push_back(entitiesCount);
   entitiesCount += entities_count;
   chunks.resize(chunks.size() + componentsCount);
   entitiesInChunk.resize(chunksCount);
@@ -843,6 +1515,35 @@ void Query::addChunks(const QueryDescription &in_desc, Archetype &type, int begi
   }
 }
 
+void Query::splitToTasks(int chunk_size, eastl::vector<Task> &tasks) const
+{
+  ASSERT(chunk_size > 0);
+
+  tasks.clear();
+
+  Task *last = nullptr;
+  for (int chunkIdx = 0; chunkIdx < chunksCount; ++chunkIdx)
+  {
+    const int count = entitiesInChunk[chunkIdx];
+    if (count <= 0)
+      continue;
+
+    if (count > chunk_size)
+    {
+      for (int offset = 0; offset < count; offset += chunk_size)
+        tasks.push_back({ chunkIdx, offset, eastl::min(chunk_size, count - offset) });
+      last = nullptr;
+    }
+    else if (last && last->count + count <= chunk_size)
+      last->count += count;
+    else
+    {
+      tasks.push_back({ chunkIdx, 0, count });
+      last = &tasks.back();
+    }
+  }
+}
+
 void EntityManager::performQuery(const QueryId &qid)
 {
   if (qidFactory.isValid(qid))
@@ -851,14 +1552,52 @@ void EntityManager::performQuery(const QueryId &qid)
 
 void EntityManager::performQuery(const QueryDescription &desc, Query &query)
 {
+  TRACE_SCOPE(kQuery, query.name.str ? query.name.str : "query", 0, trace_name_kind(query.name));
+
   const bool isValid = desc.isValid();
 
   query.chunksCount = 0;
   query.entitiesCount = 0;
   query.chunks.clear();
   query.entitiesInChunk.clear();
+  query.chunkOffsets.clear();
   query.componentsCount = desc.components.size();
 
+  if (desc.orderedIndex >= 0)
+  {
+    const OrderedIndex &index = orderedIndices[desc.orderedIndex];
+
+    eastl::vector<bool> inQuery(archetypes.size(), false);
+    for (int archetypeId : desc.archetypes)
+      inQuery[archetypeId] = true;
+
+    eastl::vector<OrderedIndex::Row> candidates;
+    for (int i = index.rangeBegin(desc.orderedRange), end = index.rangeEnd(desc.orderedRange); i < end; ++i)
+    {
+      const OrderedIndex::Row &row = index.rows[i];
+      const Archetype &type = archetypes[row.archetypeId];
+      if (inQuery[row.archetypeId] && !type.freeMask[row.entityIndex] && (!desc.filter || desc.filter(type, row.entityIndex)))
+        candidates.push_back(row);
+    }
+
+    // Back to entity order, consecutive entities make one chunk
+    eastl::sort(candidates.begin(), candidates.end(), [](const OrderedIndex::Row &lhs, const OrderedIndex::Row &rhs)
+    {
+      return lhs.archetypeId != rhs.archetypeId ? lhs.archetypeId < rhs.archetypeId : lhs.entityIndex < rhs.entityIndex;
+    });
+
+    for (int i = 0, sz = candidates.size(); i < sz;)
+    {
+      const OrderedIndex::Row &first = candidates[i];
+      int count = 1;
+      while (i + count < sz && candidates[i + count].archetypeId == first.archetypeId && candidates[i + count].entityIndex == first.entityIndex + count)
+        ++count;
+      query.addChunks(desc, archetypes[first.archetypeId], first.entityIndex, count);
+      i += count;
+    }
+    return;
+  }
+
   for (int archetypeId : desc.archetypes)
   {
     auto &type = archetypes[archetypeId];
@@ -887,88 +1626,762 @@ void EntityManager::performQuery(const QueryDescription &desc, Query &query)
   }
 }
 
+static constexpr int INDEX_PARTITION_SIZE = 4096;
+
+static inline bool index_has_archetype(const QueryDescription &desc, const Archetype &type)
+{
+  return
+    desc.isValid() &&
+    not_have_components(type, desc.notHaveComponents) &&
+    has_components(type, desc.components) &&
+    has_components(type, desc.haveComponents);
+}
+
+// Sum of change versions of the archetype's columns the index depends on
+static uint32_t index_archetype_version(const QueryDescription &desc, const Archetype &type)
+{
+  uint32_t version = 0;
+  for (int i = 0; i < type.componentsCount; ++i)
+    if (desc.isDependOnComponent(type.storageNames[i]))
+      version += type.storages[i].version;
+  return version;
+}
+
+static void index_key_columns(const Index &index, const Archetype &type, eastl::fixed_vector<int, 4> &columns)
+{
+  columns.clear();
+  for (const auto &name : index.keyComponents)
+  {
+    const int componentIdx = type.getComponentIndex(name);
+    ASSERT(componentIdx >= 0);
+    ASSERT(!type.storages[componentIdx].soa);
+    columns.push_back(componentIdx);
+  }
+}
+
+// Returns false if the entity is not in the index
+static inline bool index_entity_key(const Index &index, Archetype &type, const eastl::fixed_vector<int, 4> &columns, int entity_index, IndexKey &key)
+{
+  if (type.freeMask[entity_index] || (index.desc.filter && !index.desc.filter(type, entity_index)))
+    return false;
+
+  key.size = 0;
+  for (int column : columns)
+    key.append(type.storages[column].get(entity_index), type.storages[column].itemSize);
+  return true;
+}
+
+IndexBucket Index::bucket(int item_id)
+{
+  const int firstChunk = chunkOffsets[item_id];
+
+  IndexBucket res;
+  res.chunks = rows.chunks.data() + firstChunk * rows.componentsCount;
+  res.entitiesInChunk = rows.entitiesInChunk.data() + firstChunk;
+  res.chunksCount = chunkOffsets[item_id + 1] - firstChunk;
+  res.componentsCount = rows.componentsCount;
+  res.entitiesCount = memberOffsets[item_id + 1] - memberOffsets[item_id];
+  return res;
+}
+
+IndexBucket Index::find(const IndexKey &key)
+{
+  ASSERT(key.size == keySize);
+  auto res = itemsMap.find(key);
+  return res != itemsMap.end() ? bucket(res->second) : IndexBucket();
+}
+
+int Index::getOrAddItem(const IndexKey &key)
+{
+  auto res = itemsMap.insert(key);
+  if (res.second)
+  {
+    if (!freeItems.empty())
+    {
+      res.first->second = freeItems.back();
+      freeItems.pop_back();
+      keys[res.first->second] = key;
+    }
+    else
+    {
+      res.first->second = (int)keys.size();
+      keys.push_back(key);
+    }
+  }
+  return res.first->second;
+}
+
+void Index::clear()
+{
+  itemsMap.clear();
+  keys.clear();
+  freeItems.clear();
+  memberOffsets.clear();
+  members.clear();
+  chunkOffsets.clear();
+  rows.reset();
+  archetypes.clear();
+}
+
+void EntityManager::buildIndexRows(Index &index)
+{
+  const int itemsCount = index.itemsCount();
+
+  // Counting sort of entities by item. Archetypes and entities are visited in order,
+  // so members of an item are sorted and consecutive entities make one chunk.
+  auto &offsets = index.memberOffsets;
+  offsets.assign(itemsCount + 1, 0);
+  for (const auto &state : index.archetypes)
+    for (int itemId : state.itemOf)
+      if (itemId >= 0)
+        ++offsets[itemId + 1];
+  for (int i = 0; i < itemsCount; ++i)
+    offsets[i + 1] += offsets[i];
+
+  index.members.resize(offsets[itemsCount]);
+  for (int archetypeId = 0; archetypeId < (int)index.archetypes.size(); ++archetypeId)
+  {
+    const auto &itemOf = index.archetypes[archetypeId].itemOf;
+    for (int i = 0; i < (int)itemOf.size(); ++i)
+      if (itemOf[i] >= 0)
+        index.members[offsets[itemOf[i]]++] = { archetypeId, i };
+  }
+  // offsets[i] is the end of the item i now
+  for (int i = itemsCount; i > 0; --i)
+    offsets[i] = offsets[i - 1];
+  offsets[0] = 0;
+
+  index.rows.reset();
+  index.rows.componentsCount = index.desc.components.size();
+  index.chunkOffsets.resize(itemsCount + 1);
+
+  for (int itemId = 0; itemId < itemsCount; ++itemId)
+  {
+    index.chunkOffsets[itemId] = index.rows.chunksCount;
+    for (int i = offsets[itemId], end = offsets[itemId + 1]; i < end;)
+    {
+      const Index::Member &first = index.members[i];
+      int count = 1;
+      while (i + count < end && index.members[i + count].archetypeId == first.archetypeId && index.members[i + count].entityIndex == first.entityIndex + count)
+        ++count;
+      index.rows.addChunks(index.desc, archetypes[first.archetypeId], first.entityIndex, count);
+      i += count;
+    }
+  }
+  index.chunkOffsets[itemsCount] = index.rows.chunksCount;
+}
+
+static void copy_index_chunks(Query &to, const Query &from, int first_chunk, int count)
+{
+  for (int chunkIdx = first_chunk; chunkIdx < first_chunk + count; ++chunkIdx)
+  {
+    to.chunkOffsets.push_back(to.entitiesCount);
+    to.entitiesCount += from.entitiesInChunk[chunkIdx];
+    to.entitiesInChunk.push_back(from.entitiesInChunk[chunkIdx]);
+    to.chunks.insert(to.chunks.end(), from.chunks.begin() + chunkIdx * from.componentsCount, from.chunks.begin() + (chunkIdx + 1) * from.componentsCount);
+  }
+  to.chunksCount += count;
+}
+
+void EntityManager::updateIndexRows(Index &index, const eastl::vector<uint8_t> &changed_archetypes, const eastl::vector<uint8_t> &dirty_items)
+{
+  const int itemsCount = index.itemsCount();
+  const int oldItemsCount = (int)index.memberOffsets.size() - 1;
+
+  // Counting sort of members of changed archetypes by item, they stay sorted like in buildIndexRows
+  eastl::vector<int> changedOffsets(itemsCount + 1, 0);
+  for (int archetypeId = 0; archetypeId < (int)changed_archetypes.size(); ++archetypeId)
+    if (changed_archetypes[archetypeId])
+      for (int itemId : index.archetypes[archetypeId].itemOf)
+        if (itemId >= 0)
+          ++changedOffsets[itemId + 1];
+  for (int i = 0; i < itemsCount; ++i)
+    changedOffsets[i + 1] += changedOffsets[i];
+
+  eastl::vector<Index::Member> changedMembers(changedOffsets[itemsCount]);
+  for (int archetypeId = 0; archetypeId < (int)changed_archetypes.size(); ++archetypeId)
+    if (changed_archetypes[archetypeId])
+    {
+      const auto &itemOf = index.archetypes[archetypeId].itemOf;
+      for (int i = 0; i < (int)itemOf.size(); ++i)
+        if (itemOf[i] >= 0)
+          changedMembers[changedOffsets[itemOf[i]]++] = { archetypeId, i };
+    }
+  // changedOffsets[i] is the end of the item i now
+  for (int i = itemsCount; i > 0; --i)
+    changedOffsets[i] = changedOffsets[i - 1];
+  changedOffsets[0] = 0;
+
+  decltype(index.memberOffsets) memberOffsets(itemsCount + 1);
+  decltype(index.members) members;
+  members.reserve(index.members.size() + changedMembers.size());
+  decltype(index.chunkOffsets) chunkOffsets(itemsCount + 1);
+  Query rows;
+  rows.componentsCount = index.desc.components.size();
+
+  // Members and chunks of clean items are copied, only dirty items are grouped again
+  for (int itemId = 0; itemId < itemsCount; ++itemId)
+  {
+    memberOffsets[itemId] = (int)members.size();
+    chunkOffsets[itemId] = rows.chunksCount;
+
+    const bool isOld = itemId < oldItemsCount;
+    if (!dirty_items[itemId])
+    {
+      if (isOld)
+      {
+        members.insert(members.end(), index.members.begin() + index.memberOffsets[itemId], index.members.begin() + index.memberOffsets[itemId + 1]);
+        copy_index_chunks(rows, index.rows, index.chunkOffsets[itemId], index.chunkOffsets[itemId + 1] - index.chunkOffsets[itemId]);
+      }
+      continue;
+    }
+
+    const int first = (int)members.size();
+    if (isOld)
+      for (int i = index.memberOffsets[itemId], end = index.memberOffsets[itemId + 1]; i < end; ++i)
+        if (!changed_archetypes[index.members[i].archetypeId])
+          members.push_back(index.members[i]);
+    members.insert(members.end(), changedMembers.begin() + changedOffsets[itemId], changedMembers.begin() + changedOffsets[itemId + 1]);
+    eastl::sort(members.begin() + first, members.end(), [](const Index::Member &lhs, const Index::Member &rhs)
+    {
+      return lhs.archetypeId != rhs.archetypeId ? lhs.archetypeId < rhs.archetypeId : lhs.entityIndex < rhs.entityIndex;
+    });
+
+    const int end = (int)members.size();
+    if (first == end)
+    {
+      index.itemsMap.erase(index.keys[itemId]);
+      index.freeItems.push_back(itemId);
+      continue;
+    }
+
+    for (int i = first; i < end;)
+    {
+      const Index::Member &m = members[i];
+      int count = 1;
+      while (i + count < end && members[i + count].archetypeId == m.archetypeId && members[i + count].entityIndex == m.entityIndex + count)
+        ++count;
+      rows.addChunks(index.desc, archetypes[m.archetypeId], m.entityIndex, count);
+      i += count;
+    }
+  }
+  memberOffsets[itemsCount] = (int)members.size();
+  chunkOffsets[itemsCount] = rows.chunksCount;
+
+  index.memberOffsets = eastl::move(memberOffsets);
+  index.members = eastl::move(members);
+  index.chunkOffsets = eastl::move(chunkOffsets);
+  index.rows = eastl::move(rows);
+}
+
 void EntityManager::rebuildIndex(Index &index)
 {
-  const bool isValid = index.desc.isValid();
+  TRACE_SCOPE(kQuery, index.name.str, 0, trace_name_kind(index.name));
 
-  index.queries.clear();
-  index.itemsMap.clear();
+  // Local keys of entities of a part of an archetype
+  struct Partition
+  {
+    int archetypeId = -1;
+    int begin = 0;
+    int end = 0;
+    eastl::hash_map<IndexKey, int> keysMap;
+    eastl::vector<IndexKey> keys;
+    // Local key of every entity, -1 if the entity is not in the index
+    eastl::vector<int> keyOf;
+  };
 
-  for (auto &type : archetypes)
+  index.clear();
+  index.archetypes.resize(archetypes.size());
+
+  eastl::vector<Partition> partitions;
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
   {
-    // TODO: ASSERT on type mismatch
-    bool ok =
-      isValid &&
-      not_have_components(type, index.desc.notHaveComponents) &&
-      has_components(type, index.desc.components) &&
-      has_components(type, index.desc.haveComponents);
+    const Archetype &type = archetypes[archetypeId];
+    if (!index_has_archetype(index.desc, type))
+      continue;
 
-    if (ok)
+    index.archetypes[archetypeId].version = index_archetype_version(index.desc, type);
+    index.archetypes[archetypeId].itemOf.resize(type.entitiesCapacity, -1);
+
+    for (int begin = 0; begin < type.entitiesCapacity; begin += INDEX_PARTITION_SIZE)
     {
-      const int componentIdx = type.getComponentIndex(index.componentName);
-      ASSERT(componentIdx >= 0);
-      const int componentSize = type.storages[componentIdx].itemSize;
-      ASSERT(componentSize == sizeof(uint32_t));
-
-      int lastQueryId = -1;
-      int begin = -1;
-      for (int i = 0; i < type.entitiesCapacity; ++i)
+      Partition &p = partitions.emplace_back();
+      p.archetypeId = archetypeId;
+      p.begin = begin;
+      p.end = eastl::min(begin + INDEX_PARTITION_SIZE, type.entitiesCapacity);
+    }
+  }
+
+  auto groupPartition = [this, &index](Partition &p)
+  {
+    Archetype &type = archetypes[p.archetypeId];
+
+    eastl::fixed_vector<int, 4> columns;
+    index_key_columns(index, type, columns);
+
+    p.keyOf.resize(p.end - p.begin, -1);
+
+    IndexKey key;
+    for (int i = p.begin; i < p.end; ++i)
+      if (index_entity_key(index, type, columns, i, key))
       {
-        // TODO: Find a better solution
-        ok = !type.freeMask[i];
+        auto res = p.keysMap.insert(key);
+        if (res.second)
+        {
+          res.first->second = (int)p.keys.size();
+          p.keys.push_back(key);
+        }
+        p.keyOf[i - p.begin] = res.first->second;
+      }
+  };
+
+  if (partitions.size() > 1)
+  {
+    auto job = jobmanager::add_job((int)partitions.size(), 1, [&](int from, int count)
+    {
+      for (int i = from; i < from + count; ++i)
+        groupPartition(partitions[i]);
+    });
+    jobmanager::start_jobs();
+    jobmanager::wait(job);
+  }
+  else if (!partitions.empty())
+    groupPartition(partitions[0]);
+
+  eastl::vector<int> itemOfKey;
+  for (const Partition &p : partitions)
+  {
+    itemOfKey.resize(p.keys.size());
+    for (int k = 0; k < (int)p.keys.size(); ++k)
+      itemOfKey[k] = index.getOrAddItem(p.keys[k]);
+
+    auto &itemOf = index.archetypes[p.archetypeId].itemOf;
+    for (int i = 0; i < (int)p.keyOf.size(); ++i)
+      if (p.keyOf[i] >= 0)
+        itemOf[p.begin + i] = itemOfKey[p.keyOf[i]];
+  }
 
-        if (!ok && lastQueryId < 0)
+  buildIndexRows(index);
+}
+
+void EntityManager::updateIndex(Index &index)
+{
+  // New archetypes
+  if (index.archetypes.size() != archetypes.size())
+  {
+    rebuildIndex(index);
+    return;
+  }
+
+  TRACE_SCOPE(kQuery, index.name.str, 0, trace_name_kind(index.name));
+
+  eastl::fixed_vector<int, 4> columns;
+  IndexKey key;
+
+  // Items that lose or gain members or have members in a changed archetype
+  eastl::vector<uint8_t> dirtyItems(index.itemsCount(), 0);
+  auto markDirty = [&dirtyItems](int item_id)
+  {
+    if (item_id >= (int)dirtyItems.size())
+      dirtyItems.resize(item_id + 1, 0);
+    dirtyItems[item_id] = 1;
+  };
+
+  eastl::vector<uint8_t> changedArchetypes(archetypes.size(), 0);
+  bool changed = false;
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
+  {
+    Archetype &type = archetypes[archetypeId];
+    if (!index_has_archetype(index.desc, type))
+      continue;
+
+    Index::ArchetypeState &state = index.archetypes[archetypeId];
+    const uint32_t version = index_archetype_version(index.desc, type);
+    if (version == state.version && (int)state.itemOf.size() == type.entitiesCapacity)
+      continue;
+
+    state.version = version;
+    state.itemOf.resize(type.entitiesCapacity, -1);
+
+    index_key_columns(index, type, columns);
+
+    for (int i = 0; i < type.entitiesCapacity; ++i)
+    {
+      const int oldItemId = state.itemOf[i];
+
+      int newItemId = -1;
+      if (index_entity_key(index, type, columns, i, key))
+        newItemId = oldItemId >= 0 && index.keys[oldItemId] == key ? oldItemId : index.getOrAddItem(key);
+
+      state.itemOf[i] = newItemId;
+
+      if (oldItemId >= 0)
+        markDirty(oldItemId);
+      if (newItemId >= 0)
+        markDirty(newItemId);
+    }
+
+    changedArchetypes[archetypeId] = 1;
+    changed = true;
+  }
+
+  if (changed)
+  {
+    dirtyItems.resize(index.itemsCount(), 0);
+    updateIndexRows(index, changedArchetypes, dirtyItems);
+  }
+}
+
+Query& EntityManager::performCachedQuery(const ConstQueryDescription &in_desc, const filter_t &filter)
+{
+  std::lock_guard<std::mutex> lock(cachedQueriesMutex);
+
+  CachedQuery &cached = cachedQueries[&in_desc];
+  if (cached.archetypesCount < 0)
+  {
+    cached.desc = in_desc;
+    cached.desc.filter = filter;
+  }
+
+  if (cached.archetypesCount != (int)archetypes.size())
+  {
+    findArchetypes(cached.desc);
+    cached.archetypesCount = (int)archetypes.size();
+    // Forces performQuery
+    cached.version = ~0u;
+  }
+
+  uint32_t version = 0;
+  for (int archetypeId : cached.desc.archetypes)
+  {
+    const Archetype &type = archetypes[archetypeId];
+    version += type.structureVersion;
+    if (cached.desc.filter)
+      version += index_archetype_version(cached.desc, type);
+  }
+
+  if (version != cached.version)
+  {
+    performQuery(cached.desc, cached.query);
+    cached.version = version;
+  }
+
+  return cached.query;
+}
+
+void SpatialIndex::clear()
+{
+  bucketsMask = 0;
+  bucketOffsets.clear();
+  rows.clear();
+  componentsCount = 0;
+  columns.clear();
+}
+
+void EntityManager::rebuildSpatialIndex(SpatialIndex &index)
+{
+  TRACE_SCOPE(kQuery, index.name.str, 0, trace_name_kind(index.name));
+
+  // Entities of a part of an archetype
+  struct Range
+  {
+    int archetypeId = -1;
+    int positionColumn = -1;
+    int begin = 0;
+    int end = 0;
+    // Offset of the range in bucketOf
+    int first = 0;
+  };
+
+  // Consecutive ranges of one job, every partition has its own histogram
+  struct Partition
+  {
+    int firstRange = 0;
+    int endRange = 0;
+  };
+
+  index.clear();
+  index.componentsCount = index.desc.components.size();
+  index.columns.resize(archetypes.size() * index.componentsCount, nullptr);
+
+  int capacity = 0;
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
+    if (index_has_archetype(index.desc, archetypes[archetypeId]))
+      capacity += archetypes[archetypeId].entitiesCapacity;
+
+  if (capacity == 0)
+    return;
+
+  // At most one partition per thread, histograms take partitions * bucketsCount ints
+  int partitionsCount = (capacity + INDEX_PARTITION_SIZE - 1) / INDEX_PARTITION_SIZE;
+  if (partitionsCount > 1)
+    partitionsCount = eastl::min(partitionsCount, jobmanager::get_workers_count() + 1);
+  const int partitionSize = (capacity + partitionsCount - 1) / partitionsCount;
+
+  // Ranges are cut at partition boundaries
+  eastl::vector<Range> ranges;
+  eastl::vector<Partition> partitions(partitionsCount);
+  int first = 0;
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
+  {
+    Archetype &type = archetypes[archetypeId];
+    if (!index_has_archetype(index.desc, type))
+      continue;
+
+    // Rows address whole columns, SoA ones are block-aware (see soa_item)
+    for (int i = 0; i < index.componentsCount; ++i)
+      index.columns[archetypeId * index.componentsCount + i] = type.storages[type.getComponentIndex(index.desc.components[i].name)].items;
+
+    // Positions are read as a plain array
+    const int positionColumn = type.getComponentIndex(index.componentName);
+    ASSERT(positionColumn >= 0);
+    ASSERT(!type.storages[positionColumn].soa);
+    ASSERT(type.storages[positionColumn].itemSize == sizeof(glm::vec2));
+
+    for (int begin = 0; begin < type.entitiesCapacity;)
+    {
+      const int partitionIdx = first / partitionSize;
+      Range &r = ranges.emplace_back();
+      r.archetypeId = archetypeId;
+      r.positionColumn = positionColumn;
+      r.begin = begin;
+      r.end = eastl::min(begin + (partitionIdx + 1) * partitionSize - first, type.entitiesCapacity);
+      r.first = first;
+      partitions[partitionIdx].endRange = (int)ranges.size();
+      first += r.end - r.begin;
+      begin = r.end;
+    }
+  }
+  for (int i = 1; i < partitionsCount; ++i)
+  {
+    partitions[i].firstRange = partitions[i - 1].endRange;
+    partitions[i].endRange = eastl::max(partitions[i].endRange, partitions[i].firstRange);
+  }
+
+  int bucketsCount = 64;
+  while (bucketsCount < capacity)
+    bucketsCount <<= 1;
+  index.bucketsMask = bucketsCount - 1;
+
+  // counts[p * bucketsCount + b] is the number of rows of the partition p in the bucket b,
+  // then the position of the next row of the partition in the bucket
+  eastl::vector<int> counts(partitions.size() * bucketsCount, 0);
+  eastl::vector<int> bucketOf(capacity, -1);
+
+  auto runPartitions = [&partitions](const eastl::function<void(int)> &callback)
+  {
+    if (partitions.size() > 1)
+    {
+      auto job = jobmanager::add_job((int)partitions.size(), 1, [&](int from, int count)
+      {
+        for (int i = from; i < from + count; ++i)
+          callback(i);
+      });
+      jobmanager::start_jobs();
+      jobmanager::wait(job);
+    }
+    else
+      callback(0);
+  };
+
+  runPartitions([&](int partition_idx)
+  {
+    int *partitionCounts = counts.data() + partition_idx * bucketsCount;
+    for (int rangeIdx = partitions[partition_idx].firstRange; rangeIdx < partitions[partition_idx].endRange; ++rangeIdx)
+    {
+      const Range &r = ranges[rangeIdx];
+      Archetype &type = archetypes[r.archetypeId];
+      const glm::vec2 *positions = (const glm::vec2*)type.storages[r.positionColumn].items;
+
+      for (int i = r.begin; i < r.end; ++i)
+      {
+        if (type.freeMask[i] || (index.desc.filter && !index.desc.filter(type, i)))
           continue;
+        const int b = index.bucket(index.cellCoord(positions[i].x), index.cellCoord(positions[i].y));
+        bucketOf[r.first + i - r.begin] = b;
+        ++partitionCounts[b];
+      }
+    }
+  });
 
-        int queryId = lastQueryId;
-        Query *query = queryId >= 0 ? &index.queries[queryId] : nullptr;
+  // Buckets in order, partitions in order inside a bucket
+  index.bucketOffsets.resize(bucketsCount + 1);
+  int offset = 0;
+  for (int b = 0; b < bucketsCount; ++b)
+  {
+    index.bucketOffsets[b] = offset;
+    for (int p = 0; p < (int)partitions.size(); ++p)
+    {
+      int &count = counts[p * bucketsCount + b];
+      const int rowsCount = count;
+      count = offset;
+      offset += rowsCount;
+    }
+  }
+  index.bucketOffsets[bucketsCount] = offset;
+  index.rows.resize(offset);
 
-        if (ok)
-        {
-          const uint32_t key = type.get<uint32_t>(i, componentIdx);
+  runPartitions([&](int partition_idx)
+  {
+    int *partitionCounts = counts.data() + partition_idx * bucketsCount;
+    for (int rangeIdx = partitions[partition_idx].firstRange; rangeIdx < partitions[partition_idx].endRange; ++rangeIdx)
+    {
+      const Range &r = ranges[rangeIdx];
+      const glm::vec2 *positions = (const glm::vec2*)archetypes[r.archetypeId].storages[r.positionColumn].items;
 
-          auto res = index.itemsMap.find(key);
-          if (res == index.itemsMap.end() || res->first != key)
-          {
-            queryId = index.queries.size();
-            query = &index.queries.emplace_back();
+      for (int i = r.begin; i < r.end; ++i)
+      {
+        const int b = bucketOf[r.first + i - r.begin];
+        if (b < 0)
+          continue;
+        const int x = index.cellCoord(positions[i].x);
+        const int y = index.cellCoord(positions[i].y);
+        index.rows[partitionCounts[b]++] = { positions[i], SpatialIndex::makeCell(x, y), r.archetypeId, i };
+      }
+    }
+  });
+}
 
-            index.itemsMap.insert(eastl::pair<uint32_t, int>(key, queryId));
-          }
-          else
-          {
-            ASSERT(res->second >= 0 && res->second < (int)index.queries.size());
-            queryId = res->second;
-            query = &index.queries[res->second];
-          }
+void OrderedIndex::clear()
+{
+  rows.clear();
+  versions.clear();
+  componentsCount = 0;
+  columns.clear();
+}
 
-          if (lastQueryId >= 0 && lastQueryId != queryId && begin >= 0)
-          {
-            ASSERT(begin >= 0 && i > begin);
-            index.queries[lastQueryId].addChunks(index.desc, type, begin, i - begin);
-            begin = -1;
-          }
-        }
+// Unsorted rows of the archetype's entities, NaN keys are left out to keep the order strict
+template <typename Rows>
+static void ordered_index_rows(const OrderedIndex &index, Archetype &type, int archetype_id, Rows &rows)
+{
+  const int keyColumn = type.getComponentIndex(index.componentName);
+  ASSERT(keyColumn >= 0);
+  ASSERT(!type.storages[keyColumn].soa);
 
-        ASSERT(query != nullptr);
+  const Archetype::Storage &keys = type.storages[keyColumn];
+  for (int i = 0; i < type.entitiesCapacity; ++i)
+  {
+    if (type.freeMask[i] || (index.desc.filter && !index.desc.filter(type, i)))
+      continue;
+    const double key = index.getKey(keys.items + i * keys.itemSize);
+    if (key == key)
+      rows.push_back({ key, archetype_id, i });
+  }
+}
 
-        query->componentsCount = index.desc.components.size();
-        lastQueryId = queryId;
+void EntityManager::rebuildOrderedIndex(OrderedIndex &index)
+{
+  TRACE_SCOPE(kQuery, index.name.str, 0, trace_name_kind(index.name));
 
-        ok = ok && (!index.desc.filter || index.desc.filter(type, i));
+  index.clear();
+  index.componentsCount = index.desc.components.size();
+  index.columns.resize(archetypes.size() * index.componentsCount, nullptr);
+  index.versions.resize(archetypes.size(), 0);
 
-        if (ok && begin < 0)
-          begin = i;
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
+  {
+    Archetype &type = archetypes[archetypeId];
+    if (!index_has_archetype(index.desc, type))
+      continue;
+
+    // Rows address whole columns, SoA ones are block-aware (see soa_item), the key column is not SoA
+    for (int i = 0; i < index.componentsCount; ++i)
+      index.columns[archetypeId * index.componentsCount + i] = type.storages[type.getComponentIndex(index.desc.components[i].name)].items;
+
+    index.versions[archetypeId] = index_archetype_version(index.desc, type);
+    ordered_index_rows(index, type, archetypeId, index.rows);
+  }
+
+  eastl::sort(index.rows.begin(), index.rows.end());
+}
+
+void EntityManager::updateOrderedIndex(OrderedIndex &index)
+{
+  // New archetypes
+  if (index.versions.size() != archetypes.size())
+  {
+    rebuildOrderedIndex(index);
+    return;
+  }
+
+  eastl::vector<bool> changed;
+  eastl::vector<OrderedIndex::Row> changedRows;
+
+  for (int archetypeId = 0; archetypeId < (int)archetypes.size(); ++archetypeId)
+  {
+    Archetype &type = archetypes[archetypeId];
+    if (!index_has_archetype(index.desc, type))
+      continue;
+
+    const uint32_t version = index_archetype_version(index.desc, type);
+    if (version == index.versions[archetypeId])
+      continue;
+
+    if (changed.empty())
+      changed.resize(archetypes.size(), false);
+    changed[archetypeId] = true;
+    index.versions[archetypeId] = version;
+    ordered_index_rows(index, type, archetypeId, changedRows);
+  }
+
+  if (changed.empty())
+    return;
+
+  TRACE_SCOPE(kQuery, index.name.str, 0, trace_name_kind(index.name));
+
+  index.rows.erase(eastl::remove_if(index.rows.begin(), index.rows.end(), [&changed](const OrderedIndex::Row &row) { return changed[row.archetypeId]; }), index.rows.end());
+
+  eastl::sort(changedRows.begin(), changedRows.end());
+
+  eastl::vector<OrderedIndex::Row, memory::IndexAllocator> rows(index.rows.size() + changedRows.size());
+  eastl::merge(index.rows.begin(), index.rows.end(), changedRows.begin(), changedRows.end(), rows.begin());
+  index.rows.swap(rows);
+}
+
+static inline bool contains_component(const eastl::vector<Component> &components, const HashedString &name)
+{
+  for (const auto &c : components)
+    if (c.name == name)
+      return true;
+  return false;
+}
 
-        if (begin >= 0 && (!ok || i == type.entitiesCapacity - 1))
+// True if every archetype of the query is in the index
+static bool ordered_index_covers(const QueryDescription &index_desc, const QueryDescription &desc)
+{
+  for (const auto &c : index_desc.components)
+    if (!contains_component(desc.components, c.name) && !contains_component(desc.haveComponents, c.name))
+      return false;
+  for (const auto &c : index_desc.haveComponents)
+    if (!contains_component(desc.components, c.name) && !contains_component(desc.haveComponents, c.name))
+      return false;
+  for (const auto &c : index_desc.notHaveComponents)
+    if (!contains_component(desc.notHaveComponents, c.name))
+      return false;
+  return true;
+}
+
+void EntityManager::planOrderedQueries()
+{
+  for (const auto *plan = OrderedQueryPlan::head; plan; plan = plan->next)
+    for (const Query &q : queries)
+    {
+      QueryDescription &desc = queryDescriptions[q.id.index];
+      if (!(q.name == plan->queryName) || desc.orderedIndex >= 0)
+        continue;
+
+      // An index with its own filter misses entities the query may need
+      for (int indexIdx = 0; indexIdx < (int)orderedIndices.size(); ++indexIdx)
+      {
+        const OrderedIndex &index = orderedIndices[indexIdx];
+        if (index.componentName == plan->componentName && !index.desc.filter && ordered_index_covers(index.desc, desc))
         {
-          ASSERT(begin >= 0 && (i + (ok ? 1 : 0)) > begin);
-          query->addChunks(index.desc, type, begin, i - begin + (ok ? 1 : 0));
-          begin = -1;
+          desc.orderedIndex = indexIdx;
+          desc.orderedRange = plan->range;
+          break;
         }
       }
     }
-  }
 }
 
 void EntityManager::fillFrameSnapshot(FrameSnapshot &snapshot) const
@@ -997,7 +2410,7 @@ void EntityManager::checkFrameSnapshot(const FrameSnapshot &snapshot)
   // TODO: Optimize
   // TODO: Use component's opertator== instead of ::memcmp if possible
   int i = 0;
-  for (const auto &type : archetypes)
+  for (auto &type : archetypes)
   {
     for (const auto &name : trackComponents)
     {
@@ -1006,6 +2419,7 @@ void EntityManager::checkFrameSnapshot(const FrameSnapshot &snapshot)
       {
         if (::memcmp(snapshot[i++], type.storages[index].items, type.storages[index].size()))
         {
+          ++type.storages[index].version;
           for (const Query &q : queries)
             if (queryDescriptions[q.id.index].isDependOnComponent(name))
               dirtyQueries.push_back(q.id);
@@ -1021,6 +2435,166 @@ void EntityManager::checkFrameSnapshot(const FrameSnapshot &snapshot)
   }
 }
 
+eastl::shared_ptr<WorldSnapshot> EntityManager::snapshot()
+{
+  jobmanager::wait_context_jobs();
+
+  const eastl::shared_ptr<WorldSnapshot> prev = lastSnapshot.lock();
+  eastl::shared_ptr<WorldSnapshot> snapshot = eastl::make_shared<WorldSnapshot>();
+
+  snapshot->archetypes.resize(archetypes.size());
+  for (size_t archetypeId = 0; archetypeId < archetypes.size(); ++archetypeId)
+  {
+    const Archetype &type = archetypes[archetypeId];
+    const WorldSnapshot::ArchetypeState *prevState = prev && archetypeId < prev->archetypes.size() ? &prev->archetypes[archetypeId] : nullptr;
+
+    WorldSnapshot::ArchetypeState &state = snapshot->archetypes[archetypeId];
+    state.entitiesCount = type.entitiesCount;
+    state.entitiesCapacity = type.entitiesCapacity;
+    state.freeMask = type.freeMask;
+    state.freeIndexQueue = type.freeIndexQueue;
+    state.columns.resize(type.componentsCount);
+
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      const Archetype::Storage &storage = type.storages[i];
+      WorldSnapshot::Column &column = state.columns[i];
+      column.desc = storage.desc;
+
+      if (storage.soa || storage.desc->isTrivial)
+      {
+        column.copyFrom(storage.items, storage.size(), prevState ? &prevState->columns[i] : nullptr);
+        continue;
+      }
+
+      column.size = storage.size();
+      if (column.size == 0)
+        continue;
+
+      column.items = (uint8_t*)memory::alloc(memory::Subsystem::kSnapshot, column.size, memory::CACHE_LINE_SIZE);
+      for (int32_t j = 0; j < type.entitiesCapacity; ++j)
+        if (!type.freeMask[j])
+        {
+          storage.desc->ctor(column.items + j * storage.itemSize);
+          storage.desc->copy(column.items + j * storage.itemSize, storage.items + j * storage.itemSize);
+        }
+    }
+  }
+
+  snapshot->entitiesCount = entitiesCount;
+  snapshot->entitiesSize = (int32_t)entities.size();
+  snapshot->entities.copyFrom((const uint8_t*)entities.data(), entities.size() * sizeof(Entity), prev ? &prev->entities : nullptr);
+
+  snapshot->handlesCount = eidFactory.handlesCount;
+  snapshot->generationsSize = (int32_t)eidFactory.generations.size();
+  snapshot->generations.copyFrom((const uint8_t*)eidFactory.generations.data(), eidFactory.generations.size() * sizeof(int32_t), prev ? &prev->generations : nullptr);
+  snapshot->freeHandles = eidFactory.freeIndexQueue;
+
+  lastSnapshot = snapshot;
+
+  return snapshot;
+}
+
+void EntityManager::restore(const eastl::shared_ptr<WorldSnapshot> &snapshot)
+{
+  jobmanager::wait_context_jobs();
+
+  // Queued eids may belong to other entities once the handles are restored
+  createQueue = decltype(createQueue)();
+  deleteQueue = decltype(deleteQueue)();
+  for (auto &stream : events)
+    stream.clear();
+  levelQueue.clear();
+  // Async work may still write components that are about to be replaced
+  for (auto &v : asyncValues)
+    v.value.wait();
+  asyncValues.clear();
+
+  ASSERT(snapshot->archetypes.size() <= archetypes.size());
+
+  for (size_t archetypeId = 0; archetypeId < archetypes.size(); ++archetypeId)
+  {
+    Archetype &type = archetypes[archetypeId];
+
+    // The columns are kept, only the items are replaced
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      Archetype::Storage &storage = type.storages[i];
+      if (!storage.soa && !storage.desc->isTrivial)
+        for (int32_t j = 0; j < type.entitiesCapacity; ++j)
+          if (!type.freeMask[j])
+            storage.dtor(j);
+      ++storage.version;
+    }
+    ++type.structureVersion;
+
+    if (archetypeId >= snapshot->archetypes.size())
+    {
+      type.entitiesCount = 0;
+      type.entitiesCapacity = 0;
+      type.freeMask.clear();
+      type.freeIndexQueue.clear();
+      for (int i = 0; i < type.componentsCount; ++i)
+        type.storages[i].totalSize = 0;
+      continue;
+    }
+
+    const WorldSnapshot::ArchetypeState &state = snapshot->archetypes[archetypeId];
+    ASSERT(state.columns.size() == type.componentsCount);
+
+    // Nothing to move
+    type.entitiesCapacity = 0;
+    type.reserve(state.entitiesCapacity);
+
+    type.entitiesCount = state.entitiesCount;
+    type.entitiesCapacity = state.entitiesCapacity;
+    type.freeMask = state.freeMask;
+    type.freeIndexQueue = state.freeIndexQueue;
+
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      Archetype::Storage &storage = type.storages[i];
+      const WorldSnapshot::Column &column = state.columns[i];
+      ASSERT(column.desc == storage.desc);
+
+      storage.totalSize = (int32_t)storage.columnSize(type.entitiesCapacity);
+
+      if (!column.items)
+      {
+        column.copyTo(storage.items);
+        continue;
+      }
+
+      for (int32_t j = 0; j < type.entitiesCapacity; ++j)
+        if (!type.freeMask[j])
+          storage.ctor(j, column.items + j * storage.itemSize);
+    }
+  }
+
+  entitiesCount = snapshot->entitiesCount;
+  entities.resize(snapshot->entitiesSize);
+  snapshot->entities.copyTo((uint8_t*)entities.data());
+
+  eidFactory.handlesCount = snapshot->handlesCount;
+  eidFactory.generations.resize(snapshot->generationsSize);
+  snapshot->generations.copyTo((uint8_t*)eidFactory.generations.data());
+  eidFactory.freeIndexQueue = snapshot->freeHandles;
+
+  lastSnapshot = snapshot;
+
+  for (auto &i : orderedIndices)
+    rebuildOrderedIndex(i);
+  for (auto &q : queries)
+    performQuery(queryDescriptions[q.id.index], q);
+  for (auto &i : namedIndices)
+    rebuildIndex(i);
+  for (auto &i : spatialIndices)
+    rebuildSpatialIndex(i);
+
+  dirtyQueries.clear();
+  dirtyNamedIndices.clear();
+}
+
 void EntityManager::sendEvent(EntityId eid, uint32_t event_id, const RawArg &ev)
 {
   ASSERT(eid);
@@ -1032,8 +2606,13 @@ void EntityManager::sendEventSync(EntityId eid, uint32_t event_id, const RawArg
   if (!eidFactory.isValid(eid))
     return;
 
-  auto &e = entities[eid.index];
-  auto &type = archetypes[e.archetypeId];
+  const auto &e = entities[eid.index];
+  sendEventSync(e.archetypeId, e.indexInArchetype, 1, event_id, ev);
+}
+
+void EntityManager::sendEventSync(int archetype_id, int32_t begin, int32_t count, uint32_t event_id, const RawArg &ev)
+{
+  auto &type = archetypes[archetype_id];
 
   auto res = systemsByStage.find(event_id);
   if (res == systemsByStage.end())
@@ -1046,7 +2625,7 @@ void EntityManager::sendEventSync(EntityId eid, uint32_t event_id, const RawArg
     bool found = false;
     const QueryDescription &desc = queryDescriptions[sys.queryId.index];
     for (int archetypeId : desc.archetypes)
-      if (e.archetypeId == archetypeId)
+      if (archetype_id == archetypeId)
       {
         found = true;
         break;
@@ -1057,9 +2636,36 @@ void EntityManager::sendEventSync(EntityId eid, uint32_t event_id, const RawArg
 
     Query query;
     query.componentsCount = desc.components.size();
-    query.addChunks(desc, type, e.indexInArchetype, 1);
+    query.addChunks(desc, type, begin, count);
 
-    sys.sys(ev, query);
+    invokeSystem(sid, ev, query);
+  }
+}
+
+void EntityManager::sendEventSync(eastl::vector<EntityId> &eids, uint32_t event_id, const RawArg &ev)
+{
+  eids.erase(eastl::remove_if(eids.begin(), eids.end(), [&](EntityId eid) { return !eidFactory.isValid(eid); }), eids.end());
+  eastl::sort(eids.begin(), eids.end(), [&](EntityId lhs, EntityId rhs)
+  {
+    const Entity &l = entities[lhs.index];
+    const Entity &r = entities[rhs.index];
+    return l.archetypeId < r.archetypeId || (l.archetypeId == r.archetypeId && l.indexInArchetype < r.indexInArchetype);
+  });
+
+  for (size_t i = 0; i < eids.size();)
+  {
+    const Entity &first = entities[eids[i].index];
+    int32_t count = 1;
+    while (i + count < eids.size())
+    {
+      const Entity &next = entities[eids[i + count].index];
+      if (next.archetypeId != first.archetypeId || next.indexInArchetype != first.indexInArchetype + count)
+        break;
+      ++count;
+    }
+
+    sendEventSync(first.archetypeId, first.indexInArchetype, count, event_id, ev);
+    i += count;
   }
 }
 
@@ -1073,7 +2679,173 @@ void EntityManager::sendEventBroadcastSync(uint32_t event_id, const RawArg &ev)
   auto res = systemsByStage.find(event_id);
   if (res != systemsByStage.end())
     for (SystemId sid : res->second)
-      systems[sid.index].sys(ev, queries[systems[sid.index].queryId.index]);
+    {
+      Query &query = isPipelinedSystem(sid) ? pipelinedQueries[sid.index] : queries[systems[sid.index].queryId.index];
+      invokeSystem(sid, ev, query);
+    }
+}
+
+void EntityManager::invokeSystem(SystemId sid, const RawArg &ev, Query &query)
+{
+  const System &sys = systems[sid.index];
+
+  TRACE_SCOPE(kSystem, sys.name.str, query.entitiesCount, trace_name_kind(sys.name));
+
+  if (!profiling)
+  {
+    sys.sys(ev, query);
+    return;
+  }
+
+  // Task time and the number of the system's jobs are collected in tick
+  const uint32_t owner = hwcounters::make_owner(countersGroup, sid.index + 1);
+  jobmanager::set_job_owner(owner);
+
+  const bool countersEnabled = hwcounters::is_enabled();
+  if (countersEnabled)
+    hwcounters::begin();
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  sys.sys(ev, query);
+
+  const std::chrono::duration<double, std::milli> diff = std::chrono::high_resolution_clock::now() - start;
+
+  if (countersEnabled)
+    hwcounters::end(owner);
+  jobmanager::set_job_owner(0);
+
+  SystemProfile &profile = systemProfiles[sid.index];
+  profile.time += diff.count();
+  profile.entities += query.entitiesCount;
+  profile.chunks += query.chunksCount;
+  ++profile.calls;
+}
+
+void SystemProfile::nextFrame()
+{
+  frameTimes[framesCount % FRAMES_COUNT] = (float)time;
+  ++framesCount;
+
+  lastJobTime = jobTime;
+  lastEntities = entities;
+  lastChunks = chunks;
+  lastJobs = jobs;
+  lastCalls = calls;
+  lastCounters = counters;
+
+  time = 0.0;
+  jobTime = 0.0;
+  entities = 0;
+  chunks = 0;
+  jobs = 0;
+  calls = 0;
+  counters = {};
+}
+
+void EntityManager::setProfiling(bool enable, bool hw_counters)
+{
+  profiling = enable;
+  profilingFrameNo = 0;
+
+  if (!hwcounters::set_enabled(enable && hw_counters) && enable && hw_counters)
+    DEBUG_LOG("[profiler]: Hardware counters are not available");
+
+  systemProfiles.clear();
+  systemProfiles.resize(systems.size());
+}
+
+void EntityManager::setProfilingReport(int every_n_frames, bool csv)
+{
+  profilingReportFrames = every_n_frames;
+  profilingReportCsv = csv;
+}
+
+SystemProfileStat EntityManager::getSystemProfileStat(SystemId sid) const
+{
+  SystemProfileStat stat;
+  if (!sidFactory.isValid(sid) || sid.index >= systemProfiles.size())
+    return stat;
+
+  const SystemProfile &profile = systemProfiles[sid.index];
+  const int count = eastl::min(profile.framesCount, SystemProfile::FRAMES_COUNT);
+  if (count > 0)
+  {
+    eastl::array<float, SystemProfile::FRAMES_COUNT> times;
+    eastl::copy(profile.frameTimes.begin(), profile.frameTimes.begin() + count, times.begin());
+    eastl::sort(times.begin(), times.begin() + count);
+
+    stat.p50 = times[count / 2];
+    stat.p95 = times[eastl::min(count - 1, (count * 95) / 100)];
+    stat.max = times[count - 1];
+  }
+
+  stat.jobTime = (float)profile.lastJobTime;
+  stat.entities = profile.lastEntities;
+  stat.chunks = profile.lastChunks;
+  stat.jobs = profile.lastJobs;
+  stat.calls = profile.lastCalls;
+  stat.cycles = profile.lastCounters[hwcounters::kCycles];
+  stat.instructions = profile.lastCounters[hwcounters::kInstructions];
+  stat.cacheMisses = profile.lastCounters[hwcounters::kCacheMisses];
+  stat.branchMisses = profile.lastCounters[hwcounters::kBranchMisses];
+
+  return stat;
+}
+
+void EntityManager::writeProfilingReport(std::ostream &out, bool csv) const
+{
+  const bool withCounters = hwcounters::is_enabled();
+
+  if (csv)
+  {
+    out << "system,p50_ms,p95_ms,max_ms,job_ms,entities,chunks,jobs,calls";
+    if (withCounters)
+      out << ",cycles,instructions,llc_misses,branch_misses,cycles_per_entity,llc_misses_per_entity";
+    out << "\n";
+  }
+  else
+    out << "[profiler]: frame " << profilingFrameNo << "\n";
+
+  for (SystemId sid : systemsSorted)
+  {
+    const SystemProfileStat stat = getSystemProfileStat(sid);
+    const double entities = stat.entities > 0 ? double(stat.entities) : 1.0;
+    if (csv)
+    {
+      out << systems[sid.index].name.str << "," << stat.p50 << "," << stat.p95 << "," << stat.max << "," << stat.jobTime << ","
+        << stat.entities << "," << stat.chunks << "," << stat.jobs << "," << stat.calls;
+      if (withCounters)
+        out << "," << stat.cycles << "," << stat.instructions << "," << stat.cacheMisses << "," << stat.branchMisses
+          << "," << stat.cycles / entities << "," << stat.cacheMisses / entities;
+      out << "\n";
+    }
+    else
+    {
+      out << "  " << systems[sid.index].name.str
+        << ": p50 " << stat.p50 << " ms, p95 " << stat.p95 << " ms, max " << stat.max << " ms, jobs time " << stat.jobTime << " ms"
+        << ", entities " << stat.entities << ", chunks " << stat.chunks << ", jobs " << stat.jobs << ", calls " << stat.calls;
+      if (withCounters)
+        out << ", IPC " << (stat.cycles > 0 ? double(stat.instructions) / double(stat.cycles) : 0.0)
+          << ", cycles/entity " << stat.cycles / entities
+          << ", llc misses/entity " << stat.cacheMisses / entities
+          << ", branch misses/entity " << stat.branchMisses / entities;
+      out << "\n";
+    }
+  }
+
+  if (!csv)
+  {
+    eastl::vector<FrameMemStat> frameMem;
+    get_frame_mem_stat(frameMem);
+    for (const FrameMemStat &stat : frameMem)
+      out << "  frame mem #" << stat.threadIndex << ": " << (stat.allocated >> 10) << " kB, max " << (stat.allocatedMax >> 10)
+        << " kB, reserved " << (stat.reserved >> 10) << " kB in " << stat.blocksCount << " blocks\n";
+
+    memory::write_stat(out);
+  }
+
+  out.flush();
 }
 
 void EntityManager::invokeEventBroadcast(uint32_t event_id, const RawArg &ev)
@@ -1118,6 +2890,8 @@ SystemId EntityManager::createSystem(const HashedString &name, const SystemDescr
     systems.resize(sid.index + 1);
     systemDependencies.resize(sid.index + 1);
     systemJobs.resize(sid.index + 1);
+    if (profiling)
+      systemProfiles.resize(sid.index + 1);
   }
 
   ASSERT(desc != nullptr);
@@ -1125,12 +2899,18 @@ SystemId EntityManager::createSystem(const HashedString &name, const SystemDescr
   systems[sid.index].reset();
   systemDependencies[sid.index].clear();
   systemJobs[sid.index] = jobmanager::JobId();
+  if (profiling)
+    systemProfiles[sid.index] = SystemProfile{};
 
   systems[sid.index].id = sid;
   systems[sid.index].name = name;
   systems[sid.index].desc = desc;
   systems[sid.index].sys = desc->sys;
 
+  auto res = systemsByName.insert(name);
+  ASSERT(res.second); // Check for duplicates
+  res.first->second = sid;
+
   if (query_desc)
     systems[sid.index].queryId = createQuery(desc->name, *query_desc, desc->filter);
   else if (desc->mode != SystemDescription::Mode::FROM_EXTERNAL_QUERY)
@@ -1148,6 +2928,7 @@ void EntityManager::deleteSystem(const SystemId &sid)
 {
   if (!sidFactory.isValid(sid))
     return;
+  systemsByName.erase(systems[sid.index].name);
   systems[sid.index].reset();
   systemDependencies[sid.index].clear();
   jobmanager::wait(systemJobs[sid.index]);
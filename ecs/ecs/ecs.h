@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include <future>
+#include <mutex>
 #include <EASTL/deque.h>
 #include <EASTL/unique_ptr.h>
 
@@ -11,6 +12,11 @@
 #include "query.h"
 #include "system.h"
 #include "index.h"
+#include "spatial_index.h"
+#include "ordered_index.h"
+#include "join.h"
+#include "level.h"
+#include "snapshot.h"
 
 #include "event.h"
 #include "ecs-events.h"
@@ -18,6 +24,8 @@
 #include "components/core.h"
 
 #include "jobmanager.h"
+#include "hwcounters.h"
+#include "allocator.h"
 
 #include "framemem.h"
 
@@ -179,6 +187,55 @@ struct System
   void reset();
 };
 
+struct SystemProfile
+{
+  static constexpr int FRAMES_COUNT = 128;
+
+  // Accumulated during the current frame
+  double time = 0.0;
+  double jobTime = 0.0;
+  int entities = 0;
+  int chunks = 0;
+  int jobs = 0;
+  int calls = 0;
+  hwcounters::Values counters = {};
+
+  // Previous frame
+  double lastJobTime = 0.0;
+  int lastEntities = 0;
+  int lastChunks = 0;
+  int lastJobs = 0;
+  int lastCalls = 0;
+  hwcounters::Values lastCounters = {};
+
+  int framesCount = 0;
+  eastl::array<float, FRAMES_COUNT> frameTimes = {};
+
+  void nextFrame();
+};
+
+struct SystemProfileStat
+{
+  // Milliseconds per frame over the last SystemProfile::FRAMES_COUNT frames
+  float p50 = 0.f;
+  float p95 = 0.f;
+  float max = 0.f;
+
+  // Milliseconds spent in the tasks of the system's jobs during the previous frame, on all workers
+  float jobTime = 0.f;
+
+  int entities = 0;
+  int chunks = 0;
+  int jobs = 0;
+  int calls = 0;
+
+  // Hardware counters of the system and its jobs, zero if not available
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t cacheMisses = 0;
+  uint64_t branchMisses = 0;
+};
+
 struct EventStream
 {
   enum Flags
@@ -198,10 +255,17 @@ struct EventStream
   int popOffset = 0;
   int pushOffset = 0;
   int count = 0;
-  eastl::vector<uint8_t> data;
+  eastl::vector<uint8_t, memory::EventAllocator> data;
 
   void push(EntityId eid, uint8_t flags, int event_id, const RawArg &ev);
   eastl::tuple<Header, RawArg> pop();
+
+  inline void clear()
+  {
+    popOffset = 0;
+    pushOffset = 0;
+    count = 0;
+  }
 };
 
 struct CreateQueueData
@@ -235,6 +299,12 @@ struct Archetype
     int32_t itemSize  = 0;
     int32_t totalSize = 0;
 
+    // SoA items are stored in blocks of SOA_BLOCK_SIZE with a lane per field, see layout.h
+    bool soa = false;
+
+    // Bumped when change detection finds the column modified
+    uint32_t version = 0;
+
     Storage(const Storage &) = delete;
     Storage(Storage &&) = delete;
 
@@ -242,56 +312,102 @@ struct Archetype
     Storage& operator=(Storage &&) = delete;
 
     Storage() = default;
-    Storage(const ComponentDescription *_desc) : desc(_desc), itemSize(desc->size) {}
+    Storage(const ComponentDescription *_desc) : desc(_desc), itemSize(desc->size), soa(desc->isSoA()) {}
+
+    inline size_t columnSize(int32_t count) const
+    {
+      if (soa)
+        count = (count + SOA_BLOCK_SIZE - 1) / SOA_BLOCK_SIZE * SOA_BLOCK_SIZE;
+      return size_t(itemSize) * count;
+    }
 
     void clear(const eastl::bitvector<> &free_mask, int32_t count)
     {
       if (!items)
         return;
 
-      for (int i = 0; i < count; ++i)
-        if (!free_mask[i])
-          desc->dtor(items + i * itemSize);
+      if (!soa)
+        for (int i = 0; i < count; ++i)
+          if (!free_mask[i])
+            desc->dtor(items + i * itemSize);
 
-      delete[] items;
       items = nullptr;
+      totalSize = 0;
     }
 
-    void resize(const eastl::bitvector<> &free_mask, int32_t old_count, int32_t new_count)
+    // Items live in the archetype's column block
+    void move(uint8_t *new_items, const eastl::bitvector<> &free_mask, int32_t count)
     {
-      totalSize = new_count * itemSize;
-
-      // TODO: What about alignment ???
-      uint8_t *newItems = new uint8_t[totalSize];
-      ::memset(newItems, 0, totalSize);
+      // SoA items are trivially copyable, the lanes are kept as is
+      if (soa)
+      {
+        if (items)
+          ::memcpy(new_items, items, columnSize(count));
+        items = new_items;
+        return;
+      }
 
       // TODO: Move only if component's type non memcpy-only
-      for (int32_t i = 0; i < old_count; ++i)
+      for (int32_t i = 0; i < count; ++i)
         if (!free_mask[i])
-          desc->move(newItems + i * itemSize, items + i * itemSize);
+          desc->move(new_items + i * itemSize, items + i * itemSize);
 
-      delete[] items;
-      items = newItems;
+      items = new_items;
     }
 
     inline void ctor(int32_t index, const uint8_t *val)
     {
+      if (soa)
+      {
+        set(index, val);
+        return;
+      }
       desc->ctor(items + index * itemSize);
       desc->copy(items + index * itemSize, val);
     }
 
-    inline void dtor(int32_t index) { desc->dtor(items + index * itemSize); }
+    inline void dtor(int32_t index)
+    {
+      if (!soa)
+        desc->dtor(items + index * itemSize);
+    }
 
-    inline uint8_t* get(int32_t index) { return items + (index * itemSize); }
-    inline void set(int32_t index, const uint8_t *val) { desc->copy(items + index * itemSize, val); }
+    // Returns the item or its lane 0 element for SoA
+    inline uint8_t* get(int32_t index)
+    {
+      if (soa)
+        return soa_item(items, index, itemSize, desc->soaFieldSize);
+      return items + (index * itemSize);
+    }
+
+    inline void set(int32_t index, const uint8_t *val)
+    {
+      if (soa)
+        soa_scatter(get(index), val, desc->soaFieldsCount, desc->soaFieldSize);
+      else
+        desc->copy(items + index * itemSize, val);
+    }
 
     inline size_t size() const { return totalSize; }
   };
 
+  static constexpr int32_t MIN_RESERVED_ENTITIES = 16;
+
   int32_t entitiesCount = 0;
   int32_t entitiesCapacity = 0;
+  int32_t entitiesReserved = 0;
   int32_t componentsCount = 0;
 
+  // Bumped when an entity is added or removed, columns might have moved
+  uint32_t structureVersion = 0;
+
+  // Query chunks of archetypes with SoA components are split on SOA_BLOCK_SIZE boundaries
+  bool hasSoA = false;
+
+  // All columns are allocated as one block, each column is aligned to a cache line
+  uint8_t *columns = nullptr;
+  size_t columnsSize = 0;
+
   eastl::unique_ptr<Storage[]>      storages;
   eastl::unique_ptr<HashedString[]> storageNames;
 
@@ -303,6 +419,11 @@ struct Archetype
     for (int i = 0; i < componentsCount; ++i)
       storages[i].clear(freeMask, entitiesCapacity);
 
+    memory::free(memory::Subsystem::kStorage, columns, columnsSize);
+    columns = nullptr;
+    columnsSize = 0;
+    entitiesReserved = 0;
+
     storages.reset();
     storageNames.reset();
   }
@@ -313,6 +434,8 @@ struct Archetype
   int getComponentIndex(const HashedString &name) const;
   int getComponentIndex(const ConstHashedString &name) const;
 
+  void reserve(int32_t count);
+
   inline int32_t popFreeIndex()
   {
     if (freeIndexQueue.empty())
@@ -327,6 +450,7 @@ struct Archetype
     ASSERT(init.components.size() == componentsCount);
 
     entitiesCount++;
+    ++structureVersion;
 
     int32_t entityIndex = -1;
 
@@ -338,14 +462,16 @@ struct Archetype
     }
     else
     {
-      // TODO: Allocate more tha 1 entity
       entityIndex = entitiesCapacity;
-      ++entitiesCapacity;
 
+      if (entitiesCapacity + 1 > entitiesReserved)
+        reserve(eastl::max(entitiesReserved * 2, MIN_RESERVED_ENTITIES));
+
+      ++entitiesCapacity;
       freeMask.resize(entitiesCapacity);
 
       for (int i = 0; i < componentsCount; ++i)
-        storages[i].resize(freeMask, entitiesCapacity - 1, entitiesCapacity);
+        storages[i].totalSize = (int32_t)storages[i].columnSize(entitiesCapacity);
     }
 
     freeMask[entityIndex] = false;
@@ -367,6 +493,25 @@ struct Archetype
     return entityIndex;
   }
 
+  // Bulk creation, count entities at the end of the columns. The items are not constructed
+  int32_t allocateRange(int32_t count)
+  {
+    const int32_t first = entitiesCapacity;
+    if (entitiesCapacity + count > entitiesReserved)
+      reserve(eastl::max(eastl::max(entitiesReserved * 2, entitiesCapacity + count), MIN_RESERVED_ENTITIES));
+
+    entitiesCount += count;
+    entitiesCapacity += count;
+    ++structureVersion;
+
+    freeMask.resize(entitiesCapacity, false);
+
+    for (int i = 0; i < componentsCount; ++i)
+      storages[i].totalSize = (int32_t)storages[i].columnSize(entitiesCapacity);
+
+    return first;
+  }
+
   void deallocate(int32_t entity_index)
   {
     ASSERT(entity_index >= 0 && entity_index < entitiesCapacity);
@@ -376,6 +521,7 @@ struct Archetype
     freeMask[entity_index] = true;
 
     --entitiesCount;
+    ++structureVersion;
     for (int i = 0; i < componentsCount; ++i)
       storages[i].dtor(entity_index);
   }
@@ -399,6 +545,7 @@ struct Archetype
   template <typename T>
   inline const T& get(int32_t entity_index, int32_t i) const
   {
+    static_assert(!ComponentLayout<T>::soa, "SoA components can't be accessed by reference");
     ASSERT(entity_index >= 0 && entity_index < entitiesCapacity);
     ASSERT(i >= 0 && i < componentsCount);
     ASSERT(ComponentType<T>::type == storages[i].desc->typeHash);
@@ -408,6 +555,7 @@ struct Archetype
   template <typename T>
   inline T& get(int32_t entity_index, int32_t i)
   {
+    static_assert(!ComponentLayout<T>::soa, "SoA components can't be accessed by reference");
     ASSERT(entity_index >= 0 && entity_index < entitiesCapacity);
     ASSERT(i >= 0 && i < componentsCount);
     // TODO: Fix this. Index causes as assert here!
@@ -416,6 +564,8 @@ struct Archetype
   }
 };
 
+struct WorldThread;
+
 struct EntityManager
 {
   eastl::vector<eastl::string> order;
@@ -436,6 +586,22 @@ struct EntityManager
   eastl::vector<Index> namedIndices;
   eastl::vector<QueryId> dirtyQueries;
   eastl::vector<int> dirtyNamedIndices;
+  eastl::vector<SpatialIndex> spatialIndices;
+  eastl::vector<OrderedIndex> orderedIndices;
+
+  // Results of lazy and ad-hoc queries until archetypes they depend on change
+  struct CachedQuery
+  {
+    QueryDescription desc;
+    Query query;
+    // desc.archetypes were found among this many archetypes
+    int archetypesCount = -1;
+    // Sum of structure versions of desc.archetypes and, with a filter, change versions of their columns desc depends on
+    uint32_t version = 0;
+  };
+
+  eastl::hash_map<const ConstQueryDescription*, CachedQuery> cachedQueries;
+  std::mutex cachedQueriesMutex;
 
   HandleFactory<QueryId, 1024> qidFactory;
   eastl::vector<Query> queries;
@@ -443,17 +609,62 @@ struct EntityManager
 
   eastl::queue<CreateQueueData> createQueue;
   eastl::queue<EntityId> deleteQueue;
+  // Spliced in tick() once decoded, in the order of loading
+  eastl::vector<eastl::unique_ptr<LevelStaging>> levelQueue;
 
   eastl::set<HashedString> trackComponents;
 
+  // The last taken or restored snapshot, the next one shares unchanged blocks with it
+  eastl::weak_ptr<WorldSnapshot> lastSnapshot;
+
+  bool profiling = false;
+  bool profilingReportCsv = false;
+  int profilingReportFrames = 0;
+  int profilingFrameNo = 0;
+  eastl::vector<SystemProfile> systemProfiles;
+  // Hardware counters and job stats of the systems are owned by make_owner(countersGroup, sid.index + 1)
+  uint32_t countersGroup = 0;
+
+  // Pipelined mode: systems of pipelined stages read copies of their components
+  // extracted in tick(), so they don't wait for the jobs of the next update
+  bool pipelined = false;
+  eastl::set<uint32_t> pipelinedStages;
+  eastl::vector<Query> pipelinedQueries;
+  eastl::vector<uint8_t, memory::StorageAllocator> pipelinedStorage;
+
+  // Non-trivial copies in pipelinedStorage, destroyed by the next extraction
+  struct PipelinedItems
+  {
+    const ComponentDescription *desc = nullptr;
+    uint8_t *items = nullptr;
+    int count = 0;
+  };
+  eastl::vector<PipelinedItems> pipelinedItems;
+
   int currentEventStream = 0;
   eastl::array<EventStream, 2> events;
 
   bool isDirtySystems = false;
 
+  // Created by ecs::init, a thread works with it until it sets another world
+  static EntityManager *mainWorld;
+  // Frame memory of the world, nullptr for the main one which shares it with the rest of the app
+  void *frameMemContext = nullptr;
+  // Runs frames of the world in runWorlds when it's not the first one, kept until the world is destroyed
+  eastl::unique_ptr<WorldThread> worldThread;
+
   static void create();
   static void release();
 
+  // Worlds share the static registrations but not the templates, entities, queries, events and frame memory
+  static EntityManager* createWorld();
+  static void destroyWorld(EntityManager *world);
+  // The current world of the calling thread, the jobs it creates run in it too
+  static void setWorld(EntityManager *world);
+  // Every world runs frame on its own thread with the world set as current, their jobs share the workers.
+  // The first one runs on the calling thread, the others on threads kept by the worlds between the calls
+  static void runWorlds(const eastl::vector<EntityManager*> &worlds, const eastl::function<void(EntityManager*)> &frame);
+
   EntityManager();
   ~EntityManager();
 
@@ -470,6 +681,8 @@ struct EntityManager
   const ComponentDescription* getComponentDescByName(const ConstHashedString &name) const;
 
   Index* findIndex(const ConstHashedString &name);
+  SpatialIndex* findSpatialIndex(const ConstHashedString &name);
+  OrderedIndex* findOrderedIndex(const ConstHashedString &name);
 
   int getTemplateId(const char *name);
   void addTemplate(const char *templ_name, ComponentsMap &&cmap);
@@ -482,6 +695,12 @@ struct EntityManager
 
   void deleteEntity(const EntityId &eid);
 
+  // The entities are created on the next tick, false if the file is not a valid level
+  bool loadLevel(const char *path);
+  // The level is decoded in the background and the entities are created on the first tick after that
+  bool loadLevelAsync(const char *path);
+  void spliceLevel(LevelStaging &staging);
+
   void waitFor(EntityId eid, std::future<bool> && value);
 
   inline Query& getQuery(const QueryId &qid) { ASSERT(qidFactory.isValid(qid)); return queries[qid.index]; }
@@ -489,8 +708,23 @@ struct EntityManager
 
   void performQuery(const QueryId &qid);
   void performQuery(const QueryDescription &desc, Query &query);
+  // The result is valid until the next structural change, filtered results follow change detection like persistent queries
+  Query& performCachedQuery(const ConstQueryDescription &desc, const filter_t &filter = nullptr);
+  // Full rebuild, in jobs for big indices
   void rebuildIndex(Index &index);
+  // Rekeys only the archetypes whose column change versions changed
   void updateIndex(Index &index);
+  // Index::rows and offsets from ArchetypeState::itemOf
+  void buildIndexRows(Index &index);
+  // Regroups only the dirty items and retires the ones left without members
+  void updateIndexRows(Index &index, const eastl::vector<uint8_t> &changed_archetypes, const eastl::vector<uint8_t> &dirty_items);
+  // Parallel counting sort of the entities into buckets of cells
+  void rebuildSpatialIndex(SpatialIndex &index);
+  void rebuildOrderedIndex(OrderedIndex &index);
+  // Re-sorts only the archetypes whose column change versions changed and merges them back
+  void updateOrderedIndex(OrderedIndex &index);
+  // Binds OrderedQueryPlan ranges to the queries they name
+  void planOrderedQueries();
 
   void enableChangeDetection(const HashedString &name);
   void disableChangeDetection(const HashedString &name);
@@ -498,9 +732,33 @@ struct EntityManager
   void fillFrameSnapshot(FrameSnapshot &snapshot) const;
   void checkFrameSnapshot(const FrameSnapshot &snapshot);
 
+  // Pending creations, deletions and events are not a part of the snapshot
+  eastl::shared_ptr<WorldSnapshot> snapshot();
+  // Queries and indices are rebuilt. Archetypes created after the snapshot are left empty.
+  // Pending work of the current world is dropped: queued creations, deletions and events, loading levels
+  // and async values, the latter are waited for first. Entities keep the ready flag they had in the snapshot
+  void restore(const eastl::shared_ptr<WorldSnapshot> &snapshot);
+
+  void invokeSystem(SystemId sid, const RawArg &ev, Query &query);
+
+  void setProfiling(bool enable, bool hw_counters = false);
+  void setProfilingReport(int every_n_frames, bool csv);
+  SystemProfileStat getSystemProfileStat(SystemId sid) const;
+  void writeProfilingReport(std::ostream &out, bool csv) const;
+
+  void setPipelined(bool enable);
+  void addPipelinedStage(uint32_t stage_id);
+  bool isPipelinedSystem(SystemId sid) const;
+  void extractPipelinedQueries();
+  void destroyPipelinedItems();
+
   void tick();
   void sendEvent(EntityId eid, uint32_t event_id, const RawArg &ev);
   void sendEventSync(EntityId eid, uint32_t event_id, const RawArg &ev);
+  // Every system is invoked once for the range of entities
+  void sendEventSync(int archetype_id, int32_t begin, int32_t count, uint32_t event_id, const RawArg &ev);
+  // Entities next to each other in an archetype are sent as one range, eids are sorted
+  void sendEventSync(eastl::vector<EntityId> &eids, uint32_t event_id, const RawArg &ev);
 
   void sendEventBroadcast(uint32_t event_id, const RawArg &ev);
   void sendEventBroadcastSync(uint32_t event_id, const RawArg &ev);
@@ -531,6 +789,24 @@ struct EntityManager
     sendEventSync(eid, EventType<E>::id, arg0);
   }
 
+  template <typename E>
+  void sendEventSync(int archetype_id, int32_t begin, int32_t count, const E &ev)
+  {
+    RawArgSpec<sizeof(E)> arg0;
+    new (arg0.mem) E(ev);
+
+    sendEventSync(archetype_id, begin, count, EventType<E>::id, arg0);
+  }
+
+  template <typename E>
+  void sendEventSync(eastl::vector<EntityId> &eids, const E &ev)
+  {
+    RawArgSpec<sizeof(E)> arg0;
+    new (arg0.mem) E(ev);
+
+    sendEventSync(eids, EventType<E>::id, arg0);
+  }
+
   template <typename E>
   void sendEventBroadcast(const E &ev)
   {
@@ -559,18 +835,32 @@ struct EntityManager
   }
 };
 
-extern EntityManager *g_mgr;
+// The current world of the calling thread
+extern thread_local EntityManager *g_mgr;
 
 namespace ecs
 {
   inline void init() { EntityManager::create(); }
   inline void release() { EntityManager::release(); }
 
+  inline EntityManager* create_world() { return EntityManager::createWorld(); }
+  inline void destroy_world(EntityManager *world) { EntityManager::destroyWorld(world); }
+  inline void set_world(EntityManager *world) { EntityManager::setWorld(world); }
+  inline EntityManager* get_world() { return g_mgr; }
+  inline void run_worlds(const eastl::vector<EntityManager*> &worlds, const eastl::function<void(EntityManager*)> &frame) { EntityManager::runWorlds(worlds, frame); }
+  // Frame memory of a world is cleared after its tick
+  inline void tick_worlds(const eastl::vector<EntityManager*> &worlds) { EntityManager::runWorlds(worlds, [](EntityManager *world) { world->tick(); clear_frame_mem(); }); }
+
   inline void tick() { g_mgr->tick(); }
 
   inline void create_entity(const char *templ_name, ComponentsMap &&comps) { g_mgr->createEntity(templ_name, eastl::move(comps)); }
   inline EntityId create_entity_sync(const char *templ_name, ComponentsMap &&comps) { return g_mgr->createEntitySync(templ_name, eastl::move(comps)); }
   inline void delete_entity(const EntityId &eid) { g_mgr->deleteEntity(eid); }
+  inline bool load_level(const char *path) { return g_mgr->loadLevel(path); }
+  inline bool load_level_async(const char *path) { return g_mgr->loadLevelAsync(path); }
+
+  inline eastl::shared_ptr<WorldSnapshot> snapshot() { return g_mgr->snapshot(); }
+  inline void restore(const eastl::shared_ptr<WorldSnapshot> &snapshot) { g_mgr->restore(snapshot); }
 
   inline int32_t get_entities_count(const QueryId &query_id) { return g_mgr->getEntitiesCount(query_id); }
   inline Query& get_query(const QueryId &query_id) { return g_mgr->getQuery(query_id); }
@@ -583,15 +873,30 @@ namespace ecs
   inline void perform_query(const ConstQueryDescription &in_desc, Query &query) { perform_query(QueryDescription(in_desc), query); }
   inline Query perform_query(const ConstQueryDescription &in_desc) { Query query; perform_query(QueryDescription(in_desc), query); return query; }
 
+  // Cached by the address of desc, so desc must be static
+  inline Query& perform_cached_query(const ConstQueryDescription &desc) { return g_mgr->performCachedQuery(desc); }
+  inline Query& perform_cached_query(const LazyQueryDescription &lazy) { return g_mgr->performCachedQuery(lazy.desc, lazy.filter); }
+
   template <typename E> inline void send_event(EntityId eid, const E &ev) { g_mgr->sendEvent<E>(eid, ev); }
   template <typename E> inline void send_event_broadcast(const E &ev) { g_mgr->sendEventBroadcast<E>(ev); }
   template <typename E> inline void invoke_event_broadcast(const E &ev) { g_mgr->invokeEventBroadcast<E>(ev); }
 
   inline Index* find_index(const ConstHashedString &name) { return g_mgr->findIndex(name); }
+  inline SpatialIndex* find_spatial_index(const ConstHashedString &name) { return g_mgr->findSpatialIndex(name); }
+  inline OrderedIndex* find_ordered_index(const ConstHashedString &name) { return g_mgr->findOrderedIndex(name); }
 
   inline SystemId get_system_id(const ConstHashedString &name) { return g_mgr->getSystemId(name); }
   inline jobmanager::DependencyList get_system_dependency_list(SystemId sid)  { return g_mgr->getSystemDependencyList(sid); }
 
+  inline void set_profiling(bool enable, bool hw_counters = false) { g_mgr->setProfiling(enable, hw_counters); }
+  // Prints the report to std::cout every N frames, 0 disables the report
+  inline void set_profiling_report(int every_n_frames, bool csv = false) { g_mgr->setProfilingReport(every_n_frames, csv); }
+  inline SystemProfileStat get_system_profile(const ConstHashedString &name) { return g_mgr->getSystemProfileStat(get_system_id(name)); }
+  inline void write_profiling_report(std::ostream &out, bool csv = false) { g_mgr->writeProfilingReport(out, csv); }
+
+  inline void set_pipelined(bool enable) { g_mgr->setPipelined(enable); }
+  template <typename E> inline void add_pipelined_stage() { g_mgr->addPipelinedStage(EventType<E>::id); }
+
   inline void wait_system_dependencies(const ConstHashedString &name) { g_mgr->waitSystemDependencies(ecs::get_system_id(name)); }
   inline void wait_system_dependencies(SystemId sid) { g_mgr->waitSystemDependencies(sid); }
 
@@ -600,4 +905,22 @@ namespace ecs
     if (g_mgr->sidFactory.isValid(sid))
       g_mgr->systemJobs[sid.index] = jid;
   }
+
+  // Calls callback(columns, begin, count) in jobs, every job gets whole chunks or a part of a big chunk
+  template <typename Callable>
+  inline void parallel_for(Query &query, int chunk_size, Callable &&callback)
+  {
+    eastl::vector<Query::Task> tasks;
+    query.splitToTasks(chunk_size, tasks);
+    if (tasks.empty())
+      return;
+
+    auto job = jobmanager::add_job((int)tasks.size(), 1, [&](int from, int count)
+    {
+      for (int i = from; i < from + count; ++i)
+        query.forEachChunk(tasks[i].chunkIdx, tasks[i].offset, tasks[i].count, callback);
+    });
+    jobmanager::start_jobs();
+    jobmanager::wait(job);
+  }
 } //ecs
\ No newline at end of file
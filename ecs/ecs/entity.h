@@ -62,7 +62,7 @@ struct HandleFactory
 
   inline bool isValid(const HandleType &h) const
   {
-    return h.index <= generations.size() && h && h.generation == generations[h.index];
+    return h.index < generations.size() && h && h.generation == generations[h.index];
   }
 };
 
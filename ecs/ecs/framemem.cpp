@@ -1,4 +1,9 @@
 #include "framemem.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
 
 #if defined(_WIN64)
 static constexpr size_t default_alignment = 8;
@@ -6,43 +11,248 @@ static constexpr size_t default_alignment = 8;
 static constexpr size_t default_alignment = 4;
 #endif
 
-static eastl::array<uint8_t, 16 << 20> buffer; // 16MB
-static size_t buffer_offset = 0;
-static size_t buffer_max_offset = 0;
+static size_t g_block_size = 1 << 20; // 1MB
+
+struct Block
+{
+  Block *next = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+
+  uint8_t *data() { return (uint8_t*)(this + 1); }
+};
+
+struct Arena
+{
+  Block *head = nullptr;
+  Block *current = nullptr;
+  // Size of the filled blocks before current
+  size_t usedBefore = 0;
+  size_t allocatedMax = 0;
+
+  static Block* createBlock(size_t sz)
+  {
+    Block *block = (Block*)::malloc(sizeof(Block) + sz);
+    ASSERT(block != nullptr);
+    new (block) Block();
+    block->size = sz;
+    return block;
+  }
+
+  size_t getAllocatedSize() const
+  {
+    return current ? usedBefore + current->offset : 0;
+  }
+
+  size_t getReservedSize() const
+  {
+    size_t sz = 0;
+    for (Block *block = head; block; block = block->next)
+      sz += block->size;
+    return sz;
+  }
+
+  int getBlocksCount() const
+  {
+    int count = 0;
+    for (Block *block = head; block; block = block->next)
+      ++count;
+    return count;
+  }
+
+  uint8_t* alloc(size_t sz, size_t alignment)
+  {
+    if (!current)
+      head = current = createBlock(g_block_size);
+
+    for (;;)
+    {
+      uint8_t *mem = current->data() + current->offset;
+      uint8_t *res = (uint8_t*)(((uintptr_t)mem + (alignment - 1)) & ~(alignment - 1));
+      const size_t newOffset = current->offset + sz + ((uintptr_t)res - (uintptr_t)mem);
+      if (newOffset <= current->size)
+      {
+        current->offset = newOffset;
+        return res;
+      }
+
+      usedBefore += current->offset;
+      if (!current->next)
+        current->next = createBlock(eastl::max(current->size * 2, sz + alignment));
+      current = current->next;
+    }
+  }
+
+  void reset()
+  {
+    const size_t allocated = getAllocatedSize();
+    if (allocated > allocatedMax)
+      allocatedMax = allocated;
+
+    // Replace the chain with one block which fits the high-water mark
+    if (head && head->next)
+    {
+      const size_t sz = eastl::max(getReservedSize(), allocatedMax);
+      release();
+      head = createBlock(sz);
+    }
+
+#ifdef _DEBUG
+    for (Block *block = head; block; block = block->next)
+      ::memset(block->data(), 0xBA, block->offset);
+#endif
+
+    for (Block *block = head; block; block = block->next)
+      block->offset = 0;
+    current = head;
+    usedBefore = 0;
+  }
+
+  void release()
+  {
+    for (Block *block = head; block;)
+    {
+      Block *next = block->next;
+      ::free(block);
+      block = next;
+    }
+    head = current = nullptr;
+    usedBefore = 0;
+  }
+};
+
+struct ThreadArenas
+{
+  uint32_t index = 0;
+  void *context = nullptr;
+  Arena frame;
+  // Memory of the previous frame is in the other one
+  uint32_t doubleFrameIndex = 0;
+  Arena doubleFrame[2];
+};
+
+static std::mutex g_arenas_mutex;
+static eastl::vector<ThreadArenas*> g_arenas;
+
+static thread_local void *t_context = nullptr;
+// Arenas of t_context
+static thread_local ThreadArenas *t_arenas = nullptr;
+// Arenas of all contexts the thread has worked with
+static thread_local eastl::vector<ThreadArenas*> t_context_arenas;
+
+static ThreadArenas* get_thread_arenas()
+{
+  if (!t_arenas)
+  {
+    std::lock_guard<std::mutex> lock(g_arenas_mutex);
+    t_arenas = new ThreadArenas;
+    t_arenas->index = (uint32_t)g_arenas.size();
+    t_arenas->context = t_context;
+    g_arenas.push_back(t_arenas);
+    t_context_arenas.push_back(t_arenas);
+  }
+  return t_arenas;
+}
 
 uint8_t *alloc_frame_mem(size_t sz)
-{ 
+{
   return alloc_frame_mem(sz, default_alignment);
 }
 
 uint8_t *alloc_frame_mem(size_t sz, size_t alignment)
 {
-  uint8_t *mem = &buffer[buffer_offset];
-  uint8_t *res = (uint8_t*)(((uintptr_t)mem + (alignment - 1)) & ~(alignment - 1));
+  return get_thread_arenas()->frame.alloc(sz, alignment);
+}
 
-  buffer_offset += sz + ((uintptr_t)res - (uintptr_t)mem);
+uint8_t *alloc_double_frame_mem(size_t sz)
+{
+  return alloc_double_frame_mem(sz, default_alignment);
+}
 
-  return res;
+uint8_t *alloc_double_frame_mem(size_t sz, size_t alignment)
+{
+  ThreadArenas *arenas = get_thread_arenas();
+  return arenas->doubleFrame[arenas->doubleFrameIndex].alloc(sz, alignment);
 }
 
 void clear_frame_mem()
 {
-  if (buffer_offset > buffer_max_offset)
-    buffer_max_offset = buffer_offset;
+  std::lock_guard<std::mutex> lock(g_arenas_mutex);
 
-  buffer_offset = 0;
+  // Memory of the previous frame is released, memory of this frame lives one frame more
+  for (ThreadArenas *arenas : g_arenas)
+    if (arenas->context == t_context)
+    {
+      arenas->doubleFrameIndex ^= 1;
+      arenas->frame.reset();
+      arenas->doubleFrame[arenas->doubleFrameIndex].reset();
+    }
+}
 
-#ifdef _DEBUG
-  buffer.fill(0xBA);
-#endif
+void set_frame_mem_context(void *context)
+{
+  if (context == t_context)
+    return;
+
+  t_context = context;
+  t_arenas = nullptr;
+  for (ThreadArenas *arenas : t_context_arenas)
+    if (arenas->context == context)
+    {
+      t_arenas = arenas;
+      break;
+    }
+}
+
+void release_frame_mem_context(void *context)
+{
+  std::lock_guard<std::mutex> lock(g_arenas_mutex);
+
+  // The arenas stay registered, a context created at the same address takes them again
+  for (ThreadArenas *arenas : g_arenas)
+    if (arenas->context == context)
+    {
+      arenas->frame.release();
+      arenas->doubleFrame[0].release();
+      arenas->doubleFrame[1].release();
+    }
+}
+
+void set_frame_mem_block_size(size_t sz)
+{
+  g_block_size = sz;
 }
 
 size_t get_frame_mem_allocated_size()
 {
-  return buffer_offset;
+  std::lock_guard<std::mutex> lock(g_arenas_mutex);
+  size_t sz = 0;
+  for (ThreadArenas *arenas : g_arenas)
+    sz += arenas->frame.getAllocatedSize();
+  return sz;
 }
 
 size_t get_frame_mem_allocated_max_size()
 {
-  return buffer_max_offset;
-}
\ No newline at end of file
+  std::lock_guard<std::mutex> lock(g_arenas_mutex);
+  size_t sz = 0;
+  for (ThreadArenas *arenas : g_arenas)
+    sz += arenas->frame.allocatedMax;
+  return sz;
+}
+
+void get_frame_mem_stat(eastl::vector<FrameMemStat> &stat)
+{
+  std::lock_guard<std::mutex> lock(g_arenas_mutex);
+  stat.clear();
+  stat.reserve(g_arenas.size());
+  for (ThreadArenas *arenas : g_arenas)
+  {
+    FrameMemStat &s = stat.push_back();
+    s.threadIndex = arenas->index;
+    s.allocated = arenas->frame.getAllocatedSize();
+    s.allocatedMax = eastl::max(arenas->frame.allocatedMax, s.allocated);
+    s.reserved = arenas->frame.getReservedSize() + arenas->doubleFrame[0].getReservedSize() + arenas->doubleFrame[1].getReservedSize();
+    s.blocksCount = arenas->frame.getBlocksCount() + arenas->doubleFrame[0].getBlocksCount() + arenas->doubleFrame[1].getBlocksCount();
+  }
+}
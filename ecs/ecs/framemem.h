@@ -2,13 +2,43 @@
 
 #include "stdafx.h"
 
+// Frame memory is a set of per-thread bump arenas. Allocation is lock-free from any thread,
+// an arena chains a new block on overflow and grows to its high-water mark on clear.
+// Memory is valid until the next clear_frame_mem().
 uint8_t *alloc_frame_mem(size_t sz);
 uint8_t *alloc_frame_mem(size_t sz, size_t alignment);
+
+// Double-buffered frame memory. It is valid until the end of the next frame (two clear_frame_mem() calls),
+// i.e. pipelined jobs might read it while the next frame is running.
+uint8_t *alloc_double_frame_mem(size_t sz);
+uint8_t *alloc_double_frame_mem(size_t sz, size_t alignment);
+
+// Resets the arenas of the calling thread's context. Must be called when no jobs of the context are running
 void clear_frame_mem();
 
+// Arenas are per thread and per context, so worlds which tick concurrently don't reset each other's memory.
+// Workers switch the context with the jobs they run, nullptr is the default one
+void set_frame_mem_context(void *context);
+// Frees the blocks of the context's arenas
+void release_frame_mem_context(void *context);
+
+// Size of the first block of a thread arena
+void set_frame_mem_block_size(size_t sz);
+
 size_t get_frame_mem_allocated_size();
 size_t get_frame_mem_allocated_max_size();
 
+struct FrameMemStat
+{
+  uint32_t threadIndex = 0;
+  size_t allocated = 0;
+  size_t allocatedMax = 0;
+  size_t reserved = 0;
+  int blocksCount = 0;
+};
+
+void get_frame_mem_stat(eastl::vector<FrameMemStat> &stat);
+
 struct FrameMemAllocator
 {
   explicit FrameMemAllocator(const char * = nullptr) {}
@@ -25,6 +55,22 @@ struct FrameMemAllocator
   void set_name(const char *) {}
 };
 
+struct DoubleFrameMemAllocator
+{
+  explicit DoubleFrameMemAllocator(const char * = nullptr) {}
+  DoubleFrameMemAllocator(const DoubleFrameMemAllocator &x) {}
+  DoubleFrameMemAllocator(const DoubleFrameMemAllocator &x, const char *) {}
+
+  DoubleFrameMemAllocator &operator=(const DoubleFrameMemAllocator &x) { return *this; }
+
+  void *allocate(size_t n, int flags = 0) { return alloc_double_frame_mem(n); }
+  void *allocate(size_t n, size_t alignment, size_t offset, int flags = 0) { return alloc_double_frame_mem(n, alignment); }
+  void deallocate(void *p, size_t n) {}
+
+  const char *get_name() const { return "DoubleFrameMem"; }
+  void set_name(const char *) {}
+};
+
 template <typename T>
 struct RawFrameMemAllocator
 {
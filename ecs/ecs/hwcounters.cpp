@@ -0,0 +1,216 @@
+#include "hwcounters.h"
+
+#include <atomic>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+const char* hwcounters::get_name(Counter counter)
+{
+  switch (counter)
+  {
+    case kCycles: return "cycles";
+    case kInstructions: return "instructions";
+    case kCacheMisses: return "llc_misses";
+    case kBranchMisses: return "branch_misses";
+    default: return "";
+  }
+}
+
+#ifdef __linux__
+
+static std::atomic<bool> g_enabled = false;
+
+struct ThreadCounters
+{
+  int fds[hwcounters::kCount];
+  bool ok = false;
+
+  int depth = 0;
+  hwcounters::Values start = {};
+
+  // Deltas by owner index of every group, collect() of a group may run on another thread
+  std::mutex mutex;
+  eastl::hash_map<uint32_t, eastl::vector<hwcounters::Values>> perGroup;
+
+  ThreadCounters();
+  bool read(hwcounters::Values &out) const;
+};
+
+static std::mutex g_threads_mutex;
+static eastl::vector<ThreadCounters*> g_threads;
+
+static thread_local ThreadCounters *t_counters = nullptr;
+
+static long perf_event_open(perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+  return ::syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+ThreadCounters::ThreadCounters()
+{
+  static const uint64_t configs[hwcounters::kCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  ok = true;
+  for (int i = 0; i < hwcounters::kCount; ++i)
+  {
+    perf_event_attr attr;
+    ::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = i == 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fds[i] = (int)perf_event_open(&attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+    ok = ok && fds[i] >= 0;
+  }
+
+  if (ok)
+  {
+    ::ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  else
+  {
+    for (int i = 0; i < hwcounters::kCount; ++i)
+      if (fds[i] >= 0)
+        ::close(fds[i]);
+  }
+}
+
+bool ThreadCounters::read(hwcounters::Values &out) const
+{
+  uint64_t buffer[1 + hwcounters::kCount];
+  if (!ok || ::read(fds[0], buffer, sizeof(buffer)) != sizeof(buffer))
+    return false;
+  for (int i = 0; i < hwcounters::kCount; ++i)
+    out[i] = buffer[1 + i];
+  return true;
+}
+
+
+static ThreadCounters* get_thread_counters()
+{
+  if (!t_counters)
+  {
+    t_counters = new ThreadCounters;
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    g_threads.push_back(t_counters);
+  }
+  return t_counters;
+}
+
+bool hwcounters::is_available()
+{
+  return get_thread_counters()->ok;
+}
+
+bool hwcounters::is_enabled()
+{
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+bool hwcounters::set_enabled(bool enable)
+{
+  g_enabled.store(enable && is_available());
+  return g_enabled.load();
+}
+
+void hwcounters::begin()
+{
+  ThreadCounters *counters = get_thread_counters();
+  // Nested scopes are attributed to the outer one
+  if (counters->depth++ == 0 && !counters->read(counters->start))
+    counters->start = {};
+}
+
+void hwcounters::end(uint32_t owner)
+{
+  ThreadCounters *counters = get_thread_counters();
+  if (--counters->depth > 0)
+    return;
+
+  Values values;
+  if (owner == 0 || !counters->read(values))
+    return;
+
+  std::lock_guard<std::mutex> lock(counters->mutex);
+
+  auto &perIndex = counters->perGroup[get_owner_group(owner)];
+  const uint32_t index = get_owner_index(owner);
+  if (index >= perIndex.size())
+    perIndex.resize(index + 1, Values{});
+
+  Values &target = perIndex[index];
+  for (int i = 0; i < kCount; ++i)
+    target[i] += values[i] - counters->start[i];
+}
+
+void hwcounters::collect(uint32_t group, eastl::vector<Values> &per_index)
+{
+  std::lock_guard<std::mutex> lock(g_threads_mutex);
+  for (ThreadCounters *counters : g_threads)
+  {
+    std::lock_guard<std::mutex> threadLock(counters->mutex);
+
+    auto res = counters->perGroup.find(group);
+    if (res == counters->perGroup.end())
+      continue;
+
+    const eastl::vector<Values> &perIndex = res->second;
+    if (perIndex.size() > per_index.size())
+      per_index.resize(perIndex.size(), Values{});
+
+    for (size_t index = 0; index < perIndex.size(); ++index)
+      for (int i = 0; i < kCount; ++i)
+        per_index[index][i] += perIndex[index][i];
+    counters->perGroup.erase(res);
+  }
+}
+
+#else
+
+// Counters are not supported by the other platforms, profiling reports time only
+
+bool hwcounters::is_available()
+{
+  return false;
+}
+
+bool hwcounters::is_enabled()
+{
+  return false;
+}
+
+bool hwcounters::set_enabled(bool)
+{
+  return false;
+}
+
+void hwcounters::begin()
+{
+}
+
+void hwcounters::end(uint32_t)
+{
+}
+
+void hwcounters::collect(uint32_t, eastl::vector<Values>&)
+{
+}
+
+#endif
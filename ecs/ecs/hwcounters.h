@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <EASTL/array.h>
+#include <EASTL/vector.h>
+#include <EASTL/hash_map.h>
+
+// Hardware performance counters (perf_event_open on Linux, not available on the other platforms).
+// Counter deltas are accumulated per thread and per owner (e.g. system) and collected at a sync point.
+namespace hwcounters
+{
+  enum Counter
+  {
+    kCycles,
+    kInstructions,
+    kCacheMisses,
+    kBranchMisses,
+    kCount
+  };
+
+  using Values = eastl::array<uint64_t, kCount>;
+
+  bool is_available();
+  bool is_enabled();
+  // Returns false if counters are not supported
+  bool set_enabled(bool enable);
+
+  const char* get_name(Counter counter);
+
+  // Owners are qualified by a group (e.g. a world), groups are collected independently. 0 is no owner
+  inline uint32_t make_owner(uint32_t group, uint32_t index) { return group << 16 | index; }
+  inline uint32_t get_owner_group(uint32_t owner) { return owner >> 16; }
+  inline uint32_t get_owner_index(uint32_t owner) { return owner & 0xffff; }
+
+  // begin/end pairs on the same thread, the delta is added to the owner
+  void begin();
+  void end(uint32_t owner);
+
+  // Adds deltas of the owners of the group of all threads to per_index and resets them.
+  // Call it when no jobs of the group are running, other groups may run.
+  void collect(uint32_t group, eastl::vector<Values> &per_index);
+}
@@ -1,26 +1,148 @@
 #pragma once
 
 #include "query.h"
+#include "debug.h"
 
 struct ComponentDescription;
 
+template <typename... T>
+struct are_hash_join_keys : eastl::true_type {};
+
+template <typename Head, typename... Tail>
+struct are_hash_join_keys<Head, Tail...> : eastl::integral_constant<bool, is_hash_join_key<Head>::value && are_hash_join_keys<Tail...>::value> {};
+
+// Bytes of one or more key components, compared and hashed as raw memory.
+// Key components must be integral, enum or EntityId (see is_hash_join_key).
+struct IndexKey
+{
+  static constexpr int MAX_SIZE = 16;
+
+  uint8_t data[MAX_SIZE] = {};
+  uint8_t size = 0;
+
+  inline void append(const uint8_t *value, int value_size)
+  {
+    ASSERT(size + value_size <= MAX_SIZE);
+    ::memcpy(data + size, value, value_size);
+    size += (uint8_t)value_size;
+  }
+
+  template <typename... T>
+  static inline IndexKey make(const T&... values)
+  {
+    static_assert(sizeof...(T) > 0, "Key must have at least one component");
+    static_assert(are_hash_join_keys<T...>::value, "Only integral, enum and EntityId key components can be hashed");
+    IndexKey key;
+    const int unused[] = { (key.append((const uint8_t*)&values, (int)sizeof(T)), 0)... };
+    (void)unused;
+    return key;
+  }
+
+  inline bool operator==(const IndexKey &rhs) const { return size == rhs.size && ::memcmp(data, rhs.data, size) == 0; }
+  inline bool operator!=(const IndexKey &rhs) const { return !(*this == rhs); }
+};
+
+namespace eastl
+{
+  template <> struct hash<IndexKey>
+  {
+    size_t operator()(const IndexKey &key) const
+    {
+      uint32_t h = 2166136261u;
+      for (int i = 0; i < key.size; ++i)
+        h = (h ^ key.data[i]) * 16777619u;
+      return h;
+    }
+  };
+}
+
+// Entities of one key, a view into Index::rows
+struct IndexBucket
+{
+  uint8_t * __restrict * __restrict chunks = nullptr;
+  int * __restrict entitiesInChunk = nullptr;
+  int chunksCount = 0;
+  int componentsCount = 0;
+  int entitiesCount = 0;
+
+  explicit operator bool() const { return entitiesCount > 0; }
+
+  inline QueryIterator begin() const
+  {
+    return QueryIterator(chunks, chunksCount, entitiesInChunk, componentsCount);
+  }
+
+  inline QueryIterator end() const
+  {
+    return QueryIterator(nullptr, -1, nullptr, -1, chunksCount);
+  }
+};
+
+// Compressed sparse rows: a key table, offsets per key and flat arrays of entities and chunks.
+// Item i has members [memberOffsets[i], memberOffsets[i + 1]) and chunks [chunkOffsets[i], chunkOffsets[i + 1]) of rows.
 struct Index
 {
+  struct Member
+  {
+    int32_t archetypeId;
+    int32_t entityIndex;
+  };
+
+  // Last indexed state of an archetype
+  struct ArchetypeState
+  {
+    // Sum of change versions of the columns the index depends on
+    uint32_t version = 0;
+    // Item of every entity, -1 if the entity is not in the index
+    eastl::vector<int, memory::IndexAllocator> itemOf;
+  };
+
   HashedString name;
   HashedString componentName;
+  // The key is made of these components in this order, componentName is the first one
+  eastl::vector<HashedString> keyComponents;
+  // Sum of sizes of keyComponents, lookups of other sizes never match
+  int keySize = 0;
 
   QueryDescription desc;
 
-  eastl::hash_map<uint32_t, int> itemsMap;
-  eastl::vector<Query> queries;
+  eastl::hash_map<IndexKey, int, eastl::hash<IndexKey>, eastl::equal_to<IndexKey>, memory::IndexAllocator> itemsMap;
+  eastl::vector<IndexKey, memory::IndexAllocator> keys;
+  // Items left without members, their keys are removed from itemsMap and ids are reused by new keys
+  eastl::vector<int, memory::IndexAllocator> freeItems;
+
+  eastl::vector<int, memory::IndexAllocator> memberOffsets;
+  eastl::vector<Member, memory::IndexAllocator> members;
+  eastl::vector<int, memory::IndexAllocator> chunkOffsets;
+  // Chunks of all items in item order, consecutive entities of an archetype become one chunk
+  Query rows;
 
-  Query *find(uint32_t value);
+  eastl::vector<ArchetypeState, memory::IndexAllocator> archetypes;
+
+  inline int itemsCount() const { return (int)keys.size(); }
+  inline int liveItemsCount() const { return (int)(keys.size() - freeItems.size()); }
+
+  IndexBucket bucket(int item_id);
+
+  // Returns an empty bucket if no entity has the key
+  IndexBucket find(const IndexKey &key);
+
+  // Values are the key components in the order of keyComponents, of the component types
+  template <typename... T>
+  inline IndexBucket find(const T&... values)
+  {
+    return find(IndexKey::make(values...));
+  }
+
+  int getOrAddItem(const IndexKey &key);
+  void clear();
 };
 
 struct IndexDescription
 {
   ConstHashedString name;
   ConstHashedString componentName;
+  ConstArray<const ConstHashedString> keyComponents;
   ConstQueryDescription desc;
 
   filter_t filter;
@@ -31,4 +153,6 @@ struct IndexDescription
   const IndexDescription *next = nullptr;
 
   IndexDescription(const ConstHashedString &name, const ConstHashedString &component_name, const ConstQueryDescription &desc, filter_t &&f = nullptr);
-};
\ No newline at end of file
+  // Composite key
+  IndexDescription(const ConstHashedString &name, const ConstArray<const ConstHashedString> &key_components, const ConstQueryDescription &desc, filter_t &&f = nullptr);
+};
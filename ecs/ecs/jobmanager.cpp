@@ -2,13 +2,27 @@
 
 #include "debug.h"
 #include "framemem.h"
+#include "trace.h"
+#include "hwcounters.h"
 
+#ifdef _WIN32
 #include <Windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#else
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <immintrin.h>
 
 #include <EASTL/vector.h>
 #include <EASTL/array.h>
 #include <EASTL/algorithm.h>
 #include <EASTL/bitset.h>
+#include <EASTL/hash_map.h>
 
 #include <thread>
 #include <condition_variable>
@@ -20,31 +34,104 @@
 // TODO: More optimizations
 
 #define SQUASH_TASKS 0
-#define USE_OS_EVENTS 1
 
-#if USE_OS_EVENTS
+static std::atomic<jobmanager::WakePolicy> g_wake_policy = jobmanager::WakePolicy::kSpinPark;
+
+// Auto-reset event. Waiters spin, yield or park according to the wake policy.
+// Spin budget adapts to the number of spins the recent wakes took.
+struct Signal
+{
+  static constexpr int MIN_SPIN_COUNT = 16;
+  static constexpr int MAX_SPIN_COUNT = 1 << 14;
+
+  std::atomic<uint32_t> state = 0;
+  std::atomic<int> parkedCount = 0;
+  int spinCount = MIN_SPIN_COUNT;
+
+  void notify()
+  {
+    state.store(1);
+    if (parkedCount.load() > 0)
+      wake();
+  }
+
+  void wait()
+  {
+    const jobmanager::WakePolicy policy = g_wake_policy.load(std::memory_order_relaxed);
+
+    if (policy != jobmanager::WakePolicy::kPark)
+    {
+      const int budget = policy == jobmanager::WakePolicy::kSpin ? INT_MAX : spinCount;
+      for (int i = 0; i < budget; ++i)
+      {
+        if (state.load(std::memory_order_relaxed) && state.exchange(0))
+        {
+          spinCount = eastl::clamp((spinCount * 3 + i * 2) / 4, MIN_SPIN_COUNT, MAX_SPIN_COUNT);
+          return;
+        }
+        _mm_pause();
+      }
+      spinCount = eastl::max(spinCount * 3 / 4, MIN_SPIN_COUNT);
+    }
+
+    while (!state.exchange(0))
+    {
+      if (policy == jobmanager::WakePolicy::kSpinYield)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+
+      ++parkedCount;
+      park();
+      --parkedCount;
+    }
+  }
 
-  #define DECL_CV(n) HANDLE n##Event = NULL;
-  #define INIT_CV(n) n##Event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
-  #define DEL_CV(n) ::CloseHandle(n##Event);
-  #define NOTIFY_CV(n) ::SetEvent(n##Event);
-  #define WAIT_CV(n, c) ::WaitForSingleObjectEx(n##Event, INFINITE, TRUE);
-  #define WAIT_CV_COND(n, c) if (!c) ::WaitForSingleObjectEx(n##Event, INFINITE, TRUE);
-  #define LOCK(m) std::lock_guard<std::mutex> lock(m##Mutex);
+#ifdef _WIN32
+  void park()
+  {
+    uint32_t notSignaled = 0;
+    ::WaitOnAddress(&state, &notSignaled, sizeof(notSignaled), INFINITE);
+  }
 
+  void wake()
+  {
+    ::WakeByAddressSingle(&state);
+  }
 #else
+  void park()
+  {
+    ::syscall(SYS_futex, (uint32_t*)&state, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+  }
 
-  #define DECL_CV(n) std::condition_variable n##CV;
-  #define INIT_CV(...)
-  #define DEL_CV(...)
-  #define NOTIFY_CV(n) n##CV.notify_one();
-  #define WAIT_CV(n, c)\
-    std::unique_lock<std::mutex> lock(n##Mutex);\
-    n##CV.wait(lock, [&](){ return c; });
-  #define WAIT_CV_COND(n, c) WAIT_CV(n, c)
-  #define LOCK(...)
+  void wake()
+  {
+    ::syscall(SYS_futex, (uint32_t*)&state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+  }
+#endif
+};
+
+static inline uint32_t get_current_cpu()
+{
+#ifdef _WIN32
+  return ::GetCurrentProcessorNumber();
+#else
+  return (uint32_t)::sched_getcpu();
+#endif
+}
 
+static inline void set_thread_affinity(std::thread::native_handle_type handle, uint32_t cpu_no)
+{
+#ifdef _WIN32
+  ::SetThreadAffinityMask((HANDLE)handle, 1ull << cpu_no);
+#else
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu_no, &cpuSet);
+  ::pthread_setaffinity_np(handle, sizeof(cpuSet), &cpuSet);
 #endif
+}
 
 using JobId = jobmanager::JobId;
 using DependencyList = jobmanager::DependencyList;
@@ -56,6 +143,49 @@ static inline JobId make_jid(uint16_t gen, uint32_t index)
 
 static jobmanager::Stat g_stat;
 
+// Jobs created from now on by the thread are attributed to this owner
+static thread_local uint32_t g_job_owner = 0;
+static thread_local int g_worker_id = -1;
+
+// Jobs created from now on by the thread run with this context
+static thread_local void *g_job_context = nullptr;
+static jobmanager::context_callback_t g_context_callback = nullptr;
+
+// The thread waits for done jobs on it
+static thread_local Signal t_done_job_signal;
+
+// Stats by owner index of every group, collect_owner_stats of a group may run on another thread
+struct ThreadOwnerStats
+{
+  std::mutex mutex;
+  eastl::hash_map<uint32_t, eastl::vector<jobmanager::OwnerStat>> perGroup;
+};
+
+static std::mutex g_owner_stats_mutex;
+static eastl::vector<ThreadOwnerStats*> g_owner_stats;
+
+static thread_local ThreadOwnerStats *t_owner_stats = nullptr;
+
+static void add_owner_stat(uint32_t owner, double task_time, int jobs)
+{
+  if (!t_owner_stats)
+  {
+    t_owner_stats = new ThreadOwnerStats;
+    std::lock_guard<std::mutex> lock(g_owner_stats_mutex);
+    g_owner_stats.push_back(t_owner_stats);
+  }
+
+  std::lock_guard<std::mutex> lock(t_owner_stats->mutex);
+
+  auto &perIndex = t_owner_stats->perGroup[hwcounters::get_owner_group(owner)];
+  const uint32_t index = hwcounters::get_owner_index(owner);
+  if (index >= perIndex.size())
+    perIndex.resize(index + 1);
+
+  perIndex[index].taskTime += task_time;
+  perIndex[index].jobs += jobs;
+}
+
 static std::mutex g_output_mutex;
 static eastl::vector<eastl::string> g_output_buffer;
 
@@ -116,6 +246,9 @@ struct JobManager
 
     jobmanager::callback_t task;
 
+    uint32_t owner = 0;
+    void *context = nullptr;
+
     bool queued = false;
   };
 
@@ -131,10 +264,12 @@ struct JobManager
   {
     std::mutex startMutex;
 
-    DECL_CV(start);
+    Signal start;
 
     eastl::vector<Task> tasks;
     eastl::vector<jobmanager::callback_t> jobCallbacks;
+    eastl::vector<uint32_t> jobOwners;
+    eastl::vector<void*> jobContexts;
 
     std::atomic<bool> terminated = false;
     bool started = false;
@@ -144,7 +279,7 @@ struct JobManager
   {
     std::mutex startMutex;
 
-    DECL_CV(start);
+    Signal start;
 
     std::atomic<bool> terminated = false;
     bool started = false;
@@ -155,6 +290,8 @@ struct JobManager
     JobId jid;
     jobmanager::callback_t callback;
     int tasksCount = 0;
+    uint32_t owner = 0;
+    void *context = nullptr;
   };
 
   int workersCount = 0;
@@ -169,14 +306,16 @@ struct JobManager
   std::mutex doneWorkersMutex;
   eastl::bitset<16> doneWorkers;
 
-  DECL_CV(doneWorkers);
+  Signal doneWorkersSignal;
 
   std::thread schedulerThread;
   Scheduler scheduler;
 
   eastl::deque<uint32_t> freeJobQueue;
 
+  // Guarded by doneJobMutex
   int jobsCount = 0;
+  eastl::hash_map<void*, int> contextJobsCount;
   eastl::vector<Job> jobs;
   eastl::vector<uint8_t> jobGenerations;
   eastl::vector<DependencyList> jobDependencies;
@@ -187,7 +326,18 @@ struct JobManager
 
   std::mutex doneJobMutex;
 
-  DECL_CV(doneJob);
+  // Threads waiting for jobs, woken when jobs of their context are done. Guarded by doneJobMutex
+  struct Waiter
+  {
+    void *context = nullptr;
+    bool anyContext = false;
+    Signal *signal = nullptr;
+  };
+
+  eastl::vector<Waiter> waiters;
+
+  // startJobs might be called from several threads
+  std::mutex startJobsMutex;
 
   std::mutex currentTasksMutex;
   eastl::queue<eastl::vector<Task>> tasksQueue;
@@ -201,11 +351,17 @@ struct JobManager
   static void worker_routine(JobManager *jm, int worker_id)
   {
     Worker &worker = jm->workers[worker_id];
+    g_worker_id = worker_id;
+
+    static const char *names[] = {
+      "worker 0", "worker 1", "worker 2", "worker 3", "worker 4", "worker 5", "worker 6", "worker 7",
+      "worker 8", "worker 9", "worker 10", "worker 11", "worker 12", "worker 13", "worker 14", "worker 15" };
+    trace::set_thread_name(names[worker_id]);
 
     while (true)
     {
       {
-        WAIT_CV(worker.start, worker.started);
+        worker.start.wait();
 
         ASSERT(worker.started);
 
@@ -220,7 +376,42 @@ struct JobManager
       {
         SCOPE_TIME(g_stat.workers.task[worker_id]);
         for (const Task &task : worker.tasks)
-          worker.jobCallbacks[task.jobIdx](task.from, task.count);
+        {
+          TRACE_SCOPE(kJob, "task", task.jid.handle);
+
+          void *context = worker.jobContexts[task.jobIdx];
+          if (context != g_job_context)
+          {
+            g_job_context = context;
+            if (g_context_callback)
+              g_context_callback(context);
+          }
+
+          // Jobs created by the task are attributed to the owner of its job too
+          const uint32_t owner = worker.jobOwners[task.jobIdx];
+          g_job_owner = owner;
+
+          const bool countersEnabled = hwcounters::is_enabled();
+          if (countersEnabled)
+            hwcounters::begin();
+
+          if (owner)
+          {
+            const auto start = std::chrono::high_resolution_clock::now();
+
+            worker.jobCallbacks[task.jobIdx](task.from, task.count);
+
+            const std::chrono::duration<double, std::milli> diff = std::chrono::high_resolution_clock::now() - start;
+            add_owner_stat(owner, diff.count(), 0);
+          }
+          else
+            worker.jobCallbacks[task.jobIdx](task.from, task.count);
+
+          if (countersEnabled)
+            hwcounters::end(owner);
+
+          g_job_owner = 0;
+        }
       }
 
       {
@@ -235,7 +426,7 @@ struct JobManager
         std::lock_guard<std::mutex> lock(jm->doneWorkersMutex);
         jm->doneWorkers.set(worker_id);
       }
-      NOTIFY_CV(jm->doneWorkers);
+      jm->doneWorkersSignal.notify();
     }
   }
 
@@ -243,10 +434,13 @@ struct JobManager
   {
     Scheduler &scheduler = jm->scheduler;
 
+    trace::set_thread_name("scheduler");
+
     while (true)
     {
       {
-        WAIT_CV_COND(scheduler.start, scheduler.started)
+        if (!scheduler.started)
+          scheduler.start.wait();
 
         if (scheduler.terminated.load())
           return;
@@ -291,8 +485,16 @@ struct JobManager
           #endif
           jm->workers[i].jobCallbacks.clear();
           jm->workers[i].jobCallbacks.reserve(jm->currentJobs.size());
+          jm->workers[i].jobOwners.clear();
+          jm->workers[i].jobOwners.reserve(jm->currentJobs.size());
+          jm->workers[i].jobContexts.clear();
+          jm->workers[i].jobContexts.reserve(jm->currentJobs.size());
           for (const auto &job : jm->currentJobs)
+          {
             jm->workers[i].jobCallbacks.push_back(job.callback);
+            jm->workers[i].jobOwners.push_back(job.owner);
+            jm->workers[i].jobContexts.push_back(job.context);
+          }
         }
 
       const int currentTasksCount = jm->currentTasks.size();
@@ -364,7 +566,7 @@ struct JobManager
               std::lock_guard<std::mutex> lock(jm->workers[i].startMutex);
               jm->workers[i].started = true;
             }
-            NOTIFY_CV(jm->workers[i].start);
+            jm->workers[i].start.notify();
           }
       }
 
@@ -376,11 +578,11 @@ struct JobManager
 
         if (jm->startedWorkers.any())
         {
-          WAIT_CV(jm->doneWorkers, jm->doneWorkers.any());
+          jm->doneWorkersSignal.wait();
 
           SCOPE_TIME(g_stat.scheduler.doneTasks);
           {
-            LOCK(jm->doneWorkers);
+            std::lock_guard<std::mutex> lock(jm->doneWorkersMutex);
             doneWorkers = jm->doneWorkers;
             jm->doneWorkers.reset();
           }
@@ -432,14 +634,17 @@ struct JobManager
         if (!jobsToRemove.empty())
         {
           SCOPE_TIME_N(g_stat.scheduler.finalizeDeleteJobsTotal, 1);
-          {
-            std::lock_guard<std::mutex> lock(jm->doneJobMutex);
-            SCOPE_TIME_N(g_stat.scheduler.finalizeDeleteJobs, 2);
-            const size_t offset = jm->jobsToRemove.size();
-            jm->jobsToRemove.resize(offset + jobsToRemove.size());
-            eastl::uninitialized_copy_n(jobsToRemove.begin(), jobsToRemove.size(), jm->jobsToRemove.begin() + offset);
-          }
-          NOTIFY_CV(jm->doneJob);
+          std::lock_guard<std::mutex> lock(jm->doneJobMutex);
+          SCOPE_TIME_N(g_stat.scheduler.finalizeDeleteJobs, 2);
+          const size_t offset = jm->jobsToRemove.size();
+          jm->jobsToRemove.resize(offset + jobsToRemove.size());
+          eastl::uninitialized_copy_n(jobsToRemove.begin(), jobsToRemove.size(), jm->jobsToRemove.begin() + offset);
+
+          // Under the lock, a waiter unregisters its signal before it's gone
+          for (const Waiter &waiter : jm->waiters)
+            if (waiter.anyContext || eastl::any_of(jobsToRemove.begin(), jobsToRemove.end(),
+                  [&](const JobId &jid) { return jm->jobs[jid.index].context == waiter.context; }))
+              waiter.signal->notify();
         }
 
         {
@@ -460,11 +665,16 @@ struct JobManager
     jobGenerations.resize(1);
     jobDependencies.resize(1);
 
+    trace::set_thread_name("main");
+
     mainThreadId = std::this_thread::get_id();
-    mainCpuNo = ::GetCurrentProcessorNumber();
+    mainCpuNo = get_current_cpu();
 
-    HANDLE handle = ::GetCurrentThread();
-    ::SetThreadAffinityMask(handle, 1 << mainCpuNo);
+#ifdef _WIN32
+    ::SetThreadAffinityMask(::GetCurrentThread(), 1ull << mainCpuNo);
+#else
+    set_thread_affinity(::pthread_self(), mainCpuNo);
+#endif
 
     doneWorkers.reset();
     startedWorkers.reset();
@@ -472,29 +682,22 @@ struct JobManager
     workersCount = std::thread::hardware_concurrency() - 1;
     ASSERT(workersCount < (int)workers.size());
 
-    DWORD cpuNo = mainCpuNo == 0 ? 1 : 0;
+    uint32_t cpuNo = mainCpuNo == 0 ? 1 : 0;
     for (int i = 0; i < workersCount; ++i, ++cpuNo)
     {
-      INIT_CV(workers[i].start);
-
       workersThread[i] = eastl::move(std::thread(worker_routine, this, i));
-      HANDLE handle = (HANDLE)workersThread[i].native_handle();
 
       if (cpuNo == mainCpuNo)
         ++cpuNo;
 
-      ::SetThreadAffinityMask(handle, 1 << cpuNo);
+      set_thread_affinity(workersThread[i].native_handle(), cpuNo);
     }
 
-    INIT_CV(doneWorkers);
-    INIT_CV(doneJob);
-    INIT_CV(scheduler.start);
-
     schedulerThread = eastl::move(std::thread(scheduler_routine, this));
 
     // This reduce wait time on doneJobMutex
-    ::SetThreadAffinityMask((HANDLE)schedulerThread.native_handle(), 1 << ((mainCpuNo + 1) % workersCount));
-    // ::SetThreadAffinityMask((HANDLE)schedulerThread.native_handle(), 1 << mainCpuNo);
+    set_thread_affinity(schedulerThread.native_handle(), (mainCpuNo + 1) % workersCount);
+    // set_thread_affinity(schedulerThread.native_handle(), mainCpuNo);
 
     waitAllJobs();
   }
@@ -509,7 +712,7 @@ struct JobManager
       std::lock_guard<std::mutex> lock(scheduler.startMutex);
       scheduler.started = true;
     }
-    NOTIFY_CV(scheduler.start);
+    scheduler.start.notify();
 
     if (schedulerThread.joinable())
       schedulerThread.join();
@@ -523,19 +726,12 @@ struct JobManager
         std::lock_guard<std::mutex> lock(workers[i].startMutex);
         workers[i].started = true;
       }
-      NOTIFY_CV(workers[i].start);
+      workers[i].start.notify();
     }
 
     for (int i = 0; i < workersCount; ++i)
       if (workersThread[i].joinable())
         workersThread[i].join();
-
-    for (int i = 0; i < workersCount; ++i)
-      DEL_CV(workers[i].start);
-
-    DEL_CV(doneWorkers);
-    DEL_CV(doneJob);
-    DEL_CV(scheduler.start);
   }
 
   JobId createJob(int items_count, int chunk_size, const jobmanager::callback_t &task, const jobmanager::DependencyList &dependencies)
@@ -571,11 +767,17 @@ struct JobManager
     ASSERT(freeIndex > 0);
 
     ++jobsCount;
+    ++contextJobsCount[g_job_context];
+
+    if (g_job_owner)
+      add_owner_stat(g_job_owner, 0.0, 1);
 
     Job &j = jobs[freeIndex];
     j.itemsCount = items_count;
     j.chunkSize = chunk_size;
     j.task = task;
+    j.owner = g_job_owner;
+    j.context = g_job_context;
 
     jobDependencies[freeIndex] = eastl::move(dependencies);
 
@@ -594,6 +796,7 @@ struct JobManager
     THREAD_LOG("deleteJob: %d", jid.handle);
 
     --jobsCount;
+    --contextJobsCount[jobs[jid.index].context];
 
     jobs[jid.index].queued = false;
     jobGenerations[jid.index] = uint16_t(jobGenerations[jid.index] + 1) % JobId::GENERATION_LIMIT;
@@ -607,12 +810,21 @@ struct JobManager
 
   void startJobs()
   {
-    if (jobsToStart.empty())
+    std::lock_guard<std::mutex> startLock(startJobsMutex);
+
+    // Jobs created from now on are started by the next call
+    eastl::vector<JobId> toStart;
+    {
+      std::lock_guard<std::mutex> lock(doneJobMutex);
+      toStart.swap(jobsToStart);
+    }
+
+    if (toStart.empty())
       return;
 
     SCOPE_TIME(g_stat.jm.startJobs);
 
-    while (!jobsToStart.empty())
+    while (!toStart.empty())
     {
       SCOPE_TIME(g_stat.jm.startJobQueues);
 
@@ -620,11 +832,11 @@ struct JobManager
       eastl::vector<JobInQueue> futureJobs;
       eastl::vector<JobId> futureBarriers;
 
-      futureJobs.reserve(jobsToStart.size());
+      futureJobs.reserve(toStart.size());
 
-      for (int jobIdx = jobsToStart.size() - 1; jobIdx >= 0; --jobIdx)
+      for (int jobIdx = toStart.size() - 1; jobIdx >= 0; --jobIdx)
       {
-        JobId jid = jobsToStart[jobIdx];
+        JobId jid = toStart[jobIdx];
 
         bool canStart = true;
         Job job;
@@ -645,14 +857,14 @@ struct JobManager
 
         if (canStart)
         {
-          jobsToStart.erase(jobsToStart.begin() + jobIdx);
+          toStart.erase(toStart.begin() + jobIdx);
 
           if (job.task)
           {
             int itemsLeft = job.itemsCount;
             int tasksCount = (job.itemsCount / job.chunkSize) + ((job.itemsCount % job.chunkSize) ? 1 : 0);
 
-            futureJobs.push_back({jid, job.task, 0});
+            futureJobs.push_back({jid, job.task, 0, job.owner, job.context});
             futureTasks.reserve(futureTasks.size() + tasksCount);
 
             for (int i = 0; i < job.itemsCount; i += job.chunkSize, itemsLeft -= job.chunkSize)
@@ -692,41 +904,101 @@ struct JobManager
       std::lock_guard<std::mutex> lock(scheduler.startMutex);
       scheduler.started = true;
     }
-    NOTIFY_CV(scheduler.start);
+    scheduler.start.notify();
   }
 
-  void waitDoneJobs()
+  void retireDoneJobs()
   {
-    SCOPE_TIME(g_stat.jm.doneJobsMutex);
+    std::lock_guard<std::mutex> lock(doneJobMutex);
+    for (const JobId &jid : jobsToRemove)
+      deleteJob(jid);
+    jobsToRemove.clear();
+  }
 
-    WAIT_CV(doneJob, !jobsToRemove.empty());
+  // Each waiter parks on its own signal, waiters of different contexts don't wake each other
+  template <typename Done>
+  void waitDoneJobs(void *context, bool any_context, Done done)
+  {
+    Signal &signal = t_done_job_signal;
 
     {
-      LOCK(doneJob);
-      for (const JobId &jid : jobsToRemove)
-        deleteJob(jid);
+      std::lock_guard<std::mutex> lock(doneJobMutex);
+      waiters.push_back({ context, any_context, &signal });
     }
 
-    jobsToRemove.clear();
+    while (true)
+    {
+      // Any waiter retires done jobs of all contexts
+      retireDoneJobs();
+      if (done())
+        break;
+
+      SCOPE_TIME(g_stat.jm.doneJobsMutex);
+      signal.wait();
+    }
+
+    std::lock_guard<std::mutex> lock(doneJobMutex);
+    waiters.erase(eastl::find_if(waiters.begin(), waiters.end(), [&](const Waiter &waiter) { return waiter.signal == &signal; }));
   }
 
   void wait(const JobId &jid)
   {
-    while (!isDone(jid))
-      waitDoneJobs();
+    auto done = [&]()
+    {
+      std::lock_guard<std::mutex> lock(doneJobMutex);
+      return isDone(jid);
+    };
+
+    void *context = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(doneJobMutex);
+      if (isDone(jid))
+        return;
+      context = jobs[jid.index].context;
+    }
+
+    TRACE_SCOPE(kJob, "wait", jid.handle);
+    waitDoneJobs(context, false, done);
   }
 
   void waitAllJobs()
   {
     SCOPE_TIME(g_stat.jm.waitAllJobs);
+    TRACE_SCOPE(kJob, "wait_all_jobs");
 
     startJobs();
 
-    while (jobsCount > 0)
-      waitDoneJobs();
+    waitDoneJobs(nullptr, true, [&]()
+    {
+      std::lock_guard<std::mutex> lock(doneJobMutex);
+      return jobsCount == 0;
+    });
 
     THREAD_LOG_FLUSH;
   }
+
+  void waitContextJobs(void *context)
+  {
+    TRACE_SCOPE(kJob, "wait_context_jobs");
+
+    double waitTime = 0.0;
+    {
+      SCOPE_TIME(waitTime);
+
+      startJobs();
+
+      waitDoneJobs(context, false, [&]()
+      {
+        std::lock_guard<std::mutex> lock(doneJobMutex);
+        auto res = contextJobsCount.find(context);
+        return res == contextJobsCount.end() || res->second == 0;
+      });
+    }
+
+    // Worlds wait from several threads
+    std::lock_guard<std::mutex> lock(doneJobMutex);
+    g_stat.jm.waitAllJobs += waitTime;
+  }
 };
 
 static JobManager *g_jm = nullptr;
@@ -789,12 +1061,83 @@ void jobmanager::wait_all_jobs()
   g_jm->waitAllJobs();
 }
 
+void jobmanager::wait_context_jobs()
+{
+  ASSERT(g_jm != nullptr);
+  g_jm->waitContextJobs(g_job_context);
+}
+
 void jobmanager::start_jobs()
 {
   ASSERT(g_jm != nullptr);
   g_jm->startJobs();
 }
 
+void jobmanager::set_job_owner(uint32_t owner)
+{
+  g_job_owner = owner;
+}
+
+void jobmanager::set_context(void *context)
+{
+  g_job_context = context;
+}
+
+void* jobmanager::get_context()
+{
+  return g_job_context;
+}
+
+void jobmanager::set_context_callback(context_callback_t callback)
+{
+  g_context_callback = callback;
+}
+
+void jobmanager::collect_owner_stats(uint32_t group, eastl::vector<OwnerStat> &per_index)
+{
+  std::lock_guard<std::mutex> lock(g_owner_stats_mutex);
+  for (ThreadOwnerStats *stats : g_owner_stats)
+  {
+    std::lock_guard<std::mutex> threadLock(stats->mutex);
+
+    auto res = stats->perGroup.find(group);
+    if (res == stats->perGroup.end())
+      continue;
+
+    const eastl::vector<OwnerStat> &perIndex = res->second;
+    if (perIndex.size() > per_index.size())
+      per_index.resize(perIndex.size());
+
+    for (size_t index = 0; index < perIndex.size(); ++index)
+    {
+      per_index[index].taskTime += perIndex[index].taskTime;
+      per_index[index].jobs += perIndex[index].jobs;
+    }
+    stats->perGroup.erase(res);
+  }
+}
+
+int jobmanager::get_worker_id()
+{
+  return g_worker_id;
+}
+
+int jobmanager::get_workers_count()
+{
+  ASSERT(g_jm != nullptr);
+  return g_jm->workersCount;
+}
+
+void jobmanager::set_wake_policy(WakePolicy policy)
+{
+  g_wake_policy.store(policy);
+}
+
+jobmanager::WakePolicy jobmanager::get_wake_policy()
+{
+  return g_wake_policy.load();
+}
+
 void jobmanager::reset_stat()
 {
   g_stat = {};
@@ -3,6 +3,7 @@
 #include <EASTL/functional.h>
 #include <EASTL/array.h>
 #include <EASTL/fixed_vector.h>
+#include <EASTL/vector.h>
 
 namespace jobmanager
 {
@@ -71,6 +72,15 @@ namespace jobmanager
 
   using DependencyList = eastl::fixed_vector<JobId, 16, true>;
 
+  // How workers and waiters wait for a signal
+  enum class WakePolicy
+  {
+    kSpin,      // Lowest latency, burns the core while idle
+    kSpinYield, // Spin for the adaptive budget then yield the time slice
+    kSpinPark,  // Spin for the adaptive budget then park the thread (futex / WaitOnAddress)
+    kPark,      // Park immediately, for idle or background instances
+  };
+
   void init();
   void release();
 
@@ -82,9 +92,40 @@ namespace jobmanager
   JobId add_job(const DependencyList &dependencies);
   JobId add_job(DependencyList &&dependencies);
 
+  // Might be called from several threads at once
   void wait(const JobId &jid);
   void start_jobs();
   void wait_all_jobs();
+  // Waits for the jobs created with the context of the calling thread, the jobs of other contexts keep running
+  void wait_context_jobs();
+
+  // Jobs created after this call on the calling thread are attributed to the owner, 0 - no owner.
+  // Owners are qualified by a group, see hwcounters::make_owner. Tasks run with the owner of their job
+  void set_job_owner(uint32_t owner);
+
+  struct OwnerStat
+  {
+    double taskTime = 0.0; // Milliseconds spent in the tasks of the owner's jobs on all threads
+    int jobs = 0;
+  };
+
+  // Adds stats of the owners of the group of all threads to per_index and resets them.
+  // Call it when no jobs of the group are running, other groups may run
+  void collect_owner_stats(uint32_t group, eastl::vector<OwnerStat> &per_index);
+
+  // Jobs take the context of the thread which creates them and a worker switches to it while it runs their tasks,
+  // the callback is called on the worker on every switch. ecs keeps the current world there
+  using context_callback_t = void (*)(void * /* context */);
+  void set_context(void *context);
+  void* get_context();
+  void set_context_callback(context_callback_t callback);
+
+  // Index of the worker the calling thread is, in [0, get_workers_count()), -1 for other threads
+  int get_worker_id();
+  int get_workers_count();
+
+  void set_wake_policy(WakePolicy policy);
+  WakePolicy get_wake_policy();
 
   void reset_stat();
   const Stat& get_stat();
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "query.h"
+
+// Keys are hashed as raw memory, see is_hash_join_key. Keys of other types are joined by a nested loop.
+template <typename Key>
+inline uint32_t join_key_hash(const Key &key)
+{
+  const uint8_t *data = (const uint8_t*)&key;
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < (int)sizeof(Key); ++i)
+    h = (h ^ data[i]) * 16777619u;
+  return h;
+}
+
+// Transient hash table over the key column of a query result
+struct HashJoinTable
+{
+  struct Entry
+  {
+    int32_t chunkIdx;
+    int32_t idx;
+    // Next entry of the bucket, -1 at the end
+    int32_t next;
+  };
+
+  uint32_t bucketsMask = 0;
+  eastl::vector<int, memory::IndexAllocator> buckets;
+  eastl::vector<Entry, memory::IndexAllocator> entries;
+};
+
+// Equi-join of two query results, callback(q1, q2) is called for every pair of entities with equal keys.
+// The smaller result is put into a hash table and the larger one probes it, O(|A| + |B| + pairs).
+// Pairs come in the order of the larger result, then in the order of the smaller one.
+template <typename Key, typename Callable>
+inline void hash_join(Query &query1, int key_idx1, Query &query2, int key_idx2, Callable &&callback)
+{
+  static_assert(!ComponentLayout<Key>::soa, "SoA components can't be join keys");
+  static_assert(is_hash_join_key<Key>::value, "Only integral, enum and EntityId keys can be hashed, use equi_join");
+
+  if (query1.entitiesCount <= 0 || query2.entitiesCount <= 0)
+    return;
+
+  const bool buildFirst = query1.entitiesCount <= query2.entitiesCount;
+  Query &build = buildFirst ? query1 : query2;
+  Query &probe = buildFirst ? query2 : query1;
+  const int buildKey = buildFirst ? key_idx1 : key_idx2;
+  const int probeKey = buildFirst ? key_idx2 : key_idx1;
+
+  HashJoinTable table;
+
+  int bucketsCount = 16;
+  while (bucketsCount < build.entitiesCount * 2)
+    bucketsCount <<= 1;
+  table.bucketsMask = bucketsCount - 1;
+  table.buckets.resize(bucketsCount, -1);
+  table.entries.reserve(build.entitiesCount);
+
+  // Backwards, so every bucket lists its entries in order
+  for (int chunkIdx = build.chunksCount - 1; chunkIdx >= 0; --chunkIdx)
+  {
+    const Key *keys = (const Key*)build.chunks[chunkIdx * build.componentsCount + buildKey];
+    for (int i = build.entitiesInChunk[chunkIdx] - 1; i >= 0; --i)
+    {
+      int &head = table.buckets[join_key_hash(keys[i]) & table.bucketsMask];
+      table.entries.push_back({ chunkIdx, i, head });
+      head = (int)table.entries.size() - 1;
+    }
+  }
+
+  QueryIterator buildIter(build.chunks.data(), build.chunksCount, build.entitiesInChunk.data(), build.componentsCount);
+  for (auto probeIter = probe.begin(), e = probe.end(); probeIter != e; ++probeIter)
+  {
+    const Key &key = probeIter.get<Key>(probeKey);
+    for (int entryIdx = table.buckets[join_key_hash(key) & table.bucketsMask]; entryIdx >= 0; entryIdx = table.entries[entryIdx].next)
+    {
+      const HashJoinTable::Entry &entry = table.entries[entryIdx];
+      const Key *keys = (const Key*)build.chunks[entry.chunkIdx * build.componentsCount + buildKey];
+      if (!(keys[entry.idx] == key))
+        continue;
+
+      buildIter.chunkIdx = entry.chunkIdx;
+      buildIter.curChunk = build.chunks.data() + entry.chunkIdx * build.componentsCount;
+      buildIter.idx = entry.idx;
+
+      QueryIterator probeCopy = probeIter;
+      if (buildFirst)
+        callback(buildIter, probeCopy);
+      else
+        callback(probeCopy, buildIter);
+    }
+  }
+}
+
+// Every pair of entities, callback(q1, q2) checks the keys, O(|A| * |B|)
+template <typename Callable>
+inline void nested_loop_join(Query &query1, Query &query2, Callable &&callback)
+{
+  for (auto q1 = query1.begin(), e1 = query1.end(); q1 != e1; ++q1)
+    for (auto q2 = query2.begin(), e2 = query2.end(); q2 != e2; ++q2)
+    {
+      QueryIterator q1Copy = q1;
+      callback(q1Copy, q2);
+    }
+}
+
+template <typename Key, typename Callable>
+inline void equi_join(Query &query1, int key_idx1, Query &query2, int key_idx2, Callable &&callback, eastl::true_type)
+{
+  hash_join<Key>(query1, key_idx1, query2, key_idx2, eastl::forward<Callable>(callback));
+}
+
+template <typename Key, typename Callable>
+inline void equi_join(Query &query1, int, Query &query2, int, Callable &&callback, eastl::false_type)
+{
+  nested_loop_join(query1, query2, eastl::forward<Callable>(callback));
+}
+
+// Equi-join of two query results, hashed if the key type allows it, a nested loop otherwise
+template <typename Key, typename Callable>
+inline void equi_join(Query &query1, int key_idx1, Query &query2, int key_idx2, Callable &&callback)
+{
+  equi_join<Key>(query1, key_idx1, query2, key_idx2, eastl::forward<Callable>(callback), typename is_hash_join_key<Key>::type());
+}
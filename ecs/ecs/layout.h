@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <EASTL/type_traits.h>
+
+#include "span.h"
+
+// SoA components are stored in blocks of SOA_BLOCK_SIZE entities where each field has its own lane:
+// [x0 .. x255][y0 .. y255][x256 .. x511][y256 .. y511] ...
+// Query chunks never cross a block, so all lanes of a chunk are addressed from the lane 0 pointer.
+static constexpr int SOA_BLOCK_SIZE = 256;
+
+template <typename T>
+struct ComponentLayout
+{
+  static constexpr bool soa = false;
+  static constexpr int fieldsCount = 0;
+  static constexpr int fieldSize = 0;
+};
+
+template <typename T>
+struct ComponentLayout<const T> : ComponentLayout<T> {};
+
+#ifdef __CODEGEN__
+#define ECS_COMPONENT_LAYOUT(T, layout)
+#else
+// ECS_COMPONENT_LAYOUT(glm::vec2, soa). T must be trivially copyable and consist of T::value_type fields only.
+#define ECS_COMPONENT_LAYOUT(T, layout) ECS_COMPONENT_LAYOUT_##layout(T)
+#endif
+
+#define ECS_COMPONENT_LAYOUT_aos(T)
+
+#define ECS_COMPONENT_LAYOUT_soa(T) \
+  template <> struct ComponentLayout<T> \
+  { \
+    using FieldType = T::value_type; \
+    static constexpr bool soa = true; \
+    static constexpr int fieldsCount = sizeof(T) / sizeof(FieldType); \
+    static constexpr int fieldSize = sizeof(FieldType); \
+    static_assert(sizeof(T) == fieldsCount * sizeof(FieldType), "SoA component must consist of value_type fields only"); \
+    static_assert(eastl::is_trivially_copyable<T>::value, "SoA component must be trivially copyable"); \
+  }; \
+
+inline uint8_t* soa_lane(uint8_t *lane0, int field, int field_size)
+{
+  return lane0 + field * SOA_BLOCK_SIZE * field_size;
+}
+
+inline const uint8_t* soa_lane(const uint8_t *lane0, int field, int field_size)
+{
+  return lane0 + field * SOA_BLOCK_SIZE * field_size;
+}
+
+// Lane 0 item of the entity at index of a column, or of a chunk column while index stays in the chunk
+inline uint8_t* soa_item(uint8_t *column, int index, int item_size, int field_size)
+{
+  return column + (index / SOA_BLOCK_SIZE) * SOA_BLOCK_SIZE * item_size + (index % SOA_BLOCK_SIZE) * field_size;
+}
+
+inline void soa_gather(uint8_t *to, const uint8_t *lane0, int fields_count, int field_size)
+{
+  for (int f = 0; f < fields_count; ++f)
+    ::memcpy(to + f * field_size, soa_lane(lane0, f, field_size), field_size);
+}
+
+inline void soa_scatter(uint8_t *lane0, const uint8_t *from, int fields_count, int field_size)
+{
+  for (int f = 0; f < fields_count; ++f)
+    ::memcpy(soa_lane(lane0, f, field_size), from + f * field_size, field_size);
+}
+
+// Copy of a SoA component, changes are written back when it dies.
+// Lives until the end of the full-expression, so it's only good as a call argument.
+template <typename T>
+struct SoAValue
+{
+  using Layout = ComponentLayout<T>;
+  using ValueType = typename eastl::remove_const<T>::type;
+
+  uint8_t *lane0;
+  ValueType value;
+
+  SoAValue(uint8_t *lane0_) : lane0(lane0_)
+  {
+    soa_gather((uint8_t*)&value, lane0, Layout::fieldsCount, Layout::fieldSize);
+  }
+
+  SoAValue(const SoAValue&) = delete;
+  SoAValue& operator=(const SoAValue&) = delete;
+
+  ~SoAValue()
+  {
+    if (!eastl::is_const<T>::value)
+      soa_scatter(lane0, (const uint8_t*)&value, Layout::fieldsCount, Layout::fieldSize);
+  }
+
+  operator T&() { return value; }
+};
+
+// Element of lane 0, a column of SoA components is addressed as an array of these
+template <typename T>
+struct SoAItem
+{
+  typename ComponentLayout<T>::FieldType field;
+};
+
+template <typename T, bool SoA = ComponentLayout<T>::soa>
+struct ComponentColumnItem
+{
+  using Type = T;
+};
+
+template <typename T>
+struct ComponentColumnItem<T, true>
+{
+  using Type = SoAItem<T>;
+};
+
+template <typename T>
+struct ComponentColumnItem<const T, true>
+{
+  using Type = const SoAItem<T>;
+};
+
+// Lanes of a chunk of SoA components, e.g. lane(0) are x and lane(1) are y of glm::vec2
+template <typename T>
+struct Lanes
+{
+  using Layout = ComponentLayout<T>;
+  using FieldType = typename eastl::conditional<eastl::is_const<T>::value, const typename Layout::FieldType, typename Layout::FieldType>::type;
+
+  FieldType * __restrict data = nullptr;
+  int count = 0;
+
+  Lanes(FieldType * __restrict _data, int _count) : data(_data), count(_count) {}
+
+  inline int size() const { return count; }
+  inline static constexpr int lanesCount() { return Layout::fieldsCount; }
+
+  inline Span<FieldType> lane(int field) const { return Span<FieldType>(data + field * SOA_BLOCK_SIZE, count); }
+
+  inline operator Lanes<const T>() const { return Lanes<const T>(data, count); }
+};
+
+// Per-entity access for generated code, the identity for regular components
+template <typename T>
+__forceinline T& ecs_ref(T &value)
+{
+  return value;
+}
+
+template <typename T>
+__forceinline SoAValue<T> ecs_ref(SoAItem<T> &item)
+{
+  return SoAValue<T>((uint8_t*)&item);
+}
+
+template <typename T>
+__forceinline SoAValue<const T> ecs_ref(const SoAItem<T> &item)
+{
+  return SoAValue<const T>((uint8_t*)&item);
+}
+
+// Chunk access for generated code: Span for regular components and Lanes for SoA ones
+template <typename T>
+__forceinline Span<T> ecs_span(T * __restrict data, int count)
+{
+  return Span<T>(data, count);
+}
+
+template <typename T>
+__forceinline Lanes<T> ecs_span(SoAItem<T> * __restrict data, int count)
+{
+  return Lanes<T>(&data->field, count);
+}
+
+template <typename T>
+__forceinline Lanes<const T> ecs_span(const SoAItem<T> * __restrict data, int count)
+{
+  return Lanes<const T>(&data->field, count);
+}
+
+// Typed access to a column: T& for regular components and SoAValue<T> for SoA ones
+template <typename T, bool SoA = ComponentLayout<T>::soa>
+struct ComponentAccess
+{
+  using Ref = T&;
+  static __forceinline T& get(uint8_t *column, int index) { return ((T*)column)[index]; }
+};
+
+template <typename T>
+struct ComponentAccess<T, true>
+{
+  using Ref = SoAValue<T>;
+  static __forceinline SoAValue<T> get(uint8_t *column, int index) { return SoAValue<T>(soa_item(column, index, sizeof(T), ComponentLayout<T>::fieldSize)); }
+};
@@ -0,0 +1,402 @@
+#include "level.h"
+#include "ecs.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Column data is aligned so raw columns might be read in place
+static constexpr uint64_t COLUMN_ALIGNMENT = 16;
+
+static inline uint64_t align_offset(uint64_t offset)
+{
+  return (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+}
+
+static inline size_t align_to_cache_line(size_t sz)
+{
+  return (sz + memory::CACHE_LINE_SIZE - 1) & ~(memory::CACHE_LINE_SIZE - 1);
+}
+
+Level::~Level()
+{
+  close();
+}
+
+bool Level::open(const char *_path)
+{
+  close();
+
+  path = _path;
+
+#ifdef _WIN32
+  fileHandle = ::CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    fileHandle = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!::GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(LevelHeader))
+  {
+    close();
+    return false;
+  }
+
+  mappingHandle = ::CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  data = mappingHandle ? (const uint8_t*)::MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  size = (size_t)fileSize.QuadPart;
+#else
+  const int fd = ::open(_path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LevelHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  data = p != MAP_FAILED ? (const uint8_t*)p : nullptr;
+  size = (size_t)st.st_size;
+#endif
+
+  if (!data || !validate())
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void Level::close()
+{
+#ifdef _WIN32
+  if (data)
+    ::UnmapViewOfFile(data);
+  if (mappingHandle)
+    ::CloseHandle(mappingHandle);
+  if (fileHandle)
+    ::CloseHandle(fileHandle);
+  mappingHandle = nullptr;
+  fileHandle = nullptr;
+#else
+  if (data)
+    ::munmap((void*)data, size);
+#endif
+
+  data = nullptr;
+  size = 0;
+}
+
+bool Level::validate() const
+{
+  const LevelHeader &h = header();
+  if (h.magic != LevelHeader::MAGIC || h.version != LevelHeader::VERSION || h.size != size)
+    return false;
+
+  const uint64_t tablesSize = sizeof(LevelHeader) + uint64_t(h.groupsCount) * sizeof(LevelGroup) + uint64_t(h.columnsCount) * sizeof(LevelColumn);
+  if (tablesSize > size || h.stringsOffset < tablesSize || uint64_t(h.stringsOffset) + h.stringsSize > size)
+    return false;
+
+  // Every string is null terminated, so the last one is
+  if (h.stringsSize > 0 && data[h.stringsOffset + h.stringsSize - 1] != 0)
+    return false;
+
+  for (uint32_t i = 0; i < h.groupsCount; ++i)
+  {
+    const LevelGroup &group = groups()[i];
+    if (group.templateName >= h.stringsSize || uint64_t(group.firstColumn) + group.columnsCount > h.columnsCount)
+      return false;
+
+    for (uint32_t c = group.firstColumn; c < group.firstColumn + group.columnsCount; ++c)
+    {
+      const LevelColumn &column = columns()[c];
+      if (column.name >= h.stringsSize || column.dataOffset > size || column.dataSize > size - column.dataOffset)
+        return false;
+      if ((column.flags & LevelColumn::kSideTable) == 0 && column.dataSize != uint64_t(column.itemSize) * group.entitiesCount)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+LevelStaging::~LevelStaging()
+{
+  if (decodeResult.valid())
+    decodeResult.wait();
+
+  for (Group &group : groups)
+  {
+    for (Column &column : group.columns)
+    {
+      if (column.desc->isTrivial)
+        continue;
+      if (decoded)
+        for (int32_t i = 0; i < group.entitiesCount; ++i)
+          column.desc->dtor(column.items + i * column.desc->size);
+      column.desc->dtor(column.defaultValue);
+    }
+    memory::free(memory::Subsystem::kStorage, group.data, group.dataSize);
+  }
+}
+
+bool LevelStaging::prepare(eastl::unique_ptr<Level> &&_level)
+{
+  level = eastl::move(_level);
+
+  const LevelHeader &header = level->header();
+  groups.reserve(header.groupsCount);
+  for (uint32_t groupNo = 0; groupNo < header.groupsCount; ++groupNo)
+  {
+    const LevelGroup &levelGroup = level->groups()[groupNo];
+    const char *templName = level->getString(levelGroup.templateName);
+    const int templateId = g_mgr->getTemplateId(templName);
+    if (templateId < 0)
+      return false;
+    if (levelGroup.entitiesCount == 0)
+      continue;
+
+    const EntityTemplate &templ = g_mgr->templates[templateId];
+    const Archetype &type = g_mgr->archetypes[templ.archetypeId];
+
+    Group &group = groups.emplace_back();
+    group.templateId = templateId;
+    group.archetypeId = templ.archetypeId;
+    group.entitiesCount = (int32_t)levelGroup.entitiesCount;
+    group.columns.resize(type.componentsCount);
+
+    // Items of all columns, then the values of the template
+    size_t itemsSize = 0;
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      itemsSize += align_to_cache_line(size_t(type.storages[i].desc->size) * group.entitiesCount);
+      group.dataSize += (size_t)align_offset(type.storages[i].desc->size);
+    }
+    group.dataSize += itemsSize;
+    group.data = (uint8_t*)memory::alloc(memory::Subsystem::kStorage, group.dataSize, memory::CACHE_LINE_SIZE);
+
+    uint8_t *items = group.data;
+    uint8_t *defaultValue = group.data + itemsSize;
+    for (int i = 0; i < type.componentsCount; ++i)
+    {
+      Column &column = group.columns[i];
+      column.desc = type.storages[i].desc;
+      column.items = items;
+      column.defaultValue = defaultValue;
+      items += align_to_cache_line(size_t(column.desc->size) * group.entitiesCount);
+      defaultValue += align_offset(column.desc->size);
+
+      // A copy, the template might be registered again while the level is decoded
+      auto res = templ.cmap.components.find(type.storageNames[i]);
+      ASSERT(res != templ.cmap.components.end());
+      column.desc->ctor(column.defaultValue);
+      column.desc->copy(column.defaultValue, templ.cmap.get(res->second.offset));
+    }
+
+    for (uint32_t c = levelGroup.firstColumn; c < levelGroup.firstColumn + levelGroup.columnsCount; ++c)
+    {
+      const LevelColumn &levelColumn = level->columns()[c];
+      const char *name = level->getString(levelColumn.name);
+      const int compIdx = type.getComponentIndex(HashedString(name));
+      // Like the values of create_entity, the components the template doesn't have are skipped
+      if (compIdx < 0)
+        continue;
+
+      const ComponentDescription *desc = group.columns[compIdx].desc;
+      const bool sideTable = (levelColumn.flags & LevelColumn::kSideTable) != 0;
+      if (desc->typeHash != levelColumn.typeHash || desc->size != levelColumn.itemSize || desc->isTrivial == sideTable || !desc->isSerializable)
+      {
+        ASSERT_FMT(false, "Component '%s' of template '%s' has another type in level '%s'", name, templName, level->path.c_str());
+        continue;
+      }
+
+      group.columns[compIdx].levelColumn = &levelColumn;
+    }
+  }
+
+  return true;
+}
+
+void LevelStaging::decode()
+{
+  for (Group &group : groups)
+    for (Column &column : group.columns)
+    {
+      const ComponentDescription *desc = column.desc;
+      const LevelColumn *levelColumn = column.levelColumn;
+
+      // Trivially copyable, nothing to construct
+      if (levelColumn && (levelColumn->flags & LevelColumn::kSideTable) == 0)
+      {
+        ::memcpy(column.items, level->getColumnData(*levelColumn), (size_t)levelColumn->dataSize);
+        continue;
+      }
+
+      for (int32_t i = 0; i < group.entitiesCount; ++i)
+        if (desc->isTrivial)
+          ::memcpy(column.items + i * desc->size, column.defaultValue, desc->size);
+        else
+        {
+          desc->ctor(column.items + i * desc->size);
+          desc->copy(column.items + i * desc->size, column.defaultValue);
+        }
+
+      if (!levelColumn)
+        continue;
+
+      BinaryInStream in(level->getColumnData(*levelColumn), (size_t)levelColumn->dataSize);
+      for (int32_t i = 0; i < group.entitiesCount; ++i)
+        if (!desc->read(in, column.items + i * desc->size))
+        {
+          if (error.empty())
+            error.sprintf("Component '%s' is broken in level '%s'", level->getString(levelColumn->name), level->path.c_str());
+          break;
+        }
+    }
+
+  decoded = true;
+}
+
+bool LevelWriter::add(const char *templ_name, const ComponentsMap &cmap)
+{
+  eastl::vector<const eastl::pair<const HashedString, ComponentsMap::Value>*> values;
+  values.reserve(cmap.components.size());
+  for (const auto &kv : cmap.components)
+  {
+    if (!kv.second.desc->isSerializable)
+    {
+      DEBUG_LOG("[level]: Component '" << kv.first.str << "' of type '" << kv.second.desc->name << "' can't be stored");
+      return false;
+    }
+    // A new one is assigned on creation
+    if (kv.first.hash != HASH("eid").hash)
+      values.push_back(&kv);
+  }
+
+  eastl::sort(values.begin(), values.end(), [](const auto *lhs, const auto *rhs) { return lhs->first.hash < rhs->first.hash; });
+
+  Group *group = nullptr;
+  for (auto &g : groups)
+  {
+    if (g.templateName != templ_name || g.names.size() != values.size())
+      continue;
+    bool same = true;
+    for (size_t i = 0; i < values.size() && same; ++i)
+      same = g.names[i] == values[i]->first.str && g.descs[i] == values[i]->second.desc;
+    if (same)
+    {
+      group = &g;
+      break;
+    }
+  }
+
+  if (!group)
+  {
+    group = &groups.emplace_back();
+    group->templateName = templ_name;
+    for (const auto *kv : values)
+    {
+      group->names.push_back(kv->first.str);
+      group->descs.push_back(kv->second.desc);
+    }
+    group->columns.resize(values.size());
+  }
+
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    const ComponentDescription *desc = values[i]->second.desc;
+    const uint8_t *value = cmap.get(values[i]->second.offset);
+    if (desc->isTrivial)
+      group->columns[i].write(value, desc->size);
+    else
+      desc->write(group->columns[i], value);
+  }
+
+  ++group->entitiesCount;
+  return true;
+}
+
+bool LevelWriter::write(const char *path) const
+{
+  LevelHeader header;
+  eastl::vector<LevelGroup> levelGroups;
+  eastl::vector<LevelColumn> levelColumns;
+  eastl::vector<char> strings;
+
+  auto addString = [&](const eastl::string &str)
+  {
+    const uint32_t offset = (uint32_t)strings.size();
+    strings.insert(strings.end(), str.c_str(), str.c_str() + str.size() + 1);
+    return offset;
+  };
+
+  for (const auto &g : groups)
+  {
+    LevelGroup &group = levelGroups.emplace_back();
+    group.templateName = addString(g.templateName);
+    group.entitiesCount = (uint32_t)g.entitiesCount;
+    group.firstColumn = (uint32_t)levelColumns.size();
+    group.columnsCount = (uint32_t)g.columns.size();
+
+    for (size_t i = 0; i < g.columns.size(); ++i)
+    {
+      LevelColumn &column = levelColumns.emplace_back();
+      column.name = addString(g.names[i]);
+      column.typeHash = g.descs[i]->typeHash;
+      column.itemSize = g.descs[i]->size;
+      column.flags = g.descs[i]->isTrivial ? LevelColumn::kRaw : LevelColumn::kSideTable;
+      column.dataSize = g.columns[i].size();
+    }
+  }
+
+  header.groupsCount = (uint32_t)levelGroups.size();
+  header.columnsCount = (uint32_t)levelColumns.size();
+  header.stringsOffset = uint32_t(sizeof(LevelHeader) + levelGroups.size() * sizeof(LevelGroup) + levelColumns.size() * sizeof(LevelColumn));
+  header.stringsSize = (uint32_t)strings.size();
+
+  uint64_t offset = header.stringsOffset + header.stringsSize;
+  for (auto &column : levelColumns)
+  {
+    column.dataOffset = align_offset(offset);
+    offset = column.dataOffset + column.dataSize;
+  }
+  header.size = offset;
+
+  FILE *f = ::fopen(path, "wb");
+  if (!f)
+    return false;
+
+  bool res = ::fwrite(&header, sizeof(header), 1, f) == 1;
+  res = res && (levelGroups.empty() || ::fwrite(levelGroups.data(), sizeof(LevelGroup), levelGroups.size(), f) == levelGroups.size());
+  res = res && (levelColumns.empty() || ::fwrite(levelColumns.data(), sizeof(LevelColumn), levelColumns.size(), f) == levelColumns.size());
+  res = res && (strings.empty() || ::fwrite(strings.data(), 1, strings.size(), f) == strings.size());
+
+  const uint8_t padding[COLUMN_ALIGNMENT] = {};
+  uint64_t written = header.stringsOffset + header.stringsSize;
+  int columnIdx = 0;
+  for (const auto &g : groups)
+    for (const auto &data : g.columns)
+    {
+      const LevelColumn &column = levelColumns[columnIdx++];
+      res = res && ::fwrite(padding, 1, size_t(column.dataOffset - written), f) == size_t(column.dataOffset - written);
+      res = res && (data.data.empty() || ::fwrite(data.data.data(), 1, data.size(), f) == data.size());
+      written = column.dataOffset + column.dataSize;
+    }
+
+  ::fclose(f);
+  return res;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <future>
+#include <EASTL/unique_ptr.h>
+
+#include "serialize.h"
+
+// Binary level format, entities are grouped by template and the same set of components.
+// [LevelHeader][LevelGroup x groupsCount][LevelColumn x columnsCount][strings][column data]
+// Trivially copyable components are stored as raw columns and copied as is to archetype storages,
+// others are stored in the side table: a column of values serialized one by one with ComponentSerializer<T>.
+// Values are the ones passed to create_entity, the rest are taken from the template.
+
+struct ComponentDescription;
+struct ComponentsMap;
+
+struct LevelHeader
+{
+  static constexpr uint32_t MAGIC = 0x4C534345; // ECSL
+  static constexpr uint32_t VERSION = 1;
+
+  uint32_t magic = MAGIC;
+  uint32_t version = VERSION;
+
+  uint32_t groupsCount = 0;
+  uint32_t columnsCount = 0;
+
+  uint32_t stringsOffset = 0;
+  uint32_t stringsSize = 0;
+
+  uint64_t size = 0;
+};
+
+struct LevelGroup
+{
+  uint32_t templateName = 0;
+  uint32_t entitiesCount = 0;
+  uint32_t firstColumn = 0;
+  uint32_t columnsCount = 0;
+};
+
+struct LevelColumn
+{
+  enum Flags : uint32_t
+  {
+    kRaw = 0,
+    kSideTable = 1 << 0,
+  };
+
+  uint32_t name = 0;
+  uint32_t typeHash = 0;
+  uint32_t itemSize = 0;
+  uint32_t flags = kRaw;
+
+  uint64_t dataOffset = 0;
+  uint64_t dataSize = 0;
+};
+
+// Memory mapped level file, validated on open
+struct Level
+{
+  eastl::string path;
+
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  Level() = default;
+  ~Level();
+
+  Level(const Level&) = delete;
+  Level& operator=(const Level&) = delete;
+
+  bool open(const char *_path);
+  void close();
+
+  inline const LevelHeader& header() const { return *(const LevelHeader*)data; }
+  inline const LevelGroup* groups() const { return (const LevelGroup*)(data + sizeof(LevelHeader)); }
+  inline const LevelColumn* columns() const { return (const LevelColumn*)(groups() + header().groupsCount); }
+  inline const char* getString(uint32_t offset) const { return (const char*)data + header().stringsOffset + offset; }
+  inline const uint8_t* getColumnData(const LevelColumn &column) const { return data + column.dataOffset; }
+
+private:
+  bool validate() const;
+
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#endif
+};
+
+// Entities of a level decoded to the layout of their archetypes and spliced into them in tick().
+// prepare() runs on the main thread, decode() might run on any thread since it only touches the
+// staging memory, the mapped level and copies of the template values.
+struct LevelStaging
+{
+  struct Column
+  {
+    const ComponentDescription *desc = nullptr;
+    // nullptr if the level doesn't have the component, the value of the template is used
+    const LevelColumn *levelColumn = nullptr;
+    uint8_t *defaultValue = nullptr;
+    uint8_t *items = nullptr;
+  };
+
+  struct Group
+  {
+    int templateId = -1;
+    int archetypeId = -1;
+    int32_t entitiesCount = 0;
+
+    // In the order of the archetype storages
+    eastl::vector<Column> columns;
+
+    uint8_t *data = nullptr;
+    size_t dataSize = 0;
+  };
+
+  eastl::unique_ptr<Level> level;
+  eastl::vector<Group> groups;
+
+  // Set by decode(), read on the main thread once decodeResult is ready
+  bool decoded = false;
+  eastl::string error;
+
+  // Valid if decode() runs in the background
+  std::future<void> decodeResult;
+
+  LevelStaging() = default;
+  ~LevelStaging();
+
+  LevelStaging(const LevelStaging&) = delete;
+  LevelStaging& operator=(const LevelStaging&) = delete;
+
+  bool prepare(eastl::unique_ptr<Level> &&_level);
+  void decode();
+};
+
+struct LevelWriter
+{
+  struct Group
+  {
+    eastl::string templateName;
+    int entitiesCount = 0;
+
+    // Sorted by the hash of the name
+    eastl::vector<eastl::string> names;
+    eastl::vector<const ComponentDescription*> descs;
+    eastl::vector<BinaryOutStream> columns;
+  };
+
+  eastl::vector<Group> groups;
+
+  // The values of create_entity, false if one of them can't be stored
+  bool add(const char *templ_name, const ComponentsMap &cmap);
+  bool write(const char *path) const;
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "query.h"
+
+// Reads a numeric key component as double, exact for all 32-bit integers and floats
+using ordered_key_t = double (*)(const uint8_t *value);
+
+template <typename T>
+inline double ordered_key(const uint8_t *value)
+{
+  return double(*(const T*)value);
+}
+
+// Entities sorted by a numeric key component, for ranges and top-k.
+// Only archetypes with changed keys are re-sorted and merged back on update.
+struct OrderedIndex
+{
+  struct Row
+  {
+    double key;
+    int32_t archetypeId;
+    int32_t entityIndex;
+
+    inline bool operator<(const Row &rhs) const
+    {
+      if (key != rhs.key)
+        return key < rhs.key;
+      if (archetypeId != rhs.archetypeId)
+        return archetypeId < rhs.archetypeId;
+      return entityIndex < rhs.entityIndex;
+    }
+  };
+
+  HashedString name;
+  HashedString componentName;
+  ordered_key_t getKey = nullptr;
+
+  QueryDescription desc;
+
+  // Sorted by key, then by archetype and entity
+  eastl::vector<Row, memory::IndexAllocator> rows;
+  // Sum of change versions of the columns the index depends on per archetype
+  eastl::vector<uint32_t, memory::IndexAllocator> versions;
+
+  // Columns of desc.components per archetype, a row is the entity at entityIndex in them
+  int componentsCount = 0;
+  eastl::vector<uint8_t * __restrict, memory::IndexAllocator> columns;
+
+  // First row with the key inside the range
+  inline int rangeBegin(const OrderedRange &range) const
+  {
+    return int(eastl::lower_bound(rows.begin(), rows.end(), range, [](const Row &row, const OrderedRange &r)
+    {
+      return r.minInclusive ? row.key < r.min : row.key <= r.min;
+    }) - rows.begin());
+  }
+
+  // Row after the last one with the key inside the range
+  inline int rangeEnd(const OrderedRange &range) const
+  {
+    return int(eastl::lower_bound(rows.begin(), rows.end(), range, [](const Row &row, const OrderedRange &r)
+    {
+      return r.maxInclusive ? row.key <= r.max : row.key < r.max;
+    }) - rows.begin());
+  }
+
+  inline int count(const OrderedRange &range) const
+  {
+    return eastl::max(rangeEnd(range) - rangeBegin(range), 0);
+  }
+
+  inline QueryIterator iterator(const Row &row)
+  {
+    QueryIterator iter(columns.data() + row.archetypeId * componentsCount, 1, nullptr, componentsCount);
+    iter.idx = row.entityIndex;
+    return iter;
+  }
+
+  // Calls callback(QueryIterator&) for every entity with the key inside the range in ascending order
+  template <typename Callable>
+  inline void forEachInRange(const OrderedRange &range, Callable &&callback)
+  {
+    for (int i = rangeBegin(range), end = rangeEnd(range); i < end; ++i)
+    {
+      QueryIterator iter = iterator(rows[i]);
+      callback(iter);
+    }
+  }
+
+  // Calls callback(QueryIterator&) for count entities with the smallest keys in ascending order
+  template <typename Callable>
+  inline void forEachFirst(int count, Callable &&callback)
+  {
+    for (int i = 0, end = eastl::min(count, (int)rows.size()); i < end; ++i)
+    {
+      QueryIterator iter = iterator(rows[i]);
+      callback(iter);
+    }
+  }
+
+  // Calls callback(QueryIterator&) for count entities with the largest keys in descending order
+  template <typename Callable>
+  inline void forEachLast(int count, Callable &&callback)
+  {
+    for (int i = (int)rows.size() - 1, end = eastl::max((int)rows.size() - count, 0); i >= end; --i)
+    {
+      QueryIterator iter = iterator(rows[i]);
+      callback(iter);
+    }
+  }
+
+  void clear();
+};
+
+struct OrderedIndexDescription
+{
+  ConstHashedString name;
+  ConstHashedString componentName;
+  ordered_key_t getKey;
+  ConstQueryDescription desc;
+
+  filter_t filter;
+
+  static const OrderedIndexDescription *head;
+  static int count;
+
+  const OrderedIndexDescription *next = nullptr;
+
+  OrderedIndexDescription(const ConstHashedString &name, const ConstHashedString &component_name, ordered_key_t get_key, const ConstQueryDescription &desc, filter_t &&f = nullptr);
+};
+
+// A QL_WHERE range over a component, the query is served by an ordered index of the component if there is one
+struct OrderedQueryPlan
+{
+  ConstHashedString queryName;
+  ConstHashedString componentName;
+  OrderedRange range;
+
+  static const OrderedQueryPlan *head;
+  static int count;
+
+  const OrderedQueryPlan *next = nullptr;
+
+  OrderedQueryPlan(const ConstHashedString &query_name, const ConstHashedString &component_name, const OrderedRange &range);
+};
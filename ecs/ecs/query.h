@@ -2,12 +2,22 @@
 
 #include "entity.h"
 #include "hash.h"
+#include "allocator.h"
+#include "layout.h"
+#include "debug.h"
 
 #include <EASTL/functional.h>
 #include <EASTL/unique_ptr.h>
 
+#include <math.h>
+
 struct Archetype;
 
+// Integral, enum and EntityId values are hashed and compared as raw memory by joins and indices, both agree with operator== for them.
+// Floats (-0.f and 0.f, NaN) and structs with padding don't.
+template <typename Key>
+struct is_hash_join_key : eastl::integral_constant<bool, eastl::is_integral<Key>::value || eastl::is_enum<Key>::value || eastl::is_same<Key, EntityId>::value> {};
+
 template <typename T>
 struct ConstArray
 {
@@ -91,18 +101,57 @@ struct Component
   HashedString name;
   uint32_t size;
   const ComponentDescription* desc;
+  uint32_t flags = ComponentDescriptionFlags::kNone;
 
   Component& operator=(const ConstComponentDescription &d)
   {
     desc = nullptr;
     name = d.name;
     size = d.size;
+    flags = d.flags;
     return *this;
   }
 };
 
 using filter_t = eastl::function<bool(const Archetype&, int)>;
 
+// Keys of an OrderedIndex between min and max, comparisons of QL_WHERE are turned into it
+struct OrderedRange
+{
+  double min = -HUGE_VAL;
+  double max = HUGE_VAL;
+  bool minInclusive = true;
+  bool maxInclusive = true;
+
+  static inline OrderedRange less(double v) { OrderedRange r; r.max = v; r.maxInclusive = false; return r; }
+  static inline OrderedRange lessEqual(double v) { OrderedRange r; r.max = v; return r; }
+  static inline OrderedRange greater(double v) { OrderedRange r; r.min = v; r.minInclusive = false; return r; }
+  static inline OrderedRange greaterEqual(double v) { OrderedRange r; r.min = v; return r; }
+  static inline OrderedRange equal(double v) { OrderedRange r; r.min = v; r.max = v; return r; }
+
+  // Intersection
+  inline OrderedRange operator&(const OrderedRange &rhs) const
+  {
+    OrderedRange r = *this;
+    if (rhs.min > r.min || (rhs.min == r.min && !rhs.minInclusive))
+    {
+      r.min = rhs.min;
+      r.minInclusive = rhs.minInclusive;
+    }
+    if (rhs.max < r.max || (rhs.max == r.max && !rhs.maxInclusive))
+    {
+      r.max = rhs.max;
+      r.maxInclusive = rhs.maxInclusive;
+    }
+    return r;
+  }
+
+  inline bool contains(double key) const
+  {
+    return (minInclusive ? key >= min : key > min) && (maxInclusive ? key <= max : key < max);
+  }
+};
+
 struct PersistentQueryDescription
 {
   ConstHashedString name;
@@ -120,6 +169,21 @@ struct PersistentQueryDescription
   PersistentQueryDescription(const ConstHashedString &name, const ConstQueryDescription &desc, filter_t &&f = nullptr);
 };
 
+// ECS_LAZY_QUERY, the result is cached by the address of desc
+struct LazyQueryDescription
+{
+  const ConstQueryDescription &desc;
+
+  filter_t filter;
+
+  static const LazyQueryDescription *head;
+  static int count;
+
+  const LazyQueryDescription *next = nullptr;
+
+  LazyQueryDescription(const ConstQueryDescription &desc, filter_t &&f = nullptr);
+};
+
 struct QueryDescription
 {
   eastl::vector<Component> components;
@@ -131,6 +195,10 @@ struct QueryDescription
 
   filter_t filter;
 
+  // Candidates come from the range of this ordered index instead of a scan, the filter is still applied
+  int orderedIndex = -1;
+  OrderedRange orderedRange;
+
   void reset()
   {
     components.clear();
@@ -138,6 +206,8 @@ struct QueryDescription
     notHaveComponents.clear();
     archetypes.clear();
     filter = nullptr;
+    orderedIndex = -1;
+    orderedRange = OrderedRange();
   }
 
   QueryDescription() = default;
@@ -255,18 +325,19 @@ struct QueryIterator
     }
   }
 
+  // T& or SoAValue<T> for SoA components
   template<typename T>
-  inline T& get(int comp_idx)
+  inline typename ComponentAccess<T>::Ref get(int comp_idx)
   {
     uint8_t **chunk = curChunk + comp_idx;
-    return ((T*)*chunk)[idx];
+    return ComponentAccess<T>::get(*chunk, idx);
   }
 
   template<typename T>
-  inline T& get(int comp_idx) const
+  inline typename ComponentAccess<T>::Ref get(int comp_idx) const
   {
     uint8_t **chunk = curChunk + comp_idx;
-    return ((T*)*chunk)[idx];
+    return ComponentAccess<T>::get(*chunk, idx);
   }
 
   inline QueryIterator operator*()
@@ -287,9 +358,10 @@ struct QueryIterator
   inline void advance(int offset)
   {
     idx += offset;
-    while (idx >= entitiesInChunk[chunkIdx] && chunkIdx < chunksCount) {
+    while (chunkIdx < chunksCount && idx >= entitiesInChunk[chunkIdx]) {
       idx -= entitiesInChunk[chunkIdx];
       ++chunkIdx;
+      curChunk += componentsCount;
     }
   }
 
@@ -359,6 +431,7 @@ struct Query
     template<typename T>
     inline T& __restrict get(int32_t component_index, int32_t index_in_chunk)
     {
+      static_assert(!ComponentLayout<T>::soa, "SoA components can't be accessed by reference");
       return *(((T * __restrict)chunks[component_index]) + index_in_chunk);
     }
   };
@@ -366,6 +439,8 @@ struct Query
   template <typename T>
   struct TypedIterator
   {
+    static_assert(!ComponentLayout<T>::soa, "SoA components can't be accessed by reference");
+
     using Self = TypedIterator<T>;
 
     int idx = 0;
@@ -450,24 +525,30 @@ struct Query
     return QueryIterator(nullptr, -1, nullptr, -1, chunksCount);
   }
 
+  // Index of the chunk that contains the entity with the given offset, O(log(chunksCount))
+  inline int findChunk(int offset) const
+  {
+    ASSERT(chunksCount > 0 && offset >= 0 && offset < entitiesCount);
+    return int(eastl::upper_bound(chunkOffsets.begin(), chunkOffsets.end(), offset) - chunkOffsets.begin()) - 1;
+  }
+
   inline QueryIterator begin(int offset)
   {
+    if (offset >= entitiesCount)
+      return end();
     auto iter = QueryIterator(chunks.data(), chunksCount, entitiesInChunk.data(), componentsCount);
-    iter.advance(offset);
+    iter.chunkIdx = findChunk(offset);
+    iter.idx = offset - chunkOffsets[iter.chunkIdx];
+    iter.curChunk += iter.chunkIdx * componentsCount;
     return iter;
   }
 
   inline ChunkIterator beginChunk(int offset)
   {
-    uint8_t * __restrict * __restrict chunksData = chunks.data();
-    int * __restrict entitiesInChunkData = entitiesInChunk.data();
-    int * __restrict entitiesInChunkDataEnd = entitiesInChunk.data() + chunksCount;
-    while (offset >= *entitiesInChunkData && entitiesInChunkData != entitiesInChunkDataEnd) {
-      offset -= *entitiesInChunkData;
-      ++entitiesInChunkData;
-      chunksData += componentsCount;
-    }
-    return ChunkIterator(chunksData, entitiesInChunkData, componentsCount, offset);
+    if (offset >= entitiesCount)
+      return endChunk();
+    const int chunkIdx = findChunk(offset);
+    return ChunkIterator(chunks.data() + chunkIdx * componentsCount, entitiesInChunk.data() + chunkIdx, componentsCount, offset - chunkOffsets[chunkIdx]);
   }
 
   inline ChunkIterator beginChunk()
@@ -480,7 +561,43 @@ struct Query
     return ChunkIterator(chunks.data() + chunksCount * componentsCount, entitiesInChunk.data(), componentsCount);
   }
 
+  // Calls callback(columns, begin, count) for every chunk piece of the range [offset, offset + count)
+  // of entities that starts in the chunk chunk_idx
+  template <typename Callable>
+  inline void forEachChunk(int chunk_idx, int offset, int count, Callable &&callback)
+  {
+    uint8_t * __restrict * __restrict chunksData = chunks.data() + chunk_idx * componentsCount;
+    for (; count > 0 && chunk_idx < chunksCount; ++chunk_idx, chunksData += componentsCount)
+    {
+      const int n = eastl::min(entitiesInChunk[chunk_idx] - offset, count);
+      callback(chunksData, offset, n);
+      count -= n;
+      offset = 0;
+    }
+  }
+
+  template <typename Callable>
+  inline void forEachChunk(int from, int count, Callable &&callback)
+  {
+    if (count <= 0 || from >= entitiesCount)
+      return;
+    const int chunkIdx = findChunk(from);
+    forEachChunk(chunkIdx, from - chunkOffsets[chunkIdx], count, eastl::forward<Callable>(callback));
+  }
+
+  struct Task
+  {
+    int chunkIdx = 0;
+    int offset = 0;
+    int count = 0;
+  };
+
+  // Splits the query into tasks on chunk boundaries. Small chunks are merged up to chunk_size entities,
+  // only chunks larger than chunk_size are split.
+  void splitToTasks(int chunk_size, eastl::vector<Task> &tasks) const;
+
   void addChunks(const QueryDescription &in_desc, Archetype &type, int begin, int entities_count);
+  void addChunk(const QueryDescription &in_desc, Archetype &type, int begin, int entities_count);
 
   void reset()
   {
@@ -489,6 +606,7 @@ struct Query
     chunksCount = 0;
     entitiesCount = 0;
     entitiesInChunk.clear();
+    chunkOffsets.clear();
     chunks.clear();
     userData.reset();
   }
@@ -507,8 +625,9 @@ struct Query
   int componentsCount = 0;
   int chunksCount = 0;
   int entitiesCount = 0;
-  eastl::vector<int> entitiesInChunk;
-  eastl::vector<uint8_t * __restrict> chunks;
+  eastl::vector<int, memory::QueryAllocator> entitiesInChunk;
+  eastl::vector<int, memory::QueryAllocator> chunkOffsets;
+  eastl::vector<uint8_t * __restrict, memory::QueryAllocator> chunks;
 
   eastl::unique_ptr<QueryUserData> userData;
 };
@@ -526,7 +645,8 @@ struct StructBuilder
   template <typename T>
   struct helper
   {
-    static inline typename T::Type& get(const QueryIterator &iter)
+    // SoA components are copied, codegen checks they are not bound to reference fields
+    static inline typename ComponentAccess<typename T::Type>::Ref get(const QueryIterator &iter)
     {
       return iter.get<typename T::Type>(T::index);
     }
@@ -551,7 +671,7 @@ struct QueryIterable
   {
   }
 
-  QueryIterable(QueryIterator _first, QueryIterator _last) : first(_first), last(_last)
+  QueryIterable(QueryIterator _first, QueryIterator _last, int entities_count = -1) : first(_first), last(_last), entitiesCount(entities_count)
   {
   }
 
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+#include <EASTL/type_traits.h>
+
+struct BinaryOutStream
+{
+  eastl::vector<uint8_t> data;
+
+  inline void write(const void *src, size_t sz)
+  {
+    const size_t offset = data.size();
+    data.resize(offset + sz);
+    ::memcpy(data.data() + offset, src, sz);
+  }
+
+  template <typename T>
+  inline void write(const T &val)
+  {
+    static_assert(eastl::is_trivially_copyable<T>::value, "Only trivially copyable values are written as is");
+    write(&val, sizeof(T));
+  }
+
+  inline size_t size() const { return data.size(); }
+};
+
+// Reads from memory it doesn't own, every read is checked against the end
+struct BinaryInStream
+{
+  const uint8_t *cur = nullptr;
+  const uint8_t *end = nullptr;
+
+  BinaryInStream() = default;
+  BinaryInStream(const uint8_t *data, size_t size) : cur(data), end(data + size) {}
+
+  inline bool read(void *dst, size_t sz)
+  {
+    if (size_t(end - cur) < sz)
+      return false;
+    ::memcpy(dst, cur, sz);
+    cur += sz;
+    return true;
+  }
+
+  template <typename T>
+  inline bool read(T &val)
+  {
+    static_assert(eastl::is_trivially_copyable<T>::value, "Only trivially copyable values are read as is");
+    return read(&val, sizeof(T));
+  }
+
+  inline bool empty() const { return cur == end; }
+};
+
+// Non-trivially copyable components are stored in the side table of a level (see level.h)
+// only if the serializer is specialized:
+// template <> struct ComponentSerializer<MyComp>
+// {
+//   static constexpr bool defined = true;
+//   static void write(BinaryOutStream &out, const MyComp &val);
+//   static bool read(BinaryInStream &in, MyComp &val);
+// };
+template <typename T>
+struct ComponentSerializer
+{
+  static constexpr bool defined = false;
+  static void write(BinaryOutStream &, const T &) {}
+  static bool read(BinaryInStream &, T &) { return false; }
+};
@@ -0,0 +1,600 @@
+#include "simd.h"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET(x)
+#else
+#include <cpuid.h>
+#define SIMD_TARGET(x) __attribute__((target(x)))
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+using vec2_span = Span<glm::vec2>;
+using const_vec2_span = Span<const glm::vec2>;
+using const_float_span = Span<const float>;
+
+struct Ops
+{
+  void (*madd)(vec2_span dst, const_vec2_span src, float scale);
+  void (*maddSpan)(vec2_span dst, const_vec2_span src, const_float_span scale);
+  void (*mul)(vec2_span v, const_float_span scale);
+  void (*normalize)(vec2_span v);
+  void (*setLength)(vec2_span v, const_float_span length);
+
+  // Lane versions process one field of consecutive entities, madd and mul are called for x and y
+  void (*maddLane)(float *d, const float *s, float scale, int count);
+  void (*maddSpanLane)(float *d, const float *s, const float *scale, int count);
+  void (*mulLane)(float *d, const float *scale, int count);
+  void (*setLengthLanes)(float *x, float *y, const float *length, int count);
+};
+
+// Scalar versions also process tails of the vector ones
+
+static void madd_scalar(glm::vec2 *dst, const glm::vec2 *src, float scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    dst[i] += src[i] * scale;
+}
+
+static void madd_span_scalar(glm::vec2 *dst, const glm::vec2 *src, const float *scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    dst[i] += src[i] * scale[i];
+}
+
+static void mul_scalar(glm::vec2 *v, const float *scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    v[i] *= scale[i];
+}
+
+static void set_length_scalar(glm::vec2 *v, const float *length, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+  {
+    const float len2 = v[i].x * v[i].x + v[i].y * v[i].y;
+    v[i] = len2 > 0.f ? v[i] * ((length ? length[i] : 1.f) / ::sqrtf(len2)) : glm::vec2(0.f, 0.f);
+  }
+}
+
+static void madd_lane_scalar(float *d, const float *s, float scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    d[i] += s[i] * scale;
+}
+
+static void madd_span_lane_scalar(float *d, const float *s, const float *scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    d[i] += s[i] * scale[i];
+}
+
+static void mul_lane_scalar(float *d, const float *scale, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+    d[i] *= scale[i];
+}
+
+static void set_length_lanes_scalar(float *x, float *y, const float *length, int from, int count)
+{
+  for (int i = from; i < count; ++i)
+  {
+    const float len2 = x[i] * x[i] + y[i] * y[i];
+    const float k = len2 > 0.f ? (length ? length[i] : 1.f) / ::sqrtf(len2) : 0.f;
+    x[i] *= k;
+    y[i] *= k;
+  }
+}
+
+static const Ops g_scalar_ops = {
+  [](vec2_span dst, const_vec2_span src, float scale) { madd_scalar(dst.data, src.data, scale, 0, dst.count); },
+  [](vec2_span dst, const_vec2_span src, const_float_span scale) { madd_span_scalar(dst.data, src.data, scale.data, 0, dst.count); },
+  [](vec2_span v, const_float_span scale) { mul_scalar(v.data, scale.data, 0, v.count); },
+  [](vec2_span v) { set_length_scalar(v.data, nullptr, 0, v.count); },
+  [](vec2_span v, const_float_span length) { set_length_scalar(v.data, length.data, 0, v.count); },
+  [](float *d, const float *s, float scale, int count) { madd_lane_scalar(d, s, scale, 0, count); },
+  [](float *d, const float *s, const float *scale, int count) { madd_span_lane_scalar(d, s, scale, 0, count); },
+  [](float *d, const float *scale, int count) { mul_lane_scalar(d, scale, 0, count); },
+  [](float *x, float *y, const float *length, int count) { set_length_lanes_scalar(x, y, length, 0, count); },
+};
+
+#if SIMD_X86
+
+// SSE4: 2 vectors per register
+
+SIMD_TARGET("sse4.1") static void madd_sse4(vec2_span dst, const_vec2_span src, float scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  const __m128 k = _mm_set1_ps(scale);
+  int i = 0;
+  for (; i + 2 <= dst.count; i += 2)
+    _mm_storeu_ps(d + i * 2, _mm_add_ps(_mm_loadu_ps(d + i * 2), _mm_mul_ps(_mm_loadu_ps(s + i * 2), k)));
+  madd_scalar(dst.data, src.data, scale, i, dst.count);
+}
+
+// [s0 s1] -> [s0 s0 s1 s1]
+SIMD_TARGET("sse4.1") static inline __m128 load_pairs_sse4(const float *s)
+{
+  const __m128 x = _mm_castpd_ps(_mm_load_sd((const double*)s));
+  return _mm_unpacklo_ps(x, x);
+}
+
+SIMD_TARGET("sse4.1") static void madd_span_sse4(vec2_span dst, const_vec2_span src, const_float_span scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  int i = 0;
+  for (; i + 2 <= dst.count; i += 2)
+    _mm_storeu_ps(d + i * 2, _mm_add_ps(_mm_loadu_ps(d + i * 2), _mm_mul_ps(_mm_loadu_ps(s + i * 2), load_pairs_sse4(scale.data + i))));
+  madd_span_scalar(dst.data, src.data, scale.data, i, dst.count);
+}
+
+SIMD_TARGET("sse4.1") static void mul_sse4(vec2_span v, const_float_span scale)
+{
+  float *d = (float*)v.data;
+  int i = 0;
+  for (; i + 2 <= v.count; i += 2)
+    _mm_storeu_ps(d + i * 2, _mm_mul_ps(_mm_loadu_ps(d + i * 2), load_pairs_sse4(scale.data + i)));
+  mul_scalar(v.data, scale.data, i, v.count);
+}
+
+SIMD_TARGET("sse4.1") static void set_length_sse4(vec2_span v, const float *length)
+{
+  float *d = (float*)v.data;
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  int i = 0;
+  for (; i + 2 <= v.count; i += 2)
+  {
+    const __m128 x = _mm_loadu_ps(d + i * 2);
+    const __m128 sq = _mm_mul_ps(x, x);
+    const __m128 len2 = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    const __m128 k = _mm_div_ps(length ? load_pairs_sse4(length + i) : one, _mm_sqrt_ps(len2));
+    _mm_storeu_ps(d + i * 2, _mm_and_ps(_mm_mul_ps(x, k), _mm_cmpgt_ps(len2, zero)));
+  }
+  set_length_scalar(v.data, length, i, v.count);
+}
+
+// SSE4 lanes: 4 entities per register
+
+SIMD_TARGET("sse4.1") static void madd_lane_sse4(float *d, const float *s, float scale, int count)
+{
+  const __m128 k = _mm_set1_ps(scale);
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(_mm_loadu_ps(s + i), k)));
+  madd_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("sse4.1") static void madd_span_lane_sse4(float *d, const float *s, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(_mm_loadu_ps(s + i), _mm_loadu_ps(scale + i))));
+  madd_span_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("sse4.1") static void mul_lane_sse4(float *d, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(d + i), _mm_loadu_ps(scale + i)));
+  mul_lane_scalar(d, scale, i, count);
+}
+
+SIMD_TARGET("sse4.1") static void set_length_lanes_sse4(float *x, float *y, const float *length, int count)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 vx = _mm_loadu_ps(x + i);
+    const __m128 vy = _mm_loadu_ps(y + i);
+    const __m128 len2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+    const __m128 k = _mm_and_ps(_mm_div_ps(length ? _mm_loadu_ps(length + i) : one, _mm_sqrt_ps(len2)), _mm_cmpgt_ps(len2, zero));
+    _mm_storeu_ps(x + i, _mm_mul_ps(vx, k));
+    _mm_storeu_ps(y + i, _mm_mul_ps(vy, k));
+  }
+  set_length_lanes_scalar(x, y, length, i, count);
+}
+
+static const Ops g_sse4_ops = {
+  madd_sse4,
+  madd_span_sse4,
+  mul_sse4,
+  [](vec2_span v) { set_length_sse4(v, nullptr); },
+  [](vec2_span v, const_float_span length) { set_length_sse4(v, length.data); },
+  madd_lane_sse4,
+  madd_span_lane_sse4,
+  mul_lane_sse4,
+  set_length_lanes_sse4,
+};
+
+// AVX2: 4 vectors per register
+
+SIMD_TARGET("avx2,fma") static void madd_avx2(vec2_span dst, const_vec2_span src, float scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  const __m256 k = _mm256_set1_ps(scale);
+  int i = 0;
+  for (; i + 4 <= dst.count; i += 4)
+    _mm256_storeu_ps(d + i * 2, _mm256_fmadd_ps(_mm256_loadu_ps(s + i * 2), k, _mm256_loadu_ps(d + i * 2)));
+  madd_scalar(dst.data, src.data, scale, i, dst.count);
+}
+
+// [s0 s1 s2 s3] -> [s0 s0 s1 s1 s2 s2 s3 s3]
+SIMD_TARGET("avx2,fma") static inline __m256 load_pairs_avx2(const float *s)
+{
+  const __m256i idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+  return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(s)), idx);
+}
+
+SIMD_TARGET("avx2,fma") static void madd_span_avx2(vec2_span dst, const_vec2_span src, const_float_span scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  int i = 0;
+  for (; i + 4 <= dst.count; i += 4)
+    _mm256_storeu_ps(d + i * 2, _mm256_fmadd_ps(_mm256_loadu_ps(s + i * 2), load_pairs_avx2(scale.data + i), _mm256_loadu_ps(d + i * 2)));
+  madd_span_scalar(dst.data, src.data, scale.data, i, dst.count);
+}
+
+SIMD_TARGET("avx2,fma") static void mul_avx2(vec2_span v, const_float_span scale)
+{
+  float *d = (float*)v.data;
+  int i = 0;
+  for (; i + 4 <= v.count; i += 4)
+    _mm256_storeu_ps(d + i * 2, _mm256_mul_ps(_mm256_loadu_ps(d + i * 2), load_pairs_avx2(scale.data + i)));
+  mul_scalar(v.data, scale.data, i, v.count);
+}
+
+SIMD_TARGET("avx2,fma") static void set_length_avx2(vec2_span v, const float *length)
+{
+  float *d = (float*)v.data;
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  int i = 0;
+  for (; i + 4 <= v.count; i += 4)
+  {
+    const __m256 x = _mm256_loadu_ps(d + i * 2);
+    const __m256 sq = _mm256_mul_ps(x, x);
+    const __m256 len2 = _mm256_add_ps(sq, _mm256_permute_ps(sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    const __m256 k = _mm256_div_ps(length ? load_pairs_avx2(length + i) : one, _mm256_sqrt_ps(len2));
+    _mm256_storeu_ps(d + i * 2, _mm256_and_ps(_mm256_mul_ps(x, k), _mm256_cmp_ps(len2, zero, _CMP_GT_OQ)));
+  }
+  set_length_scalar(v.data, length, i, v.count);
+}
+
+// AVX2 lanes: 8 entities per register
+
+SIMD_TARGET("avx2,fma") static void madd_lane_avx2(float *d, const float *s, float scale, int count)
+{
+  const __m256 k = _mm256_set1_ps(scale);
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(d + i, _mm256_fmadd_ps(_mm256_loadu_ps(s + i), k, _mm256_loadu_ps(d + i)));
+  madd_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("avx2,fma") static void madd_span_lane_avx2(float *d, const float *s, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(d + i, _mm256_fmadd_ps(_mm256_loadu_ps(s + i), _mm256_loadu_ps(scale + i), _mm256_loadu_ps(d + i)));
+  madd_span_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("avx2,fma") static void mul_lane_avx2(float *d, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(scale + i)));
+  mul_lane_scalar(d, scale, i, count);
+}
+
+SIMD_TARGET("avx2,fma") static void set_length_lanes_avx2(float *x, float *y, const float *length, int count)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m256 vx = _mm256_loadu_ps(x + i);
+    const __m256 vy = _mm256_loadu_ps(y + i);
+    const __m256 len2 = _mm256_fmadd_ps(vx, vx, _mm256_mul_ps(vy, vy));
+    const __m256 k = _mm256_and_ps(_mm256_div_ps(length ? _mm256_loadu_ps(length + i) : one, _mm256_sqrt_ps(len2)), _mm256_cmp_ps(len2, zero, _CMP_GT_OQ));
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(vx, k));
+    _mm256_storeu_ps(y + i, _mm256_mul_ps(vy, k));
+  }
+  set_length_lanes_scalar(x, y, length, i, count);
+}
+
+static const Ops g_avx2_ops = {
+  madd_avx2,
+  madd_span_avx2,
+  mul_avx2,
+  [](vec2_span v) { set_length_avx2(v, nullptr); },
+  [](vec2_span v, const_float_span length) { set_length_avx2(v, length.data); },
+  madd_lane_avx2,
+  madd_span_lane_avx2,
+  mul_lane_avx2,
+  set_length_lanes_avx2,
+};
+
+// AVX-512: 8 vectors per register
+
+SIMD_TARGET("avx512f") static void madd_avx512(vec2_span dst, const_vec2_span src, float scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  const __m512 k = _mm512_set1_ps(scale);
+  int i = 0;
+  for (; i + 8 <= dst.count; i += 8)
+    _mm512_storeu_ps(d + i * 2, _mm512_fmadd_ps(_mm512_loadu_ps(s + i * 2), k, _mm512_loadu_ps(d + i * 2)));
+  madd_scalar(dst.data, src.data, scale, i, dst.count);
+}
+
+// [s0 .. s7] -> [s0 s0 .. s7 s7]
+SIMD_TARGET("avx512f") static inline __m512 load_pairs_avx512(const float *s)
+{
+  const __m512i idx = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+  return _mm512_permutexvar_ps(idx, _mm512_castps256_ps512(_mm256_loadu_ps(s)));
+}
+
+SIMD_TARGET("avx512f") static void madd_span_avx512(vec2_span dst, const_vec2_span src, const_float_span scale)
+{
+  float *d = (float*)dst.data;
+  const float *s = (const float*)src.data;
+  int i = 0;
+  for (; i + 8 <= dst.count; i += 8)
+    _mm512_storeu_ps(d + i * 2, _mm512_fmadd_ps(_mm512_loadu_ps(s + i * 2), load_pairs_avx512(scale.data + i), _mm512_loadu_ps(d + i * 2)));
+  madd_span_scalar(dst.data, src.data, scale.data, i, dst.count);
+}
+
+SIMD_TARGET("avx512f") static void mul_avx512(vec2_span v, const_float_span scale)
+{
+  float *d = (float*)v.data;
+  int i = 0;
+  for (; i + 8 <= v.count; i += 8)
+    _mm512_storeu_ps(d + i * 2, _mm512_mul_ps(_mm512_loadu_ps(d + i * 2), load_pairs_avx512(scale.data + i)));
+  mul_scalar(v.data, scale.data, i, v.count);
+}
+
+SIMD_TARGET("avx512f") static void set_length_avx512(vec2_span v, const float *length)
+{
+  float *d = (float*)v.data;
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 one = _mm512_set1_ps(1.f);
+  int i = 0;
+  for (; i + 8 <= v.count; i += 8)
+  {
+    const __m512 x = _mm512_loadu_ps(d + i * 2);
+    const __m512 sq = _mm512_mul_ps(x, x);
+    const __m512 len2 = _mm512_add_ps(sq, _mm512_permute_ps(sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    const __m512 k = _mm512_div_ps(length ? load_pairs_avx512(length + i) : one, _mm512_sqrt_ps(len2));
+    _mm512_storeu_ps(d + i * 2, _mm512_maskz_mul_ps(_mm512_cmp_ps_mask(len2, zero, _CMP_GT_OQ), x, k));
+  }
+  set_length_scalar(v.data, length, i, v.count);
+}
+
+// AVX-512 lanes: 16 entities per register
+
+SIMD_TARGET("avx512f") static void madd_lane_avx512(float *d, const float *s, float scale, int count)
+{
+  const __m512 k = _mm512_set1_ps(scale);
+  int i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(d + i, _mm512_fmadd_ps(_mm512_loadu_ps(s + i), k, _mm512_loadu_ps(d + i)));
+  madd_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("avx512f") static void madd_span_lane_avx512(float *d, const float *s, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(d + i, _mm512_fmadd_ps(_mm512_loadu_ps(s + i), _mm512_loadu_ps(scale + i), _mm512_loadu_ps(d + i)));
+  madd_span_lane_scalar(d, s, scale, i, count);
+}
+
+SIMD_TARGET("avx512f") static void mul_lane_avx512(float *d, const float *scale, int count)
+{
+  int i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(d + i, _mm512_mul_ps(_mm512_loadu_ps(d + i), _mm512_loadu_ps(scale + i)));
+  mul_lane_scalar(d, scale, i, count);
+}
+
+SIMD_TARGET("avx512f") static void set_length_lanes_avx512(float *x, float *y, const float *length, int count)
+{
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 one = _mm512_set1_ps(1.f);
+  int i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    const __m512 vx = _mm512_loadu_ps(x + i);
+    const __m512 vy = _mm512_loadu_ps(y + i);
+    const __m512 len2 = _mm512_fmadd_ps(vx, vx, _mm512_mul_ps(vy, vy));
+    const __mmask16 nonZero = _mm512_cmp_ps_mask(len2, zero, _CMP_GT_OQ);
+    const __m512 k = _mm512_div_ps(length ? _mm512_loadu_ps(length + i) : one, _mm512_sqrt_ps(len2));
+    _mm512_storeu_ps(x + i, _mm512_maskz_mul_ps(nonZero, vx, k));
+    _mm512_storeu_ps(y + i, _mm512_maskz_mul_ps(nonZero, vy, k));
+  }
+  set_length_lanes_scalar(x, y, length, i, count);
+}
+
+static const Ops g_avx512_ops = {
+  madd_avx512,
+  madd_span_avx512,
+  mul_avx512,
+  [](vec2_span v) { set_length_avx512(v, nullptr); },
+  [](vec2_span v, const_float_span length) { set_length_avx512(v, length.data); },
+  madd_lane_avx512,
+  madd_span_lane_avx512,
+  mul_lane_avx512,
+  set_length_lanes_avx512,
+};
+
+static void cpuid(int info[4], int leaf, int subleaf)
+{
+#ifdef _MSC_VER
+  __cpuidex(info, leaf, subleaf);
+#else
+  __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static uint64_t xgetbv0()
+{
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static simd::Level detect_cpu_level()
+{
+  int info[4];
+  cpuid(info, 0, 0);
+  const int maxLeaf = info[0];
+
+  cpuid(info, 1, 0);
+  const bool sse41 = (info[2] & (1 << 19)) != 0;
+  const bool fma = (info[2] & (1 << 12)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+
+  if (!sse41)
+    return simd::Level::kScalar;
+
+  // The OS must save YMM/ZMM registers
+  const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+  if (!avx || !fma || (xcr0 & 0x6) != 0x6 || maxLeaf < 7)
+    return simd::Level::kSSE4;
+
+  cpuid(info, 7, 0);
+  const bool avx2 = (info[1] & (1 << 5)) != 0;
+  const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+  if (avx512f && avx2 && (xcr0 & 0xE6) == 0xE6)
+    return simd::Level::kAVX512;
+  return avx2 ? simd::Level::kAVX2 : simd::Level::kSSE4;
+}
+
+#else
+
+static simd::Level detect_cpu_level()
+{
+  return simd::Level::kScalar;
+}
+
+#endif
+
+static const Ops* get_level_ops(simd::Level level)
+{
+  switch (level)
+  {
+#if SIMD_X86
+    case simd::Level::kSSE4: return &g_sse4_ops;
+    case simd::Level::kAVX2: return &g_avx2_ops;
+    case simd::Level::kAVX512: return &g_avx512_ops;
+#endif
+    default: return &g_scalar_ops;
+  }
+}
+
+static const simd::Level g_cpu_level = detect_cpu_level();
+static simd::Level g_level = g_cpu_level;
+static const Ops *g_ops = get_level_ops(g_cpu_level);
+
+simd::Level simd::get_cpu_level()
+{
+  return g_cpu_level;
+}
+
+simd::Level simd::get_level()
+{
+  return g_level;
+}
+
+void simd::set_level(Level level)
+{
+  g_level = (int)level <= (int)g_cpu_level ? level : g_cpu_level;
+  g_ops = get_level_ops(g_level);
+}
+
+const char* simd::get_level_name(Level level)
+{
+  switch (level)
+  {
+    case Level::kSSE4: return "SSE4";
+    case Level::kAVX2: return "AVX2";
+    case Level::kAVX512: return "AVX-512";
+    default: return "scalar";
+  }
+}
+
+void simd::madd(Span<glm::vec2> dst, Span<const glm::vec2> src, float scale)
+{
+  g_ops->madd(dst, src, scale);
+}
+
+void simd::madd(Span<glm::vec2> dst, Span<const glm::vec2> src, Span<const float> scale)
+{
+  g_ops->maddSpan(dst, src, scale);
+}
+
+void simd::mul(Span<glm::vec2> v, Span<const float> scale)
+{
+  g_ops->mul(v, scale);
+}
+
+void simd::normalize(Span<glm::vec2> v)
+{
+  g_ops->normalize(v);
+}
+
+void simd::set_length(Span<glm::vec2> v, Span<const float> length)
+{
+  g_ops->setLength(v, length);
+}
+
+void simd::madd(Vec2Lanes dst, ConstVec2Lanes src, float scale)
+{
+  g_ops->maddLane(dst.x.data, src.x.data, scale, dst.x.count);
+  g_ops->maddLane(dst.y.data, src.y.data, scale, dst.y.count);
+}
+
+void simd::madd(Vec2Lanes dst, ConstVec2Lanes src, Span<const float> scale)
+{
+  g_ops->maddSpanLane(dst.x.data, src.x.data, scale.data, dst.x.count);
+  g_ops->maddSpanLane(dst.y.data, src.y.data, scale.data, dst.y.count);
+}
+
+void simd::mul(Vec2Lanes v, Span<const float> scale)
+{
+  g_ops->mulLane(v.x.data, scale.data, v.x.count);
+  g_ops->mulLane(v.y.data, scale.data, v.y.count);
+}
+
+void simd::normalize(Vec2Lanes v)
+{
+  g_ops->setLengthLanes(v.x.data, v.y.data, nullptr, v.x.count);
+}
+
+void simd::set_length(Vec2Lanes v, Span<const float> length)
+{
+  g_ops->setLengthLanes(v.x.data, v.y.data, length.data, v.x.count);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "span.h"
+#include "layout.h"
+
+#include <glm/vec2.hpp>
+
+// Batch operations over component spans for ECS_RUN_CHUNK systems.
+// The implementation is selected at runtime by the best instruction set the CPU supports.
+// vec2 spans are interleaved (x0 y0 x1 y1 ...), the ops work on pairs of lanes.
+// Vec2Lanes are x and y lanes of SoA components, every register holds one field of consecutive entities.
+namespace simd
+{
+  struct Vec2Lanes
+  {
+    Span<float> x;
+    Span<float> y;
+  };
+
+  struct ConstVec2Lanes
+  {
+    Span<const float> x;
+    Span<const float> y;
+  };
+
+  // Lanes of a SoA component of 2 floats, e.g. ECS_COMPONENT_LAYOUT(T, soa) for a glm::vec2 based T
+  template <typename T>
+  inline Vec2Lanes vec2_lanes(const Lanes<T> &lanes)
+  {
+    static_assert(Lanes<T>::lanesCount() == 2 && sizeof(typename ComponentLayout<T>::FieldType) == sizeof(float), "Lanes of 2 floats are expected");
+    return { lanes.lane(0), lanes.lane(1) };
+  }
+
+  template <typename T>
+  inline ConstVec2Lanes vec2_lanes(const Lanes<const T> &lanes)
+  {
+    static_assert(Lanes<const T>::lanesCount() == 2 && sizeof(typename ComponentLayout<T>::FieldType) == sizeof(float), "Lanes of 2 floats are expected");
+    return { lanes.lane(0), lanes.lane(1) };
+  }
+
+  enum class Level
+  {
+    kScalar,
+    kSSE4,
+    kAVX2,
+    kAVX512,
+  };
+
+  Level get_cpu_level();
+  Level get_level();
+  // Clamped to the CPU level, useful for tests and benchmarks
+  void set_level(Level level);
+  const char* get_level_name(Level level);
+
+  // dst[i] += src[i] * scale
+  void madd(Span<glm::vec2> dst, Span<const glm::vec2> src, float scale);
+  // dst[i] += src[i] * scale[i]
+  void madd(Span<glm::vec2> dst, Span<const glm::vec2> src, Span<const float> scale);
+  // v[i] *= scale[i]
+  void mul(Span<glm::vec2> v, Span<const float> scale);
+  // v[i] = normalize(v[i]), zero vectors stay zero
+  void normalize(Span<glm::vec2> v);
+  // v[i] = normalize(v[i]) * length[i], zero vectors stay zero
+  void set_length(Span<glm::vec2> v, Span<const float> length);
+
+  void madd(Vec2Lanes dst, ConstVec2Lanes src, float scale);
+  void madd(Vec2Lanes dst, ConstVec2Lanes src, Span<const float> scale);
+  void mul(Vec2Lanes v, Span<const float> scale);
+  void normalize(Vec2Lanes v);
+  void set_length(Vec2Lanes v, Span<const float> length);
+
+  template <typename T>
+  inline void madd(Lanes<T> dst, Lanes<const T> src, float scale) { madd(vec2_lanes(dst), vec2_lanes(src), scale); }
+  template <typename T>
+  inline void madd(Lanes<T> dst, Lanes<const T> src, Span<const float> scale) { madd(vec2_lanes(dst), vec2_lanes(src), scale); }
+  template <typename T>
+  inline void mul(Lanes<T> v, Span<const float> scale) { mul(vec2_lanes(v), scale); }
+  template <typename T>
+  inline void normalize(Lanes<T> v) { normalize(vec2_lanes(v)); }
+  template <typename T>
+  inline void set_length(Lanes<T> v, Span<const float> length) { set_length(vec2_lanes(v), length); }
+}
@@ -0,0 +1,65 @@
+#include "snapshot.h"
+#include "ecs.h"
+
+WorldSnapshot::Block::Block(const uint8_t *src, size_t sz) : size(sz)
+{
+  data = (uint8_t*)memory::alloc(memory::Subsystem::kSnapshot, size, memory::CACHE_LINE_SIZE);
+  ::memcpy(data, src, size);
+}
+
+WorldSnapshot::Block::~Block()
+{
+  memory::free(memory::Subsystem::kSnapshot, data, size);
+}
+
+void WorldSnapshot::Column::copyFrom(const uint8_t *src, size_t sz, const Column *prev)
+{
+  size = sz;
+  blocks.resize((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+  for (size_t i = 0, offset = 0; i < blocks.size(); ++i, offset += BLOCK_SIZE)
+  {
+    const size_t blockSize = eastl::min(BLOCK_SIZE, size - offset);
+    if (prev && i < prev->blocks.size())
+    {
+      const BlockPtr &prevBlock = prev->blocks[i];
+      if (prevBlock->size == blockSize && ::memcmp(prevBlock->data, src + offset, blockSize) == 0)
+      {
+        blocks[i] = prevBlock;
+        continue;
+      }
+    }
+    blocks[i] = eastl::make_shared<Block>(src + offset, blockSize);
+  }
+}
+
+void WorldSnapshot::Column::copyTo(uint8_t *dst) const
+{
+  for (const BlockPtr &block : blocks)
+  {
+    ::memcpy(dst, block->data, block->size);
+    dst += block->size;
+  }
+}
+
+WorldSnapshot::~WorldSnapshot()
+{
+  for (ArchetypeState &state : archetypes)
+    for (Column &column : state.columns)
+    {
+      if (!column.items)
+        continue;
+      for (int32_t i = 0; i < state.entitiesCapacity; ++i)
+        if (!state.freeMask[i])
+          column.desc->dtor(column.items + i * column.desc->size);
+      memory::free(memory::Subsystem::kSnapshot, column.items, column.size);
+    }
+}
+
+size_t WorldSnapshot::size() const
+{
+  size_t sz = entities.size + generations.size;
+  for (const ArchetypeState &state : archetypes)
+    for (const Column &column : state.columns)
+      sz += column.size;
+  return sz;
+}
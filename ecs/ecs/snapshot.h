@@ -0,0 +1,81 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <EASTL/deque.h>
+#include <EASTL/bitvector.h>
+#include <EASTL/shared_ptr.h>
+
+struct ComponentDescription;
+
+// Copy of the world: archetype columns, the entity table and the generations of entity handles.
+// Trivially copyable columns are split into blocks, a block is shared with the previous snapshot
+// while its content is the same, so consecutive snapshots copy only the blocks written in between.
+// Other columns are copied item by item.
+struct WorldSnapshot
+{
+  static constexpr size_t BLOCK_SIZE = 16 << 10;
+
+  struct Block
+  {
+    uint8_t *data = nullptr;
+    size_t size = 0;
+
+    Block(const uint8_t *src, size_t sz);
+    ~Block();
+
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+  };
+
+  using BlockPtr = eastl::shared_ptr<Block>;
+
+  struct Column
+  {
+    const ComponentDescription *desc = nullptr;
+    size_t size = 0;
+
+    // Trivially copyable data
+    eastl::vector<BlockPtr> blocks;
+
+    // Non-trivially copyable items, constructed for the alive entities only
+    uint8_t *items = nullptr;
+
+    // Blocks of prev are taken where the data is the same
+    void copyFrom(const uint8_t *src, size_t sz, const Column *prev);
+    void copyTo(uint8_t *dst) const;
+  };
+
+  struct ArchetypeState
+  {
+    int32_t entitiesCount = 0;
+    int32_t entitiesCapacity = 0;
+
+    eastl::bitvector<> freeMask;
+    eastl::deque<int32_t> freeIndexQueue;
+
+    eastl::vector<Column> columns;
+  };
+
+  eastl::vector<ArchetypeState> archetypes;
+
+  int entitiesCount = 0;
+  // eastl::vector<Entity>
+  Column entities;
+  int32_t entitiesSize = 0;
+
+  uint32_t handlesCount = 0;
+  // eastl::vector<int32_t> of the generations
+  Column generations;
+  int32_t generationsSize = 0;
+  eastl::deque<int32_t> freeHandles;
+
+  WorldSnapshot() = default;
+  ~WorldSnapshot();
+
+  WorldSnapshot(const WorldSnapshot&) = delete;
+  WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+  // Size of the blocks and items, shared blocks are counted in every snapshot they are in
+  size_t size() const;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Contiguous part of a component column, ECS_RUN_CHUNK systems get one per component.
+// Columns are cache line aligned but a chunk might start in the middle of a column.
+template <typename T>
+struct Span
+{
+  T * __restrict data = nullptr;
+  int count = 0;
+
+  Span() = default;
+  Span(T * __restrict _data, int _count) : data(_data), count(_count) {}
+
+  inline int size() const { return count; }
+  inline bool empty() const { return count == 0; }
+
+  inline T* begin() const { return data; }
+  inline T* end() const { return data + count; }
+
+  inline T& operator[](int i) const { return data[i]; }
+
+  inline bool isAligned(uintptr_t alignment) const { return ((uintptr_t)data & (alignment - 1)) == 0; }
+
+  inline operator Span<const T>() const { return Span<const T>(data, count); }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "query.h"
+
+#include <math.h>
+
+#include <glm/vec2.hpp>
+
+// Hashed grid over a glm::vec2 component, rebuilt every tick.
+// Rows are sorted by bucket, a bucket has rows of all cells with the same hash.
+// Positions are the ones of the last tick, components are read through the rows as is.
+struct SpatialIndex
+{
+  struct Row
+  {
+    glm::vec2 pos;
+    uint32_t cell;
+    int32_t archetypeId;
+    int32_t entityIndex;
+  };
+
+  HashedString name;
+  HashedString componentName;
+  float cellSize = 1.f;
+  float invCellSize = 1.f;
+
+  QueryDescription desc;
+
+  int bucketsMask = 0;
+  // Rows of the bucket b are [bucketOffsets[b], bucketOffsets[b + 1])
+  eastl::vector<int, memory::IndexAllocator> bucketOffsets;
+  eastl::vector<Row, memory::IndexAllocator> rows;
+
+  // Columns of desc.components per archetype, a row is the entity at entityIndex in them
+  int componentsCount = 0;
+  eastl::vector<uint8_t * __restrict, memory::IndexAllocator> columns;
+
+  inline int cellCoord(float v) const
+  {
+    return int(::floorf(v * invCellSize));
+  }
+
+  static inline uint32_t makeCell(int x, int y)
+  {
+    return (uint32_t(uint16_t(x)) << 16) | uint16_t(y);
+  }
+
+  inline int bucket(int x, int y) const
+  {
+    return int((uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u)) & bucketsMask;
+  }
+
+  inline QueryIterator iterator(const Row &row)
+  {
+    QueryIterator iter(columns.data() + row.archetypeId * componentsCount, 1, nullptr, componentsCount);
+    iter.idx = row.entityIndex;
+    return iter;
+  }
+
+  // Calls callback(row) once for every row of the cells that overlap [min, max]
+  template <typename Callable>
+  inline void forEachInCells(const glm::vec2 &min, const glm::vec2 &max, Callable &&callback)
+  {
+    if (rows.empty())
+      return;
+
+    const int x0 = cellCoord(min.x);
+    const int y0 = cellCoord(min.y);
+    const int x1 = cellCoord(max.x);
+    const int y1 = cellCoord(max.y);
+
+    // It's cheaper to scan all rows than to visit more cells than buckets
+    if (int64_t(x1 - x0 + 1) * int64_t(y1 - y0 + 1) > int64_t(bucketsMask) + 1)
+    {
+      for (const Row &row : rows)
+        if (row.pos.x >= min.x && row.pos.x <= max.x && row.pos.y >= min.y && row.pos.y <= max.y)
+          callback(row);
+      return;
+    }
+
+    for (int x = x0; x <= x1; ++x)
+      for (int y = y0; y <= y1; ++y)
+      {
+        const uint32_t cell = makeCell(x, y);
+        const int b = bucket(x, y);
+        for (int i = bucketOffsets[b], end = bucketOffsets[b + 1]; i < end; ++i)
+          if (rows[i].cell == cell)
+            callback(rows[i]);
+      }
+  }
+
+  // Calls callback(QueryIterator&) for every entity inside [min, max]
+  template <typename Callable>
+  inline void forEachInAabb(const glm::vec2 &min, const glm::vec2 &max, Callable &&callback)
+  {
+    forEachInCells(min, max, [&](const Row &row)
+    {
+      if (row.pos.x >= min.x && row.pos.x <= max.x && row.pos.y >= min.y && row.pos.y <= max.y)
+      {
+        QueryIterator iter = iterator(row);
+        callback(iter);
+      }
+    });
+  }
+
+  // Calls callback(QueryIterator&) for every entity not farther than radius from center
+  template <typename Callable>
+  inline void forEachInRadius(const glm::vec2 &center, float radius, Callable &&callback)
+  {
+    const float radiusSq = radius * radius;
+    forEachInCells(center - glm::vec2(radius, radius), center + glm::vec2(radius, radius), [&](const Row &row)
+    {
+      const float dx = row.pos.x - center.x;
+      const float dy = row.pos.y - center.y;
+      if (dx * dx + dy * dy <= radiusSq)
+      {
+        QueryIterator iter = iterator(row);
+        callback(iter);
+      }
+    });
+  }
+
+  void clear();
+};
+
+struct SpatialIndexDescription
+{
+  ConstHashedString name;
+  ConstHashedString componentName;
+  float cellSize;
+  ConstQueryDescription desc;
+
+  filter_t filter;
+
+  static const SpatialIndexDescription *head;
+  static int count;
+
+  const SpatialIndexDescription *next = nullptr;
+
+  SpatialIndexDescription(const ConstHashedString &name, const ConstHashedString &component_name, float cell_size, const ConstQueryDescription &desc, filter_t &&f = nullptr);
+};
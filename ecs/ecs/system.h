@@ -4,6 +4,7 @@
 
 #include "ecs/event.h"
 #include "ecs/query.h"
+#include "ecs/span.h"
 
 struct EntityManager;
 
@@ -68,12 +69,16 @@ struct EntityManager;
   #define QL_WHERE(expr) struct ql_where { static constexpr char const *ql_expr = #expr; };
   #define QL_JOIN(expr) struct ql_join { static constexpr char const *ql_expr = #expr; };
   #define QL_INDEX(...) struct ql_index { QL_FOREACH(QL_INDEX_BY_COMPONENT, __VA_ARGS__) };
-  #define QL_INDEX_LOOKUP(expr) struct ql_index_lookup { static constexpr char const *ql_expr = #expr; };
+  #define QL_INDEX_LOOKUP(...) struct ql_index_lookup { static constexpr char const *ql_expr = #__VA_ARGS__; };
+  #define QL_SPATIAL_INDEX(component, cell_size) struct ql_spatial_index { ql_component component; static constexpr char const *ql_expr = #cell_size; };
+  #define QL_ORDERED_INDEX(component) struct ql_ordered_index { ql_component component; };
 
   #define ECS_QUERY struct ecs_query {};
   #define ECS_LAZY_QUERY struct ecs_lazy_query {};
   #define ECS_SYSTEM struct ecs_system {};
   #define ECS_SYSTEM_IN_JOBS struct ecs_system_in_jobs {};
+  #define ECS_SYSTEM_CHUNK struct ecs_system_chunk {};
+  #define ECS_SYSTEM_CHUNK_IN_JOBS struct ecs_system_chunk_in_jobs {};
   #define ECS_JOBS_CHUNK_SIZE(n) struct ecs_jobs_chunk_size { static constexpr char const *ql_expr = #n; };
 
   #define ECS_BARRIER struct ecs_barrier {};
@@ -94,6 +99,8 @@ struct EntityManager;
   #define QL_JOIN(...)
   #define QL_INDEX(...)
   #define QL_INDEX_LOOKUP(...)
+  #define QL_SPATIAL_INDEX(...)
+  #define QL_ORDERED_INDEX(...)
 
   #define ECS_QUERY\
     template <typename Callable> static __forceinline void foreach(Callable);\
@@ -102,12 +109,21 @@ struct EntityManager;
     using Self = decltype(detect_self_helper());\
     static __forceinline Self get(QueryIterator &iter);\
     static __forceinline Index* index();\
+    static __forceinline SpatialIndex* spatial_index();\
+    template <typename Callable> static __forceinline void foreach_in_radius(const glm::vec2 &center, float radius, Callable);\
+    template <typename Callable> static __forceinline void foreach_in_aabb(const glm::vec2 &min, const glm::vec2 &max, Callable);\
+    static __forceinline OrderedIndex* ordered_index();\
+    template <typename Callable> static __forceinline void foreach_in_range(const OrderedRange &range, Callable);\
+    template <typename Callable> static __forceinline void foreach_first(int count, Callable);\
+    template <typename Callable> static __forceinline void foreach_last(int count, Callable);\
 
   #define ECS_LAZY_QUERY\
     template <typename Callable> static __forceinline void perform(Callable);\
 
   #define ECS_SYSTEM
   #define ECS_SYSTEM_IN_JOBS
+  #define ECS_SYSTEM_CHUNK
+  #define ECS_SYSTEM_CHUNK_IN_JOBS
   #define ECS_JOBS_CHUNK_SIZE(...)
 
   #define ECS_BARRIER
@@ -125,11 +141,15 @@ struct EntityManager;
 #ifdef _DEBUG
 #define ECS_RUN ECS_SYSTEM; static void run
 #define ECS_RUN_IN_JOBS ECS_SYSTEM_IN_JOBS; static void run
+#define ECS_RUN_CHUNK ECS_SYSTEM_CHUNK; static void run
+#define ECS_RUN_CHUNK_IN_JOBS ECS_SYSTEM_CHUNK_IN_JOBS; static void run
 #define ECS_RUN_T ECS_SYSTEM; template <typename _> static void run
 #define ECS_ADD_JOBS static jobmanager::JobId addJobs
 #else
 #define ECS_RUN ECS_SYSTEM; static __forceinline void run
 #define ECS_RUN_IN_JOBS ECS_SYSTEM_IN_JOBS; static __forceinline void run
+#define ECS_RUN_CHUNK ECS_SYSTEM_CHUNK; static __forceinline void run
+#define ECS_RUN_CHUNK_IN_JOBS ECS_SYSTEM_CHUNK_IN_JOBS; static __forceinline void run
 #define ECS_RUN_T ECS_SYSTEM; template <typename _> static __forceinline void run
 #define ECS_ADD_JOBS static __forceinline jobmanager::JobId addJobs
 #endif
@@ -141,6 +161,8 @@ struct EntityManager;
 #define GET_COMPONENT_ITER(q, c, t) auto c = query.iter<t>(index_of_component<_countof(q##_components)>::get(HASH(#c), q##_components))
 #define GET_COMPONENT_INDEX(q, c) static constexpr int compIdx_##c = index_of_component<_countof(q##_components)>::get(HASH(#c), q##_components)
 #define GET_COMPONENT(q, i, t, c) i.get<t>(INDEX_OF_COMPONENT(q, c))
+// T* or SoAItem<T>* for SoA components, generated code accesses it via ecs_ref and ecs_span
+#define GET_COMPONENT_COLUMN(q, columns, t, c) ((typename ComponentColumnItem<t>::Type * __restrict)columns[INDEX_OF_COMPONENT(q, c)])
 
 struct SystemId : Handle_8_24
 {
@@ -0,0 +1,211 @@
+#include "trace.h"
+
+#include <EASTL/vector.h>
+#include <EASTL/unique_ptr.h>
+#include <EASTL/string.h>
+
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <iomanip>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TRACE_USE_TSC 1
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define TRACE_USE_TSC 0
+#endif
+
+std::atomic<bool> trace::g_enabled = true;
+
+// Single writer (owner thread) ring buffer. Old events are overwritten.
+struct ThreadBuffer
+{
+  static constexpr uint32_t CAPACITY = 1 << 14;
+  static constexpr uint32_t MASK = CAPACITY - 1;
+
+  eastl::string name;
+  uint32_t tid = 0;
+
+  std::atomic<uint32_t> head = 0;
+  eastl::vector<trace::Event> events;
+
+  ThreadBuffer(uint32_t _tid) : tid(_tid)
+  {
+    events.resize(CAPACITY);
+  }
+};
+
+static std::mutex g_buffers_mutex;
+static eastl::vector<eastl::unique_ptr<ThreadBuffer>> g_buffers;
+
+static thread_local ThreadBuffer *t_buffer = nullptr;
+
+using clock_type = std::chrono::steady_clock;
+
+static const clock_type::time_point g_start_time = clock_type::now();
+#if TRACE_USE_TSC
+static const uint64_t g_start_tsc = __rdtsc();
+#endif
+
+static ThreadBuffer* get_thread_buffer()
+{
+  if (!t_buffer)
+  {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    g_buffers.emplace_back(new ThreadBuffer((uint32_t)g_buffers.size()));
+    t_buffer = g_buffers.back().get();
+  }
+  return t_buffer;
+}
+
+uint64_t trace::now()
+{
+#if TRACE_USE_TSC
+  return __rdtsc();
+#else
+  return (uint64_t)clock_type::now().time_since_epoch().count();
+#endif
+}
+
+void trace::record(Category category, const char *name, uint64_t begin, uint64_t end, uint32_t arg, Name kind)
+{
+  if (!g_enabled.load(std::memory_order_relaxed))
+    return;
+
+  ThreadBuffer *buffer = get_thread_buffer();
+  const uint32_t head = buffer->head.load(std::memory_order_relaxed);
+
+  Event &ev = buffer->events[head & ThreadBuffer::MASK];
+  if (name && kind == Name::kCopy)
+  {
+    int i = 0;
+    for (; i < Event::NAME_SIZE - 1 && name[i]; ++i)
+      ev.nameCopy[i] = name[i];
+    ev.nameCopy[i] = 0;
+    ev.name = nullptr;
+  }
+  else
+  {
+    ev.nameCopy[0] = 0;
+    ev.name = name;
+  }
+  ev.begin = begin;
+  ev.end = end;
+  ev.arg = arg;
+  ev.category = category;
+
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void trace::set_enabled(bool enable)
+{
+  g_enabled.store(enable);
+}
+
+void trace::set_thread_name(const char *name)
+{
+  get_thread_buffer()->name = name;
+}
+
+void trace::clear()
+{
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+  for (auto &buffer : g_buffers)
+    buffer->head.store(0);
+}
+
+static const char* category_name(trace::Category category)
+{
+  switch (category)
+  {
+    case trace::Category::kJob: return "job";
+    case trace::Category::kSystem: return "system";
+    case trace::Category::kQuery: return "query";
+    case trace::Category::kEvent: return "event";
+    default: return "user";
+  }
+}
+
+static void write_json_string(std::ostream &out, const char *str)
+{
+  out << '"';
+  for (const char *c = str; *c; ++c)
+    switch (*c)
+    {
+      case '"': out << "\\\""; break;
+      case '\\': out << "\\\\"; break;
+      case '\n': out << "\\n"; break;
+      case '\r': out << "\\r"; break;
+      case '\t': out << "\\t"; break;
+      default:
+        if ((unsigned char)*c < 0x20)
+          out << "\\u00" << "0123456789abcdef"[(*c >> 4) & 0xf] << "0123456789abcdef"[*c & 0xf];
+        else
+          out << *c;
+    }
+  out << '"';
+}
+
+bool trace::dump_chrome_trace(const char *filename)
+{
+  std::ofstream out(filename, std::ofstream::out);
+  if (out.fail())
+    return false;
+
+  // Ticks to microseconds
+#if TRACE_USE_TSC
+  const double elapsedUs = std::chrono::duration<double, std::micro>(clock_type::now() - g_start_time).count();
+  const uint64_t startTicks = g_start_tsc;
+  const double ticksPerUs = elapsedUs > 0.0 ? double(__rdtsc() - g_start_tsc) / elapsedUs : 1.0;
+#else
+  const uint64_t startTicks = (uint64_t)g_start_time.time_since_epoch().count();
+  const double ticksPerUs = double(clock_type::period::den) / (double(clock_type::period::num) * 1e6);
+#endif
+
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+  bool first = true;
+  for (const auto &buffer : g_buffers)
+  {
+    if (!first)
+      out << ",\n";
+    first = false;
+
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+      << ",\"args\":{\"name\":";
+    write_json_string(out, buffer->name.empty() ? "thread" : buffer->name.c_str());
+    out << "}}";
+
+    const uint32_t head = buffer->head.load(std::memory_order_acquire);
+    const uint32_t count = head < ThreadBuffer::CAPACITY ? head : ThreadBuffer::CAPACITY;
+    for (uint32_t i = head - count; i != head; ++i)
+    {
+      const Event &ev = buffer->events[i & ThreadBuffer::MASK];
+      const char *name = ev.name ? ev.name : ev.nameCopy;
+      if (!*name)
+        continue;
+
+      const double ts = double(int64_t(ev.begin - startTicks)) / ticksPerUs;
+      const double dur = double(ev.end - ev.begin) / ticksPerUs;
+
+      out << ",\n{\"name\":";
+      write_json_string(out, name);
+      out << ",\"cat\":\"" << category_name(ev.category)
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+        << ",\"ts\":" << ts << ",\"dur\":" << dur
+        << ",\"args\":{\"arg\":" << ev.arg << "}}";
+    }
+  }
+
+  out << "\n]}\n";
+
+  return !out.fail();
+}
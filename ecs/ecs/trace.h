@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+namespace trace
+{
+  enum class Category : uint8_t
+  {
+    kJob,
+    kSystem,
+    kQuery,
+    kEvent,
+    kUser,
+  };
+
+  enum class Name : uint8_t
+  {
+    kStatic, // Outlives the dump (literals, ConstHashedString), stored as a pointer
+    kCopy, // Might be freed before the dump, copied into the event
+  };
+
+  struct Event
+  {
+    static constexpr int NAME_SIZE = 32;
+
+    const char *name = nullptr;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint32_t arg = 0;
+    Category category = Category::kUser;
+    // Truncated copy of a Name::kCopy name, the name pointer is null then
+    char nameCopy[NAME_SIZE] = {};
+  };
+
+  extern std::atomic<bool> g_enabled;
+
+  uint64_t now();
+  void record(Category category, const char *name, uint64_t begin, uint64_t end, uint32_t arg = 0, Name kind = Name::kStatic);
+
+  void set_enabled(bool enable);
+  void set_thread_name(const char *name);
+
+  // Writes Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+  // Call it at a sync point when there are no running jobs.
+  bool dump_chrome_trace(const char *filename);
+  void clear();
+
+  struct Scope
+  {
+    const char *name;
+    uint64_t begin = 0;
+    uint32_t arg;
+    Category category;
+    Name kind;
+
+    Scope(Category _category, const char *_name, uint32_t _arg = 0, Name _kind = Name::kStatic) : name(_name), arg(_arg), category(_category), kind(_kind)
+    {
+      if (g_enabled.load(std::memory_order_relaxed))
+        begin = now();
+    }
+
+    ~Scope()
+    {
+      if (begin)
+        record(category, name, begin, now(), arg, kind);
+    }
+  };
+}
+
+#define TRACE_SCOPE_CONCAT2(a, b) a##b
+#define TRACE_SCOPE_CONCAT(a, b) TRACE_SCOPE_CONCAT2(a, b)
+#define TRACE_SCOPE(category, ...) trace::Scope TRACE_SCOPE_CONCAT(__trace_scope_, __LINE__)(trace::Category::category, __VA_ARGS__);
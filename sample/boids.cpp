@@ -2,6 +2,7 @@
 
 #include <ecs/ecs.h>
 #include <ecs/jobmanager.h>
+#include <ecs/simd.h>
 
 #include <raylib.h>
 
@@ -39,7 +40,7 @@ struct Boid
   QL_HAVE(boid);
 
   const glm::vec2 &pos;
-  const glm::vec2 &vel;
+  const BoidVec2 vel;
   float mass;
 };
 
@@ -250,9 +251,15 @@ struct update_boid_position
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, const glm::vec2 &vel, glm::vec2 &pos)
+  ECS_RUN_CHUNK(const EventUpdate &evt, Lanes<const BoidVec2> vel, Span<glm::vec2> pos)
   {
-    pos += vel * evt.dt;
+    const Span<const float> x = vel.lane(0);
+    const Span<const float> y = vel.lane(1);
+    for (int i = 0; i < pos.size(); ++i)
+    {
+      pos[i].x += x[i] * evt.dt;
+      pos[i].y += y[i] * evt.dt;
+    }
   }
 };
 
@@ -265,7 +272,7 @@ struct update_boid_rotation
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, const glm::vec2 &vel, float &rotation)
+  ECS_RUN(const EventUpdate &evt, const BoidVec2 &vel, float &rotation)
   {
     const glm::vec2 dir = glm::normalize(vel);
     rotation = glm::degrees(glm::acos(dir.x)) * glm::sign(vel.y);
@@ -281,7 +288,7 @@ struct update_boid_avoid_walls
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, const glm::vec2 &pos, const glm::vec2 &vel, float mass, float &move_to_center_timer, glm::vec2 &force)
+  ECS_RUN(const EventUpdate &evt, const glm::vec2 &pos, const BoidVec2 &vel, float mass, float &move_to_center_timer, glm::vec2 &force)
   {
     const float hw = 0.5f * screen_width * (1.f / camera.zoom);
     const float hh = 0.5f * screen_height * (1.f / camera.zoom);
@@ -353,7 +360,7 @@ struct update_boid_wander
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, const glm::vec2 &vel, glm::vec2 &force, glm::vec2 &wander_vel, float &wander_timer)
+  ECS_RUN(const EventUpdate &evt, const BoidVec2 &vel, glm::vec2 &force, glm::vec2 &wander_vel, float &wander_timer)
   {
     wander_timer -= evt.dt;
     if (wander_timer <= 0.f)
@@ -379,15 +386,17 @@ struct control_boid_velocity
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, float max_vel, glm::vec2 &vel)
+  ECS_RUN_CHUNK(const EventUpdate &evt, Span<const float> max_vel, Lanes<BoidVec2> vel)
   {
-    if (glm::length(vel) == 0.f)
-    {
-      float rndX = -1.f + (1.f - (-1.f)) * float(::rand())/float(RAND_MAX);
-      float rndY = -1.f + (1.f - (-1.f)) * float(::rand())/float(RAND_MAX);
-      vel = glm::vec2(rndX, rndY);
-    }
-    vel = max_vel * glm::normalize(vel);
+    const Span<float> x = vel.lane(0);
+    const Span<float> y = vel.lane(1);
+    for (int i = 0; i < vel.size(); ++i)
+      if (x[i] == 0.f && y[i] == 0.f)
+      {
+        x[i] = -1.f + (1.f - (-1.f)) * float(::rand())/float(RAND_MAX);
+        y[i] = -1.f + (1.f - (-1.f)) * float(::rand())/float(RAND_MAX);
+      }
+    simd::set_length(vel, max_vel);
   }
 };
 
@@ -400,10 +409,17 @@ struct apply_boid_force
     return jobmanager::add_job(eastl::move(deps), count, 256, eastl::move(task));
   }
 
-  ECS_RUN(const EventUpdate &evt, float mass, glm::vec2 &force, glm::vec2 &vel)
+  ECS_RUN_CHUNK(const EventUpdate &evt, Span<const float> mass, Span<glm::vec2> force, Lanes<BoidVec2> vel)
   {
-    vel += force * (1.f / mass) * evt.dt;
-    force = glm::vec2(0.f, 0.f);
+    const Span<float> x = vel.lane(0);
+    const Span<float> y = vel.lane(1);
+    for (int i = 0; i < force.size(); ++i)
+    {
+      const float k = (1.f / mass[i]) * evt.dt;
+      x[i] += force[i].x * k;
+      y[i] += force[i].y * k;
+      force[i] = glm::vec2(0.f, 0.f);
+    }
   }
 };
 
@@ -415,7 +431,7 @@ struct BoidSeparation
 
   const EntityId &eid;
   const glm::vec2 &pos;
-  const glm::vec2 &vel;
+  const BoidVec2 vel;
   glm::vec2 &force;
   glm::vec2 &separation_center;
   glm::vec2 &cohesion_center;
@@ -426,23 +442,19 @@ struct BoidSeparation
 
 #if GRID_BOIDS
 
-struct update_boid_rules
+struct BoidNeighbor
 {
-  struct StaticData
-  {
-    std::mutex boidsMapMutex;
-    eastl::hash_multimap<uint32_t, int> boidsMap;
-  };
+  ECS_QUERY;
 
-  static StaticData sd;
+  QL_HAVE(boid);
+  QL_SPATIAL_INDEX(pos, GRID_CELL_SIZE);
 
-  static void addBoidToMap(uint32_t grid_cell, int index)
-  {
-    std::lock_guard<std::mutex> lock(sd.boidsMapMutex);
-    auto res = sd.boidsMap.insert(grid_cell);
-    res->second = index;
-  }
+  const glm::vec2 &pos;
+  const BoidVec2 vel;
+};
 
+struct update_boid_rules
+{
   ECS_RUN_T(const EventUpdate &evt, QueryIterable<BoidSeparation, _> &&boids)
   {
     using Iter = QueryIterable<BoidSeparation, _>;
@@ -451,113 +463,44 @@ struct update_boid_rules
 
     jobmanager::DependencyList deps = ecs::get_system_dependency_list(sid);
 
-    using Vec2List = eastl::vector<glm::vec2, FrameMemAllocator>;
-    using IntList = eastl::vector<int, FrameMemAllocator>;
-
-    Vec2List *cellSeparation = new (alloc_frame_mem(sizeof(Vec2List))) Vec2List();
-    cellSeparation->resize(boids.count());
-
-    Vec2List *cellAlignment = new (alloc_frame_mem(sizeof(Vec2List))) Vec2List();
-    cellAlignment->resize(boids.count());
-
-    IntList *cellIndices = new (alloc_frame_mem(sizeof(IntList))) IntList();
-    cellIndices->resize(boids.count(), -1);
-
-    IntList *cellCount = new (alloc_frame_mem(sizeof(IntList))) IntList();
-    cellCount->resize(boids.count(), 1);
-
-    sd.boidsMap.clear();
-    sd.boidsMap.reserve(boids.count());
-
     auto boidsBegin = boids.first;
-    auto addBoidsToMapJob = jobmanager::add_job(deps, boids.count(), 256, [boidsBegin](int from, int count)
+    auto steerJob = jobmanager::add_job(deps, boids.count(), 256, [boidsBegin](int from, int count)
     {
-      int i = from;
-      for (auto q = boidsBegin + from, e = q + count; q != e; ++q, ++i)
+      for (auto q = boidsBegin + from, e = q + count; q != e; ++q)
       {
         BoidSeparation boid(Iter::get(q));
-        const uint32_t gridCell = MAKE_GRID_CELL_FROM_POS(boid.pos + glm::vec2(0.f, float(GRID_SIZE)), GRID_SIZE);
-        addBoidToMap(gridCell, i);
-      }
-    });
-
-    auto initCellSeparationJob = jobmanager::add_job(deps, boids.count(), 256, [boidsBegin, cellSeparation](int from, int count)
-    {
-      int i = from;
-      for (auto q = boidsBegin + from, e = q + count; q != e; ++q, ++i)
-        (*cellSeparation)[i] = Iter::get(q).pos;
-    });
-
-    auto initCellAlignmentJob = jobmanager::add_job(deps, boids.count(), 256, [boidsBegin, cellAlignment](int from, int count)
-    {
-      int i = from;
-      for (auto q = boidsBegin + from, e = q + count; q != e; ++q, ++i)
-        (*cellAlignment)[i] = Iter::get(q).vel;
-    });
-
-    auto initBarrier = jobmanager::add_job({ addBoidsToMapJob, initCellSeparationJob, initCellAlignmentJob });
-
-    auto mergeCellsJob = jobmanager::add_job({ initBarrier }, sd.boidsMap.bucket_count(), 1, [cellIndices, cellCount, cellSeparation, cellAlignment](int bucket, int)
-    {
-      eastl::hash_map<uint32_t, int> firstIndexMap;
-      firstIndexMap.reserve(sd.boidsMap.bucket_size(bucket));
-      for (auto i = sd.boidsMap.begin(bucket), e = sd.boidsMap.end(bucket); i != e; ++i)
-      {
-        const uint32_t gridCell = i->first;
-        const int index = i->second;
-
-        auto firstIndex = firstIndexMap.find(gridCell);
-        if (firstIndex == firstIndexMap.end())
-        {
-          firstIndexMap.insert(eastl::pair<uint32_t, int>(gridCell, index));
-
-          (*cellIndices)[index] = index;
-        }
-        else
-        {
-          const int cellIndex = firstIndex->second;
-
-          (*cellCount)[cellIndex] += 1;
-          (*cellAlignment)[cellIndex] = (*cellAlignment)[cellIndex] + (*cellAlignment)[index];
-          (*cellSeparation)[cellIndex] = (*cellSeparation)[cellIndex] + (*cellSeparation)[index];
-
-          (*cellIndices)[index] = cellIndex;
-        }
-      }
-    });
-
-    auto steerJob = jobmanager::add_job({ mergeCellsJob }, boids.count(), 256, [boidsBegin, cellIndices, cellCount, cellAlignment, cellSeparation](int from, int count)
-    {
-      int i = from;
-      for (auto q = boidsBegin + from, e = q + count; q != e; ++q, ++i)
-      {
-        BoidSeparation boid(Iter::get(q));
-
-        glm::vec2 box(SEPARATION_RADIUS, SEPARATION_RADIUS);
 
         glm::vec2 separationCenter(0.f, 0.f);
-        int separationNeighborCount = 0;
-
-        for (int x = MAKE_GRID_INDEX(boid.pos.x - box.x, GRID_SIZE); x <= MAKE_GRID_INDEX(boid.pos.x + box.x, GRID_SIZE); ++x)
-          for (int y = MAKE_GRID_INDEX(boid.pos.y + float(GRID_SIZE) - box.y, GRID_SIZE); y <= MAKE_GRID_INDEX(boid.pos.y + float(GRID_SIZE) + box.y, GRID_SIZE); ++y)
+        glm::vec2 cohesionCenter(0.f, 0.f);
+        glm::vec2 alignmentDir(0.f, 0.f);
+        int separationCount = 0;
+        int cohesionCount = 0;
+        int alignmentCount = 0;
+
+        const float radius = glm::max(SEPARATION_RADIUS, glm::max(COHESION_RADIUS, ALIGNMENT_RADIUS));
+        BoidNeighbor::foreach_in_radius(boid.pos, radius, [&](BoidNeighbor &&neighbor)
+        {
+          const float dist = glm::distance(boid.pos, neighbor.pos);
+          if (dist <= SEPARATION_RADIUS)
           {
-            auto res = sd.boidsMap.find(MAKE_GRID_CELL(x, y));
-            if (res != sd.boidsMap.end())
-            {
-              const int cellIndex = (*cellIndices)[res->second];
-              const int neighborCount = (*cellCount)[cellIndex];
-
-              separationCenter += (*cellSeparation)[cellIndex];
-              separationNeighborCount += (*cellCount)[cellIndex];
-            }
+            separationCenter += neighbor.pos;
+            ++separationCount;
           }
+          if (dist <= COHESION_RADIUS)
+          {
+            cohesionCenter += neighbor.pos;
+            ++cohesionCount;
+          }
+          if (dist <= ALIGNMENT_RADIUS)
+          {
+            alignmentDir += glm::vec2(neighbor.vel);
+            ++alignmentCount;
+          }
+        });
 
-        separationCenter /= float(separationNeighborCount);
-
-        const int cellIndex = (*cellIndices)[i];
-        const int neighborCount = (*cellCount)[cellIndex];
-
-        glm::vec2 cohesionCenter = (*cellSeparation)[cellIndex] / float(neighborCount);
+        separationCenter = separationCount > 0 ? separationCenter / float(separationCount) : boid.pos;
+        cohesionCenter = cohesionCount > 0 ? cohesionCenter / float(cohesionCount) : boid.pos;
+        alignmentDir = alignmentCount > 0 ? alignmentDir / float(alignmentCount) : glm::vec2(boid.vel);
 
         glm::vec2 separation = boid.pos - separationCenter;
         const float separationLen = glm::length(separation);
@@ -569,14 +512,14 @@ struct update_boid_rules
         if (cohesionLen > 0.f)
           boid.force += (cohesion / cohesionLen) * COHESION;
 
-        glm::vec2 alignment = ((*cellAlignment)[cellIndex] / float(neighborCount)) - boid.vel;
+        glm::vec2 alignment = alignmentDir - boid.vel;
         const float alignmentLen = glm::length(alignment);
         if (alignmentLen > 0.f)
           boid.force += (alignment / alignmentLen) * ALIGNMENT;
 
         boid.separation_center = separationCenter;
         boid.cohesion_center = cohesionCenter;
-        boid.alignment_dir = (*cellAlignment)[i] / float(neighborCount);
+        boid.alignment_dir = alignmentDir;
       }
     });
 
@@ -586,8 +529,6 @@ struct update_boid_rules
   }
 };
 
-update_boid_rules::StaticData update_boid_rules::sd;
-
 #else
 
 struct update_boid_rules
@@ -1,9 +1,20 @@
 #include <ecs/event.h>
+#include <ecs/component.h>
 
 #include <glm/vec2.hpp>
 
 #include <daScript/daScript.h>
 
+// Boid velocity, stored as x and y lanes for the SIMD kernels
+struct BoidVec2 : glm::vec2
+{
+  BoidVec2() : glm::vec2(0.f, 0.f) {}
+  BoidVec2(const glm::vec2 &v) : glm::vec2(v) {}
+};
+
+ECS_COMPONENT_TYPE(BoidVec2);
+ECS_COMPONENT_LAYOUT(BoidVec2, soa);
+
 struct EventOnClickMouseLeftButton
 {
   glm::vec2 pos = { 0.f, 0.f };
@@ -85,6 +85,38 @@ struct AliveEnemy
   bool &is_alive;
 };
 
+struct EnemyByDist
+{
+  ECS_QUERY;
+
+  QL_HAVE(enemy);
+  QL_ORDERED_INDEX(dist_to_player);
+
+  const EntityId &eid;
+  const float &dist_to_player;
+};
+
+struct CloseEnemy
+{
+  ECS_QUERY;
+
+  QL_HAVE(enemy);
+  QL_WHERE(dist_to_player < 10.0 && is_alive == true);
+
+  const EntityId &eid;
+  const float &dist_to_player;
+};
+
+struct NearestEnemies
+{
+  ECS_RUN(const EventUpdate &evt, const glm::vec2 &pos)
+  {
+    EnemyByDist::foreach_first(32, [&](EnemyByDist &&enemy)
+    {
+    });
+  }
+};
+
 struct Simple
 {
   ECS_RUN(const EventUpdate &evt, const glm::vec2 &vel, glm::vec2 &pos)
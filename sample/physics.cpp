@@ -6,166 +6,10 @@
 
 #include "update.h"
 #include "grid.h"
-
-extern int screen_width;
-extern int screen_height;
+#include "physics.h"
 
 static b2World *g_world = nullptr;
 
-static inline Color to_color(const b2Color& c)
-{
-  return { (uint8_t)(255.f * c.r), (uint8_t)(255.f * c.g), (uint8_t)(255.f * c.b), (uint8_t)(255.f * c.a) };
-}
-
-struct PhysDebugDraw : public b2Draw
-{
-  /// Draw a closed polygon provided in CCW order.
-  void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override final
-  {
-    DrawSegment(vertices[vertexCount - 1], vertices[0], color);
-    for (int i = 0; i < vertexCount - 1; ++i)
-      DrawSegment(vertices[i], vertices[i + 1], color);
-  }
-
-  /// Draw a solid closed polygon provided in CCW order.
-  void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override final
-  {
-    DrawSegment(vertices[vertexCount - 1], vertices[0], color);
-    for (int i = 0; i < vertexCount - 1; ++i)
-      DrawSegment(vertices[i], vertices[i + 1], color);
-  }
-
-  /// Draw a circle.
-  void DrawCircle(const b2Vec2& center, float radius, const b2Color& color) override final
-  {
-    ::DrawCircleV({center.x, center.y}, radius, to_color(color));
-  }
-
-  /// Draw a solid circle.
-  void DrawSolidCircle(const b2Vec2& center, float radius, const b2Vec2& axis, const b2Color& color) override final
-  {
-    ::DrawCircleV({center.x, center.y}, radius, to_color(color));
-  }
-
-  /// Draw a line segment.
-  void DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color) override final
-  {
-    const float hw = screen_width * 0.5f;
-    const float hh = screen_height * 0.5f;
-    ::DrawLineEx({ hw + p1.x, hh + p1.y }, { hw + p2.x, hh + p2.y }, 1.0f, to_color(color));
-  }
-
-  /// Draw a transform. Choose your own length scale.
-  /// @param xf a transform.
-  void DrawTransform(const b2Transform& xf) override final
-  {
-  }
-
-  /// Draw a point.
-  void DrawPoint(const b2Vec2& p, float size, const b2Color& color) override final
-  {
-    ::DrawCircleV({p.x, p.y}, 4.f, to_color(color));
-  }
-};
-
-struct PhysicsWorld
-{
-  ECS_BIND_TYPE(phys, isLocal=true);
-
-  int atTick = 0;
-
-  PhysDebugDraw debugDraw;
-
-  // void operator=(const PhysicsWorld&) { ASSERT(false); }
-  ECS_DEFAULT_CTORS(PhysicsWorld);
-
-  // TODO: Use event on destruction
-  // ~PhysicsWorld()
-  // {
-  //   delete g_world;
-  //   g_world = nullptr;
-  // }
-};
-
-ECS_COMPONENT_TYPE_BIND(PhysicsWorld);
-
-struct CollisionShape
-{
-  ECS_BIND_TYPE(phys, canNew=true; isRefType=true; isPod=false; isLocal=true; canCopy=true; canMove=true);
-
-  ECS_BIND(sideEffect=modifyArgument)
-  static void add_shape(CollisionShape *&self, const char *type, das::float2 size, das::float2 center, float angle, float density, float friction)
-  {
-    auto &s = self->shapes.emplace_back();
-    s.shape.SetAsBox(0.5f * size.x, 0.5f * size.y, { center.x, center.y }, angle);
-    s.density = density;
-    s.friction = friction;
-  }
-
-  ECS_BIND(sideEffect=modifyArgument)
-  static void add_sensor(CollisionShape *&self, const char *type, das::float2 size, das::float2 center)
-  {
-    auto &s = self->shapes.emplace_back();
-    s.shape.SetAsBox(0.5f * size.x, 0.5f * size.y, { center.x, center.y }, 0.f);
-    s.density = 0.f;
-    s.friction = 0.f;
-    s.isSensor = true;
-  }
-
-  ECS_DEFAULT_CTORS(CollisionShape);
-
-  struct Shape
-  {
-    b2PolygonShape shape;
-
-    bool isSensor = false;
-
-    float density = 0.f;
-    float friction = 0.f;
-
-    b2Fixture *fixture = nullptr;
-  };
-
-  eastl::vector<Shape> shapes;
-};
-
-ECS_COMPONENT_TYPE_BIND(CollisionShape);
-
-struct PhysicsBody
-{
-  ECS_BIND_TYPE(phys, isLocal=true; canCopy=true);
-
-  b2BodyType type;
-  b2Body *body;
-
-  ECS_BIND(sideEffect=none; simNode=das::SimNode_ExtFuncCallAndCopyOrMove)
-  static PhysicsBody create_phys_body(const char *type)
-  {
-    b2BodyType bodyType;
-    if (::strcmp(type, "static") == 0)
-      bodyType = b2_staticBody;
-    else if (::strcmp(type, "kinematic") == 0)
-      bodyType = b2_kinematicBody;
-    else if (::strcmp(type, "dynamic") == 0)
-      bodyType = b2_dynamicBody;
-    else
-      ASSERT(false);
-
-    return {bodyType, nullptr};
-  }
-
-  // ECS_DEFAULT_CTORS(PhysicsBody);
-
-  // TODO: Use event instead
-  // ~PhysicsBody()
-  // {
-  //   if (body && g_world)
-  //     g_world->DestroyBody(body);
-  // }
-};
-
-ECS_COMPONENT_TYPE_BIND(PhysicsBody);
-
 struct Brick
 {
   ECS_QUERY;
@@ -470,8 +314,8 @@ struct update_player_collisions
     for (int x = boxCellLeft; x <= boxCellRight; ++x)
       for (int y = boxCellTop; y <= boxCellBottom; ++y)
       {
-        if (Query *cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
-          for (auto q = cell->begin(), e = cell->end(); q != e; ++q)
+        if (IndexBucket cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
+          for (auto q = cell.begin(), e = cell.end(); q != e; ++q)
             process_collision(player, Brick::get(q));
       }
   }
@@ -500,8 +344,8 @@ struct render_debug_player_grid_cell
       {
         DrawRectangleV(Vector2{hw + float(x) * float(GRID_CELL_SIZE), hh + float(y) * float(GRID_CELL_SIZE)}, Vector2{float(GRID_CELL_SIZE), float(GRID_CELL_SIZE)}, Color{ 0, 117, 44, 28 });
 
-        if (Query *cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
-          for (auto q = cell->begin(), e = cell->end(); q != e; ++q)
+        if (IndexBucket cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
+          for (auto q = cell.begin(), e = cell.end(); q != e; ++q)
           {
             Brick brick = Brick::get(q);
             DrawCircleV(Vector2{hw + brick.pos.x, hh + brick.pos.y}, 5.f, Color{ 255, 0, 0, 100 });
@@ -570,8 +414,8 @@ struct update_auto_move_collisions
     for (int x = boxCellLeft; x <= boxCellRight; ++x)
       for (int y = boxCellTop; y <= boxCellBottom; ++y)
       {
-        if (Query *cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
-          for (auto q = cell->begin(), e = cell->end(); q != e; ++q)
+        if (IndexBucket cell = Brick::index()->find(MAKE_GRID_CELL(x, y)))
+          for (auto q = cell.begin(), e = cell.end(); q != e; ++q)
             process_collision(enemy, Brick::get(q));
       }
   }
@@ -8,6 +8,7 @@
 #include <ecs/perf.h>
 #include <ecs/jobmanager.h>
 #include <ecs/autoBind.h>
+#include <ecs/trace.h>
 
 #include <raylib.h>
 
@@ -49,6 +50,13 @@ struct Texture2DAnnotation : das::ManagedStructureAnnotation<Texture2D, false>
 
 ECS_COMPONENT_TYPE_DETAILS(Texture2D);
 
+static das::ModuleAotType sample_aot_require(das::TextWriter &tw)
+{
+  tw << "#include \"dasModules/ecs.h\"\n";
+  tw << "#include \"update.h\"\n";
+  return das::ModuleAotType::cpp;
+}
+
 struct RaylibModule final : public das::Module
 {
   RaylibModule() : das::Module("raylib")
@@ -64,8 +72,7 @@ struct RaylibModule final : public das::Module
 
   das::ModuleAotType aotRequire(das::TextWriter& tw) const override
   {
-    tw << "#include \"dasModules/ecs.h\"\n";
-    return das::ModuleAotType::cpp;
+    return sample_aot_require(tw);
   }
 };
 
@@ -87,8 +94,7 @@ struct AnimModule final : public das::Module
 
   das::ModuleAotType aotRequire(das::TextWriter& tw) const override
   {
-    tw << "#include \"dasModules/ecs.h\"\n";
-    return das::ModuleAotType::cpp;
+    return sample_aot_require(tw);
   }
 };
 
@@ -110,8 +116,7 @@ struct RenderModule final : public das::Module
 
   das::ModuleAotType aotRequire(das::TextWriter& tw) const override
   {
-    tw << "#include \"dasModules/ecs.h\"\n";
-    return das::ModuleAotType::cpp;
+    return sample_aot_require(tw);
   }
 };
 
@@ -133,8 +138,8 @@ struct PhysModule final : public das::Module
 
   das::ModuleAotType aotRequire(das::TextWriter& tw) const override
   {
-    tw << "#include \"dasModules/ecs.h\"\n";
-    return das::ModuleAotType::cpp;
+    tw << "#include \"physics.h\"\n";
+    return sample_aot_require(tw);
   }
 };
 
@@ -156,8 +161,7 @@ struct SampleModule final : public das::Module
 
   das::ModuleAotType aotRequire(das::TextWriter& tw) const override
   {
-    tw << "#include \"dasModules/ecs.h\"\n";
-    return das::ModuleAotType::cpp;
+    return sample_aot_require(tw);
   }
 };
 
@@ -169,17 +173,99 @@ DasContextPtr dasCtx;
 static constexpr char *dasRoot = "../libs/daScript";
 static constexpr char *dasProject = "scripts/project.das_project";
 static constexpr char *dasInitScript = "scripts/sample.das";
+static constexpr char *dasExportLevelScript = "scripts/export_level.das";
 static constexpr char *dasMainScript = "scripts/main.das";
-static eastl::hash_map<eastl::string, SystemId> dasMainSystems;
-static eastl::vector<QueryId> dasMainQueries;
-static time_t dasMainLastModified = 0;
 static bool isDasInitScriptLoaded = false;
 
+static uint32_t hash_source(const char *data, size_t size)
+{
+  uint32_t res = hash::fnv1a<uint32_t>::default_offset_basis;
+  for (size_t i = 0; i < size; ++i)
+    res = (res ^ uint8_t(data[i])) * hash::fnv1a<uint32_t>::prime;
+  return res;
+}
+
+// Files read by a compilation of a script with the hashes of their content
+struct ScriptFiles
+{
+  struct File
+  {
+    time_t lastModified = 0;
+    uint32_t hash = 0;
+  };
+
+  eastl::hash_map<eastl::string, File> files;
+
+  void add(const char *path, const char *source, size_t size)
+  {
+    File &file = files[path];
+    file.hash = hash_source(source, size);
+
+    struct stat st;
+    if (::stat(path, &st) == 0)
+      file.lastModified = st.st_mtime;
+  }
+
+  // Only the touched files are read, a save without changes does not cause a recompilation
+  bool isChanged()
+  {
+    if (files.empty())
+      return true;
+
+    bool changed = false;
+    for (auto &kv : files)
+    {
+      struct stat st;
+      if (::stat(kv.first.c_str(), &st) != 0 || st.st_mtime == kv.second.lastModified)
+        continue;
+      kv.second.lastModified = st.st_mtime;
+
+      eastl::vector<char> source;
+      if (FILE *f = ::fopen(kv.first.c_str(), "rb"))
+      {
+        source.resize(st.st_size);
+        source.resize(::fread(source.data(), 1, source.size(), f));
+        ::fclose(f);
+      }
+      changed = changed || hash_source(source.data(), source.size()) != kv.second.hash;
+    }
+    return changed;
+  }
+};
+
+// Records the script and the modules it requires
+struct ScriptFileAccess final : das::FsFileAccess
+{
+  ScriptFiles scriptFiles;
+
+  ScriptFileAccess() : das::FsFileAccess(dasProject, das::make_smart<das::FsFileAccess>()) {}
+
+  das::FileInfo* getNewFileInfo(const das::string &fileName) override
+  {
+    das::FileInfo *info = das::FsFileAccess::getNewFileInfo(fileName);
+    if (info)
+      scriptFiles.add(fileName.c_str(), info->source, info->sourceLength);
+    return info;
+  }
+};
+
+struct DasMainSystem
+{
+  SystemId sid;
+  eastl::string signature;
+};
+
+static ScriptFiles dasMainFiles;
+static eastl::hash_map<eastl::string, DasMainSystem> dasMainSystems;
+static EcsModuleGroupData::QueriesByName dasMainQueries;
+
 template <typename TFileAccess>
-static bool compile_and_simulate_script(DasContextPtr &ctx, const char *path, das::ModuleGroup &libGroup, const TFileAccess &file_access)
+static bool compile_and_simulate_script(DasContextPtr &ctx, const char *path, das::ModuleGroup &libGroup, const TFileAccess &file_access, const char *aot_path = nullptr)
 {
   das::TextPrinter tout;
-  auto program = das::compileDaScript(path, file_access, tout, libGroup);
+  das::CodeOfPolicies policies;
+  policies.fail_on_no_aot = false;
+  auto program = das::compileDaScript(path, file_access, tout, libGroup, false, policies);
   if (!program)
     return false;
   
@@ -201,6 +287,26 @@ static bool compile_and_simulate_script(DasContextPtr &ctx, const char *path, da
     return false;
   }
 
+  if (aot_path)
+  {
+    das::TextWriter tw;
+    if (!das_aot_cpp(program, *tmpCtx, tw))
+      tout << "[das]: " << path << ": AOT is disabled, the script is interpreted\n";
+
+    FILE *f = ::fopen(aot_path, "w");
+    if (!f)
+      return false;
+    const das::string &str = tw.str();
+    ::fwrite(str.c_str(), 1, str.length(), f);
+    ::fclose(f);
+  }
+
+#ifdef ECS_DAS_AOT
+  // Changed or reloaded functions have no AOT with the same semantic hash and stay interpreted
+  const int aotCount = das_link_aot(*program, *tmpCtx, tout);
+  tout << "[das]: " << path << ": " << aotCount << "/" << tmpCtx->getTotalFunctions() << " functions are AOT\n";
+#endif
+
   ctx = eastl::move(tmpCtx);
 
   return true;
@@ -219,50 +325,53 @@ static bool reload_scripts()
   if (!isDasInitScriptLoaded)
     return false;
 
-  struct stat st;
-  if (::stat(dasMainScript, &st) == 0)
-  {
-    if (st.st_mtime == dasMainLastModified)
-      return true;
-    dasMainLastModified = st.st_mtime;
-  }
-  else
-  {
-    ASSERT(false);
-    return false;
-  }
+  if (!dasMainFiles.isChanged())
+    return true;
 
-  auto fAccess = das::make_smart<das::FsFileAccess>(dasProject, das::make_smart<das::FsFileAccess>());
+  auto fAccess = das::make_smart<ScriptFileAccess>();
   das::ModuleGroup libGroup;
-  libGroup.setUserData(new EcsModuleGroupData);
+  auto *moduleData = new EcsModuleGroupData;
+  moduleData->reusableQueries = dasMainQueries;
+  libGroup.setUserData(moduleData);
   const bool res = compile_and_simulate_script(dasCtx, dasMainScript, libGroup, fAccess);
-  if (res)
-  {
-    for (auto kv : dasMainSystems)
-      g_mgr->deleteSystem(kv.second);
 
-    for (QueryId qid : dasMainQueries)
-      g_mgr->deleteQuery(qid);
+  // A failed compilation is not repeated until one of the files is changed again
+  dasMainFiles = eastl::move(fAccess->scriptFiles);
 
-    dasMainSystems.clear();
-    dasMainQueries.clear();
+  if (res)
+  {
+    dasMainQueries = eastl::move(moduleData->dasQueriesByName);
+    moduleData->resolveQueries();
 
-    auto *moduleData = ((EcsModuleGroupData*)libGroup.getUserData("ecs"));
-    dasMainQueries = moduleData->dasQueries;
+    // Systems with the same signature are kept, they only take the data of the new program
+    for (auto it = dasMainSystems.begin(); it != dasMainSystems.end();)
+    {
+      auto s = moduleData->unresolvedSystems.find(it->first);
+      if (s == moduleData->unresolvedSystems.end() || s->second.signature != it->second.signature)
+      {
+        g_mgr->deleteSystem(it->second.sid);
+        it = dasMainSystems.erase(it);
+      }
+      else
+        ++it;
+    }
 
     for (auto &s : moduleData->unresolvedSystems)
     {
       auto res = dasMainSystems.insert(s.first);
+      if (res.second)
+      {
+        res.first->second.sid = g_mgr->createSystem(s.first.c_str(), s.second.systemDesc.release(), &s.second.queryDesc);
+        res.first->second.signature = s.second.signature;
+      }
 
-      SystemId sid = g_mgr->createSystem(s.first.c_str(), s.second.systemDesc.release(), &s.second.queryDesc);
-      res.first->second = sid;
-
+      SystemId sid = res.first->second.sid;
       g_mgr->queries[g_mgr->systems[sid.index].queryId.index].userData = eastl::move(s.second.queryData);
     }
 
-    for (auto kv : dasMainSystems)
+    for (auto &kv : dasMainSystems)
     {
-      SystemId sid = kv.second;
+      SystemId sid = kv.second.sid;
       DasQueryData *queryData = (DasQueryData*)g_mgr->queries[g_mgr->systems[sid.index].queryId.index].userData.get();
       queryData->ctx = dasCtx.get();
       queryData->fn  = dasCtx->findFunction(kv.first.c_str());
@@ -271,7 +380,7 @@ static bool reload_scripts()
   return res;
 }
 
-bool init_sample()
+static void init_das()
 {
   extern int das_def_tab_size;
   das_def_tab_size = 2;
@@ -291,10 +400,59 @@ bool init_sample()
   NEED_MODULE(RenderModule);
   NEED_MODULE(PhysModule);
   NEED_MODULE(SampleModule);
+}
 
+bool init_sample()
+{
+  init_das();
   return reload_scripts();
 }
 
+// sample --aot scripts/main.das main.das.aot.cpp, run by the build from the sample directory
+static bool aot_script(const char *path, const char *aot_path)
+{
+  init_das();
+
+  auto fAccess = das::make_smart<das::FsFileAccess>(dasProject, das::make_smart<das::FsFileAccess>());
+  DasContextPtr ctx;
+  das::ModuleGroup libGroup;
+  libGroup.setUserData(new EcsModuleGroupData);
+  return compile_and_simulate_script(ctx, path, libGroup, fAccess, aot_path);
+}
+
+// sample --export-level data/level_1.json data/level_1.ecsl
+static bool export_level(const char *json_path, const char *level_path)
+{
+  init_das();
+
+  auto fAccess = das::make_smart<das::FsFileAccess>(dasProject, das::make_smart<das::FsFileAccess>());
+  DasContextPtr ctx;
+  das::ModuleGroup libGroup;
+  libGroup.setUserData(new EcsModuleGroupData);
+  if (!compile_and_simulate_script(ctx, dasExportLevelScript, libGroup, fAccess))
+    return false;
+
+  das::SimFunction *fn = ctx->findFunction("export_level");
+  if (!fn)
+    return false;
+
+  vec4f args[1] = { das::cast<char*>::from((char*)json_path) };
+  ctx->evalWithCatch(fn, args);
+  if (ctx->getException())
+    return false;
+
+  // create_entity only queues the entities
+  LevelWriter writer;
+  for (; !g_mgr->createQueue.empty(); g_mgr->createQueue.pop())
+  {
+    const auto &q = g_mgr->createQueue.front();
+    if (!writer.add(q.templanemName.c_str(), q.components))
+      return false;
+  }
+
+  return writer.write(level_path);
+}
+
 struct RecordDescription
 {
   using offset_t = uint16_t;
@@ -772,6 +930,27 @@ int main(int argc, char *argv[])
   // TODO: Update queries after templates registratina has been done
   ecs::init();
 
+  if (argc == 4 && ::strcmp(argv[1], "--aot") == 0)
+    return aot_script(argv[2], argv[3]) ? 0 : 1;
+
+  if (argc == 4 && ::strcmp(argv[1], "--export-level") == 0)
+    return export_level(argv[2], argv[3]) ? 0 : 1;
+
+  for (int i = 1; i < argc; ++i)
+    if (::strcmp(argv[i], "--pipelined") == 0)
+    {
+      // Render reads the state of the previous frame while the update jobs are running
+      ecs::add_pipelined_stage<EventRender>();
+      ecs::set_pipelined(true);
+    }
+    else if (::strcmp(argv[i], "--profile") == 0 || ::strcmp(argv[i], "--profile-hw") == 0)
+    {
+      ecs::set_profiling(true, ::strcmp(argv[i], "--profile-hw") == 0);
+      ecs::set_profiling_report(300);
+    }
+    else if (::strcmp(argv[i], "--huge-pages") == 0)
+      memory::set_huge_pages(true);
+
   // test_struct();
 
   init_sample();
@@ -860,6 +1039,10 @@ int main(int argc, char *argv[])
     // This is valid until all jobs live one frame
     clear_frame_mem();
 
+    // All jobs are done here
+    if (IsKeyPressed(KEY_F9))
+      trace::dump_chrome_trace("trace.json");
+
     const float dt = glm::clamp(GetFrameTime(), 0.f, 1.f / 60.f);
     ecs::invoke_event_broadcast(EventUpdate{ dt, totalTime });
     const float delta = (float)((GetTime() - t) * 1e3);
@@ -23,18 +23,6 @@ struct HUD
 
 ECS_COMPONENT_TYPE(HUD);
 
-struct UserInput
-{
-  ECS_BIND_TYPE(sample, isLocal=true);
-  ECS_BIND_ALL_FIELDS;
-
-  bool left = false;
-  bool right = false;
-  bool jump = false;
-};
-
-ECS_COMPONENT_TYPE_BIND(UserInput);
-
 // TODO: Implement texture manager
 static eastl::hash_map<eastl::string, eastl::shared_ptr<Texture2D>> texture_map;
 void clear_textures()
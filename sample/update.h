@@ -75,4 +75,16 @@ struct AnimState
   ECS_DEFAULT_CTORS(AnimState);
 };
 
-ECS_COMPONENT_TYPE_BIND(AnimState);
\ No newline at end of file
+ECS_COMPONENT_TYPE_BIND(AnimState);
+
+struct UserInput
+{
+  ECS_BIND_TYPE(sample, isLocal=true);
+  ECS_BIND_ALL_FIELDS;
+
+  bool left = false;
+  bool right = false;
+  bool jump = false;
+};
+
+ECS_COMPONENT_TYPE_BIND(UserInput);
\ No newline at end of file
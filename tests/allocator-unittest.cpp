@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+#include <ecs/allocator.h>
+
+TEST(Allocator, Stat)
+{
+  const memory::Stat before = memory::get_stat(memory::Subsystem::kOther);
+
+  void *small = memory::alloc(memory::Subsystem::kOther, 100, 64);
+  void *large = memory::alloc(memory::Subsystem::kOther, 4 << 20);
+  EXPECT_EQ(0u, (uintptr_t)small & 63);
+  EXPECT_EQ(0u, (uintptr_t)large & (memory::DEFAULT_ALIGNMENT - 1));
+
+  ::memset(large, 1, 4 << 20);
+
+  memory::Stat stat = memory::get_stat(memory::Subsystem::kOther);
+  EXPECT_EQ(before.allocated + 100 + (4 << 20), stat.allocated);
+  EXPECT_EQ(before.allocationsCount + 2, stat.allocationsCount);
+  EXPECT_GE(stat.allocatedMax, stat.allocated);
+
+  memory::free(memory::Subsystem::kOther, small, 100);
+  memory::free(memory::Subsystem::kOther, large, 4 << 20);
+
+  stat = memory::get_stat(memory::Subsystem::kOther);
+  EXPECT_EQ(before.allocated, stat.allocated);
+  EXPECT_EQ(before.allocationsCount, stat.allocationsCount);
+}
+
+TEST(Allocator, HugePages)
+{
+  memory::set_huge_pages(true);
+
+  // Falls back to regular pages if huge pages are not available
+  const size_t sz = 8 << 20;
+  uint8_t *p = (uint8_t*)memory::alloc(memory::Subsystem::kOther, sz);
+  ASSERT_NE(nullptr, p);
+  ::memset(p, 1, sz);
+  const size_t hugePagesSize = memory::get_stat(memory::Subsystem::kOther).hugePagesSize;
+  if (hugePagesSize > 0)
+  {
+    EXPECT_EQ(sz, hugePagesSize);
+    // Pages start at a huge page boundary, the data follows the header of the block
+    EXPECT_EQ(0u, (uintptr_t)(p - memory::CACHE_LINE_SIZE) & (memory::HUGE_PAGE_SIZE - 1));
+  }
+  memory::free(memory::Subsystem::kOther, p, sz);
+
+  EXPECT_EQ(0u, memory::get_stat(memory::Subsystem::kOther).hugePagesSize);
+
+  memory::set_huge_pages(false);
+}
+
+TEST(Allocator, SubsystemAllocator)
+{
+  const memory::Stat before = memory::get_stat(memory::Subsystem::kQuery);
+
+  {
+    eastl::vector<int, memory::QueryAllocator> v;
+    for (int i = 0; i < 1000; ++i)
+      v.push_back(i);
+    EXPECT_GT(memory::get_stat(memory::Subsystem::kQuery).allocated, before.allocated);
+  }
+
+  EXPECT_EQ(before.allocated, memory::get_stat(memory::Subsystem::kQuery).allocated);
+}
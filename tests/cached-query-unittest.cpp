@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription CachedTest_components[] = {
+  {HASH("cached_value"), sizeof(int)},
+};
+static constexpr ConstQueryDescription CachedTest_query_desc = {
+  make_const_array(CachedTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+// QL_WHERE(cached_value >= 100) as codegen would emit it
+static constexpr ConstComponentDescription CachedTestBig_have_components[] = {
+  {HASH("cached_value"), 0},
+};
+static constexpr ConstQueryDescription CachedTestBig_query_desc = {
+  make_const_array(CachedTest_components),
+  make_const_array(CachedTestBig_have_components),
+  empty_desc_array,
+  make_const_array(CachedTestBig_have_components),
+};
+static LazyQueryDescription _reg_lazy_query_cached_test_big(CachedTestBig_query_desc, [](const Archetype &type, int entity_idx)
+{
+  GET_COMPONENT_VALUE(cached_value, int);
+  return cached_value >= 100;
+});
+
+struct CachedQueryTest : public testing::Test
+{
+  static constexpr int ENTITIES_COUNT = 1000;
+
+  EntityVector eids;
+
+  static void SetUpTestCase()
+  {
+    {
+      ComponentsMap cmap;
+      cmap.createComponent(HASH("cached_value"), find_component(HASH("int")));
+      g_mgr->addTemplate("cached-query-test", eastl::move(cmap));
+    }
+    {
+      ComponentsMap cmap;
+      cmap.createComponent(HASH("cached_value"), find_component(HASH("int")));
+      cmap.createComponent(HASH("cached_other"), find_component(HASH("float")));
+      g_mgr->addTemplate("cached-query-other-test", eastl::move(cmap));
+    }
+  }
+
+  void SetUp() override
+  {
+    for (int i = 0; i < ENTITIES_COUNT; ++i)
+      create("cached-query-test", i);
+  }
+
+  void TearDown() override
+  {
+    for (const auto &eid : eids)
+      ecs::delete_entity(eid);
+    eids.clear();
+    ecs::tick();
+  }
+
+  void create(const char *templ, int value)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("cached_value"), value);
+    eids.emplace_back() = g_mgr->createEntitySync(templ, eastl::move(cmap));
+  }
+
+  static int sum(Query &query)
+  {
+    int res = 0;
+    for (auto q = query.begin(), e = query.end(); q != e; ++q)
+      res += q.get<int>(0);
+    return res;
+  }
+};
+
+TEST_F(CachedQueryTest, Structure)
+{
+  Query &query = ecs::perform_cached_query(CachedTest_query_desc);
+  EXPECT_EQ(ENTITIES_COUNT, query.entitiesCount);
+
+  // Nothing changed, the same result is returned as is
+  const uint8_t *firstChunk = query.chunks[0];
+  EXPECT_EQ(&query, &ecs::perform_cached_query(CachedTest_query_desc));
+  EXPECT_EQ(firstChunk, query.chunks[0]);
+
+  create("cached-query-test", -1);
+  EXPECT_EQ(ENTITIES_COUNT + 1, ecs::perform_cached_query(CachedTest_query_desc).entitiesCount);
+
+  // New archetype
+  create("cached-query-other-test", -2);
+  EXPECT_EQ(ENTITIES_COUNT + 2, ecs::perform_cached_query(CachedTest_query_desc).entitiesCount);
+  EXPECT_EQ(ENTITIES_COUNT * (ENTITIES_COUNT - 1) / 2 - 3, sum(ecs::perform_cached_query(CachedTest_query_desc)));
+
+  ecs::delete_entity(eids.back());
+  eids.pop_back();
+  ecs::tick();
+  EXPECT_EQ(ENTITIES_COUNT + 1, ecs::perform_cached_query(CachedTest_query_desc).entitiesCount);
+}
+
+TEST_F(CachedQueryTest, Filter)
+{
+  EXPECT_EQ(ENTITIES_COUNT - 100, ecs::perform_cached_query(_reg_lazy_query_cached_test_big).entitiesCount);
+
+  FrameSnapshot snapshot;
+  g_mgr->fillFrameSnapshot(snapshot);
+
+  // Values are not structure, only change detection drops the result
+  for (int i = 0; i < 10; ++i)
+  {
+    const Entity &e = g_mgr->entities[eids[i].index];
+    Archetype &type = g_mgr->archetypes[e.archetypeId];
+    *(int*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("cached_value"))) = 1000 + i;
+  }
+
+  g_mgr->checkFrameSnapshot(snapshot);
+
+  EXPECT_EQ(ENTITIES_COUNT - 90, ecs::perform_cached_query(_reg_lazy_query_cached_test_big).entitiesCount);
+}
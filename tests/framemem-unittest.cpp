@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+#include <ecs/framemem.h>
+
+#include <thread>
+
+TEST(FrameMem, Alignment)
+{
+  clear_frame_mem();
+
+  alloc_frame_mem(1);
+  uint8_t *mem = alloc_frame_mem(64, 64);
+  EXPECT_EQ(0u, (uintptr_t)mem & 63);
+
+  clear_frame_mem();
+}
+
+TEST(FrameMem, GrowOnOverflow)
+{
+  clear_frame_mem();
+
+  // The block size is taken by the first allocation of a thread, so the arena is created by a new one
+  set_frame_mem_block_size(1 << 10);
+
+  std::thread thread([]()
+  {
+    static const size_t allocatedSize = sizeof(int) * 16 * 1024;
+
+    // Arenas of the thread are registered after the existing ones
+    eastl::vector<FrameMemStat> stat;
+    get_frame_mem_stat(stat);
+    const uint32_t firstIndex = (uint32_t)stat.size();
+
+    // Must not overlap after the first block is full
+    eastl::vector<int*> ptrs;
+    for (int i = 0; i < 1024; ++i)
+    {
+      int *p = (int*)alloc_frame_mem(sizeof(int) * 16);
+      for (int j = 0; j < 16; ++j)
+        p[j] = i;
+      ptrs.push_back(p);
+    }
+
+    for (int i = 0; i < 1024; ++i)
+      for (int j = 0; j < 16; ++j)
+        EXPECT_EQ(i, ptrs[i][j]);
+
+    auto findArena = [firstIndex](const eastl::vector<FrameMemStat> &stat)
+    {
+      for (const FrameMemStat &s : stat)
+        if (s.threadIndex >= firstIndex && s.allocatedMax >= allocatedSize)
+          return &s;
+      return (const FrameMemStat*)nullptr;
+    };
+
+    get_frame_mem_stat(stat);
+    const FrameMemStat *arena = findArena(stat);
+    ASSERT_NE(nullptr, arena);
+    EXPECT_GE(arena->allocated, allocatedSize);
+    EXPECT_GT(arena->blocksCount, 1);
+
+    clear_frame_mem();
+
+    // The arena is merged to one block which fits the previous frame
+    get_frame_mem_stat(stat);
+    arena = findArena(stat);
+    ASSERT_NE(nullptr, arena);
+    EXPECT_EQ(0u, arena->allocated);
+    EXPECT_EQ(1, arena->blocksCount);
+    EXPECT_GE(arena->reserved, allocatedSize);
+  });
+  thread.join();
+
+  set_frame_mem_block_size(1 << 20);
+}
+
+TEST(FrameMem, DoubleFrame)
+{
+  clear_frame_mem();
+
+  int *value = (int*)alloc_double_frame_mem(sizeof(int));
+  *value = 42;
+
+  // The next frame reuses frame memory but not the double-buffered one
+  clear_frame_mem();
+  int *other = (int*)alloc_double_frame_mem(sizeof(int));
+  *other = 0;
+  EXPECT_NE(value, other);
+  EXPECT_EQ(42, *value);
+
+  clear_frame_mem();
+  clear_frame_mem();
+}
+
+TEST(FrameMem, Threads)
+{
+  clear_frame_mem();
+
+  static const int count = 4;
+  static const int allocs = 1000;
+
+  eastl::vector<int*> ptrs;
+  ptrs.resize(count * allocs);
+
+  eastl::vector<std::thread> threads;
+  for (int t = 0; t < count; ++t)
+    threads.emplace_back([t, &ptrs]()
+    {
+      for (int i = 0; i < allocs; ++i)
+      {
+        int *p = (int*)alloc_frame_mem(sizeof(int));
+        *p = t * allocs + i;
+        ptrs[t * allocs + i] = p;
+      }
+    });
+
+  for (auto &thread : threads)
+    thread.join();
+
+  for (int i = 0; i < count * allocs; ++i)
+    EXPECT_EQ(i, *ptrs[i]);
+
+  clear_frame_mem();
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription IndexTest_components[] = {
+  {HASH("cell_x"), sizeof(int)},
+  {HASH("cell_y"), sizeof(int)},
+};
+static constexpr ConstQueryDescription IndexTest_query_desc = {
+  make_const_array(IndexTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+static constexpr ConstHashedString IndexTest_keys[] = { HASH("cell_x"), HASH("cell_y") };
+static IndexDescription _reg_index_composite_test(HASH("composite_test_index"), make_const_array(IndexTest_keys), IndexTest_query_desc);
+
+struct IndexTest : public testing::Test
+{
+  // Enough entities for the full rebuild to run in several jobs
+  static constexpr int ENTITIES_COUNT = 10000;
+
+  EntityVector eids;
+
+  static void SetUpTestCase()
+  {
+    ComponentsMap cmap;
+    cmap.createComponent(HASH("cell_x"), find_component(HASH("int")));
+    cmap.createComponent(HASH("cell_y"), find_component(HASH("int")));
+    g_mgr->addTemplate("index-test", eastl::move(cmap));
+  }
+
+  void SetUp() override
+  {
+    for (int i = 0; i < ENTITIES_COUNT; ++i)
+    {
+      ComponentsMap cmap;
+      cmap.add(HASH("cell_x"), i % 4);
+      cmap.add(HASH("cell_y"), i % 5);
+      eids.emplace_back() = g_mgr->createEntitySync("index-test", eastl::move(cmap));
+    }
+    g_mgr->rebuildIndex(*ecs::find_index(HASH("composite_test_index")));
+  }
+
+  void TearDown() override
+  {
+    for (const auto &eid : eids)
+      ecs::delete_entity(eid);
+    eids.clear();
+    ecs::tick();
+  }
+};
+
+static int count_cell(const IndexBucket &bucket, int x, int y)
+{
+  int count = 0;
+  for (auto q = bucket.begin(), e = bucket.end(); q != e; ++q, ++count)
+  {
+    EXPECT_EQ(x, q.get<int>(0));
+    EXPECT_EQ(y, q.get<int>(1));
+  }
+  EXPECT_EQ(bucket.entitiesCount, count);
+  return count;
+}
+
+TEST_F(IndexTest, CompositeKey)
+{
+  Index *index = ecs::find_index(HASH("composite_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  EXPECT_EQ(20, index->itemsCount());
+  for (int x = 0; x < 4; ++x)
+    for (int y = 0; y < 5; ++y)
+      EXPECT_EQ(ENTITIES_COUNT / 20, count_cell(index->find(x, y), x, y));
+
+  // No entity of a key is next to another one
+  EXPECT_EQ(ENTITIES_COUNT, index->memberOffsets.back());
+  EXPECT_EQ(ENTITIES_COUNT, index->rows.chunksCount);
+
+  EXPECT_FALSE(index->find(4, 0));
+  // Lookups must pass every key component, find() asserts the size
+  EXPECT_EQ(int(sizeof(int) * 2), index->keySize);
+}
+
+TEST_F(IndexTest, IncrementalUpdate)
+{
+  Index *index = ecs::find_index(HASH("composite_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  // Move every 10th entity of (0, 0) to (7, 7)
+  FrameSnapshot snapshot;
+  g_mgr->fillFrameSnapshot(snapshot);
+
+  int moved = 0;
+  for (int i = 0; i < ENTITIES_COUNT; i += 20)
+    if ((i / 20) % 10 == 0)
+    {
+      const Entity &e = g_mgr->entities[eids[i].index];
+      Archetype &type = g_mgr->archetypes[e.archetypeId];
+      *(int*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("cell_x"))) = 7;
+      *(int*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("cell_y"))) = 7;
+      ++moved;
+    }
+
+  g_mgr->checkFrameSnapshot(snapshot);
+  ecs::tick();
+
+  EXPECT_EQ(ENTITIES_COUNT / 20 - moved, count_cell(index->find(0, 0), 0, 0));
+  EXPECT_EQ(moved, count_cell(index->find(7, 7), 7, 7));
+  EXPECT_EQ(ENTITIES_COUNT / 20, count_cell(index->find(1, 1), 1, 1));
+
+  // Matches the full rebuild
+  g_mgr->rebuildIndex(*index);
+  EXPECT_EQ(ENTITIES_COUNT / 20 - moved, count_cell(index->find(0, 0), 0, 0));
+  EXPECT_EQ(moved, count_cell(index->find(7, 7), 7, 7));
+}
+
+TEST_F(IndexTest, RetireEmptyItems)
+{
+  Index *index = ecs::find_index(HASH("composite_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  auto moveCell = [this](int from_x, int from_y, int to_x, int to_y)
+  {
+    FrameSnapshot snapshot;
+    g_mgr->fillFrameSnapshot(snapshot);
+
+    for (const auto &eid : eids)
+    {
+      const Entity &e = g_mgr->entities[eid.index];
+      Archetype &type = g_mgr->archetypes[e.archetypeId];
+      int &x = *(int*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("cell_x")));
+      int &y = *(int*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("cell_y")));
+      if (x == from_x && y == from_y)
+      {
+        x = to_x;
+        y = to_y;
+      }
+    }
+
+    g_mgr->checkFrameSnapshot(snapshot);
+    ecs::tick();
+  };
+
+  // (0, 0) is retired and its id is reused by (8, 8)
+  moveCell(0, 0, 7, 7);
+  EXPECT_FALSE(index->find(0, 0));
+  EXPECT_EQ(20, index->liveItemsCount());
+
+  moveCell(7, 7, 8, 8);
+  EXPECT_FALSE(index->find(7, 7));
+  EXPECT_EQ(ENTITIES_COUNT / 20, count_cell(index->find(8, 8), 8, 8));
+  EXPECT_EQ(21, index->itemsCount());
+  EXPECT_EQ(20, index->liveItemsCount());
+  EXPECT_EQ(ENTITIES_COUNT / 20, count_cell(index->find(1, 2), 1, 2));
+  EXPECT_EQ(ENTITIES_COUNT, index->memberOffsets.back());
+}
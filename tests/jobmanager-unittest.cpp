@@ -3,6 +3,9 @@
 #include <ecs/ecs.h>
 #include <ecs/jobmanager.h>
 
+#include <thread>
+#include <chrono>
+
 TEST(JobManager, doAndWaitAllTasksDone)
 {
   static const int count = 10000;
@@ -80,4 +83,39 @@ TEST(JobManager, Dependencies)
       EXPECT_EQ(i * 2, data[i]);
     else
       EXPECT_EQ((count - i) * 2, data[i]);
-}
\ No newline at end of file
+}
+TEST(JobManager, OwnerStats)
+{
+  static const uint32_t group = 1000;
+
+  eastl::vector<jobmanager::OwnerStat> stats;
+  jobmanager::collect_owner_stats(group, stats);
+  stats.clear();
+
+  auto task = [](int, int count)
+  {
+    // Jobs created by tasks are attributed to the owner of the task's job
+    if (count == 1)
+    {
+      jobmanager::add_job(1, 1, [](int, int) { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+      jobmanager::start_jobs();
+    }
+  };
+
+  jobmanager::set_job_owner(hwcounters::make_owner(group, 1));
+  jobmanager::add_job(1, 1, task);
+  jobmanager::add_job(4, 2, task);
+  jobmanager::set_job_owner(0);
+  jobmanager::add_job(1, 1, task);
+  jobmanager::wait_all_jobs();
+
+  jobmanager::collect_owner_stats(group, stats);
+  ASSERT_EQ(2u, stats.size());
+  EXPECT_EQ(3, stats[1].jobs);
+  EXPECT_GE(stats[1].taskTime, 2.0);
+  EXPECT_EQ(0, stats[0].jobs);
+
+  stats.clear();
+  jobmanager::collect_owner_stats(group, stats);
+  EXPECT_TRUE(stats.empty());
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription JoinA_components[] = {
+  {HASH("join_a_key"), sizeof(int)},
+  {HASH("join_a_id"), sizeof(int)},
+};
+static constexpr ConstQueryDescription JoinA_query_desc = {
+  make_const_array(JoinA_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+static constexpr ConstComponentDescription JoinB_components[] = {
+  {HASH("join_b_id"), sizeof(int)},
+  {HASH("join_b_key"), sizeof(int)},
+};
+static constexpr ConstQueryDescription JoinB_query_desc = {
+  make_const_array(JoinB_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+struct HashJoinTest : public testing::Test
+{
+  // Tens of thousands of rows on the larger side
+  static constexpr int A_COUNT = 20000;
+  static constexpr int B_COUNT = 3000;
+  static constexpr int KEYS_COUNT = 1000;
+
+  EntityVector eids;
+
+  static void SetUpTestCase()
+  {
+    {
+      ComponentsMap cmap;
+      cmap.createComponent(HASH("join_a_key"), find_component(HASH("int")));
+      cmap.createComponent(HASH("join_a_id"), find_component(HASH("int")));
+      g_mgr->addTemplate("join-a-test", eastl::move(cmap));
+    }
+    {
+      ComponentsMap cmap;
+      cmap.createComponent(HASH("join_b_id"), find_component(HASH("int")));
+      cmap.createComponent(HASH("join_b_key"), find_component(HASH("int")));
+      g_mgr->addTemplate("join-b-test", eastl::move(cmap));
+    }
+  }
+
+  static int keyOfA(int i) { return (i * 7) % KEYS_COUNT; }
+  // Half of the keys of B are not in A
+  static int keyOfB(int i) { return (i * 13) % (KEYS_COUNT * 2); }
+
+  void SetUp() override
+  {
+    for (int i = 0; i < A_COUNT; ++i)
+    {
+      ComponentsMap cmap;
+      cmap.add(HASH("join_a_key"), keyOfA(i));
+      cmap.add(HASH("join_a_id"), i);
+      eids.emplace_back() = g_mgr->createEntitySync("join-a-test", eastl::move(cmap));
+    }
+    for (int i = 0; i < B_COUNT; ++i)
+    {
+      ComponentsMap cmap;
+      cmap.add(HASH("join_b_id"), i);
+      cmap.add(HASH("join_b_key"), keyOfB(i));
+      eids.emplace_back() = g_mgr->createEntitySync("join-b-test", eastl::move(cmap));
+    }
+  }
+
+  void TearDown() override
+  {
+    for (const auto &eid : eids)
+      ecs::delete_entity(eid);
+    eids.clear();
+    ecs::tick();
+  }
+
+  static int64_t expectedPairs()
+  {
+    eastl::vector<int64_t> countA(KEYS_COUNT * 2, 0);
+    eastl::vector<int64_t> countB(KEYS_COUNT * 2, 0);
+    for (int i = 0; i < A_COUNT; ++i)
+      ++countA[keyOfA(i)];
+    for (int i = 0; i < B_COUNT; ++i)
+      ++countB[keyOfB(i)];
+    int64_t pairs = 0;
+    for (int k = 0; k < KEYS_COUNT * 2; ++k)
+      pairs += countA[k] * countB[k];
+    return pairs;
+  }
+};
+
+TEST_F(HashJoinTest, LargerFirst)
+{
+  Query a = ecs::perform_query(JoinA_query_desc);
+  Query b = ecs::perform_query(JoinB_query_desc);
+  ASSERT_EQ(A_COUNT, a.entitiesCount);
+  ASSERT_EQ(B_COUNT, b.entitiesCount);
+
+  int64_t pairs = 0;
+  int prevId = -1;
+  hash_join<int>(a, 0, b, 1, [&](QueryIterator &qa, QueryIterator &qb)
+  {
+    const int idA = qa.get<int>(1);
+    const int idB = qb.get<int>(0);
+    EXPECT_EQ(keyOfA(idA), qa.get<int>(0));
+    EXPECT_EQ(keyOfB(idB), qb.get<int>(1));
+    EXPECT_EQ(qa.get<int>(0), qb.get<int>(1));
+    // The larger side probes in its order
+    EXPECT_LE(prevId, idA);
+    prevId = idA;
+    ++pairs;
+  });
+  EXPECT_EQ(expectedPairs(), pairs);
+}
+
+TEST_F(HashJoinTest, SmallerFirst)
+{
+  Query a = ecs::perform_query(JoinA_query_desc);
+  Query b = ecs::perform_query(JoinB_query_desc);
+
+  int64_t pairs = 0;
+  hash_join<int>(b, 1, a, 0, [&](QueryIterator &qb, QueryIterator &qa)
+  {
+    EXPECT_EQ(qb.get<int>(1), qa.get<int>(0));
+    EXPECT_EQ(keyOfB(qb.get<int>(0)), qb.get<int>(1));
+    ++pairs;
+  });
+  EXPECT_EQ(expectedPairs(), pairs);
+}
+
+TEST_F(HashJoinTest, Empty)
+{
+  Query a = ecs::perform_query(JoinA_query_desc);
+  Query empty;
+
+  int pairs = 0;
+  hash_join<int>(a, 0, empty, 0, [&](QueryIterator &, QueryIterator &) { ++pairs; });
+  hash_join<int>(empty, 0, a, 0, [&](QueryIterator &, QueryIterator &) { ++pairs; });
+  EXPECT_EQ(0, pairs);
+}
+
+TEST_F(HashJoinTest, KeyTypes)
+{
+  static_assert(is_hash_join_key<int>::value, "");
+  static_assert(is_hash_join_key<EntityId>::value, "");
+  static_assert(!is_hash_join_key<float>::value, "-0.f == 0.f has other bytes");
+  static_assert(!is_hash_join_key<glm::vec2>::value, "");
+
+  Query a = ecs::perform_query(JoinA_query_desc);
+  Query b = ecs::perform_query(JoinB_query_desc);
+
+  int64_t pairs = 0;
+  equi_join<int>(a, 0, b, 1, [&](QueryIterator &qa, QueryIterator &qb)
+  {
+    EXPECT_EQ(qa.get<int>(0), qb.get<int>(1));
+    ++pairs;
+  });
+  EXPECT_EQ(expectedPairs(), pairs);
+
+  // Nested loop visits every pair, keys are checked by the callback
+  Query empty;
+  pairs = 0;
+  equi_join<float>(a, 0, empty, 0, [&](QueryIterator &, QueryIterator &) { ++pairs; });
+  EXPECT_EQ(0, pairs);
+}
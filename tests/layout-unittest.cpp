@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+struct SoAVec2
+{
+  using value_type = float;
+  float x = 0.f;
+  float y = 0.f;
+};
+
+ECS_COMPONENT_TYPE(SoAVec2);
+ECS_COMPONENT_LAYOUT(SoAVec2, soa);
+
+static ComponentDescriptionDetails<SoAVec2> soa_vec2_desc("SoAVec2");
+
+static void scale(SoAVec2 &v, const SoAVec2 &s)
+{
+  v.x *= s.x;
+  v.y *= s.y;
+}
+
+TEST(Layout, Description)
+{
+  EXPECT_TRUE(soa_vec2_desc.isSoA());
+  EXPECT_EQ(2, soa_vec2_desc.soaFieldsCount);
+  EXPECT_EQ((int)sizeof(float), soa_vec2_desc.soaFieldSize);
+
+  static_assert(ComponentLayout<const SoAVec2>::soa, "");
+  static_assert(!ComponentLayout<glm::vec2>::soa, "");
+}
+
+TEST(Layout, StorageLanes)
+{
+  const int count = SOA_BLOCK_SIZE + 10;
+
+  Archetype::Storage storage(&soa_vec2_desc);
+  ASSERT_TRUE(storage.soa);
+  EXPECT_EQ(2 * SOA_BLOCK_SIZE * sizeof(SoAVec2), storage.columnSize(count));
+
+  eastl::vector<uint8_t> column(storage.columnSize(count));
+  storage.items = column.data();
+
+  for (int i = 0; i < count; ++i)
+  {
+    SoAVec2 v;
+    v.x = float(i);
+    v.y = float(-i);
+    storage.ctor(i, (const uint8_t*)&v);
+  }
+
+  const float *lanes = (const float*)column.data();
+  for (int i = 0; i < count; ++i)
+  {
+    const float *block = lanes + (i / SOA_BLOCK_SIZE) * SOA_BLOCK_SIZE * 2;
+    EXPECT_EQ(float(i), block[i % SOA_BLOCK_SIZE]) << i;
+    EXPECT_EQ(float(-i), block[SOA_BLOCK_SIZE + i % SOA_BLOCK_SIZE]) << i;
+    EXPECT_EQ((const uint8_t*)&block[i % SOA_BLOCK_SIZE], storage.get(i)) << i;
+  }
+}
+
+TEST(Layout, RefAndSpan)
+{
+  eastl::vector<float> column(2 * SOA_BLOCK_SIZE);
+  for (int i = 0; i < SOA_BLOCK_SIZE; ++i)
+  {
+    column[i] = float(i);
+    column[SOA_BLOCK_SIZE + i] = 1.f;
+  }
+
+  auto * __restrict items = (SoAItem<SoAVec2>*)column.data();
+  const auto * __restrict scales = (const SoAItem<SoAVec2>*)column.data();
+
+  // Changes are written back to the lanes
+  SoAVec2 s;
+  s.x = 2.f;
+  s.y = 3.f;
+  scale(ecs_ref(items[5]), s);
+  EXPECT_EQ(10.f, column[5]);
+  EXPECT_EQ(3.f, column[SOA_BLOCK_SIZE + 5]);
+
+  const SoAVec2 v = ecs_ref(scales[7]);
+  EXPECT_EQ(7.f, v.x);
+  EXPECT_EQ(1.f, v.y);
+
+  Lanes<SoAVec2> lanes = ecs_span(items + 4, 8);
+  EXPECT_EQ(8, lanes.size());
+  EXPECT_EQ(2, lanes.lanesCount());
+  EXPECT_EQ(4.f, lanes.lane(0)[0]);
+  EXPECT_EQ(10.f, lanes.lane(0)[1]);
+  EXPECT_EQ(3.f, lanes.lane(1)[1]);
+
+  Lanes<const SoAVec2> constLanes = lanes;
+  EXPECT_EQ(&column[SOA_BLOCK_SIZE + 4], constLanes.lane(1).begin());
+
+  // Regular components are passed as is
+  glm::vec2 aos[2] = {};
+  EXPECT_EQ(&aos[1], &ecs_ref(aos[1]));
+  EXPECT_EQ(&aos[0], ecs_span(aos, 2).begin());
+}
+
+TEST(Layout, ChunksDoNotCrossBlocks)
+{
+  const HashedString name = hash_str("pos");
+
+  Archetype type;
+  type.componentsCount = 1;
+  type.storages.reset(new Archetype::Storage[1]);
+  type.storageNames.reset(new HashedString[1]);
+  new (&type.storages[0]) Archetype::Storage(&soa_vec2_desc);
+  type.storageNames[0] = name;
+  type.hasSoA = true;
+
+  ComponentsMap init;
+  init.createComponent(name, &soa_vec2_desc);
+
+  const int count = 2 * SOA_BLOCK_SIZE + 20;
+  for (int i = 0; i < count; ++i)
+  {
+    ComponentsMap cmap;
+    ((SoAVec2*)cmap.createComponent(name, &soa_vec2_desc))->x = float(i);
+    type.allocate(init, eastl::move(cmap));
+  }
+
+  QueryDescription desc;
+  Component comp;
+  comp.name = name;
+  comp.size = sizeof(SoAVec2);
+  comp.desc = &soa_vec2_desc;
+  desc.components.push_back(comp);
+
+  Query query;
+  query.componentsCount = 1;
+  query.addChunks(desc, type, 10, count - 10);
+
+  ASSERT_EQ(3, query.chunksCount);
+  EXPECT_EQ(SOA_BLOCK_SIZE - 10, query.entitiesInChunk[0]);
+  EXPECT_EQ(SOA_BLOCK_SIZE, query.entitiesInChunk[1]);
+  EXPECT_EQ(20, query.entitiesInChunk[2]);
+
+  int i = 10;
+  for (auto q = query.begin(), e = query.end(); q != e; ++q, ++i)
+  {
+    const SoAVec2 v = q.get<SoAVec2>(0);
+    EXPECT_EQ(float(i), v.x);
+  }
+  EXPECT_EQ(count, i);
+
+  type.clear();
+}
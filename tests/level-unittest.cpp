@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription LevelTest_components[] = {
+  {HASH("eid"), sizeof(EntityId)},
+  {HASH("level_value"), sizeof(int)},
+  {HASH("level_pos"), sizeof(glm::vec2)},
+  {HASH("level_name"), sizeof(eastl::string)},
+  {HASH("level_default"), sizeof(float)},
+};
+static constexpr ConstQueryDescription LevelTest_query_desc = {
+  make_const_array(LevelTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+struct LevelTest : public testing::Test
+{
+  static constexpr int ENTITIES_COUNT = 1000;
+  static constexpr char const *LEVEL_PATH = "level-unittest.ecsl";
+
+  static void SetUpTestCase()
+  {
+    ComponentsMap cmap;
+    cmap.createComponent(HASH("level_value"), find_component(HASH("int")));
+    cmap.createComponent(HASH("level_pos"), find_component("vec2"));
+    cmap.createComponent(HASH("level_name"), find_component("string"));
+    *(float*)cmap.createComponent(HASH("level_default"), find_component(HASH("float"))) = 5.f;
+    g_mgr->addTemplate("level-test", eastl::move(cmap));
+  }
+
+  void TearDown() override
+  {
+    Query query = ecs::perform_query(LevelTest_query_desc);
+    for (auto q = query.begin(), e = query.end(); q != e; ++q)
+      ecs::delete_entity(q.get<EntityId>(0));
+    ecs::tick();
+
+    ::remove(LEVEL_PATH);
+  }
+};
+
+TEST_F(LevelTest, RoundTrip)
+{
+  LevelWriter writer;
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("level_value"), i);
+    cmap.add(HASH("level_pos"), glm::vec2(float(i), float(-i)));
+    // Another set of components, another group
+    if (i % 2)
+      cmap.add(HASH("level_name"), eastl::string(eastl::string::CtorSprintf(), "entity-%d", i));
+    ASSERT_TRUE(writer.add("level-test", cmap));
+  }
+  EXPECT_EQ(2, writer.groups.size());
+  ASSERT_TRUE(writer.write(LEVEL_PATH));
+
+  ASSERT_TRUE(ecs::load_level(LEVEL_PATH));
+  EXPECT_EQ(0, ecs::perform_query(LevelTest_query_desc).entitiesCount);
+
+  ecs::tick();
+
+  Query query = ecs::perform_query(LevelTest_query_desc);
+  EXPECT_EQ(ENTITIES_COUNT, query.entitiesCount);
+
+  eastl::bitvector<> found(ENTITIES_COUNT, false);
+  for (auto q = query.begin(), e = query.end(); q != e; ++q)
+  {
+    const EntityId eid = q.get<EntityId>(0);
+    const int value = q.get<int>(1);
+    ASSERT_TRUE(value >= 0 && value < ENTITIES_COUNT);
+    EXPECT_FALSE(found[value]);
+    found[value] = true;
+
+    const Entity &entity = g_mgr->entities[eid.index];
+    EXPECT_TRUE(entity.ready);
+    const Archetype &type = g_mgr->archetypes[entity.archetypeId];
+    EXPECT_EQ(eid, type.get<EntityId>(entity.indexInArchetype, type.getComponentIndex(HASH("eid"))));
+
+    EXPECT_EQ(glm::vec2(float(value), float(-value)), q.get<glm::vec2>(2));
+    if (value % 2)
+      EXPECT_EQ(eastl::string(eastl::string::CtorSprintf(), "entity-%d", value), q.get<eastl::string>(3));
+    else
+      EXPECT_TRUE(q.get<eastl::string>(3).empty());
+    EXPECT_EQ(5.f, q.get<float>(4));
+  }
+}
+
+static int level_test_created = 0;
+
+static void level_test_on_create(const RawArg&, Query &query)
+{
+  level_test_created += query.entitiesCount;
+}
+
+static SystemDescription _reg_sys_level_test_on_create(HASH("level_test_on_create"), &level_test_on_create, HASH("EventOnEntityCreate"), LevelTest_query_desc, "*", "*", nullptr);
+
+TEST_F(LevelTest, Async)
+{
+  LevelWriter writer;
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("level_value"), i);
+    ASSERT_TRUE(writer.add("level-test", cmap));
+  }
+  ASSERT_TRUE(writer.write(LEVEL_PATH));
+
+  level_test_created = 0;
+  ASSERT_TRUE(ecs::load_level_async(LEVEL_PATH));
+  while (!g_mgr->levelQueue.empty())
+    ecs::tick();
+
+  EXPECT_EQ(ENTITIES_COUNT, level_test_created);
+
+  Query query = ecs::perform_query(LevelTest_query_desc);
+  EXPECT_EQ(ENTITIES_COUNT, query.entitiesCount);
+
+  int sum = 0;
+  for (auto q = query.begin(), e = query.end(); q != e; ++q)
+  {
+    sum += q.get<int>(1);
+    EXPECT_EQ(glm::vec2(0.f, 0.f), q.get<glm::vec2>(2));
+    EXPECT_EQ(5.f, q.get<float>(4));
+  }
+  EXPECT_EQ(ENTITIES_COUNT * (ENTITIES_COUNT - 1) / 2, sum);
+}
+
+TEST_F(LevelTest, Invalid)
+{
+  EXPECT_FALSE(ecs::load_level("level-unittest-not-found.ecsl"));
+
+  LevelWriter writer;
+  ComponentsMap cmap;
+  cmap.add(HASH("level_value"), 1);
+  ASSERT_TRUE(writer.add("level-test", cmap));
+  ASSERT_TRUE(writer.write(LEVEL_PATH));
+
+  // The size in the header doesn't match the file
+  FILE *f = ::fopen(LEVEL_PATH, "r+b");
+  ASSERT_TRUE(f != nullptr);
+  LevelHeader header;
+  ASSERT_EQ(1, ::fread(&header, sizeof(header), 1, f));
+  header.size += 1;
+  ::fseek(f, 0, SEEK_SET);
+  ::fwrite(&header, sizeof(header), 1, f);
+  ::fclose(f);
+
+  EXPECT_FALSE(ecs::load_level(LEVEL_PATH));
+  EXPECT_TRUE(g_mgr->levelQueue.empty());
+}
+
+TEST_F(LevelTest, BrokenComponent)
+{
+  static constexpr char const *NAME = "broken-level-name";
+
+  LevelWriter writer;
+  for (int i = 0; i < 2; ++i)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("level_value"), i);
+    cmap.add(HASH("level_name"), eastl::string(NAME));
+    ASSERT_TRUE(writer.add("level-test", cmap));
+  }
+  ASSERT_TRUE(writer.write(LEVEL_PATH));
+
+  // The length of the last string runs past the column
+  FILE *f = ::fopen(LEVEL_PATH, "r+b");
+  ASSERT_TRUE(f != nullptr);
+  eastl::vector<char> data(1 << 16);
+  data.resize(::fread(data.data(), 1, data.size(), f));
+  auto nameIt = eastl::find_end(data.begin(), data.end(), NAME, NAME + ::strlen(NAME));
+  ASSERT_TRUE(nameIt != data.end());
+  const uint32_t brokenSize = 0xffffff;
+  ::fseek(f, long(nameIt - data.begin()) - (long)sizeof(brokenSize), SEEK_SET);
+  ::fwrite(&brokenSize, sizeof(brokenSize), 1, f);
+  ::fclose(f);
+
+  level_test_created = 0;
+  ASSERT_TRUE(ecs::load_level(LEVEL_PATH));
+  ecs::tick();
+
+  EXPECT_TRUE(g_mgr->levelQueue.empty());
+  EXPECT_EQ(0, level_test_created);
+  EXPECT_EQ(0, ecs::perform_query(LevelTest_query_desc).entitiesCount);
+}
@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription OrderedTest_components[] = {
+  {HASH("ordered_dist"), sizeof(float)},
+  {HASH("ordered_id"), sizeof(int)},
+};
+static constexpr ConstQueryDescription OrderedTest_query_desc = {
+  make_const_array(OrderedTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+static OrderedIndexDescription _reg_ordered_index_test(HASH("ordered_test_index"), HASH("ordered_dist"), &ordered_key<float>, OrderedTest_query_desc);
+
+// QL_WHERE(ordered_dist < 10 && ordered_id % 2 == 0) as codegen would emit it
+static constexpr ConstComponentDescription OrderedTestNear_components[] = {
+  {HASH("ordered_id"), sizeof(int)},
+};
+static constexpr ConstComponentDescription OrderedTestNear_have_components[] = {
+  {HASH("ordered_dist"), 0},
+};
+static constexpr ConstQueryDescription OrderedTestNear_query_desc = {
+  make_const_array(OrderedTestNear_components),
+  make_const_array(OrderedTestNear_have_components),
+  empty_desc_array,
+  empty_desc_array,
+};
+static PersistentQueryDescription _reg_query_ordered_test_near(HASH("ordered_test_near"), OrderedTestNear_query_desc, [](const Archetype &type, int entity_idx)
+{
+  GET_COMPONENT_VALUE(ordered_dist, float);
+  GET_COMPONENT_VALUE(ordered_id, int);
+  return ordered_dist < 10 && ordered_id % 2 == 0;
+});
+static OrderedQueryPlan _plan_ordered_test_near(HASH("ordered_test_near"), HASH("ordered_dist"), OrderedRange::less(10));
+
+struct OrderedIndexTest : public testing::Test
+{
+  static constexpr int ENTITIES_COUNT = 10000;
+
+  EntityVector eids;
+  eastl::vector<float> dists;
+
+  static void SetUpTestCase()
+  {
+    ComponentsMap cmap;
+    cmap.createComponent(HASH("ordered_dist"), find_component(HASH("float")));
+    cmap.createComponent(HASH("ordered_id"), find_component(HASH("int")));
+    g_mgr->addTemplate("ordered-index-test", eastl::move(cmap));
+  }
+
+  void SetUp() override
+  {
+    // Every key in [0, 100) with 0.01 step once, in shuffled order
+    for (int i = 0; i < ENTITIES_COUNT; ++i)
+    {
+      const float dist = float((i * 7919) % ENTITIES_COUNT) * 0.01f;
+      ComponentsMap cmap;
+      cmap.add(HASH("ordered_dist"), dist);
+      cmap.add(HASH("ordered_id"), i);
+      eids.emplace_back() = g_mgr->createEntitySync("ordered-index-test", eastl::move(cmap));
+      dists.push_back(dist);
+    }
+    g_mgr->rebuildOrderedIndex(*ecs::find_ordered_index(HASH("ordered_test_index")));
+    g_mgr->performQuery(_reg_query_ordered_test_near.queryId);
+  }
+
+  void TearDown() override
+  {
+    for (const auto &eid : eids)
+      ecs::delete_entity(eid);
+    eids.clear();
+    dists.clear();
+    ecs::tick();
+  }
+
+  void setDist(int i, float dist)
+  {
+    const Entity &e = g_mgr->entities[eids[i].index];
+    Archetype &type = g_mgr->archetypes[e.archetypeId];
+    *(float*)type.getRaw(e.indexInArchetype, type.getComponentIndex(HASH("ordered_dist"))) = dist;
+    dists[i] = dist;
+  }
+
+  void checkRange(OrderedIndex &index, const OrderedRange &range)
+  {
+    eastl::vector<bool> found(dists.size(), false);
+    float prev = -1.f;
+    int count = 0;
+    index.forEachInRange(range, [&](QueryIterator &iter)
+    {
+      const float dist = iter.get<float>(0);
+      const int id = iter.get<int>(1);
+      EXPECT_TRUE(range.contains(dist));
+      EXPECT_LE(prev, dist);
+      EXPECT_FALSE(found[id]);
+      found[id] = true;
+      prev = dist;
+      ++count;
+    });
+
+    int expected = 0;
+    for (int i = 0; i < (int)dists.size(); ++i)
+    {
+      EXPECT_EQ(range.contains(dists[i]), found[i]) << i;
+      expected += range.contains(dists[i]) ? 1 : 0;
+    }
+    EXPECT_EQ(expected, count);
+    EXPECT_EQ(expected, index.count(range));
+  }
+
+  void checkPlannedQuery()
+  {
+    const QueryId qid = _reg_query_ordered_test_near.queryId;
+    EXPECT_GE(g_mgr->queryDescriptions[qid.index].orderedIndex, 0);
+
+    eastl::vector<bool> found(dists.size(), false);
+    Query &query = ecs::get_query(qid);
+    int count = 0;
+    for (auto q = query.begin(), e = query.end(); q != e; ++q, ++count)
+    {
+      const int id = q.get<int>(0);
+      EXPECT_FALSE(found[id]);
+      found[id] = true;
+    }
+
+    int expected = 0;
+    for (int i = 0; i < (int)dists.size(); ++i)
+    {
+      const bool inside = dists[i] < 10 && i % 2 == 0;
+      EXPECT_EQ(inside, found[i]) << i;
+      expected += inside ? 1 : 0;
+    }
+    EXPECT_EQ(expected, count);
+    EXPECT_EQ(expected, query.entitiesCount);
+  }
+};
+
+TEST_F(OrderedIndexTest, Range)
+{
+  OrderedIndex *index = ecs::find_ordered_index(HASH("ordered_test_index"));
+  ASSERT_TRUE(index != nullptr);
+  EXPECT_EQ(ENTITIES_COUNT, (int)index->rows.size());
+
+  checkRange(*index, OrderedRange::less(10));
+  checkRange(*index, OrderedRange::lessEqual(10));
+  checkRange(*index, OrderedRange::greater(99.5f));
+  checkRange(*index, OrderedRange::greaterEqual(25) & OrderedRange::less(26));
+  checkRange(*index, OrderedRange::equal(dists[17]));
+  checkRange(*index, OrderedRange::greater(50) & OrderedRange::less(40));
+  checkRange(*index, OrderedRange());
+}
+
+TEST_F(OrderedIndexTest, TopK)
+{
+  OrderedIndex *index = ecs::find_ordered_index(HASH("ordered_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  eastl::vector<float> sorted = dists;
+  eastl::sort(sorted.begin(), sorted.end());
+
+  int k = 0;
+  index->forEachFirst(32, [&](QueryIterator &iter) { EXPECT_EQ(sorted[k++], iter.get<float>(0)); });
+  EXPECT_EQ(32, k);
+
+  k = 0;
+  index->forEachLast(32, [&](QueryIterator &iter) { EXPECT_EQ(sorted[ENTITIES_COUNT - 1 - k++], iter.get<float>(0)); });
+  EXPECT_EQ(32, k);
+
+  k = 0;
+  index->forEachFirst(ENTITIES_COUNT * 2, [&](QueryIterator &) { ++k; });
+  EXPECT_EQ(ENTITIES_COUNT, k);
+}
+
+TEST_F(OrderedIndexTest, PlannedQuery)
+{
+  checkPlannedQuery();
+}
+
+TEST_F(OrderedIndexTest, IncrementalUpdate)
+{
+  OrderedIndex *index = ecs::find_ordered_index(HASH("ordered_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  FrameSnapshot snapshot;
+  g_mgr->fillFrameSnapshot(snapshot);
+
+  // Move some entities into the range of the planned query and some out of it
+  for (int i = 0; i < ENTITIES_COUNT; i += 97)
+    setDist(i, dists[i] < 10 ? 50.f + float(i) * 0.001f : float(i) * 0.0001f);
+
+  g_mgr->checkFrameSnapshot(snapshot);
+  ecs::tick();
+
+  EXPECT_EQ(ENTITIES_COUNT, (int)index->rows.size());
+  checkRange(*index, OrderedRange::less(10));
+  checkRange(*index, OrderedRange::greaterEqual(50) & OrderedRange::less(51));
+  checkPlannedQuery();
+
+  // Matches the full rebuild
+  g_mgr->rebuildOrderedIndex(*index);
+  checkRange(*index, OrderedRange::less(10));
+  checkRange(*index, OrderedRange::greaterEqual(50) & OrderedRange::less(51));
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static Query make_query(std::initializer_list<int> entities_in_chunk)
+{
+  Query query;
+  for (int count : entities_in_chunk)
+  {
+    query.chunkOffsets.push_back(query.entitiesCount);
+    query.entitiesInChunk.push_back(count);
+    query.entitiesCount += count;
+    ++query.chunksCount;
+  }
+  return query;
+}
+
+TEST(QueryTasks, FindChunk)
+{
+  Query query = make_query({ 3, 5, 1, 10 });
+
+  EXPECT_EQ(0, query.findChunk(0));
+  EXPECT_EQ(0, query.findChunk(2));
+  EXPECT_EQ(1, query.findChunk(3));
+  EXPECT_EQ(1, query.findChunk(7));
+  EXPECT_EQ(2, query.findChunk(8));
+  EXPECT_EQ(3, query.findChunk(9));
+  EXPECT_EQ(3, query.findChunk(18));
+}
+
+TEST(QueryTasks, SplitOnChunkBoundaries)
+{
+  Query query = make_query({ 3, 5, 1, 10, 2 });
+
+  eastl::vector<Query::Task> tasks;
+  query.splitToTasks(4, tasks);
+
+  // 3 | 5 -> 4 + 1 | 1 | 10 -> 4 + 4 + 2 | 2
+  ASSERT_EQ(8, (int)tasks.size());
+
+  int total = 0;
+  for (const auto &task : tasks)
+  {
+    EXPECT_LE(task.count, 4);
+    EXPECT_EQ(query.chunkOffsets[task.chunkIdx] + task.offset, total);
+    total += task.count;
+  }
+  EXPECT_EQ(query.entitiesCount, total);
+}
+
+TEST(QueryTasks, MergeSmallChunks)
+{
+  Query query = make_query({ 1, 1, 1, 1, 1, 1 });
+
+  eastl::vector<Query::Task> tasks;
+  query.splitToTasks(4, tasks);
+
+  ASSERT_EQ(2, (int)tasks.size());
+  EXPECT_EQ(4, tasks[0].count);
+  EXPECT_EQ(4, tasks[1].chunkIdx);
+  EXPECT_EQ(2, tasks[1].count);
+}
@@ -182,13 +182,19 @@ static constexpr ConstQueryDescription TestIndex_query_desc = {
 };
 IndexDescription _reg_index_test(HASH("test_index"), HASH("grid_cell"), TestIndex_query_desc);
 
+template <typename T, typename Builder>
+static QueryIterable<T, Builder> make_bucket_iterable(const IndexBucket &bucket)
+{
+  return QueryIterable<T, Builder>(bucket.begin(), bucket.end(), bucket.entitiesCount);
+}
+
 TEST_F(QueryTest, Index)
 {
   Index *index = ecs::find_index(HASH("test_index"));
   g_mgr->rebuildIndex(*index);
 
   EXPECT_EQ(index->itemsMap.size(), 10ul);
-  EXPECT_EQ(index->queries.size(), 10ul);
+  EXPECT_EQ(index->itemsCount(), 10);
 
   using TestViewBuilder = StructBuilder<
     StructField<int, INDEX_OF_COMPONENT(TestIndex, grid_cell)>,
@@ -198,19 +204,19 @@ TEST_F(QueryTest, Index)
   TestIndexSystem testSystem;
   EventUpdate evt;
   for (const auto &item : index->itemsMap)
-    testSystem.run(evt, *(int*)(uint8_t*)&item.first, QueryIterable<TestView, TestViewBuilder>(index->queries[item.second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&item.first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(item.second)));
 
   EXPECT_EQ(testSystem.entitiesIterCount, 30);
   EXPECT_EQ(testSystem.entitiesCount, 30);
   EXPECT_EQ(testSystem.errorsCount, 0);
 
-  auto res = index->itemsMap.find(6);
-  EXPECT_TRUE(res != index->itemsMap.end() && res->first == 6);
-  if (res != index->itemsMap.end() && res->first == 6)
+  auto res = index->itemsMap.find(IndexKey::make(6));
+  EXPECT_TRUE(res != index->itemsMap.end() && res->first == IndexKey::make(6));
+  if (res != index->itemsMap.end() && res->first == IndexKey::make(6))
   {
     TestIndexSystem testSystem;
     EventUpdate evt;
-    testSystem.run(evt, *(int*)(uint8_t*)&res->first, QueryIterable<TestView, TestViewBuilder>(index->queries[res->second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&res->first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(res->second)));
 
     EXPECT_EQ(testSystem.entitiesIterCount, 3);
     EXPECT_EQ(testSystem.entitiesCount, 3);
@@ -227,7 +233,7 @@ TEST_F(QueryTest, Index_Delete)
   ecs::tick();
 
   EXPECT_EQ(index->itemsMap.size(), 10ul);
-  EXPECT_EQ(index->queries.size(), 10ul);
+  EXPECT_EQ(index->itemsCount(), 10);
 
   using TestViewBuilder = StructBuilder<
     StructField<int, INDEX_OF_COMPONENT(TestIndex, grid_cell)>,
@@ -237,7 +243,7 @@ TEST_F(QueryTest, Index_Delete)
   TestIndexSystem testSystem;
   EventUpdate evt;
   for (const auto &item : index->itemsMap)
-    testSystem.run(evt, *(int*)(uint8_t*)&item.first, QueryIterable<TestView, TestViewBuilder>(index->queries[item.second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&item.first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(item.second)));
 
   EXPECT_EQ(testSystem.entitiesIterCount, 29);
   EXPECT_EQ(testSystem.entitiesCount, 29);
@@ -249,7 +255,7 @@ TEST_F(QueryTest, Index_Delete)
   {
     TestIndexSystem testSystem;
     EventUpdate evt;
-    testSystem.run(evt, *(int*)(uint8_t*)&res->first, QueryIterable<TestView, TestViewBuilder>(index->queries[res->second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&res->first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(res->second)));
 
     EXPECT_EQ(testSystem.entitiesIterCount, 2);
     EXPECT_EQ(testSystem.entitiesCount, 2);
@@ -278,7 +284,7 @@ TEST_F(QueryTest, Index_ChangeDetection)
   ecs::tick();
 
   EXPECT_EQ(index->itemsMap.size(), 10ul);
-  EXPECT_EQ(index->queries.size(), 10ul);
+  EXPECT_EQ(index->itemsCount(), 10);
 
   using TestViewBuilder = StructBuilder<
     StructField<int, INDEX_OF_COMPONENT(TestIndex, grid_cell)>,
@@ -288,7 +294,7 @@ TEST_F(QueryTest, Index_ChangeDetection)
   TestIndexSystem testSystem;
   EventUpdate evt;
   for (const auto &item : index->itemsMap)
-    testSystem.run(evt, *(int*)(uint8_t*)&item.first, QueryIterable<TestView, TestViewBuilder>(index->queries[item.second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&item.first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(item.second)));
 
   EXPECT_EQ(testSystem.entitiesIterCount, 30);
   EXPECT_EQ(testSystem.entitiesCount, 30);
@@ -300,7 +306,7 @@ TEST_F(QueryTest, Index_ChangeDetection)
   {
     TestIndexSystem testSystem;
     EventUpdate evt;
-    testSystem.run(evt, *(int*)(uint8_t*)&res->first, QueryIterable<TestView, TestViewBuilder>(index->queries[res->second]));
+    testSystem.run(evt, *(int*)(uint8_t*)&res->first, make_bucket_iterable<TestView, TestViewBuilder>(index->bucket(res->second)));
 
     EXPECT_EQ(testSystem.entitiesIterCount, 2);
     EXPECT_EQ(testSystem.entitiesCount, 2);
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+#include <ecs/simd.h>
+
+struct SimdVec2 : glm::vec2 {};
+ECS_COMPONENT_LAYOUT(SimdVec2, soa);
+
+static void fill(eastl::vector<glm::vec2> &v, eastl::vector<float> &f, int count)
+{
+  v.resize(count);
+  f.resize(count);
+  for (int i = 0; i < count; ++i)
+  {
+    v[i] = glm::vec2(float(i % 7) - 3.f, float(i % 5) - 2.f);
+    f[i] = 0.5f + float(i % 3);
+  }
+  // Zero vector must stay zero
+  if (count > 3)
+    v[3] = glm::vec2(0.f, 0.f);
+}
+
+static void expect_near(const eastl::vector<glm::vec2> &a, const eastl::vector<glm::vec2> &b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (int i = 0; i < (int)a.size(); ++i)
+  {
+    EXPECT_NEAR(a[i].x, b[i].x, 1e-5f) << i;
+    EXPECT_NEAR(a[i].y, b[i].y, 1e-5f) << i;
+  }
+}
+
+TEST(SIMD, AllLevelsMatchScalar)
+{
+  const simd::Level cpuLevel = simd::get_cpu_level();
+
+  // Odd count to check tails
+  const int count = 37;
+
+  eastl::vector<glm::vec2> src, expected, actual;
+  eastl::vector<float> scale;
+  fill(src, scale, count);
+
+  for (int level = (int)simd::Level::kSSE4; level <= (int)cpuLevel; ++level)
+  {
+    auto run = [&](simd::Level l, eastl::vector<glm::vec2> &out)
+    {
+      simd::set_level(l);
+      out = src;
+      Span<glm::vec2> v(out.data(), count);
+      simd::madd(v, Span<const glm::vec2>(src.data(), count), 0.25f);
+      simd::madd(v, Span<const glm::vec2>(src.data(), count), Span<const float>(scale.data(), count));
+      simd::mul(v, Span<const float>(scale.data(), count));
+      simd::set_length(v, Span<const float>(scale.data(), count));
+      simd::normalize(v);
+    };
+
+    run(simd::Level::kScalar, expected);
+    run((simd::Level)level, actual);
+
+    SCOPED_TRACE(simd::get_level_name((simd::Level)level));
+    expect_near(expected, actual);
+    EXPECT_EQ(0.f, actual[3].x);
+    EXPECT_EQ(0.f, actual[3].y);
+  }
+
+  simd::set_level(cpuLevel);
+}
+
+TEST(SIMD, LanesMatchSpans)
+{
+  const simd::Level cpuLevel = simd::get_cpu_level();
+
+  const int count = 37;
+
+  eastl::vector<glm::vec2> src, expected;
+  eastl::vector<float> scale;
+  fill(src, scale, count);
+
+  // x and y lanes of a SoA block
+  eastl::vector<float> srcLanes(2 * SOA_BLOCK_SIZE, 0.f), lanes;
+  for (int i = 0; i < count; ++i)
+  {
+    srcLanes[i] = src[i].x;
+    srcLanes[SOA_BLOCK_SIZE + i] = src[i].y;
+  }
+
+  for (int level = (int)simd::Level::kScalar; level <= (int)cpuLevel; ++level)
+  {
+    simd::set_level((simd::Level)level);
+
+    expected = src;
+    Span<glm::vec2> v(expected.data(), count);
+    simd::madd(v, Span<const glm::vec2>(src.data(), count), 0.25f);
+    simd::madd(v, Span<const glm::vec2>(src.data(), count), Span<const float>(scale.data(), count));
+    simd::mul(v, Span<const float>(scale.data(), count));
+    simd::set_length(v, Span<const float>(scale.data(), count));
+    simd::normalize(v);
+
+    lanes = srcLanes;
+    Lanes<SimdVec2> l(lanes.data(), count);
+    Lanes<const SimdVec2> s(srcLanes.data(), count);
+    simd::madd(l, s, 0.25f);
+    simd::madd(l, s, Span<const float>(scale.data(), count));
+    simd::mul(l, Span<const float>(scale.data(), count));
+    simd::set_length(l, Span<const float>(scale.data(), count));
+    simd::normalize(l);
+
+    SCOPED_TRACE(simd::get_level_name((simd::Level)level));
+    for (int i = 0; i < count; ++i)
+    {
+      EXPECT_NEAR(expected[i].x, lanes[i], 1e-5f) << i;
+      EXPECT_NEAR(expected[i].y, lanes[SOA_BLOCK_SIZE + i], 1e-5f) << i;
+    }
+    EXPECT_EQ(0.f, lanes[3]);
+    EXPECT_EQ(0.f, lanes[SOA_BLOCK_SIZE + 3]);
+    // The rest of the block is untouched
+    EXPECT_EQ(0.f, lanes[count]);
+  }
+
+  simd::set_level(cpuLevel);
+}
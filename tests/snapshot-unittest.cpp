@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription SnapshotTest_components[] = {
+  {HASH("eid"), sizeof(EntityId)},
+  {HASH("snapshot_value"), sizeof(int)},
+  {HASH("snapshot_name"), sizeof(eastl::string)},
+};
+static constexpr ConstQueryDescription SnapshotTest_query_desc = {
+  make_const_array(SnapshotTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+struct SnapshotTest : public testing::Test
+{
+  static constexpr int ENTITIES_COUNT = 10000;
+
+  static void SetUpTestCase()
+  {
+    ComponentsMap cmap;
+    cmap.createComponent(HASH("snapshot_value"), find_component(HASH("int")));
+    cmap.createComponent(HASH("snapshot_name"), find_component("string"));
+    g_mgr->addTemplate("snapshot-test", eastl::move(cmap));
+  }
+
+  static EntityId createEntity(int value)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("snapshot_value"), value);
+    cmap.add(HASH("snapshot_name"), eastl::string(eastl::string::CtorSprintf(), "entity-%d", value));
+    return ecs::create_entity_sync("snapshot-test", eastl::move(cmap));
+  }
+
+  static Archetype& getArchetype()
+  {
+    return g_mgr->archetypes[g_mgr->templates[g_mgr->getTemplateId("snapshot-test")].archetypeId];
+  }
+
+  void TearDown() override
+  {
+    Query query = ecs::perform_query(SnapshotTest_query_desc);
+    for (auto q = query.begin(), e = query.end(); q != e; ++q)
+      ecs::delete_entity(q.get<EntityId>(0));
+    ecs::tick();
+  }
+};
+
+TEST_F(SnapshotTest, Restore)
+{
+  eastl::vector<EntityId> eids;
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+    eids.push_back(createEntity(i));
+  ecs::tick();
+
+  eastl::shared_ptr<WorldSnapshot> snapshot = ecs::snapshot();
+
+  Query query = ecs::perform_query(SnapshotTest_query_desc);
+  for (auto q = query.begin(), e = query.end(); q != e; ++q)
+  {
+    q.get<int>(1) += ENTITIES_COUNT;
+    q.get<eastl::string>(2) = "changed";
+  }
+  for (int i = 0; i < ENTITIES_COUNT / 10; ++i)
+    ecs::delete_entity(eids[i]);
+  ecs::tick();
+  const EntityId created = createEntity(-1);
+  ecs::tick();
+
+  EXPECT_EQ(ENTITIES_COUNT - ENTITIES_COUNT / 10 + 1, ecs::perform_query(SnapshotTest_query_desc).entitiesCount);
+
+  ecs::restore(snapshot);
+
+  EXPECT_FALSE(g_mgr->eidFactory.isValid(created));
+
+  query = ecs::perform_query(SnapshotTest_query_desc);
+  EXPECT_EQ(ENTITIES_COUNT, query.entitiesCount);
+  for (auto q = query.begin(), e = query.end(); q != e; ++q)
+  {
+    const int value = q.get<int>(1);
+    ASSERT_TRUE(value >= 0 && value < ENTITIES_COUNT);
+    EXPECT_EQ(eids[value], q.get<EntityId>(0));
+    EXPECT_EQ(eastl::string(eastl::string::CtorSprintf(), "entity-%d", value), q.get<eastl::string>(2));
+  }
+
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+  {
+    ASSERT_TRUE(g_mgr->eidFactory.isValid(eids[i]));
+    const Entity &entity = g_mgr->entities[eids[i].index];
+    const Archetype &type = g_mgr->archetypes[entity.archetypeId];
+    EXPECT_EQ(i, type.get<int>(entity.indexInArchetype, type.getComponentIndex(HASH("snapshot_value"))));
+  }
+}
+
+TEST_F(SnapshotTest, SharedBlocks)
+{
+  EntityId eid;
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+    eid = createEntity(i);
+  ecs::tick();
+
+  Archetype &type = getArchetype();
+  const int archetypeId = g_mgr->templates[g_mgr->getTemplateId("snapshot-test")].archetypeId;
+  const int valueIdx = type.getComponentIndex(HASH("snapshot_value"));
+
+  eastl::shared_ptr<WorldSnapshot> first = ecs::snapshot();
+  eastl::shared_ptr<WorldSnapshot> second = ecs::snapshot();
+
+  const WorldSnapshot::Column &firstColumn = first->archetypes[archetypeId].columns[valueIdx];
+  const WorldSnapshot::Column &secondColumn = second->archetypes[archetypeId].columns[valueIdx];
+  ASSERT_GT(firstColumn.blocks.size(), 1);
+  ASSERT_EQ(firstColumn.blocks.size(), secondColumn.blocks.size());
+  for (size_t i = 0; i < firstColumn.blocks.size(); ++i)
+    EXPECT_EQ(firstColumn.blocks[i], secondColumn.blocks[i]);
+  EXPECT_EQ(first->entities.blocks, second->entities.blocks);
+
+  // Only the block of the changed item is copied
+  const int32_t index = g_mgr->entities[eid.index].indexInArchetype;
+  const int value = type.get<int>(index, valueIdx);
+  type.get<int>(index, valueIdx) = -1;
+
+  eastl::shared_ptr<WorldSnapshot> third = ecs::snapshot();
+  const WorldSnapshot::Column &thirdColumn = third->archetypes[archetypeId].columns[valueIdx];
+  const size_t changedBlock = index * sizeof(int) / WorldSnapshot::BLOCK_SIZE;
+  for (size_t i = 0; i < thirdColumn.blocks.size(); ++i)
+    if (i == changedBlock)
+      EXPECT_NE(secondColumn.blocks[i], thirdColumn.blocks[i]);
+    else
+      EXPECT_EQ(secondColumn.blocks[i], thirdColumn.blocks[i]);
+
+  ecs::restore(second);
+  EXPECT_EQ(value, type.get<int>(index, valueIdx));
+}
+
+TEST_F(SnapshotTest, PendingWorkIsDropped)
+{
+  eastl::vector<EntityId> eids;
+  for (int i = 0; i < 100; ++i)
+    eids.push_back(createEntity(i));
+  ecs::tick();
+
+  eastl::shared_ptr<WorldSnapshot> snapshot = ecs::snapshot();
+
+  ecs::delete_entity(eids[0]);
+  ComponentsMap cmap;
+  cmap.add(HASH("snapshot_value"), -1);
+  ecs::create_entity("snapshot-test", eastl::move(cmap));
+
+  ecs::restore(snapshot);
+  ecs::tick();
+
+  EXPECT_TRUE(g_mgr->eidFactory.isValid(eids[0]));
+  EXPECT_EQ(100, ecs::perform_query(SnapshotTest_query_desc).entitiesCount);
+}
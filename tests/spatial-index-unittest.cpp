@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+static constexpr ConstComponentDescription SpatialTest_components[] = {
+  {HASH("spatial_pos"), sizeof(glm::vec2)},
+  {HASH("spatial_id"), sizeof(int)},
+};
+static constexpr ConstQueryDescription SpatialTest_query_desc = {
+  make_const_array(SpatialTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+static SpatialIndexDescription _reg_spatial_index_test(HASH("spatial_test_index"), HASH("spatial_pos"), 10.f, SpatialTest_query_desc);
+
+struct SpatialSoAVel
+{
+  using value_type = float;
+  float x = 0.f;
+  float y = 0.f;
+};
+
+ECS_COMPONENT_TYPE(SpatialSoAVel);
+ECS_COMPONENT_LAYOUT(SpatialSoAVel, soa);
+
+static ComponentDescriptionDetails<SpatialSoAVel> spatial_soa_vel_desc("SpatialSoAVel");
+
+static constexpr ConstComponentDescription SpatialSoATest_components[] = {
+  {HASH("spatial_soa_pos"), sizeof(glm::vec2)},
+  {HASH("spatial_soa_id"), sizeof(int)},
+  {HASH("spatial_soa_vel"), sizeof(SpatialSoAVel)},
+};
+static constexpr ConstQueryDescription SpatialSoATest_query_desc = {
+  make_const_array(SpatialSoATest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+static SpatialIndexDescription _reg_spatial_index_soa_test(HASH("spatial_soa_test_index"), HASH("spatial_soa_pos"), 10.f, SpatialSoATest_query_desc);
+
+struct SpatialIndexTest : public testing::Test
+{
+  // 100x100 grid with 3.f step around the origin, enough for several partitions
+  static constexpr int GRID_SIZE = 100;
+  static constexpr float STEP = 3.f;
+
+  EntityVector eids;
+  eastl::vector<glm::vec2> positions;
+
+  static void SetUpTestCase()
+  {
+    ComponentsMap cmap;
+    cmap.createComponent(HASH("spatial_pos"), find_component("vec2"));
+    cmap.createComponent(HASH("spatial_id"), find_component(HASH("int")));
+    g_mgr->addTemplate("spatial-index-test", eastl::move(cmap));
+  }
+
+  void SetUp() override
+  {
+    for (int x = 0; x < GRID_SIZE; ++x)
+      for (int y = 0; y < GRID_SIZE; ++y)
+      {
+        const glm::vec2 pos(float(x - GRID_SIZE / 2) * STEP, float(y - GRID_SIZE / 2) * STEP);
+        ComponentsMap cmap;
+        cmap.add(HASH("spatial_pos"), pos);
+        cmap.add(HASH("spatial_id"), (int)positions.size());
+        eids.emplace_back() = g_mgr->createEntitySync("spatial-index-test", eastl::move(cmap));
+        positions.push_back(pos);
+      }
+    g_mgr->rebuildSpatialIndex(*ecs::find_spatial_index(HASH("spatial_test_index")));
+  }
+
+  void TearDown() override
+  {
+    for (const auto &eid : eids)
+      ecs::delete_entity(eid);
+    eids.clear();
+    positions.clear();
+    ecs::tick();
+  }
+};
+
+TEST_F(SpatialIndexTest, Radius)
+{
+  SpatialIndex *index = ecs::find_spatial_index(HASH("spatial_test_index"));
+  ASSERT_TRUE(index != nullptr);
+  EXPECT_EQ(GRID_SIZE * GRID_SIZE, (int)index->rows.size());
+
+  const glm::vec2 centers[] = { glm::vec2(0.f, 0.f), glm::vec2(-31.5f, 17.f), glm::vec2(148.f, -149.f) };
+  const float radii[] = { 0.5f, 9.f, 25.f, 1000.f };
+
+  for (const glm::vec2 &center : centers)
+    for (float radius : radii)
+    {
+      eastl::vector<bool> found(positions.size(), false);
+      int count = 0;
+      index->forEachInRadius(center, radius, [&](QueryIterator &iter)
+      {
+        const int id = iter.get<int>(1);
+        EXPECT_FALSE(found[id]);
+        EXPECT_EQ(positions[id].x, iter.get<glm::vec2>(0).x);
+        found[id] = true;
+        ++count;
+      });
+
+      int expected = 0;
+      for (int i = 0; i < (int)positions.size(); ++i)
+      {
+        const glm::vec2 d = positions[i] - center;
+        const bool inside = d.x * d.x + d.y * d.y <= radius * radius;
+        EXPECT_EQ(inside, found[i]) << i;
+        expected += inside ? 1 : 0;
+      }
+      EXPECT_EQ(expected, count);
+    }
+}
+
+TEST_F(SpatialIndexTest, Aabb)
+{
+  SpatialIndex *index = ecs::find_spatial_index(HASH("spatial_test_index"));
+  ASSERT_TRUE(index != nullptr);
+
+  const glm::vec2 min(-10.f, -4.f);
+  const glm::vec2 max(5.f, 20.f);
+
+  int count = 0;
+  index->forEachInAabb(min, max, [&](QueryIterator &iter)
+  {
+    const glm::vec2 &pos = iter.get<glm::vec2>(0);
+    EXPECT_TRUE(pos.x >= min.x && pos.x <= max.x && pos.y >= min.y && pos.y <= max.y);
+    ++count;
+  });
+
+  // x in [-9, 3], y in [-3, 18]
+  EXPECT_EQ(5 * 8, count);
+}
+
+// Positions are AoS, another column of the archetype is SoA and rows read it across blocks
+TEST(SpatialIndex, SoAColumn)
+{
+  static constexpr int ENTITIES_COUNT = 1000;
+
+  ComponentsMap templ;
+  templ.createComponent(HASH("spatial_soa_pos"), find_component("vec2"));
+  templ.createComponent(HASH("spatial_soa_id"), find_component(HASH("int")));
+  templ.createComponent(HASH("spatial_soa_vel"), find_component("SpatialSoAVel"));
+  g_mgr->addTemplate("spatial-index-soa-test", eastl::move(templ));
+
+  EntityVector eids;
+  for (int i = 0; i < ENTITIES_COUNT; ++i)
+  {
+    ComponentsMap cmap;
+    cmap.add(HASH("spatial_soa_pos"), glm::vec2(float(i), 0.f));
+    cmap.add(HASH("spatial_soa_id"), i);
+    cmap.add(HASH("spatial_soa_vel"), SpatialSoAVel{ float(i), float(-i) });
+    eids.emplace_back() = g_mgr->createEntitySync("spatial-index-soa-test", eastl::move(cmap));
+  }
+
+  SpatialIndex *index = ecs::find_spatial_index(HASH("spatial_soa_test_index"));
+  ASSERT_TRUE(index != nullptr);
+  g_mgr->rebuildSpatialIndex(*index);
+  EXPECT_EQ(ENTITIES_COUNT, (int)index->rows.size());
+
+  int count = 0;
+  index->forEachInRadius(glm::vec2(500.f, 0.f), 300.5f, [&](QueryIterator &iter)
+  {
+    const int id = iter.get<int>(1);
+    const SpatialSoAVel vel = iter.get<SpatialSoAVel>(2);
+    EXPECT_EQ(float(id), vel.x);
+    EXPECT_EQ(float(-id), vel.y);
+    ++count;
+  });
+  EXPECT_EQ(601, count);
+
+  for (const auto &eid : eids)
+    ecs::delete_entity(eid);
+  ecs::tick();
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <ecs/ecs.h>
+
+#include <atomic>
+#include <thread>
+
+static constexpr ConstComponentDescription WorldTest_components[] = {
+  {HASH("eid"), sizeof(EntityId)},
+  {HASH("world_value"), sizeof(int)},
+};
+static constexpr ConstQueryDescription WorldTest_query_desc = {
+  make_const_array(WorldTest_components),
+  empty_desc_array,
+  empty_desc_array,
+  empty_desc_array,
+};
+
+struct WorldTest : public testing::Test
+{
+  static constexpr int WORLDS_COUNT = 4;
+  static constexpr int ENTITIES_COUNT = 10000;
+
+  eastl::vector<EntityManager*> worlds;
+
+  void SetUp() override
+  {
+    for (int i = 0; i < WORLDS_COUNT; ++i)
+    {
+      EntityManager *world = ecs::create_world();
+      worlds.push_back(world);
+
+      ecs::set_world(world);
+      ComponentsMap cmap;
+      cmap.createComponent(HASH("world_value"), find_component(HASH("int")));
+      g_mgr->addTemplate("world-test", eastl::move(cmap));
+    }
+    ecs::set_world(EntityManager::mainWorld);
+  }
+
+  void TearDown() override
+  {
+    for (EntityManager *world : worlds)
+      ecs::destroy_world(world);
+    EXPECT_EQ(EntityManager::mainWorld, ecs::get_world());
+  }
+
+  static void createEntities(int value)
+  {
+    for (int i = 0; i < ENTITIES_COUNT; ++i)
+    {
+      ComponentsMap cmap;
+      cmap.add(HASH("world_value"), value);
+      ecs::create_entity("world-test", eastl::move(cmap));
+    }
+  }
+};
+
+TEST_F(WorldTest, Separate)
+{
+  for (int i = 0; i < WORLDS_COUNT; ++i)
+  {
+    ecs::set_world(worlds[i]);
+    createEntities(i);
+    ecs::tick();
+  }
+  ecs::set_world(EntityManager::mainWorld);
+
+  EXPECT_EQ(0, ecs::perform_query(WorldTest_query_desc).entitiesCount);
+
+  for (int i = 0; i < WORLDS_COUNT; ++i)
+  {
+    ecs::set_world(worlds[i]);
+
+    Query query = ecs::perform_query(WorldTest_query_desc);
+    EXPECT_EQ(ENTITIES_COUNT, query.entitiesCount);
+    for (auto q = query.begin(), e = query.end(); q != e; ++q)
+      EXPECT_EQ(i, q.get<int>(1));
+
+    // The static registrations are shared
+    EXPECT_EQ(EntityManager::mainWorld->systems.size(), g_mgr->systems.size());
+  }
+  ecs::set_world(EntityManager::mainWorld);
+}
+
+TEST_F(WorldTest, Concurrent)
+{
+  eastl::vector<int64_t> sums(WORLDS_COUNT, 0);
+  std::atomic<int> wrongWorld = 0;
+  eastl::vector<std::thread::id> threads(WORLDS_COUNT);
+
+  for (int frame = 0; frame < 3; ++frame)
+    ecs::run_worlds(worlds, [&](EntityManager *world)
+    {
+      const int worldNo = int(eastl::find(worlds.begin(), worlds.end(), world) - worlds.begin());
+      EXPECT_EQ(world, ecs::get_world());
+
+      // A world keeps its thread between frames
+      if (frame == 0)
+        threads[worldNo] = std::this_thread::get_id();
+      else
+        EXPECT_EQ(threads[worldNo], std::this_thread::get_id());
+
+      createEntities(worldNo + 1);
+      ecs::tick();
+
+      // The jobs run in the world which created them
+      Query query = ecs::perform_query(WorldTest_query_desc);
+      std::atomic<int64_t> sum = 0;
+      ecs::parallel_for(query, 256, [&](uint8_t * __restrict * __restrict columns, int offset, int count)
+      {
+        if (ecs::get_world() != world)
+          ++wrongWorld;
+        const int *values = (const int*)columns[1] + offset;
+        int64_t localSum = 0;
+        for (int i = 0; i < count; ++i)
+          localSum += values[i];
+        sum += localSum;
+      });
+      sums[worldNo] = sum.load();
+
+      clear_frame_mem();
+    });
+
+  EXPECT_EQ(0, wrongWorld.load());
+  for (int i = 0; i < WORLDS_COUNT; ++i)
+    EXPECT_EQ(int64_t(i + 1) * ENTITIES_COUNT * 3, sums[i]);
+}